@@ -88,6 +88,7 @@ ECHO INCLNET = /I"%BLDDIR%libnet\include" >> Makefile.constants
 ECHO INCLHTTPCMN = /I"%BLDDIR%http\include\common" >> Makefile.constants
 ECHO INCLHTTPSRVR = /I"%BLDDIR%http\include\server" >> Makefile.constants
 ECHO INCLHTTPCLNT = /I"%BLDDIR%http\include\client" >> Makefile.constants
+ECHO INCLRDBD = /I"%BLDDIR%rdbd\include" >> Makefile.constants
 ECHO INCLTF = /I"%BLDDIR%tf" >> Makefile.constants
 ECHO INCLSSL = /I"%BLDDIR%ssl\%BLDPLAT%\include" /I"%BLDDIR%libsslwrapper\include" >> Makefile.constants
 ECHO LIBCOM = "%BLDDIR%libcom\src\%BLDPLAT%\com.lib" >> Makefile.constants
@@ -99,6 +100,7 @@ ECHO LIBNET = "%BLDDIR%libnet\src\%BLDPLAT%\net.lib" >> Makefile.constants
 ECHO LIBHTTPCMN = "%BLDDIR%http\src\common\%BLDPLAT%\httpcmn.lib" >> Makefile.constants
 ECHO LIBHTTPSRVR = "%BLDDIR%http\src\server\%BLDPLAT%\httpsrvr.lib" >> Makefile.constants
 ECHO LIBHTTPCLNT = "%BLDDIR%http\src\common\%BLDPLAT%\httpclnt.lib" >> Makefile.constants
+ECHO LIBRDBD = "%BLDDIR%rdbd\src\%BLDPLAT%\rdbd.lib" >> Makefile.constants
 
 ECHO Makefile.constants generated successfully
 
@@ -84,6 +84,7 @@ if [ "$PLAT" = "Linux" ]; then
 		INCLHTTPCMN = -I`pwd`/http/include/common
 		INCLHTTPSRVR = -I`pwd`/http/include/server
 		INCLHTTPCLNT = -I`pwd`/http/include/client
+		INCLRDBD = -I`pwd`/rdbd/include
 		INCLTF = -I`pwd`/tf
 		INCLSSL = -I`pwd`/ssl/$BLDPLAT/include -I`pwd`/libsslwrapper/include
 		LIBCOM = `pwd`/libcom/src/$BLDPLAT/libcom.a
@@ -95,6 +96,7 @@ if [ "$PLAT" = "Linux" ]; then
 		LIBHTTPCMN = `pwd`/http/src/common/$BLDPLAT/libhttpcmn.a
 		LIBHTTPSRVR = `pwd`/http/src/server/$BLDPLAT/libhttpsrvr.a
 		LIBHTTPCLNT = `pwd`/http/src/client/$BLDPLAT/libhttpclnt.a
+		LIBRDBD = `pwd`/rdbd/src/$BLDPLAT/librdbd.a
 LINUX_CONFIG
 
 else
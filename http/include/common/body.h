@@ -34,6 +34,10 @@ namespace http {
  * The factory class should be employed to get
  * HTTP body from different sources.
  *
+ * A body read from a file returns the file from
+ * source_file(); such a body can be sent with
+ * nio::sendfile(), without reading the data.
+ *
  * To read the body data, the following style could
  * be employed:
  *
@@ -56,6 +60,7 @@ public:
 	virtual bool chunked() const { return false; }
 	virtual size_t chunk_size() const { return 0; }
 	virtual param_vec_t chunk_extensions() { return param_vec_t(); }
+	virtual snf::file *source_file() { return nullptr; }
 	virtual bool has_next() = 0;
 	virtual const void *next(size_t &) = 0;
 };
@@ -11,14 +11,22 @@ namespace http {
 
 /*
  * Transmits HTTP request/response message.
+ *
+ * Reads from the I/O object are buffered (see nio::setbuf()), so
+ * that the message line and headers are not read a byte at a time.
+ * The data read past a message stays in the I/O object's buffer,
+ * for the next message.
  */
 class transmitter
 {
 private:
+	static const int BUFSIZE = 16384;
+
 	snf::net::nio   *m_io = nullptr;
 
-	int send_data(const void *, size_t, const std::string &);
-	int send_body(body *);
+	int send_datav(const snf::net::iobuf *, int, const std::string &);
+	int send_file(snf::file &, int64_t, const std::string &);
+	int send_message(const std::string &, body *);
 
 public:
 	transmitter(snf::net::nio *io)
@@ -26,6 +34,7 @@ public:
 	{
 		if (m_io == nullptr)
 			throw std::runtime_error("invalid input/output object specified");
+		m_io->setbuf(BUFSIZE);
 	}
 
 	transmitter(const transmitter &t) : m_io(t.m_io) {}
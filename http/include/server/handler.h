@@ -7,18 +7,28 @@
 namespace snf {
 namespace http {
 
+/*
+ * Accepts the connections on a listening socket. The accepted
+ * connections are registered with the given reactor (the one
+ * the listening socket is registered with, when every reactor
+ * has a listening socket of its own), or else spread over the
+ * server reactors round-robin.
+ */
 class accept_handler : public snf::net::handler
 {
 protected:
 	std::unique_ptr<snf::net::socket>   m_sock;
 	snf::net::event                     m_event;
 	bool                                m_secured;
+	snf::net::reactor                   *m_reactor;
 
 public:
-	accept_handler(snf::net::socket *s, snf::net::event e, bool secured = false)
+	accept_handler(snf::net::socket *s, snf::net::event e, bool secured = false,
+		snf::net::reactor *r = nullptr)
 		: m_sock(s)
 		, m_event(e)
 		, m_secured(secured)
+		, m_reactor(r)
 	{
 	}
 
@@ -36,33 +46,43 @@ public:
 	virtual bool operator()(sock_t, snf::net::event) override;
 };
 
+/*
+ * Hands a readable connection over to the thread pool. The
+ * connection is registered again with the same reactor once
+ * the request is processed, so that it stays with its reactor.
+ */
 class read_handler : public snf::net::handler
 {
 protected:
+	snf::net::reactor                  *m_reactor;
 	std::unique_ptr<snf::net::nio>     m_io;
 	std::unique_ptr<snf::net::socket>  m_sock;
 	snf::net::event                    m_event;
 	bool                               m_shutting_down;
 
 public:
-	read_handler(snf::net::nio *io, snf::net::event e)
-		: m_io(io)
+	read_handler(snf::net::reactor *r, snf::net::nio *io, snf::net::event e)
+		: m_reactor(r)
+		, m_io(io)
 		, m_sock(nullptr)
 		, m_event(e)
 		, m_shutting_down(false)
 	{
 	}
 
-	read_handler(snf::net::nio *io, snf::net::socket *s, snf::net::event e)
-		: m_io(io)
+	read_handler(snf::net::reactor *r, snf::net::nio *io, snf::net::socket *s, snf::net::event e)
+		: m_reactor(r)
+		, m_io(io)
 		, m_sock(s)
 		, m_event(e)
 		, m_shutting_down(false)
 	{
 	}
 
-	read_handler(snf::net::nio *io, snf::net::socket *s, snf::net::event e, bool shutting_down)
-		: m_io(io)
+	read_handler(snf::net::reactor *r, snf::net::nio *io, snf::net::socket *s, snf::net::event e,
+		bool shutting_down)
+		: m_reactor(r)
+		, m_io(io)
 		, m_sock(s)
 		, m_event(e)
 		, m_shutting_down(shutting_down)
@@ -7,17 +7,31 @@
 #include "reactor.h"
 #include "thrdpool.h"
 #include "router.h"
+#include <atomic>
 #include <memory>
+#include <vector>
 
 namespace snf {
 namespace http {
 
+/*
+ * HTTP server. Runs a reactor (event loop) per configured
+ * reactor, each pinned to a CPU when there are more than one.
+ * Where SO_REUSEPORT is supported, every reactor has listening
+ * sockets of its own and the kernel spreads the connections
+ * over them; otherwise the first reactor accepts the
+ * connections and hands them over to the reactors round-robin.
+ * A connection stays with its reactor.
+ */
 class server
 {
 private:
+	using reactors_type = std::vector<std::unique_ptr<snf::net::reactor>>;
+
 	const server_config                 *m_config = nullptr;
 	snf::ssl::context                   m_ctx;
-	snf::net::reactor                   m_reactor;
+	reactors_type                       m_reactors;
+	std::atomic<size_t>                 m_next_reactor { 0 };
 	std::unique_ptr<snf::thread_pool>   m_thrdpool;
 	bool                                m_started = false;
 	bool                                m_stopped = false;
@@ -25,7 +39,9 @@ private:
 	server() {}
 
 	int setup_context();
-	snf::net::socket *setup_socket(in_port_t);
+	void setup_reactors();
+	snf::net::socket *setup_socket(in_port_t, bool);
+	int add_listeners(in_port_t, bool);
 
 public:
 	server(const server &) = delete;
@@ -46,7 +62,18 @@ public:
 	int stop();
 	void register_path(const std::string &, request_handler_t);
 	snf::ssl::context &ssl_context() { return m_ctx; }
-	snf::net::reactor &reactor() { return m_reactor; }
+	size_t reactor_count() const { return m_reactors.size(); }
+	snf::net::reactor &reactor(size_t i = 0) { return *m_reactors[i]; }
+
+	/*
+	 * Gets the reactor to register the next connection with,
+	 * round-robin.
+	 */
+	snf::net::reactor &next_reactor()
+	{
+		return *m_reactors[m_next_reactor++ % m_reactors.size()];
+	}
+
 	snf::thread_pool *thread_pool() { return m_thrdpool.get(); }
 };
 
@@ -11,13 +11,17 @@ class server_config : public common_config
 {
 private:
 	int         m_nthreads = 20;    // default worker threads
-	
+	int         m_nreactors = 1;    // reactors (event loops); 0 for one per CPU
+
 public:
 	server_config() : common_config() {}
 	virtual ~server_config() {}
 
 	int worker_thread_count() const { return m_nthreads; }
 	void worker_thread_count(int n) { m_nthreads = n; }
+
+	int reactor_count() const { return m_nreactors; }
+	void reactor_count(int n) { m_nreactors = n; }
 };
 
 } // namespace http
@@ -144,6 +144,7 @@ public:
 	}
 
 	size_t length() const { return m_filesize; }
+	snf::file *source_file() { return (m_read == 0) ? m_file : nullptr; }
 	bool has_next() { return (m_read < m_filesize); }
 
 	const void *next(size_t &buflen)
@@ -269,7 +270,7 @@ public:
 	virtual ~body_source_istream() {}
 
 	bool chunked() const { return m_chunked; }
-	size_t length() { return m_chunked ? 0 : m_size; }
+	size_t length() const { return m_chunked ? 0 : m_size; }
 	size_t chunk_size() const { return m_chunked ? m_size : 0; }
 	param_vec_t chunk_extensions() { return m_extensions; }
 
@@ -385,7 +386,7 @@ public:
 	virtual ~body_source_socket() {}
 
 	bool chunked() const { return m_chunked; }
-	size_t length() { return m_chunked ? 0 : m_size; }
+	size_t length() const { return m_chunked ? 0 : m_size; }
 	size_t chunk_size() const { return m_chunked ? m_size : 0; }
 	param_vec_t chunk_extensions() { return m_extensions; }
 
@@ -408,6 +409,7 @@ public:
 
 			if (!scn.read_chunk_size(&m_size))
 				throw bad_message("no chunk size");
+			m_read = 0;
 
 			if (scn.read_special(';')) {
 				m_extensions.clear();
@@ -9,10 +9,10 @@ namespace snf {
 namespace http {
 
 /*
- * Sends the HTTP message data.
+ * Sends the HTTP message data, gathered from the buffers.
  *
- * @param [in] data      - data to send.
- * @param [in] datalen   - length of the data to be sent.
+ * @param [in] iov       - buffers to send.
+ * @param [in] iovcnt    - number of buffers.
  * @param [in] exceptstr - exception message in case of error.
  *
  * @throws std::system_error in case of write error.
@@ -20,14 +20,17 @@ namespace http {
  * @return E_ok on success, -ve error code on failure.
  */
 int
-transmitter::send_data(const void *data, size_t datalen, const std::string &exceptstr)
+transmitter::send_datav(const snf::net::iobuf *iov, int iovcnt, const std::string &exceptstr)
 {
 	int retval = E_ok;
-	int to_write = static_cast<int>(datalen);
+	int to_write = 0;
 	int bwritten = 0;
 	int syserr = 0;
 
-	retval = m_io->write(data, to_write, &bwritten, 1000, &syserr);
+	for (int i = 0; i < iovcnt; ++i)
+		to_write += static_cast<int>(iov[i].len);
+
+	retval = m_io->writev(iov, iovcnt, &bwritten, 1000, &syserr);
 	if (retval != E_ok) {
 		throw std::system_error(
 			syserr,
@@ -41,27 +44,82 @@ transmitter::send_data(const void *data, size_t datalen, const std::string &exce
 }
 
 /*
- * Sends HTTP message body.
+ * Sends the HTTP message data from the file.
+ *
+ * @param [in] f         - file to send the data of.
+ * @param [in] length    - number of bytes to send, from the
+ *                         start of the file.
+ * @param [in] exceptstr - exception message in case of error.
+ *
+ * @throws std::system_error in case of write error.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+transmitter::send_file(snf::file &f, int64_t length, const std::string &exceptstr)
+{
+	int retval = E_ok;
+	int64_t bsent = 0;
+	int syserr = 0;
+
+	retval = m_io->sendfile(f, 0, length, &bsent, 1000, &syserr);
+	if (retval != E_ok) {
+		throw std::system_error(
+			syserr,
+			std::system_category(),
+			exceptstr);
+	} else if (length != bsent) {
+		retval = E_write_failed;
+	}
+
+	return retval;
+}
+
+/*
+ * Sends HTTP message: the message line and headers, and the
+ * body. The message line and headers go out with the first
+ * part of the body, and every chunk with its size line and
+ * terminator: a message with a body of one part (e.g. a
+ * string) is sent in one write. A body larger than that
+ * read from a file is sent with nio::sendfile(), after the
+ * message line and headers.
  *
- * @param [in] body - message body.
+ * @param [in] head - message line and headers.
+ * @param [in] body - message body, if any.
  *
  * @throws std::system_error in case of write errors.
  *
  * @return E_ok on success, -ve error code in case of failure.
  */
 int
-transmitter::send_body(body *body)
+transmitter::send_message(const std::string &head, body *body)
 {
-	int     retval = E_ok;
-	size_t  chunklen;
+	int                 retval = E_ok;
+	snf::net::iobuf     iov[4];
+	int                 iovcnt = 0;
+
+	iov[iovcnt++] = { const_cast<char *>(head.data()), head.size() };
+
+	if (body == nullptr)
+		return send_datav(iov, iovcnt, "failed to send message line and headers");
+
 	bool    body_chunked = body->chunked();
 	int64_t body_length = body->length();
+	snf::file *file = body->source_file();
+
+	if (!body_chunked && (file != nullptr) && (body_length > body::CHUNKSIZE)) {
+		retval = send_datav(iov, iovcnt, "failed to send message line and headers");
+		if (retval == E_ok)
+			retval = send_file(*file, body_length, "failed to send body");
+		return retval;
+	}
 
 	while (body->has_next()) {
-		chunklen = 0;
+		size_t chunklen = 0;
 		param_vec_t cext = std::move(body->chunk_extensions());
 		const void *buf = body->next(chunklen);
-	
+		std::string sizeline;
+
 		if (body_chunked) {
 			std::ostringstream oss;
 
@@ -70,43 +128,40 @@ transmitter::send_body(body *body)
 				for (auto e : cext)
 					oss << ";" << e.first << "=" << e.second;
 			}
+			oss << "\r\n";
 
-			std::string s = std::move(oss.str());
-
-			retval = send_data(
-					s.data(),
-					s.size(),
-					"failed to send chunk size");
-			if (retval != E_ok)
-				break;
+			sizeline = std::move(oss.str());
+			iov[iovcnt++] = { const_cast<char *>(sizeline.data()), sizeline.size() };
 		}
 
-		retval = send_data(
-				buf,
-				chunklen,
+		if (chunklen)
+			iov[iovcnt++] = { const_cast<void *>(buf), chunklen };
+
+		if (body_chunked)
+			iov[iovcnt++] = { const_cast<char *>("\r\n"), 2 };
+		else
+			body_length -= chunklen;
+
+		retval = send_datav(
+				iov,
+				iovcnt,
 				body_chunked ? "failed to send chunk" : "failed to send body");
 		if (retval != E_ok)
-			break;
+			return retval;
 
-		if (body_chunked) {
-			retval = send_data("\r\n", 2, "failed to send chunk terminator");
-			if (retval != E_ok)
-				break;
-		} else {
-			body_length -= chunklen;
-		}
+		iovcnt = 0;
 	}
 
-	if (retval == E_ok) {
-		if (body_chunked) {
-			retval = send_data(
-					"0\r\n\r\n",
-					5,
-					"failed to send last chunk");
-		} else if (body_length != 0) {
-			retval = E_write_failed;
-		}
-	}
+	if (body_chunked)
+		iov[iovcnt++] = { const_cast<char *>("0\r\n\r\n"), 5 };
+	else if (body_length != 0)
+		return E_write_failed;
+
+	if (iovcnt > 0)
+		retval = send_datav(
+				iov,
+				iovcnt,
+				body_chunked ? "failed to send last chunk" : "failed to send message line and headers");
 
 	return retval;
 }
@@ -128,14 +183,7 @@ transmitter::send_request(const request &req)
 	oss << req;
 
 	std::string s = std::move(oss.str());
-	int retval = send_data(s.data(), s.size(), "failed to send request and headers");
-	if (retval == E_ok) {
-		body *req_body = req.get_body();
-		if (req_body)
-			retval = send_body(req_body);
-	}
-
-	return retval;
+	return send_message(s, req.get_body());
 }
 
 /*
@@ -170,14 +218,7 @@ transmitter::send_response(const response &resp)
 	oss << resp;
 
 	std::string s = std::move(oss.str());
-	int retval = send_data(s.data(), s.size(), "failed to send response and headers");
-	if (retval == E_ok) {
-		body *resp_body = resp.get_body();
-		if (resp_body)
-			retval = send_body(resp_body);
-	}
-
-	return retval;
+	return send_message(s, resp.get_body());
 }
 
 /*
@@ -13,7 +13,7 @@ namespace snf {
 namespace http {
 
 void
-process_ssl_handshake(snf::net::socket *s)
+process_ssl_handshake(snf::net::reactor *r, snf::net::socket *s)
 {
 	std::unique_ptr<snf::net::socket> sock(s);
 
@@ -32,10 +32,10 @@ process_ssl_handshake(snf::net::socket *s)
 				<< snf::log::record::endl;
 
 			sock_t thesock = *sock;
-			server::instance().reactor().add_handler(
+			r->add_handler(
 				thesock,
 				snf::net::event::read,
-				DBG_NEW read_handler(cnxn.release(), sock.release(), snf::net::event::read));
+				DBG_NEW read_handler(r, cnxn.release(), sock.release(), snf::net::event::read));
 		} else {
 			ERROR_STRM(nullptr)
 				<< "SSL handshake failed for socket "
@@ -80,13 +80,17 @@ accept_handler::operator()(sock_t s, snf::net::event e)
 			<< *nsock
 			<< snf::log::record::endl;
 
+		snf::net::reactor *r = m_reactor;
+		if (r == nullptr)
+			r = &server::instance().next_reactor();
+
 		if (is_secured()) {
-			server::instance().thread_pool()->submit(process_ssl_handshake, nsock);
+			server::instance().thread_pool()->submit(process_ssl_handshake, r, nsock);
 		} else {
-			server::instance().reactor().add_handler(
+			r->add_handler(
 					*nsock,
 					snf::net::event::read,
-					DBG_NEW read_handler(nsock, snf::net::event::read));
+					DBG_NEW read_handler(r, nsock, snf::net::event::read));
 		}
 		return true;
 	} catch (std::system_error &ex) {
@@ -98,18 +102,15 @@ accept_handler::operator()(sock_t s, snf::net::event e)
 }
 
 void
-process_request(snf::net::nio *io, snf::net::socket *s)
+process_request(snf::net::reactor *r, snf::net::nio *io, snf::net::socket *s)
 {
 	std::unique_ptr<snf::net::nio> ioptr(io);
-	std::unique_ptr<snf::net::socket> sptr;
+	std::unique_ptr<snf::net::socket> sptr(s);    // the socket under the TLS connection
 	bool close_connection = false;
 
 	if (!s)
 		s = dynamic_cast<snf::net::socket *>(io);
 
-	if (s)
-		sptr.reset(s);
-
 	transmitter xfer(ioptr.get());
 
 	int retval = E_ok;
@@ -172,14 +173,20 @@ process_request(snf::net::nio *io, snf::net::socket *s)
 		snf::net::ssl::connection *cnxn = dynamic_cast<snf::net::ssl::connection *>(ioptr.get());
 		if (cnxn)
 			cnxn->shutdown();
-		sptr->shutdown(SHUTDOWN_WRITE);
+		s->shutdown(SHUTDOWN_WRITE);
+	}
+
+	if (!close_connection && (ioptr->pending() > 0)) {
+		// the next request is read already; there is no read event to wait for
+		server::instance().thread_pool()->submit(process_request, r, ioptr.release(), sptr.release());
+		return;
 	}
 
-	sock_t thesock = *(sptr.get());
-	server::instance().reactor().add_handler(
+	sock_t thesock = *s;
+	r->add_handler(
 		thesock,
 		snf::net::event::read,
-		DBG_NEW read_handler(ioptr.release(), sptr.get(), snf::net::event::read, close_connection));
+		DBG_NEW read_handler(r, ioptr.release(), sptr.release(), snf::net::event::read, close_connection));
 }
 
 bool
@@ -223,7 +230,7 @@ read_handler::operator()(sock_t s, snf::net::event e)
 		return false;
 	}
 
-	server::instance().thread_pool()->submit(process_request, m_io.release(), m_sock.release());
+	server::instance().thread_pool()->submit(process_request, m_reactor, m_io.release(), m_sock.release());
 
 	// Do not register it again.
 	return false;
@@ -2,6 +2,9 @@
 #include "error.h"
 #include "handler.h"
 #include "logmgr.h"
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace snf {
 namespace http {
@@ -69,8 +72,44 @@ server::setup_context()
 	}
 }
 
+/*
+ * Creates the reactors: as many as configured, or one per CPU.
+ * With more than one reactor, every reactor thread is pinned
+ * to a CPU.
+ */
+void
+server::setup_reactors()
+{
+	int ncpus = static_cast<int>(std::thread::hardware_concurrency());
+	int n = m_config->reactor_count();
+
+	if (n <= 0)
+		n = (ncpus > 0) ? ncpus : 1;
+
+	for (int i = 0; i < n; ++i) {
+		int cpu = ((n > 1) && (ncpus > 0)) ? (i % ncpus) : -1;
+		m_reactors.emplace_back(DBG_NEW snf::net::reactor(5000,
+			snf::net::default_reactor_backend, cpu));
+	}
+
+	INFO_STRM("server")
+		<< "started " << n << " "
+		<< snf::net::backendstr(m_reactors[0]->backend())
+		<< " reactor(s)"
+		<< snf::log::record::endl;
+}
+
+/*
+ * Creates a listening socket.
+ *
+ * @param [in] port      - port to listen on.
+ * @param [in] reuseport - share the port with the other sockets
+ *                         listening on it (SO_REUSEPORT).
+ *
+ * @return the listening socket, nullptr on failure.
+ */
 snf::net::socket *
-server::setup_socket(in_port_t port)
+server::setup_socket(in_port_t port, bool reuseport)
 {
 	try {
 		std::unique_ptr<snf::net::socket> s(
@@ -78,6 +117,8 @@ server::setup_socket(in_port_t port)
 		s->keepalive(true);
 		s->tcpnodelay(true);
 		s->reuseaddr(true);
+		if (reuseport)
+			s->reuseport(true);
 		s->blocking(false);
 		s->bind(AF_INET, port);
 
@@ -94,9 +135,92 @@ server::setup_socket(in_port_t port)
 			<< ex.what()
 			<< snf::log::record::endl;
 		return nullptr;
+	} catch (std::runtime_error &ex) {
+		ERROR_STRM("server")
+			<< ex.what()
+			<< snf::log::record::endl;
+		return nullptr;
 	}
 }
 
+/*
+ * Listens on the port: with a socket per reactor if the port
+ * can be shared, with one socket on the first reactor otherwise.
+ * If the port is 0, the port the first socket is bound to is
+ * shared by the rest.
+ *
+ * @param [in] port    - port to listen on.
+ * @param [in] secured - accept TLS connections?
+ *
+ * @return E_ok on success, E_bind_failed on failure.
+ */
+int
+server::add_listeners(in_port_t port, bool secured)
+{
+	const char *proto = secured ? "https" : "http";
+	bool shared = (m_reactors.size() > 1);
+	in_port_t sport = port;
+	std::vector<std::pair<snf::net::reactor *, sock_t>> added;
+
+	for (size_t i = 0; i < m_reactors.size(); ++i) {
+		std::unique_ptr<snf::net::socket> sock(setup_socket(sport, shared));
+		if (!sock && shared) {
+			WARNING_STRM("server")
+				<< "cannot share " << proto << " port " << sport
+				<< "; connections are accepted by one reactor"
+				<< snf::log::record::endl;
+
+			for (auto &a : added)
+				a.first->remove_handler(a.second);
+			added.clear();
+
+			shared = false;
+			sport = port;
+			i = 0;
+			sock.reset(setup_socket(sport, false));
+		}
+
+		if (!sock) {
+			ERROR_STRM("server")
+				<< "failed to get socket bound to " << proto << " port "
+				<< sport
+				<< snf::log::record::endl;
+			return E_bind_failed;
+		}
+
+		if (shared && (sport == 0)) {
+			try {
+				sport = sock->local_address().port();
+			} catch (std::system_error &ex) {
+				ERROR_STRM("server", ex.code().value())
+					<< ex.what()
+					<< snf::log::record::endl;
+				return E_bind_failed;
+			}
+		}
+
+		INFO_STRM("server")
+			<< "created " << proto << " socket "
+			<< *sock
+			<< sock->dump_options()
+			<< snf::log::record::endl;
+
+		snf::net::reactor *r = m_reactors[i].get();
+		sock_t s = *sock;
+		r->add_handler(
+				s,
+				snf::net::event::read,
+				DBG_NEW accept_handler(sock.release(), snf::net::event::read,
+					secured, shared ? r : nullptr));
+		added.emplace_back(r, s);
+
+		if (!shared)
+			break;
+	}
+
+	return E_ok;
+}
+
 int
 server::start(const server_config *cfg)
 {
@@ -125,47 +249,15 @@ server::start(const server_config *cfg)
 
 	m_thrdpool.reset(DBG_NEW snf::thread_pool(m_config->worker_thread_count()));
 
-	std::unique_ptr<snf::net::socket> sock(setup_socket(m_config->http_port()));
-	if (!sock) {
-		ERROR_STRM("server")
-			<< "failed to get socket bound to http port "
-			<< m_config->http_port()
-			<< snf::log::record::endl;
-		return E_bind_failed;
-	} else {
-		INFO_STRM("server")
-			<< "created http socket "
-			<< *sock
-			<< sock->dump_options()
-			<< snf::log::record::endl;
-
-		sock_t s = *sock;
-		m_reactor.add_handler(
-				s, 
-				snf::net::event::read,
-				DBG_NEW accept_handler(sock.release(), snf::net::event::read));
-	}
+	setup_reactors();
 
-	std::unique_ptr<snf::net::socket> sec_sock(setup_socket(m_config->https_port()));
-	if (!sec_sock) {
-		ERROR_STRM("server")
-			<< "failed to get socket bound to https port "
-			<< m_config->https_port()
-			<< snf::log::record::endl;
-		return E_bind_failed;
-	} else {
-		INFO_STRM("server")
-			<< "created https socket "
-			<< *sec_sock
-			<< sec_sock->dump_options()
-			<< snf::log::record::endl;
+	r = add_listeners(m_config->http_port(), false);
+	if (r != E_ok)
+		return r;
 
-		sock_t s = *sec_sock;
-		m_reactor.add_handler(
-				s,
-				snf::net::event::read,
-				DBG_NEW accept_handler(sec_sock.release(), snf::net::event::read, true));
-	}
+	r = add_listeners(m_config->https_port(), true);
+	if (r != E_ok)
+		return r;
 
 	m_started = true;
 
@@ -175,8 +267,10 @@ server::start(const server_config *cfg)
 int
 server::stop()
 {
-	m_reactor.stop();
-	m_thrdpool->stop();
+	for (auto &r : m_reactors)
+		r->stop();
+	if (m_thrdpool)
+		m_thrdpool->stop();
 	m_started = false;
 	m_stopped = true;
 	return 0;
@@ -13,6 +13,7 @@ get_server_config(snf::http::server_config &srvrcfg)
 	srvrcfg.certfile("/home/moji/snf/http/tests/server/server.cert.pem");
 	srvrcfg.cafile("/home/moji/snf/http/tests/server/chain.cert.pem");
 	srvrcfg.certificate_chain_depth(2);
+	srvrcfg.reactor_count(0);
 }
 
 int
@@ -4,6 +4,7 @@
 #include "rqstresp.h"
 #include "bodytest.h"
 #include "routertest.h"
+#include "transmittest.h"
 
 namespace snf {
 namespace tf {
@@ -13,6 +14,7 @@ test *test_list[] = {
 	DBG_NEW rqstresp(),
 	DBG_NEW bodytest(),
 	DBG_NEW routertest(),
+	DBG_NEW transmittest(),
 	0
 };
 
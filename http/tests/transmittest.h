@@ -0,0 +1,188 @@
+#include "transmit.h"
+#include "body.h"
+#include "sock.h"
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+class transmittest : public snf::tf::test
+{
+private:
+	static std::string read_body(snf::http::body *b)
+	{
+		std::string data;
+
+		while (b && b->has_next()) {
+			size_t len = 0;
+			const char *buf = static_cast<const char *>(b->next(len));
+			data.append(buf, len);
+		}
+
+		return data;
+	}
+
+	bool test_plain(snf::http::transmitter &tx, snf::http::transmitter &rx)
+	{
+		const std::string data = "{ \"hello\": \"world\" }";
+
+		snf::http::headers hdrs;
+		hdrs.content_type(snf::http::CONTENT_TYPE_T_APPLICATION, snf::http::CONTENT_TYPE_ST_JSON);
+
+		snf::http::response_builder bldr;
+		snf::http::response resp = bldr
+			.with_version(1, 1)
+			.with_status(snf::http::status_code::OK)
+			.with_headers(std::move(hdrs))
+			.with_body(snf::http::body_factory::instance().from_string(data))
+			.build();
+
+		ASSERT_EQ(int, tx.send_response(resp), E_ok, "response sent");
+
+		snf::http::response got = rx.recv_response();
+		ASSERT_EQ(snf::http::status_code, got.get_status(), snf::http::status_code::OK, "status matches");
+		ASSERT_EQ(size_t, got.get_headers().content_length(), data.size(), "content length matches");
+		ASSERT_EQ(const std::string &, read_body(got.get_body()), data, "body matches");
+
+		return true;
+	}
+
+	bool test_chunked(snf::http::transmitter &tx, snf::http::transmitter &rx)
+	{
+		std::vector<std::string> chunks { "first chunk", "second", "and the last chunk" };
+		std::string data;
+		size_t next = 0;
+
+		for (auto &c : chunks)
+			data += c;
+
+		snf::http::body_functor_t f = [&chunks, &next](void *buf, size_t, size_t *len, snf::http::param_vec_t *) {
+			*len = 0;
+			if (next < chunks.size()) {
+				memcpy(buf, chunks[next].data(), chunks[next].size());
+				*len = chunks[next++].size();
+			}
+			return E_ok;
+		};
+
+		snf::http::response_builder bldr;
+		snf::http::response resp = bldr
+			.with_version(1, 1)
+			.with_status(snf::http::status_code::OK)
+			.with_body(snf::http::body_factory::instance().from_functor(std::move(f)))
+			.build();
+
+		ASSERT_EQ(int, tx.send_response(resp), E_ok, "chunked response sent");
+
+		snf::http::response got = rx.recv_response();
+		ASSERT_EQ(bool, got.get_headers().is_message_chunked(), true, "message is chunked");
+		ASSERT_EQ(const std::string &, read_body(got.get_body()), data, "chunked body matches");
+
+		return true;
+	}
+
+	bool test_file(snf::http::transmitter &tx, snf::http::transmitter &rx)
+	{
+		const char *fname = "transmittest.dat";
+		std::string data;
+
+		// larger than a body chunk, to go with sendfile
+		for (int i = 0; data.size() <= snf::http::body::CHUNKSIZE; ++i)
+			data += "line " + std::to_string(i) + "\n";
+
+		{
+			std::ofstream ofs(fname, std::ios::binary);
+			ofs << data;
+		}
+
+		snf::http::response_builder bldr;
+		snf::http::response resp = bldr
+			.with_version(1, 1)
+			.with_status(snf::http::status_code::OK)
+			.with_body(snf::http::body_factory::instance().from_file(fname))
+			.build();
+
+		int retval = tx.send_response(resp);
+		std::remove(fname);
+		ASSERT_EQ(int, retval, E_ok, "file response sent");
+
+		snf::http::response got = rx.recv_response();
+		ASSERT_EQ(size_t, got.get_headers().content_length(), data.size(), "content length matches");
+		ASSERT_EQ(const std::string &, read_body(got.get_body()), data, "file body matches");
+
+		return true;
+	}
+
+	bool test_pipelined(snf::http::transmitter &tx, snf::http::transmitter &rx,
+		snf::net::nio *rxio)
+	{
+		const char *paths[] = { "/first", "/second" };
+		const char *data[] = { "{ \"n\": 1 }", "{ \"n\": 2 }" };
+
+		// both requests are sent before either is received
+		for (int i = 0; i < 2; ++i) {
+			snf::http::headers hdrs;
+			hdrs.host("localhost", 8080);
+			hdrs.content_type(snf::http::CONTENT_TYPE_T_APPLICATION, snf::http::CONTENT_TYPE_ST_JSON);
+
+			snf::http::request_builder bldr;
+			snf::http::request req = bldr
+				.method("POST")
+				.with_uri(paths[i])
+				.with_version(1, 1)
+				.with_headers(std::move(hdrs))
+				.with_body(snf::http::body_factory::instance().from_string(data[i]))
+				.build();
+
+			ASSERT_EQ(int, tx.send_request(req), E_ok, "request sent");
+		}
+
+		for (int i = 0; i < 2; ++i) {
+			snf::http::request got = rx.recv_request();
+			ASSERT_EQ(const std::string &, got.get_uri().get_path().get_path(), paths[i], "path matches");
+			ASSERT_EQ(const std::string &, read_body(got.get_body()), data[i], "body matches");
+			if (i == 0)
+				ASSERT_EQ(bool, rxio->pending() > 0, true, "next request buffered");
+		}
+
+		ASSERT_EQ(int, rxio->pending(), 0, "nothing buffered");
+
+		return true;
+	}
+
+public:
+	transmittest() : snf::tf::test() {}
+	~transmittest() {}
+
+	virtual const char *name() const
+	{
+		return "Transmit Test";
+	}
+
+	virtual const char *description() const
+	{
+		return "Tests sending/receiving HTTP messages";
+	}
+
+	virtual bool execute(const snf::config *)
+	{
+		std::array<snf::net::socket, 2> sp = snf::net::socket::socketpair();
+		snf::http::transmitter tx(&sp[0]);
+		snf::http::transmitter rx(&sp[1]);
+
+		try {
+			if (!test_plain(tx, rx))
+				return false;
+			if (!test_chunked(tx, rx))
+				return false;
+			if (!test_file(tx, rx))
+				return false;
+			if (!test_pipelined(tx, rx, &sp[1]))
+				return false;
+		} catch (const std::exception &ex) {
+			std::cerr << ex.what() << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+};
@@ -33,5 +33,7 @@
 #define E_broken_pipe           -29
 #define E_timed_out             -30
 #define E_ssl_error             -31
+#define E_mismatch              -32
+#define E_checksum_failed       -33
 
 #endif // _SNF_ERROR_H_
@@ -65,6 +65,7 @@ public:
 		bool	o_truncate;
 		bool	o_excl;
 		bool	o_sync;
+		bool	o_direct;
 
 		open_flags()
 		{
@@ -75,6 +76,7 @@ public:
 			o_truncate = false;
 			o_excl = false;
 			o_sync = false;
+			o_direct = false;
 		}
 	};
 
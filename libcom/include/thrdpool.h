@@ -1,9 +1,16 @@
+#ifndef _SNF_THRDPOOL_H_
+#define _SNF_THRDPOOL_H_
+
+#include <atomic>
+#include <condition_variable>
 #include <deque>
 #include <vector>
 #include <mutex>
 #include <functional>
 #include <future>
 #include <memory>
+#include <thread>
+#include "common.h"
 
 namespace snf {
 
@@ -227,3 +234,5 @@ public:
 };
 
 } // namespace snf
+
+#endif // _SNF_THRDPOOL_H_
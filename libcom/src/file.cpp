@@ -102,6 +102,10 @@ file::open(const open_flags &flags, mode_t mode, int *oserr)
 		fattr = FILE_FLAG_WRITE_THROUGH;
 	}
 
+	if (flags.o_direct) {
+		fattr |= FILE_FLAG_NO_BUFFERING;
+	}
+
 	wchar_t *fnameW = snf::mbs2wcs(fname.c_str());
 	if (fnameW) {
 		SECURITY_ATTRIBUTES sa = {sizeof(SECURITY_ATTRIBUTES), NULL, TRUE};
@@ -143,10 +147,22 @@ file::open(const open_flags &flags, mode_t mode, int *oserr)
 		oflags |= O_SYNC;
 	}
 
+#if defined(O_DIRECT)
+	if (flags.o_direct) {
+		oflags |= O_DIRECT;
+	}
+#endif
+
 	file_mask fmask(mask);
 
 	fd = ::open(fname.c_str(), oflags, mode);
 
+#if defined(__APPLE__)
+	if ((fd != INVALID_HANDLE_VALUE) && flags.o_direct) {
+		fcntl(fd, F_NOCACHE, 1);
+	}
+#endif
+
 #endif
 
 	if (fd == INVALID_HANDLE_VALUE) {
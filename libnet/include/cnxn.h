@@ -64,6 +64,8 @@ public:
 	void handshake(const socket &, int to = POLL_WAIT_FOREVER);
 	int readn(void *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0);
 	int writen(const void *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0);
+	int read_some(void *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0) override;
+	int writev(const iobuf *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0) override;
 	void shutdown();
 	void reset();
 	snf::ssl::x509_certificate *get_peer_certificate();
@@ -4,10 +4,21 @@
 #include <string>
 #include "net.h"
 #include "error.h"
+#include "file.h"
 
 namespace snf {
 namespace net {
 
+/*
+ * A buffer of a vectored read or write (see nio::readv() and
+ * nio::writev()).
+ */
+struct iobuf
+{
+	void    *base;  // buffer
+	size_t  len;    // buffer length
+};
+
 /*
  * A base class (think of it as interface) that is implemented
  * by socket and ssl::connection class to provide a consistent
@@ -32,8 +43,12 @@ private:
 	int  m_len = 0;             // valid data in the buffer
 	int  m_idx = 0;             // next i/o index
 
+	int fill(int, int *);
 	int read_buffered(void *, int, int *, int, int *);
 
+protected:
+	bool is_buffered() const { return m_buffered; }
+
 public:
 	nio() {}
 	nio(const nio &) = delete;
@@ -81,12 +96,21 @@ public:
 
 	virtual int readn(void *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0) = 0;
 	virtual int writen(const void *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0) = 0;
+	virtual int read_some(void *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0) = 0;
 
 	void setbuf(int);
+	int pending() const { return m_len - m_idx; }
+	int peek(const char **, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0);
+	void consume(int);
 
 	int read(void *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0);
 	int write(const void *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0);
 
+	virtual int readv(const iobuf *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0);
+	virtual int writev(const iobuf *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0);
+	virtual int sendfile(snf::file &, int64_t, int64_t, int64_t *,
+		int to = POLL_WAIT_FOREVER, int *oserr = 0);
+
 	int get_char(char &, int to = POLL_WAIT_FOREVER, int *oserr = 0);
 	int put_char(char, int to = POLL_WAIT_FOREVER, int *oserr = 0);
 
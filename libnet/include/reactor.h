@@ -4,7 +4,9 @@
 #include <chrono>
 #include "netplat.h"
 #include "sock.h"
+#include "timerwheel.h"
 #include <array>
+#include <functional>
 #include <vector>
 #include <map>
 #include <memory>
@@ -67,6 +69,31 @@ eventstr(event e)
 	}
 }
 
+/*
+ * Mechanism the reactor waits for the socket events with.
+ */
+enum class reactor_backend
+{
+	poll,   // poll(2): the sockets are passed in on every wait
+	epoll   // epoll(7), Linux only: the sockets are registered once
+};
+
+#if defined(__linux__)
+constexpr reactor_backend default_reactor_backend = reactor_backend::epoll;
+#else
+constexpr reactor_backend default_reactor_backend = reactor_backend::poll;
+#endif
+
+inline std::string
+backendstr(reactor_backend b)
+{
+	switch (b) {
+		case reactor_backend::poll: return "poll";
+		case reactor_backend::epoll: return "epoll";
+		default: return "unknown";
+	}
+}
+
 /*
  * Registered socket event handler. This is a pure interface.
  * It must be overridden to provide the event handling.
@@ -82,7 +109,10 @@ public:
 	virtual const char *name() const = 0;
 
 	/*
-	 * Called when the event is triggered.
+	 * Called when the event is triggered, from the reactor
+	 * thread with the reactor lock held. The handler may
+	 * register handlers for other sockets; for its own socket,
+	 * it must use the return value instead.
 	 *
 	 * @param [in] s - socket ID that received the event.
 	 * @param [in] e - event type received.
@@ -101,23 +131,19 @@ class reactor
 private:
 	struct ev_info
 	{
-		event                                   e;   // event
-		std::unique_ptr<handler>                h;   // handler
-		std::chrono::milliseconds               to;  // timeout
-		std::chrono::system_clock::time_point   exp; // expiration
+		event                       e;      // event
+		std::unique_ptr<handler>    h;      // handler
+		int64_t                     to;     // timeout, 0 for none
+		int64_t                     exp;    // expiration
+		timer_wheel::timer_id       timer;  // timeout timer
 
 		ev_info(event _e, int _to, handler *_h)
 			: e(_e)
 			, h(_h)
+			, to((_to > 0) ? _to : 0)
+			, exp(timer_wheel::never)
+			, timer(0)
 		{
-			if (_to <= 0) {
-				to = std::chrono::milliseconds::zero();
-				exp = std::chrono::system_clock::time_point::max();
-			} else {
-				to = std::chrono::milliseconds{_to};
-				exp = std::chrono::system_clock::now();
-				exp += to;
-			}
 		}
 	};
 
@@ -125,28 +151,53 @@ private:
 	using ev_handler_type = std::map<sock_t, ev_info_type>;
 
 	int                               m_timeout;
+	reactor_backend                   m_backend;
+	int                               m_cpu;        // CPU the thread is pinned to
+	int                               m_epfd = -1;  // epoll instance
 	std::atomic<bool>                 m_stopped { false };
 	std::array<snf::net::socket, 2>   m_sockpair;
 	std::future<void>                 m_future;
-	std::mutex                        m_lock;
+	std::recursive_mutex              m_lock;
 	ev_handler_type                   m_handlers;
-
+	timer_wheel                       m_timers;
+	int64_t                           m_wait_until = INT64_MIN; // end of the current wait
+
+	static int64_t now();
+
+	static short interest(const ev_info_type &);
+	void set_interest(sock_t, short, short);
+	void dispatch(sock_t, short, int64_t);
+	void arm(sock_t, ev_info *);
+	void disarm(ev_info *);
+	void timed_out(sock_t, event);
+	void wakeup_by(int64_t);
+	int wait_timeout();
+	void waited();
+	void run_timers();
 	std::vector<pollfd> set_poll_vector();
 	void process_poll_vector(std::vector<pollfd> &);
+	void notify();
+	void wakeup();
+	void pin();
+	void poll_loop();
+	void epoll_loop();
 	void start();
 
 public:
-	reactor(int to = 5000);
+	reactor(int to = 5000, reactor_backend b = default_reactor_backend, int cpu = -1);
 	reactor(const reactor &) = delete;
 	reactor(reactor &&) = delete;
 	const reactor &operator=(const reactor &) = delete;
 	reactor &operator=(reactor &&) = delete;
-	~reactor() { stop(); m_future.wait(); }
+	~reactor();
 
+	reactor_backend backend() const { return m_backend; }
 	void stop();
 	void add_handler(sock_t, event, handler *, int to = 0);
 	void remove_handler(sock_t);
 	void remove_handler(sock_t, event);
+	timer_wheel::timer_id add_timer(std::function<void()>, int);
+	bool cancel_timer(timer_wheel::timer_id);
 };
 
 } // namespace net
@@ -63,6 +63,8 @@ public:
 	void keepalive(bool);
 	bool reuseaddr();
 	void reuseaddr(bool);
+	bool reuseport();
+	void reuseport(bool);
 	linger_type linger(int *to = nullptr);
 	void linger(linger_type, int to = 60);
 	int rcvbuf();
@@ -93,6 +95,11 @@ public:
 	bool is_writable(int to = POLL_WAIT_FOREVER, int *oserr = 0);
 	int readn(void *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0);
 	int writen(const void *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0);
+	int read_some(void *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0) override;
+	int readv(const iobuf *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0) override;
+	int writev(const iobuf *, int, int *, int to = POLL_WAIT_FOREVER, int *oserr = 0) override;
+	int sendfile(snf::file &, int64_t, int64_t, int64_t *,
+		int to = POLL_WAIT_FOREVER, int *oserr = 0) override;
 	void close();
 	void shutdown(int);
 
@@ -0,0 +1,87 @@
+#ifndef _SNF_TIMERWHEEL_H_
+#define _SNF_TIMERWHEEL_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace snf {
+namespace net {
+
+/*
+ * Hierarchical timer wheel, as in the classic kernel timers.
+ *
+ * Time is counted in ticks (milliseconds). There are
+ * TW_LEVELS wheels of TW_SLOTS slots; a slot of level l spans
+ * TW_SLOTS^l ticks. A timer is kept in the lowest level whose
+ * range covers its due time. Every tick, the timers of the
+ * current slot of level 0 expire; when level l wraps around,
+ * the current slot of level l + 1 is cascaded (its timers are
+ * placed again, in lower levels). Adding and cancelling a
+ * timer is O(1); a timer is cascaded at most TW_LEVELS - 1
+ * times, so expiring is O(1) amortized.
+ *
+ * Timers due beyond the range of the wheel (2^24 ticks, about
+ * 4.6 hours) are parked in the last slot of the top level and
+ * placed again when it is cascaded.
+ *
+ * The wheel is not thread safe.
+ */
+class timer_wheel
+{
+public:
+	using timer_id = uint64_t;
+	using callback = std::function<void()>;
+
+	static constexpr int64_t never = INT64_MAX;
+
+private:
+	static constexpr int TW_BITS = 6;
+	static constexpr int TW_SLOTS = 1 << TW_BITS;
+	static constexpr int TW_MASK = TW_SLOTS - 1;
+	static constexpr int TW_LEVELS = 4;
+
+	struct node
+	{
+		timer_id    id;
+		int64_t     due;
+		callback    cb;
+		node        *prev = nullptr;
+		node        *next = nullptr;
+		int         level = 0;
+		int         slot = 0;
+	};
+
+	int64_t                                         m_tick;     // next tick to expire
+	timer_id                                        m_next_id = 1;
+	node                                            *m_slots[TW_LEVELS][TW_SLOTS] = {};
+	size_t                                          m_count[TW_LEVELS] = {};
+	std::unordered_map<timer_id, std::unique_ptr<node>> m_timers;
+
+	void place(node *);
+	void unlink(node *);
+	void cascade(int, int);
+
+public:
+	timer_wheel(int64_t now) : m_tick(now) {}
+	timer_wheel(const timer_wheel &) = delete;
+	timer_wheel &operator=(const timer_wheel &) = delete;
+	~timer_wheel() {}
+
+	/*
+	 * Gets the number of timers pending.
+	 */
+	size_t size() const { return m_timers.size(); }
+
+	timer_id add(int64_t, callback);
+	bool cancel(timer_id);
+	int64_t next_due() const;
+	void expire(int64_t, std::vector<callback> &);
+};
+
+} // namespace net
+} // namespace snf
+
+#endif // _SNF_TIMERWHEEL_H_
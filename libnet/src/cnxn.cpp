@@ -1,6 +1,12 @@
 #include "cnxn.h"
 #include "error.h"
 #include <algorithm>
+#include <climits>
+#include <cstring>
+
+#if !defined(TLS_MAX_RECORD)
+#define TLS_MAX_RECORD  16384   // maximum TLS record payload
+#endif
 
 /*
  * Server name callback for SNI.
@@ -545,6 +551,67 @@ connection::readn(void *buf, int to_read, int *bread, int to, int *oserr)
 	return retval;
 }
 
+/**
+ * Reads from the TLS connection, with one successful read: as
+ * much as is available, up to to_read bytes (at most a TLS
+ * record).
+ *
+ * @param [out] buf     - buffer to read the data into.
+ * @param [in]  to_read - maximum number of bytes to read.
+ * @param [out] bread   - number of bytes read. 0 if the
+ *                        connection is closed.
+ * @param [in]  to      - timeout in milliseconds.
+ *                        POLL_WAIT_FOREVER for inifinite wait.
+ *                        POLL_WAIT_NONE for no wait.
+ * @param [out] oserr   - system error code.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ *
+ * @throws snf::ssl::exception if the internal socket could not be
+ *         retrieved or a SSL occurs while reading.
+ */
+int
+connection::read_some(void *buf, int to_read, int *bread, int to, int *oserr)
+{
+	int     retval = E_ok;
+	int     n = 0, nbytes = 0;
+	sock_t  sock;
+
+	if (buf == nullptr)
+		return E_invalid_arg;
+
+	if (to_read <= 0)
+		return E_invalid_arg;
+
+	if (bread == nullptr)
+		return E_invalid_arg;
+
+	*bread = 0;
+
+	sock = m_tls->get_socket();
+
+	do {
+		error_info ei;
+
+		n = m_tls->read(static_cast<char *>(buf), to_read, &nbytes);
+		if (n <= 0) {
+			ei.op = operation::read;
+			ei.error = n;
+
+			retval = handle_ssl_error(sock, to, ei);
+			if (E_try_again != retval) {
+				if (oserr) *oserr = ei.os_error;
+				break;
+			}
+		} else {
+			retval = E_ok;
+			*bread = nbytes;
+		}
+	} while (retval == E_try_again);
+
+	return retval;
+}
+
 /**
  * Writes to the TLS connection. SIGPIPE must be handled
  * explicitly while using this.
@@ -605,6 +672,84 @@ connection::writen(const void *buf, int to_write, int *bwritten, int to, int *os
 	return retval;
 }
 
+/**
+ * Writes the buffers to the TLS connection, gathered into
+ * records: the small buffers (e.g. the headers and the body of
+ * a response) are copied into one record instead of a record,
+ * and a system call, each. Data that fills whole records is
+ * written as is. SIGPIPE must be handled explicitly while
+ * using this.
+ *
+ * @param [in]  iov      - buffers to write.
+ * @param [in]  iovcnt   - number of buffers.
+ * @param [out] bwritten - number of bytes written.
+ * @param [in]  to       - timeout in milliseconds.
+ *                         POLL_WAIT_FOREVER for inifinite wait.
+ *                         POLL_WAIT_NONE for no wait.
+ * @param [out] oserr    - system error code.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ *
+ * @throws snf::ssl::exception if the internal socket could not be
+ *         retrieved or a SSL occurs while writing.
+ */
+int
+connection::writev(const iobuf *iov, int iovcnt, int *bwritten, int to, int *oserr)
+{
+	int     retval = E_ok;
+	char    rec[TLS_MAX_RECORD];
+	int     len = 0;
+
+	if ((iov == nullptr) || (iovcnt <= 0))
+		return E_invalid_arg;
+
+	if (bwritten == nullptr)
+		return E_invalid_arg;
+
+	*bwritten = 0;
+
+	auto flush = [&](const char *buf, int buflen) {
+		int n = 0;
+		retval = writen(buf, buflen, &n, to, oserr);
+		*bwritten += n;
+		if ((retval == E_ok) && (n != buflen))
+			retval = E_write_failed;
+		return (retval == E_ok);
+	};
+
+	for (int i = 0; i < iovcnt; ++i) {
+		const char *cbuf = static_cast<const char *>(iov[i].base);
+		size_t left = iov[i].len;
+
+		while (left > 0) {
+			if ((len == 0) && (left >= TLS_MAX_RECORD)) {
+				int n = static_cast<int>(std::min(left - (left % TLS_MAX_RECORD),
+						size_t(INT_MAX - (INT_MAX % TLS_MAX_RECORD))));
+				if (!flush(cbuf, n))
+					return retval;
+				cbuf += n;
+				left -= n;
+			} else {
+				int n = static_cast<int>(std::min(left, size_t(TLS_MAX_RECORD - len)));
+				memcpy(rec + len, cbuf, n);
+				len += n;
+				cbuf += n;
+				left -= n;
+				if (len == TLS_MAX_RECORD) {
+					if (!flush(rec, len))
+						return retval;
+					len = 0;
+				}
+			}
+		}
+	}
+
+	if (len > 0)
+		flush(rec, len);
+
+	return retval;
+}
+
 /*
  * Shuts down the TLS connection.
  */
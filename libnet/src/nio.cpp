@@ -2,6 +2,7 @@
 #include "dbg.h"
 #include <memory>
 #include <algorithm>
+#include <cstring>
 
 namespace snf {
 namespace net {
@@ -31,7 +32,22 @@ nio::setbuf(int bufsize)
 }
 
 /*
- * Reads buffered data.
+ * Reads into the buffer, if it is empty: as much as is available,
+ * with one read.
+ */
+int
+nio::fill(int to, int *oserr)
+{
+	if (m_idx < m_len)
+		return E_ok;
+
+	m_idx = m_len = 0;
+	return read_some(m_buf, m_max, &m_len, to, oserr);
+}
+
+/*
+ * Reads buffered data. The reads larger than the buffer bypass
+ * it, once the buffered data is read.
  */
 int
 nio::read_buffered(void *buf, int to_read, int *bread, int to, int *oserr)
@@ -55,18 +71,20 @@ nio::read_buffered(void *buf, int to_read, int *bread, int to, int *oserr)
 			n = std::min((m_len - m_idx), to_read);
 			memcpy(cbuf, m_buf + m_idx, n);
 			m_idx += n;
+			cbuf += n;
 			to_read -= n;
 			nbytes += n;
 		}
 
 		if (to_read) {
-			if (m_idx >= m_len) {
-				retval = E_invalid_state;
-			} else {
-				m_idx = m_len = 0;
-				retval = readn(m_buf, m_max, &m_len, to, oserr);
+			if (to_read >= m_max) {
+				n = 0;
+				retval = readn(cbuf, to_read, &n, to, oserr);
+				nbytes += n;
+				break;
 			}
 
+			retval = fill(to, oserr);
 			if ((retval != E_ok) || (m_len == 0))
 				break;
 		}
@@ -77,6 +95,55 @@ nio::read_buffered(void *buf, int to_read, int *bread, int to, int *oserr)
 	return retval;
 }
 
+/*
+ * Gets the buffered data, reading more if there is none. The data
+ * stays in the buffer until consumed (see consume()) or read; the
+ * view remains valid until more data is read into the buffer.
+ *
+ * @param [out] data  - start of the buffered data.
+ * @param [out] len   - length of the buffered data. 0 if the end
+ *                      of file is reached.
+ * @param [in]  to    - timeout in milliseconds.
+ *                      POLL_WAIT_FOREVER for inifinite wait.
+ *                      POLL_WAIT_NONE for no wait.
+ * @param [out] oserr - system error in case of failure, if not null.
+ *
+ * @return E_ok on success, E_invalid_state if the read is not
+ *         buffered (see setbuf()), -ve error code on failure.
+ */
+int
+nio::peek(const char **data, int *len, int to, int *oserr)
+{
+	if ((data == nullptr) || (len == nullptr))
+		return E_invalid_arg;
+
+	if (!m_buffered)
+		return E_invalid_state;
+
+	int retval = fill(to, oserr);
+	if (retval == E_ok) {
+		*data = m_buf + m_idx;
+		*len = m_len - m_idx;
+	} else {
+		*data = nullptr;
+		*len = 0;
+	}
+
+	return retval;
+}
+
+/*
+ * Consumes the buffered data, got with peek().
+ *
+ * @param [in] n - number of bytes to consume.
+ */
+void
+nio::consume(int n)
+{
+	if (n > 0)
+		m_idx += std::min(n, m_len - m_idx);
+}
+
 int
 nio::read(void *buf, int to_read, int *bread, int to, int *oserr)
 {
@@ -91,6 +158,150 @@ nio::write(const void *buf, int to_write, int *bwritten, int to, int *oserr)
 	return writen(buf, to_write, bwritten, to, oserr);
 }
 
+/*
+ * Reads into the buffers, in order. The default implementation
+ * reads the buffers one by one; the derived classes read them
+ * together where they can.
+ *
+ * @param [in]  iov    - buffers to read into.
+ * @param [in]  iovcnt - number of buffers.
+ * @param [out] bread  - number of bytes read. This can be less
+ *                       than the total length of the buffers.
+ * @param [in]  to     - timeout in milliseconds.
+ *                       POLL_WAIT_FOREVER for inifinite wait.
+ *                       POLL_WAIT_NONE for no wait.
+ * @param [out] oserr  - system error in case of failure, if not null.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+nio::readv(const iobuf *iov, int iovcnt, int *bread, int to, int *oserr)
+{
+	int retval = E_ok;
+
+	if ((iov == nullptr) || (iovcnt <= 0))
+		return E_invalid_arg;
+
+	if (bread == nullptr)
+		return E_invalid_arg;
+
+	*bread = 0;
+
+	for (int i = 0; i < iovcnt; ++i) {
+		if (iov[i].len == 0)
+			continue;
+
+		int to_read = static_cast<int>(iov[i].len);
+		int n = 0;
+
+		retval = read(iov[i].base, to_read, &n, to, oserr);
+		*bread += n;
+		if ((retval != E_ok) || (n != to_read))
+			break;
+	}
+
+	return retval;
+}
+
+/*
+ * Writes the buffers, in order. The default implementation
+ * writes the buffers one by one; the derived classes write
+ * them together where they can.
+ *
+ * @param [in]  iov      - buffers to write.
+ * @param [in]  iovcnt   - number of buffers.
+ * @param [out] bwritten - number of bytes written.
+ * @param [in]  to       - timeout in milliseconds.
+ *                         POLL_WAIT_FOREVER for inifinite wait.
+ *                         POLL_WAIT_NONE for no wait.
+ * @param [out] oserr    - system error in case of failure, if not null.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+nio::writev(const iobuf *iov, int iovcnt, int *bwritten, int to, int *oserr)
+{
+	int retval = E_ok;
+
+	if ((iov == nullptr) || (iovcnt <= 0))
+		return E_invalid_arg;
+
+	if (bwritten == nullptr)
+		return E_invalid_arg;
+
+	*bwritten = 0;
+
+	for (int i = 0; i < iovcnt; ++i) {
+		if (iov[i].len == 0)
+			continue;
+
+		int to_write = static_cast<int>(iov[i].len);
+		int n = 0;
+
+		retval = write(iov[i].base, to_write, &n, to, oserr);
+		*bwritten += n;
+		if ((retval != E_ok) || (n != to_write))
+			break;
+	}
+
+	return retval;
+}
+
+/*
+ * Sends the file data. The default implementation reads the file
+ * into a buffer and writes the buffer; the derived classes send
+ * the data without copying it where they can. The data is read
+ * from the specified offset; the file offset may be changed.
+ *
+ * @param [in]  f      - file to send the data of.
+ * @param [in]  offset - offset of the data in the file.
+ * @param [in]  length - number of bytes to send.
+ * @param [out] bsent  - number of bytes sent. This is less than
+ *                       length if the file is shorter.
+ * @param [in]  to     - timeout in milliseconds.
+ *                       POLL_WAIT_FOREVER for inifinite wait.
+ *                       POLL_WAIT_NONE for no wait.
+ * @param [out] oserr  - system error in case of failure, if not null.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+nio::sendfile(snf::file &f, int64_t offset, int64_t length, int64_t *bsent, int to, int *oserr)
+{
+	const int   bufsize = 65536;
+	int         retval = E_ok;
+
+	if ((offset < 0) || (length <= 0))
+		return E_invalid_arg;
+
+	if (bsent == nullptr)
+		return E_invalid_arg;
+
+	*bsent = 0;
+
+	std::unique_ptr<char []> buf(DBG_NEW char[bufsize]);
+
+	while (length > 0) {
+		int to_read = static_cast<int>(std::min(length, static_cast<int64_t>(bufsize)));
+		int bread = 0;
+		int bwritten = 0;
+
+		retval = f.read(offset, buf.get(), to_read, &bread, oserr);
+		if ((retval != E_ok) || (bread == 0))
+			break;
+
+		retval = write(buf.get(), bread, &bwritten, to, oserr);
+		*bsent += bwritten;
+		if ((retval != E_ok) || (bwritten != bread))
+			break;
+
+		offset += bread;
+		length -= bread;
+	}
+
+	return retval;
+}
+
 /*
  * Reads a single character.
  *
@@ -204,25 +415,31 @@ nio::read_string(std::string &str, int to, int *oserr)
 int
 nio::write_string(const std::string &str, int to, int *oserr)
 {
-	int retval;
-	int to_write = static_cast<int>(str.size());
-
-	retval = write_integral(to_write, to, oserr);
-	if (E_ok == retval) {
-		int bwritten = 0;
-
-		retval = write(str.c_str(), to_write, &bwritten, to, oserr);
-		if (E_ok == retval)
-			if (to_write != bwritten)
-				retval = E_write_failed;
-	}
+	int     retval;
+	int32_t len = hton(static_cast<int32_t>(str.size()));
+	int     to_write = static_cast<int>(sizeof(len) + str.size());
+	int     bwritten = 0;
+
+	// the length and the string in one write
+	iobuf iov[2] = {
+		{ &len, sizeof(len) },
+		{ const_cast<char *>(str.data()), str.size() }
+	};
+
+	retval = writev(iov, 2, &bwritten, to, oserr);
+	if (E_ok == retval)
+		if (to_write != bwritten)
+			retval = E_write_failed;
 
 	return retval;
 }
 
 /*
  * Reads a line terminated by newline ('\n'). This will continue
- * reading until a new line is encountered.
+ * reading until a new line is encountered. If the read is buffered
+ * (see setbuf()), the buffered data is scanned for the new line;
+ * otherwise the line is read a byte at a time, so as not to read
+ * past it.
  *
  * @param [out] line  - line read.
  * @param [in]  to    - timeout in milliseconds.
@@ -240,6 +457,31 @@ nio::readline(std::string &line, int to, int *oserr)
 {
 	int     retval = E_ok;
 	int     n;
+
+	if (m_buffered) {
+		const char  *data;
+		const char  *nl = nullptr;
+
+		do {
+			retval = peek(&data, &n, to, oserr);
+			if (retval != E_ok) {
+				break;
+			} else if (n == 0) {
+				retval = E_read_failed;
+				break;
+			}
+
+			nl = static_cast<const char *>(memchr(data, '\n', n));
+			if (nl)
+				n = static_cast<int>(nl - data) + 1;
+
+			line.append(data, n);
+			consume(n);
+		} while (nl == nullptr);
+
+		return retval;
+	}
+
 	char    buf[1];
 
 	do {
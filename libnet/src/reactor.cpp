@@ -1,6 +1,18 @@
 #include "net.h"
 #include "reactor.h"
 #include "logger.h"
+#include <algorithm>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
+
+#if !defined(REACTOR_MAX_EVENTS)
+#define REACTOR_MAX_EVENTS  1024
+#endif
 
 namespace snf {
 namespace net {
@@ -34,12 +46,347 @@ public:
 			return false;
 		}
 
-		int dummy = 0;
-		m_reader.read_integral(&dummy, POLL_WAIT_NONE);
+		// drain the wake-ups pending
+		char buf[256];
+		int n = 0;
+		int oserr = 0;
+		do {
+			m_reader.readn(buf, static_cast<int>(sizeof(buf)), &n, POLL_WAIT_NONE, &oserr);
+		} while (n == static_cast<int>(sizeof(buf)));
+
 		return true;
 	}
 };
 
+/*
+ * Gets the events the handlers of a socket wait for.
+ */
+short
+reactor::interest(const ev_info_type &eivec)
+{
+	short events = 0;
+
+	for (auto &ei : eivec) {
+		switch (ei->e) {
+			case event::read:
+			case event::write:
+				events |= static_cast<short>(ei->e);
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	return events;
+}
+
+/*
+ * Updates the registration of the socket with the epoll
+ * instance, from the events its handlers waited for to the
+ * events they wait for now. The poll backend has nothing to
+ * update: the sockets are passed to poll() on every wait.
+ *
+ * A socket closed while registered is removed by the system,
+ * so removal failures are ignored.
+ *
+ * @throws std::system_error if the socket could not be
+ *         registered.
+ */
+void
+reactor::set_interest(sock_t s, short from, short to)
+{
+#if defined(__linux__)
+	if ((m_backend != reactor_backend::epoll) || (from == to))
+		return;
+
+	epoll_event ev = {};
+	ev.events = static_cast<uint32_t>(to);
+	ev.data.fd = s;
+
+	if (to == 0) {
+		if (epoll_ctl(m_epfd, EPOLL_CTL_DEL, s, &ev) != 0) {
+			DEBUG_STRM("reactor")
+				<< "socket " << s
+				<< " is not registered"
+				<< snf::log::record::endl;
+		}
+		return;
+	}
+
+	int op = (from == 0) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+	if (epoll_ctl(m_epfd, op, s, &ev) == 0)
+		return;
+
+	// The socket (number) may still be registered if it was
+	// closed and reopened while the reactor was not looking,
+	// or unregistered if it was closed.
+	int syserr = errno;
+	if ((syserr == EEXIST) || (syserr == ENOENT)) {
+		op = (syserr == EEXIST) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+		if (epoll_ctl(m_epfd, op, s, &ev) == 0)
+			return;
+		syserr = errno;
+	}
+
+	throw std::system_error(
+		syserr,
+		std::system_category(),
+		"failed to register socket with epoll");
+#else
+	(void)s; (void)from; (void)to;
+#endif
+}
+
+/*
+ * Gets the current time, in milliseconds of the steady clock:
+ * the ticks of the timer wheel.
+ */
+int64_t
+reactor::now()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+ * Calls the handlers of the socket for the events received.
+ * Depending on the return value of the handler, the handler
+ * is re-registered or removed. Must be called with the lock
+ * held.
+ */
+void
+reactor::dispatch(sock_t s, short revents, int64_t now)
+{
+	if (revents == 0)
+		return;
+
+	ev_handler_type::iterator H;
+	H = m_handlers.find(s);
+	if (H == m_handlers.end())
+		return;
+
+	short before = interest(H->second);
+
+	// By index: a handler may add a handler (for another
+	// socket) and the vector is not to be iterated over then.
+	size_t i = 0;
+	while (i < H->second.size()) {
+		std::unique_ptr<ev_info> &uptr = H->second[i];
+		short e = static_cast<short>(uptr->e);
+		bool ok = true;
+
+		if (revents & POLLERR) {
+			ok = (*uptr->h)(s, event::error);
+		} else if (revents & POLLHUP) {
+			ok = (*uptr->h)(s, event::hup);
+		} else if (revents & POLLNVAL) {
+			ok = (*uptr->h)(s, event::invalid);
+		} else if (revents & e) {
+			ok = (*uptr->h)(s, uptr->e);
+			// the timer is moved when it fires, not on
+			// every event
+			if (ok && (uptr->to != 0))
+				uptr->exp = now + uptr->to;
+		}
+
+		if (!ok) {
+			// uptr is gone once erased
+			DEBUG_STRM("reactor")
+				<< "removing " << eventstr(uptr->e)
+				<< " handler " << uptr->h->name()
+				<< " for socket " << s
+				<< snf::log::record::endl;
+
+			disarm(uptr.get());
+			H->second.erase(H->second.begin() + i);
+		} else {
+			++i;
+		}
+	}
+
+	short after = interest(H->second);
+
+	if (H->second.empty()) {
+		m_handlers.erase(H);
+
+		DEBUG_STRM("reactor")
+			<< "all handlers for socket " << s
+			<< " are removed"
+			<< snf::log::record::endl;
+	}
+
+	set_interest(s, before, after);
+}
+
+/*
+ * Schedules the timeout of the handler at its expiration.
+ * Must be called with the lock held.
+ */
+void
+reactor::arm(sock_t s, ev_info *ei)
+{
+	event e = ei->e;
+
+	ei->timer = m_timers.add(ei->exp, [this, s, e]() { timed_out(s, e); });
+	wakeup_by(ei->exp);
+}
+
+/*
+ * Cancels the timeout of the handler, if any. Must be called
+ * with the lock held.
+ */
+void
+reactor::disarm(ev_info *ei)
+{
+	if (ei->timer != 0) {
+		m_timers.cancel(ei->timer);
+		ei->timer = 0;
+	}
+}
+
+/*
+ * Called when the timeout of the handler of the socket for
+ * the event fires. If the socket has seen the event since the
+ * timer was scheduled, the timer is scheduled again at the new
+ * expiration; otherwise the handler is called with
+ * event::timeout, and re-registered or removed depending on
+ * its return value. Must be called with the lock held.
+ */
+void
+reactor::timed_out(sock_t s, event e)
+{
+	ev_handler_type::iterator H;
+	H = m_handlers.find(s);
+	if (H == m_handlers.end())
+		return;
+
+	ev_info_type::iterator E = H->second.begin();
+	while ((E != H->second.end()) && ((*E)->e != e))
+		++E;
+	if (E == H->second.end())
+		return;
+
+	ev_info *ei = E->get();
+	ei->timer = 0;
+
+	int64_t t = now();
+	if (t < ei->exp) {
+		arm(s, ei);
+		return;
+	}
+
+	if ((*ei->h)(s, event::timeout)) {
+		ei->exp = t + ei->to;
+		arm(s, ei);
+		return;
+	}
+
+	DEBUG_STRM("reactor")
+		<< "removing " << eventstr(e)
+		<< " handler " << ei->h->name()
+		<< " for socket " << s
+		<< " on timeout"
+		<< snf::log::record::endl;
+
+	short before = interest(H->second);
+
+	H->second.erase(E);
+
+	short after = interest(H->second);
+
+	if (H->second.empty()) {
+		m_handlers.erase(H);
+
+		DEBUG_STRM("reactor")
+			<< "all handlers for socket " << s
+			<< " are removed"
+			<< snf::log::record::endl;
+	}
+
+	set_interest(s, before, after);
+}
+
+/*
+ * Writes to the socket pair, for the reactor thread to return
+ * from its wait. The write does not block (the lock may be
+ * held): if the socket pair is full, the reactor thread has
+ * wake-ups pending already.
+ */
+void
+reactor::notify()
+{
+	int oserr = 0;
+	m_sockpair[1].write_integral(1, POLL_WAIT_NONE, &oserr);
+}
+
+/*
+ * Wakes up the reactor thread if it is waiting beyond the
+ * given time, for the wait to be cut short to a timer just
+ * added. Must be called with the lock held.
+ */
+void
+reactor::wakeup_by(int64_t due)
+{
+	if (due < m_wait_until)
+		notify();
+}
+
+/*
+ * Gets the time to wait for the sockets: the reactor timeout,
+ * or less if a timer is due earlier.
+ *
+ * @return the time to wait in milliseconds, POLL_WAIT_FOREVER
+ *         to wait until woken up.
+ */
+int
+reactor::wait_timeout()
+{
+	std::lock_guard<std::recursive_mutex> guard(m_lock);
+
+	int64_t t = now();
+	int64_t wait = (m_timeout < 0) ? timer_wheel::never : m_timeout;
+
+	int64_t due = m_timers.next_due();
+	if (due != timer_wheel::never)
+		wait = std::min(wait, std::max(due - t, int64_t(0)));
+
+	if (wait == timer_wheel::never) {
+		m_wait_until = timer_wheel::never;
+		return POLL_WAIT_FOREVER;
+	}
+
+	m_wait_until = t + wait;
+	return static_cast<int>(wait);
+}
+
+/*
+ * Notes that the wait is over: there is no need to wake up the
+ * reactor thread for a timer until it waits again.
+ */
+void
+reactor::waited()
+{
+	std::lock_guard<std::recursive_mutex> guard(m_lock);
+	m_wait_until = INT64_MIN;
+}
+
+/*
+ * Calls the callbacks of the timers that are due, with the
+ * lock held.
+ */
+void
+reactor::run_timers()
+{
+	std::vector<timer_wheel::callback> cbs;
+
+	std::lock_guard<std::recursive_mutex> guard(m_lock);
+
+	m_timers.expire(now(), cbs);
+	for (auto &cb : cbs)
+		cb();
+}
+
 /*
  * Prepares the poll vector to be used with poll()
  * system call by iterating over the registered
@@ -50,22 +397,10 @@ reactor::set_poll_vector()
 {
 	std::vector<pollfd> poll_vec;
 
-	std::lock_guard<std::mutex> guard(m_lock);
+	std::lock_guard<std::recursive_mutex> guard(m_lock);
 
 	for (auto &h : m_handlers) {
-		pollfd fdelem = { h.first, 0, 0 };
-		for (auto &ei : h.second) {
-			switch (ei->e) {
-				case event::read:
-				case event::write:
-					fdelem.events |= static_cast<short>(ei->e);
-					break;
-
-				default:
-					break;
-			}
-		}
-
+		pollfd fdelem = { h.first, interest(h.second), 0 };
 		if (fdelem.events != 0)
 			poll_vec.push_back(fdelem);
 	}
@@ -76,83 +411,33 @@ reactor::set_poll_vector()
 /*
  * Process the poll vector after call to poll() system call.
  * Calls the registered handlers when the socket is ready.
- * Depending on the return value of the handler, the handler
- * is re-registered or removed.
  */
 void
 reactor::process_poll_vector(std::vector<pollfd> &poll_vec)
 {
-	std::chrono::system_clock::time_point now = 
-		std::chrono::system_clock::now();
+	int64_t t = now();
 
 	for (auto &fdelem : poll_vec) {
-		std::lock_guard<std::mutex> guard(m_lock);
-
-		ev_handler_type::iterator H;
-		H = m_handlers.find(fdelem.fd);
-		if (H != m_handlers.end()) {
-			ev_info_type::iterator E = H->second.begin();
-			while (E != H->second.end()) {
-				std::unique_ptr<ev_info> &uptr = *E;
-				bool ok = true;
-
-				if (fdelem.revents != 0) {
-					short e = static_cast<short>(uptr->e);
-
-					if (fdelem.revents & POLLERR) {
-						ok = (*uptr->h)(fdelem.fd, event::error);
-					} else if (fdelem.revents & POLLHUP) {
-						ok = (*uptr->h)(fdelem.fd, event::hup);
-					} else if (fdelem.revents & POLLNVAL) {
-						ok = (*uptr->h)(fdelem.fd, event::invalid);
-					} else if (fdelem.revents & e) {
-						ok = (*uptr->h)(fdelem.fd, uptr->e);
-						if (ok && (uptr->to != std::chrono::milliseconds::zero()))
-							uptr->exp = now + uptr->to;
-					}
-				} else {
-					if (now > uptr->exp)
-						ok = (*uptr->h)(fdelem.fd, event::timeout);
-				}
-
-				if (!ok) {
-					E = H->second.erase(E);
-
-					DEBUG_STRM("reactor")
-						<< "removed " << eventstr(uptr->e)
-						<< " handler " << uptr->h->name()
-						<< " for socket " << fdelem.fd
-						<< snf::log::record::endl;
-				} else {
-					++E;
-				}
-			}
-
-			if (H->second.empty()) {
-				m_handlers.erase(fdelem.fd);
-
-				DEBUG_STRM("reactor")
-					<< "all handlers for socket " << fdelem.fd
-					<< " are removed"
-					<< snf::log::record::endl;
-			}
-		}
+		std::lock_guard<std::recursive_mutex> guard(m_lock);
+		dispatch(fdelem.fd, fdelem.revents, t);
 	}
 }
 
 /*
- * Starts the reactor.
+ * Runs the reactor with poll(): the poll vector is built from
+ * the registered handlers on every iteration.
  *
  * @throws std::system_error in case of poll() system call failure.
  */
 void
-reactor::start()
+reactor::poll_loop()
 {
 	while (!m_stopped) {
 		std::vector<pollfd> poll_vec = std::move(set_poll_vector());
 		int syserr = 0;
 
-		int nready = snf::net::poll(poll_vec, m_timeout, &syserr);
+		int nready = snf::net::poll(poll_vec, wait_timeout(), &syserr);
+		waited();
 		if (SOCKET_ERROR == nready) {
 			throw std::system_error(
 				syserr,
@@ -161,7 +446,104 @@ reactor::start()
 		} else if (nready > 0) {
 			process_poll_vector(poll_vec);
 		}
+
+		run_timers();
+	}
+}
+
+/*
+ * Runs the reactor with epoll: the sockets are registered
+ * when the handlers are added or removed, and a wait costs
+ * only as much as the number of sockets ready.
+ *
+ * @throws std::system_error in case of epoll_wait() system call failure.
+ */
+void
+reactor::epoll_loop()
+{
+#if defined(__linux__)
+	static_assert((EPOLLIN == POLLIN) && (EPOLLOUT == POLLOUT) &&
+		(EPOLLERR == POLLERR) && (EPOLLHUP == POLLHUP),
+		"epoll and poll event flags differ");
+
+	std::vector<epoll_event> events(REACTOR_MAX_EVENTS);
+
+	while (!m_stopped) {
+		int nready = epoll_wait(m_epfd, events.data(),
+				static_cast<int>(events.size()), wait_timeout());
+		waited();
+		if (nready < 0) {
+			if (errno == EINTR)
+				continue;
+			throw std::system_error(
+				errno,
+				std::system_category(),
+				"epoll_wait failed");
+		}
+
+		int64_t t = now();
+
+		for (int i = 0; i < nready; ++i) {
+			std::lock_guard<std::recursive_mutex> guard(m_lock);
+			dispatch(events[i].data.fd, static_cast<short>(events[i].events), t);
+		}
+
+		run_timers();
 	}
+#endif
+}
+
+/*
+ * Pins the reactor thread to its CPU, if any. Failing to pin
+ * is not fatal: the reactor runs wherever it is scheduled.
+ */
+void
+reactor::pin()
+{
+	if (m_cpu < 0)
+		return;
+
+#if defined(__linux__)
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	CPU_SET(m_cpu, &cpus);
+
+	int syserr = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+	if (syserr != 0) {
+		WARNING_STRM("reactor", syserr)
+			<< "failed to pin reactor to cpu " << m_cpu
+			<< snf::log::record::endl;
+		return;
+	}
+#elif defined(_WIN32)
+	if (SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << m_cpu) == 0) {
+		WARNING_STRM("reactor", GetLastError())
+			<< "failed to pin reactor to cpu " << m_cpu
+			<< snf::log::record::endl;
+		return;
+	}
+#endif
+
+	DEBUG_STRM("reactor")
+		<< "reactor pinned to cpu " << m_cpu
+		<< snf::log::record::endl;
+}
+
+/*
+ * Starts the reactor.
+ *
+ * @throws std::system_error in case of poll()/epoll_wait() system
+ *         call failure.
+ */
+void
+reactor::start()
+{
+	pin();
+
+	if (m_backend == reactor_backend::epoll)
+		epoll_loop();
+	else
+		poll_loop();
 }
 
 /*
@@ -170,12 +552,38 @@ reactor::start()
  * @param [in]    to    - timeout in milliseconds.
  *                        POLL_WAIT_FOREVER for inifinite wait.
  *                        POLL_WAIT_NONE for no wait.
+ * @param [in]    b     - backend to use. Falls back to poll if
+ *                        epoll is not available.
+ * @param [in]    cpu   - CPU to pin the reactor thread to; < 0
+ *                        not to pin it.
  */
-reactor::reactor(int to)
+reactor::reactor(int to, reactor_backend b, int cpu)
 	: m_timeout(to)
+	, m_backend(b)
+	, m_cpu(cpu)
 	, m_sockpair(std::move(snf::net::socket::socketpair()))
+	, m_timers(now())
 {
+#if defined(__linux__)
+	if (m_backend == reactor_backend::epoll) {
+		m_epfd = epoll_create1(EPOLL_CLOEXEC);
+		if (m_epfd < 0) {
+			WARNING_STRM("reactor", errno)
+				<< "failed to create epoll instance; using poll"
+				<< snf::log::record::endl;
+			m_backend = reactor_backend::poll;
+		}
+	}
+#else
+	m_backend = reactor_backend::poll;
+#endif
+
+	DEBUG_STRM("reactor")
+		<< "using " << backendstr(m_backend)
+		<< snf::log::record::endl;
+
 	m_sockpair[0].blocking(false);
+	m_sockpair[1].blocking(false);
 	sock_t s = m_sockpair[0];
 
 	add_handler(s, event::read, DBG_NEW sockpair_handler(m_sockpair[0]));
@@ -183,16 +591,39 @@ reactor::reactor(int to)
 	m_future = std::async(std::launch::async, &reactor::start, this);
 }
 
+reactor::~reactor()
+{
+	stop();
+	m_future.wait();
+
+#if defined(__linux__)
+	if (m_epfd >= 0)
+		::close(m_epfd);
+#endif
+}
+
 void
 reactor::stop()
 {
 	if (!m_stopped) {
 		m_stopped = true;
-		m_sockpair[1].write_integral(1);
+		notify();
 		m_future.wait();
 	}
 }
 
+/*
+ * Wakes up the reactor thread for poll() to be called with
+ * the handlers just added or removed. epoll picks up the
+ * changes of registration by itself.
+ */
+void
+reactor::wakeup()
+{
+	if (m_backend == reactor_backend::poll)
+		notify();
+}
+
 /*
  * Adds/registers the event handler.
  *
@@ -204,6 +635,9 @@ reactor::stop()
  *
  * @throws std::invalid_argument if any of the arguments is
  *         invalid.
+ * @throws std::system_error if the socket could not be
+ *         registered with epoll. The handler is not taken
+ *         over then.
  */
 void
 reactor::add_handler(sock_t s, event e, handler *h, int to)
@@ -220,10 +654,14 @@ reactor::add_handler(sock_t s, event e, handler *h, int to)
 	if (m_stopped)
 		return;
 
-	std::lock_guard<std::mutex> guard(m_lock);
+	std::lock_guard<std::recursive_mutex> guard(m_lock);
 
 	ev_handler_type::iterator H;
 	H = m_handlers.find(s);
+
+	short before = (H != m_handlers.end()) ? interest(H->second) : 0;
+	set_interest(s, before, before | static_cast<short>(e));
+
 	if (H != m_handlers.end()) {
 		bool found = false;
 		for (auto &ei : H->second) {
@@ -245,6 +683,10 @@ reactor::add_handler(sock_t s, event e, handler *h, int to)
 
 		if (!found) {
 			std::unique_ptr<ev_info> ei(DBG_NEW ev_info(e, to, h));
+			if (ei->to != 0) {
+				ei->exp = now() + ei->to;
+				arm(s, ei.get());
+			}
 			H->second.push_back(std::move(ei));
 
 			DEBUG_STRM("reactor")
@@ -256,6 +698,10 @@ reactor::add_handler(sock_t s, event e, handler *h, int to)
 	} else {
 		ev_info_type eivec;
 		std::unique_ptr<ev_info> ei(DBG_NEW ev_info(e, to, h));
+		if (ei->to != 0) {
+			ei->exp = now() + ei->to;
+			arm(s, ei.get());
+		}
 		eivec.push_back(std::move(ei));
 		m_handlers[s] = std::move(eivec);
 
@@ -266,7 +712,7 @@ reactor::add_handler(sock_t s, event e, handler *h, int to)
 			<< snf::log::record::endl;
 	}
 
-	m_sockpair[1].write_integral(1);
+	wakeup();
 }
 
 /*
@@ -277,16 +723,26 @@ reactor::add_handler(sock_t s, event e, handler *h, int to)
 void
 reactor::remove_handler(sock_t s)
 {
-	std::lock_guard<std::mutex> guard(m_lock);
+	std::lock_guard<std::recursive_mutex> guard(m_lock);
+
+	ev_handler_type::iterator H;
+	H = m_handlers.find(s);
+	if (H != m_handlers.end()) {
+		short before = interest(H->second);
 
-	m_handlers.erase(s);
+		for (auto &ei : H->second)
+			disarm(ei.get());
+		m_handlers.erase(H);
+
+		set_interest(s, before, 0);
+	}
 
 	DEBUG_STRM("reactor")
 		<< "all handlers for socket " << s
 		<< " are removed"
 		<< snf::log::record::endl;
 
-	m_sockpair[1].write_integral(1);
+	wakeup();
 }
 
 /*
@@ -298,11 +754,13 @@ reactor::remove_handler(sock_t s)
 void
 reactor::remove_handler(sock_t s, event e)
 {
-	std::lock_guard<std::mutex> guard(m_lock);
+	std::lock_guard<std::recursive_mutex> guard(m_lock);
 
 	ev_handler_type::iterator H;
 	H = m_handlers.find(s);
 	if (H != m_handlers.end()) {
+		short before = interest(H->second);
+
 		ev_info_type::iterator E = H->second.begin();
 		while (E != H->second.end()) {
 			if ((*E)->e == e) {
@@ -312,12 +770,15 @@ reactor::remove_handler(sock_t s, event e)
 					<< " for socket " << s
 					<< snf::log::record::endl;
 
+				disarm(E->get());
 				H->second.erase(E);
 				break;
 			}
 			++E;
 		}
 
+		short after = interest(H->second);
+
 		if (H->second.empty()) {
 			m_handlers.erase(s);
 
@@ -326,11 +787,62 @@ reactor::remove_handler(sock_t s, event e)
 				<< " are removed"
 				<< snf::log::record::endl;
 		}
+
+		set_interest(s, before, after);
 	}
 
-	m_sockpair[1].write_integral(1);
+	wakeup();
+}
+
+/*
+ * Adds a timer, to call the callback once after the delay,
+ * e.g. to reap idle connections or to retry. The callback is
+ * called from the reactor thread with the reactor lock held,
+ * like the handlers.
+ *
+ * @param [in] cb    - callback to call.
+ * @param [in] delay - delay in milliseconds. A value of <= 0
+ *                     calls the callback on the next iteration.
+ *
+ * @return the timer ID, to cancel the timer with, or 0 if the
+ *         reactor is stopped.
+ *
+ * @throws std::invalid_argument if the callback is empty.
+ */
+timer_wheel::timer_id
+reactor::add_timer(std::function<void()> cb, int delay)
+{
+	if (!cb)
+		throw std::invalid_argument("invalid callback");
+
+	if (m_stopped)
+		return 0;
+
+	std::lock_guard<std::recursive_mutex> guard(m_lock);
+
+	// part of the current tick has gone by already: round up
+	// for the timer not to fire early
+	int64_t due = now() + ((delay > 0) ? (delay + 1) : 0);
+	timer_wheel::timer_id id = m_timers.add(due, std::move(cb));
+	wakeup_by(due);
+
+	return id;
 }
 
+/*
+ * Cancels a timer.
+ *
+ * @param [in] id - timer ID, as returned by add_timer().
+ *
+ * @return true if the timer is cancelled, false if it has
+ *         fired or has been cancelled already.
+ */
+bool
+reactor::cancel_timer(timer_wheel::timer_id id)
+{
+	std::lock_guard<std::recursive_mutex> guard(m_lock);
+	return m_timers.cancel(id);
+}
 
 } // namespace net
 } // namespace snf
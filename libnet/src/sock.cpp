@@ -1,10 +1,106 @@
 #include "sock.h"
 #include "ia.h"
 #include "error.h"
+#include <algorithm>
+#include <climits>
+
+#if !defined(_WIN32)
+#include <sys/uio.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#endif
+
+#if !defined(SOCK_MAX_IOV)
+#define SOCK_MAX_IOV    64
+#endif
+
+#if !defined(SOCK_MAX_SENDFILE)
+#define SOCK_MAX_SENDFILE   (1 << 30)
+#endif
 
 namespace snf {
 namespace net {
 
+#if defined(_WIN32)
+using sysiov_t = WSABUF;
+#else
+using sysiov_t = iovec;
+#endif
+
+/*
+ * Fills the system I/O vector with (at most SOCK_MAX_IOV of)
+ * the buffers not transferred yet, starting at the offset in
+ * the buffer.
+ *
+ * @return the number of entries filled.
+ */
+static int
+fill_sysiov(sysiov_t *sysiov, const iobuf *iov, int iovcnt, int idx, size_t off)
+{
+	int cnt = 0;
+
+	for (; (idx < iovcnt) && (cnt < SOCK_MAX_IOV); ++idx, off = 0) {
+		if (iov[idx].len <= off)
+			continue;
+
+		char *base = static_cast<char *>(iov[idx].base) + off;
+		size_t len = iov[idx].len - off;
+#if defined(_WIN32)
+		sysiov[cnt].buf = base;
+		sysiov[cnt].len = static_cast<ULONG>(len);
+#else
+		sysiov[cnt].iov_base = base;
+		sysiov[cnt].iov_len = len;
+#endif
+		cnt++;
+	}
+
+	return cnt;
+}
+
+/*
+ * Moves the position (buffer index and offset in the buffer)
+ * past the bytes transferred.
+ */
+static void
+advance_iov(const iobuf *iov, int iovcnt, int &idx, size_t &off, size_t n)
+{
+	while ((n > 0) && (idx < iovcnt)) {
+		size_t avail = iov[idx].len - off;
+		if (n < avail) {
+			off += n;
+			n = 0;
+		} else {
+			n -= avail;
+			off = 0;
+			idx++;
+		}
+	}
+}
+
+/*
+ * Gets the total length of the buffers.
+ *
+ * @return the total length, -1 if it is not valid.
+ */
+static int
+iov_length(const iobuf *iov, int iovcnt)
+{
+	size_t total = 0;
+
+	for (int i = 0; i < iovcnt; ++i) {
+		if ((iov[i].len > INT_MAX) || (iov[i].base == nullptr && iov[i].len != 0))
+			return -1;
+		total += iov[i].len;
+		if (total > INT_MAX)
+			return -1;
+	}
+
+	return static_cast<int>(total);
+}
+
 const char *
 socket::optstr(int level, int optname)
 {
@@ -14,6 +110,9 @@ socket::optstr(int level, int optname)
 				case SO_TYPE: return "SO_TYPE";
 				case SO_KEEPALIVE: return "SO_KEEPALIVE";
 				case SO_REUSEADDR: return "SO_REUSEADDR";
+#if defined(SO_REUSEPORT)
+				case SO_REUSEPORT: return "SO_REUSEPORT";
+#endif
 				case SO_LINGER: return "SO_LINGER";
 				case SO_RCVBUF: return "SO_RCVBUF";
 				case SO_SNDBUF: return "SO_SNDBUF";
@@ -377,6 +476,48 @@ socket::reuseaddr(bool set)
 	setopt(SOL_SOCKET, SO_REUSEADDR, &value, vlen);
 }
 
+/*
+ * Determines if the socket option reuse port (SO_REUSEPORT) is enabled.
+ *
+ * @return true if socket reuse port is enabled, false otherwise
+ *         (always false where the option is not supported).
+ *
+ * @throws std::system_error if the socket option could not be fetched.
+ */
+bool
+socket::reuseport()
+{
+#if defined(SO_REUSEPORT)
+	int value = 0;
+	int vlen = static_cast<int>(sizeof(value));
+	getopt(SOL_SOCKET, SO_REUSEPORT, &value, &vlen);
+	return (value != 0);
+#else
+	return false;
+#endif
+}
+
+/*
+ * Enables/disables the socket option reuse port (SO_REUSEPORT).
+ * Sockets bound to the same port with the option enabled share
+ * the incoming connections.
+ *
+ * @throws std::system_error if the socket option could not be set.
+ * @throws std::runtime_error if the option is not supported.
+ */
+void
+socket::reuseport(bool set)
+{
+#if defined(SO_REUSEPORT)
+	int value = set ? 1 : 0;
+	int vlen = static_cast<int>(sizeof(value));
+	setopt(SOL_SOCKET, SO_REUSEPORT, &value, vlen);
+#else
+	if (set)
+		throw std::runtime_error("SO_REUSEPORT is not supported");
+#endif
+}
+
 /*
  * Gets the linger type. There are 3 possible return values:
  * - socket::linger_type::dflt  - When the socket is closed, close() returns immediately.
@@ -561,8 +702,7 @@ socket::rcvtimeout(int64_t to)
 	struct timeval value;
 	int vlen = static_cast<int>(sizeof(value));
 
-	if (to > 1000)
-		value.tv_sec = to / 1000;
+	value.tv_sec = to / 1000;
 	value.tv_usec = (to % 1000) * 1000;
 	setopt(SOL_SOCKET, SO_RCVTIMEO, &value, vlen);
 #endif
@@ -612,8 +752,7 @@ socket::sndtimeout(int64_t to)
 	struct timeval value;
 	int vlen = static_cast<int>(sizeof(value));
 
-	if (to > 1000)
-		value.tv_sec = to / 1000;
+	value.tv_sec = to / 1000;
 	value.tv_usec = (to % 1000) * 1000;
 	setopt(SOL_SOCKET, SO_SNDTIMEO, &value, vlen);
 #endif
@@ -767,6 +906,7 @@ socket::dump_options()
 	oss << std::boolalpha
 		<< ", keepalive=" << keepalive()
 		<< ", reuseaddr=" << reuseaddr()
+		<< ", reuseport=" << reuseport()
 		<< ", tcpnodelay=" << tcpnodelay()
 		<< ", blocking=" << blocking()
 		<< std::noboolalpha;
@@ -1188,6 +1328,77 @@ socket::readn(void *buf, int to_read, int *bread, int to, int *oserr)
 	return retval;
 }
 
+/**
+ * Reads from the socket, with one read: as much as is
+ * available, up to to_read bytes.
+ *
+ * @param [out] buf     - buffer to read the data into.
+ * @param [in]  to_read - maximum number of bytes to read.
+ * @param [out] bread   - number of bytes read. 0 if the
+ *                        end of file is reached.
+ * @param [in]  to      - timeout in milliseconds.
+ *                        POLL_WAIT_FOREVER for inifinite wait.
+ *                        POLL_WAIT_NONE for no wait.
+ * @param [out] oserr   - system error code.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+socket::read_some(void *buf, int to_read, int *bread, int to, int *oserr)
+{
+	int     retval = E_ok;
+	int     n = 0;
+
+	if (buf == nullptr)
+		return E_invalid_arg;
+
+	if (to_read <= 0)
+		return E_invalid_arg;
+
+	if (bread == nullptr)
+		return E_invalid_arg;
+
+	*bread = 0;
+
+	bool reset = false;
+	if (POLL_WAIT_FOREVER != to) {
+		if (blocking()) {
+			blocking(false);
+			reset = true;
+		}
+	}
+
+	for (;;) {
+		if (!blocking()) {
+			int syserr = 0;
+			if (!is_readable(to, &syserr)) {
+				if (oserr) *oserr = syserr;
+				retval = map_system_error(syserr, E_read_failed);
+				break;
+			}
+		}
+
+		n = ::recv(m_sock, static_cast<char *>(buf), to_read, 0);
+		if (SOCKET_ERROR == n) {
+			int error = snf::net::error();
+#if !defined(_WIN32)
+			if (EINTR == error)
+				continue;
+#endif
+			if (oserr) *oserr = error;
+			retval = map_system_error(error, E_read_failed);
+		} else {
+			*bread = n;
+		}
+		break;
+	}
+
+	if (reset)
+		blocking(true);
+
+	return retval;
+}
+
 /**
  * Writes to the socket. There is no need to handle SIGPIPE
  * explicitly while using this.
@@ -1269,6 +1480,291 @@ socket::writen(const void *buf, int to_write, int *bwritten, int to, int *oserr)
 	return retval;
 }
 
+/**
+ * Reads from the socket into the buffers, with as few system
+ * calls as possible (recvmsg()/WSARecv()).
+ *
+ * @param [in]  iov    - buffers to read into.
+ * @param [in]  iovcnt - number of buffers.
+ * @param [out] bread  - number of bytes read. This can be less
+ *                       than the total length of the buffers.
+ * @param [in]  to     - timeout in milliseconds.
+ *                       POLL_WAIT_FOREVER for inifinite wait.
+ *                       POLL_WAIT_NONE for no wait.
+ * @param [out] oserr  - system error code.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+socket::readv(const iobuf *iov, int iovcnt, int *bread, int to, int *oserr)
+{
+	int         retval = E_ok;
+	int         n = 0, nbytes = 0;
+	int         idx = 0;
+	size_t      off = 0;
+	sysiov_t    sysiov[SOCK_MAX_IOV];
+
+	if ((iov == nullptr) || (iovcnt <= 0))
+		return E_invalid_arg;
+
+	if (bread == nullptr)
+		return E_invalid_arg;
+
+	// the data buffered is to be read first
+	if (is_buffered())
+		return nio::readv(iov, iovcnt, bread, to, oserr);
+
+	int to_read = iov_length(iov, iovcnt);
+	if (to_read <= 0)
+		return E_invalid_arg;
+
+	bool reset = false;
+	if (POLL_WAIT_FOREVER != to) {
+		if (blocking()) {
+			blocking(false);
+			reset = true;
+		}
+	}
+
+	do {
+		if (!blocking()) {
+			int syserr = 0;
+			if (!is_readable(to, &syserr)) {
+				if (oserr) *oserr = syserr;
+				retval = map_system_error(syserr, E_read_failed);
+				break;
+			}
+		}
+
+		int cnt = fill_sysiov(sysiov, iov, iovcnt, idx, off);
+#if defined(_WIN32)
+		DWORD received = 0;
+		DWORD flags = 0;
+		if (WSARecv(m_sock, sysiov, cnt, &received, &flags, nullptr, nullptr) == 0)
+			n = static_cast<int>(received);
+		else
+			n = SOCKET_ERROR;
+#else
+		msghdr msg = {};
+		msg.msg_iov = sysiov;
+		msg.msg_iovlen = cnt;
+		n = static_cast<int>(::recvmsg(m_sock, &msg, 0));
+#endif
+
+		if (SOCKET_ERROR == n) {
+			int error = snf::net::error();
+#if !defined(_WIN32)
+			if (EINTR == error)
+				continue;
+#endif
+			if (oserr) *oserr = error;
+			retval = map_system_error(error, E_read_failed);
+			break;
+		} else if (0 == n) {
+			break;
+		} else {
+			advance_iov(iov, iovcnt, idx, off, n);
+			to_read -= n;
+			nbytes += n;
+		}
+	} while (to_read > 0);
+
+	*bread = nbytes;
+
+	if (reset)
+		blocking(true);
+
+	return retval;
+}
+
+/**
+ * Writes the buffers to the socket, with as few system calls
+ * as possible (sendmsg()/WSASend()). There is no need to
+ * handle SIGPIPE explicitly while using this.
+ *
+ * @param [in]  iov      - buffers to write.
+ * @param [in]  iovcnt   - number of buffers.
+ * @param [out] bwritten - number of bytes written.
+ * @param [in]  to       - timeout in milliseconds.
+ *                         POLL_WAIT_FOREVER for inifinite wait.
+ *                         POLL_WAIT_NONE for no wait.
+ * @param [out] oserr    - system error code.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+socket::writev(const iobuf *iov, int iovcnt, int *bwritten, int to, int *oserr)
+{
+	int         retval = E_ok;
+	int         flags = 0;
+	int         n = 0, nbytes = 0;
+	int         idx = 0;
+	size_t      off = 0;
+	sysiov_t    sysiov[SOCK_MAX_IOV];
+
+	if ((iov == nullptr) || (iovcnt <= 0))
+		return E_invalid_arg;
+
+	if (bwritten == nullptr)
+		return E_invalid_arg;
+
+	int to_write = iov_length(iov, iovcnt);
+	if (to_write <= 0)
+		return E_invalid_arg;
+
+#if !defined(_WIN32)
+	flags = MSG_NOSIGNAL;
+#endif
+
+	bool reset = false;
+	if (POLL_WAIT_FOREVER != to) {
+		if (blocking()) {
+			blocking(false);
+			reset = true;
+		}
+	}
+
+	do {
+		if (!blocking()) {
+			int syserr = 0;
+			if (!is_writable(to, &syserr)) {
+				if (oserr) *oserr = syserr;
+				retval = map_system_error(syserr, E_write_failed);
+				break;
+			}
+		}
+
+		int cnt = fill_sysiov(sysiov, iov, iovcnt, idx, off);
+#if defined(_WIN32)
+		DWORD sent = 0;
+		if (WSASend(m_sock, sysiov, cnt, &sent, 0, nullptr, nullptr) == 0)
+			n = static_cast<int>(sent);
+		else
+			n = SOCKET_ERROR;
+		(void)flags;
+#else
+		msghdr msg = {};
+		msg.msg_iov = sysiov;
+		msg.msg_iovlen = cnt;
+		n = static_cast<int>(::sendmsg(m_sock, &msg, flags));
+#endif
+
+		if (SOCKET_ERROR == n) {
+			int error = snf::net::error();
+#if !defined(_WIN32)
+			if (EINTR == error)
+				continue;
+#endif
+			if (oserr) *oserr = error;
+			retval = map_system_error(error, E_write_failed);
+			break;
+		} else if (0 == n) {
+			break;
+		} else {
+			advance_iov(iov, iovcnt, idx, off, n);
+			to_write -= n;
+			nbytes += n;
+		}
+	} while (to_write > 0);
+
+	*bwritten = nbytes;
+
+	if (reset)
+		blocking(true);
+
+	return retval;
+}
+
+/**
+ * Sends the file data over the socket. On Linux, the data goes
+ * from the page cache to the socket with sendfile(), without
+ * being copied to user space, and the file offset is not
+ * changed. Elsewhere, or if the file does not support
+ * sendfile(), the data is read and written (see nio::sendfile()).
+ * There is no need to handle SIGPIPE explicitly while using this.
+ *
+ * @param [in]  f      - file to send the data of.
+ * @param [in]  offset - offset of the data in the file.
+ * @param [in]  length - number of bytes to send.
+ * @param [out] bsent  - number of bytes sent. This is less than
+ *                       length if the file is shorter.
+ * @param [in]  to     - timeout in milliseconds.
+ *                       POLL_WAIT_FOREVER for inifinite wait.
+ *                       POLL_WAIT_NONE for no wait.
+ * @param [out] oserr  - system error code.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+socket::sendfile(snf::file &f, int64_t offset, int64_t length, int64_t *bsent, int to, int *oserr)
+{
+#if defined(__linux__)
+	int         retval = E_ok;
+	int64_t     nbytes = 0;
+	off_t       off = static_cast<off_t>(offset);
+	bool        fallback = false;
+
+	if ((offset < 0) || (length <= 0))
+		return E_invalid_arg;
+
+	if (bsent == nullptr)
+		return E_invalid_arg;
+
+	bool reset = false;
+	if (POLL_WAIT_FOREVER != to) {
+		if (blocking()) {
+			blocking(false);
+			reset = true;
+		}
+	}
+
+	do {
+		if (!blocking()) {
+			int syserr = 0;
+			if (!is_writable(to, &syserr)) {
+				if (oserr) *oserr = syserr;
+				retval = map_system_error(syserr, E_write_failed);
+				break;
+			}
+		}
+
+		size_t count = static_cast<size_t>(std::min(length, static_cast<int64_t>(SOCK_MAX_SENDFILE)));
+		ssize_t n = ::sendfile(m_sock, static_cast<fhandle_t>(f), &off, count);
+
+		if (SOCKET_ERROR == n) {
+			int error = snf::net::error();
+			if (EINTR == error)
+				continue;
+			if ((nbytes == 0) && ((EINVAL == error) || (ENOSYS == error))) {
+				// not supported for this file
+				fallback = true;
+				break;
+			}
+			if (oserr) *oserr = error;
+			retval = map_system_error(error, E_write_failed);
+			break;
+		} else if (0 == n) {
+			break;
+		} else {
+			length -= n;
+			nbytes += n;
+		}
+	} while (length > 0);
+
+	*bsent = nbytes;
+
+	if (reset)
+		blocking(true);
+
+	if (fallback)
+		return nio::sendfile(f, offset, length, bsent, to, oserr);
+
+	return retval;
+#else
+	return nio::sendfile(f, offset, length, bsent, to, oserr);
+#endif
+}
+
 /*
  * Closes the socket.
  *
@@ -0,0 +1,221 @@
+#include "timerwheel.h"
+
+namespace snf {
+namespace net {
+
+/*
+ * Places the timer in the slot covering its due time, relative
+ * to the current tick.
+ */
+void
+timer_wheel::place(node *n)
+{
+	int64_t due = n->due;
+	int64_t delta = due - m_tick;
+	int level = 0;
+
+	if (delta < 0) {
+		// overdue: expires with the current tick
+		due = m_tick;
+	} else {
+		while ((level < (TW_LEVELS - 1)) && (delta >= (int64_t(1) << (TW_BITS * (level + 1)))))
+			level++;
+
+		int64_t range = int64_t(1) << (TW_BITS * TW_LEVELS);
+		if (delta >= range) {
+			// parked until the top level comes around
+			due = m_tick + range - 1;
+		}
+	}
+
+	n->level = level;
+	n->slot = static_cast<int>((due >> (TW_BITS * level)) & TW_MASK);
+
+	node *&head = m_slots[level][n->slot];
+	n->prev = nullptr;
+	n->next = head;
+	if (head)
+		head->prev = n;
+	head = n;
+	m_count[level]++;
+}
+
+/*
+ * Takes the timer out of its slot.
+ */
+void
+timer_wheel::unlink(node *n)
+{
+	if (n->prev)
+		n->prev->next = n->next;
+	else
+		m_slots[n->level][n->slot] = n->next;
+
+	if (n->next)
+		n->next->prev = n->prev;
+
+	n->prev = n->next = nullptr;
+	m_count[n->level]--;
+}
+
+/*
+ * Places the timers of the slot of the level again.
+ */
+void
+timer_wheel::cascade(int level, int slot)
+{
+	node *n = m_slots[level][slot];
+
+	m_slots[level][slot] = nullptr;
+	while (n) {
+		node *next = n->next;
+		m_count[level]--;
+		place(n);
+		n = next;
+	}
+}
+
+/*
+ * Adds a timer.
+ *
+ * @param [in] due - tick the timer is due at.
+ * @param [in] cb  - callback to call when the timer expires.
+ *
+ * @return the timer ID, to cancel the timer with.
+ */
+timer_wheel::timer_id
+timer_wheel::add(int64_t due, callback cb)
+{
+	std::unique_ptr<node> n(new node);
+	n->id = m_next_id++;
+	n->due = due;
+	n->cb = std::move(cb);
+
+	place(n.get());
+
+	timer_id id = n->id;
+	m_timers.emplace(id, std::move(n));
+	return id;
+}
+
+/*
+ * Cancels a timer.
+ *
+ * @param [in] id - timer ID.
+ *
+ * @return true if the timer is cancelled, false if it has
+ *         expired or has been cancelled already.
+ */
+bool
+timer_wheel::cancel(timer_id id)
+{
+	auto T = m_timers.find(id);
+	if (T == m_timers.end())
+		return false;
+
+	unlink(T->second.get());
+	m_timers.erase(T);
+	return true;
+}
+
+/*
+ * Gets the tick the next timer is due at, or the tick the next
+ * timer is cascaded at if earlier (the lower levels do not
+ * keep the exact due time). Waiting until then does not miss
+ * any timer. At most TW_LEVELS * TW_SLOTS slots are looked at.
+ *
+ * @return the tick, timer_wheel::never if there is no timer.
+ */
+int64_t
+timer_wheel::next_due() const
+{
+	if (m_timers.empty())
+		return never;
+
+	if (m_count[0] > 0) {
+		for (int k = 0; k < TW_SLOTS; ++k) {
+			if (m_slots[0][(m_tick + k) & TW_MASK])
+				return m_tick + k;
+		}
+	}
+
+	int64_t due = never;
+
+	for (int level = 1; level < TW_LEVELS; ++level) {
+		if (m_count[level] == 0)
+			continue;
+
+		int shift = TW_BITS * level;
+		int64_t span = int64_t(TW_SLOTS) << shift;
+
+		for (int k = 0; k < TW_SLOTS; ++k) {
+			int64_t start = ((m_tick >> shift) + k) << shift;
+			if (m_slots[level][(start >> shift) & TW_MASK]) {
+				// the current slot may be a full turn away
+				if (start < m_tick)
+					start += span;
+				if (start < due)
+					due = start;
+			}
+		}
+	}
+
+	return due;
+}
+
+/*
+ * Expires the timers due up to the tick, cascading the higher
+ * levels on the way. The callbacks are not called but handed
+ * back, so that the caller can call them once done with the
+ * wheel (a callback may add timers).
+ *
+ * @param [in]  now - current tick.
+ * @param [out] cbs - callbacks of the timers expired.
+ */
+void
+timer_wheel::expire(int64_t now, std::vector<callback> &cbs)
+{
+	while (m_tick <= now) {
+		if (m_timers.empty()) {
+			m_tick = now + 1;
+			break;
+		}
+
+		if (m_count[0] == 0) {
+			// nothing to expire before the next cascade
+			int64_t due = next_due();
+			if (due > m_tick) {
+				if (due > now) {
+					m_tick = now + 1;
+					break;
+				}
+				m_tick = due;
+			}
+		}
+
+		int index = static_cast<int>(m_tick & TW_MASK);
+		if (index == 0) {
+			for (int level = 1; level < TW_LEVELS; ++level) {
+				int slot = static_cast<int>((m_tick >> (TW_BITS * level)) & TW_MASK);
+				cascade(level, slot);
+				if (slot != 0)
+					break;
+			}
+		}
+
+		m_tick++;
+
+		node *n = m_slots[0][index];
+		m_slots[0][index] = nullptr;
+		while (n) {
+			node *next = n->next;
+			m_count[0]--;
+			cbs.push_back(std::move(n->cb));
+			m_timers.erase(n->id);
+			n = next;
+		}
+	}
+}
+
+} // namespace net
+} // namespace snf
@@ -0,0 +1,276 @@
+#include "net.h"
+#include "reactor.h"
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <cstring>
+#include <ctime>
+
+/*
+ * Loopback benchmark of the reactor backends: clients send
+ * small requests over TCP connections to 127.0.0.1 and wait
+ * for the replies, which the reactor echoes back. Reports the
+ * requests per second and the CPU time the reactor thread
+ * spends per request.
+ */
+
+struct arguments
+{
+	int conns;
+	int threads;
+	int size;
+	int secs;
+	std::string backend;
+
+	arguments()
+		: conns(64)
+		, threads(4)
+		, size(64)
+		, secs(3)
+		, backend("all")
+	{
+	}
+};
+
+/*
+ * Echoes what is read back to the client.
+ */
+class echo_handler : public snf::net::handler
+{
+private:
+	std::vector<char> m_buf;
+
+public:
+	echo_handler(int size) : m_buf(size) {}
+	virtual ~echo_handler() {}
+
+	virtual const char *name() const { return "echo-handler"; }
+
+	virtual bool operator()(sock_t s, snf::net::event e) override
+	{
+		if (e != snf::net::event::read)
+			return false;
+
+		int n = ::recv(s, m_buf.data(), static_cast<int>(m_buf.size()), 0);
+		if (n <= 0)
+			return false;
+
+		int off = 0;
+		while (off < n) {
+			int w = ::send(s, m_buf.data() + off, n - off, 0);
+			if (w <= 0)
+				return false;
+			off += w;
+		}
+
+		return true;
+	}
+};
+
+/*
+ * Gets the CPU time of the calling thread, in microseconds.
+ */
+static int64_t
+thread_cpu()
+{
+#if defined(__linux__)
+	timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+#else
+	return 0;
+#endif
+}
+
+/*
+ * Gets the CPU time of the reactor thread, from a timer.
+ */
+static int64_t
+reactor_cpu(snf::net::reactor &r)
+{
+	std::promise<int64_t> p;
+	std::future<int64_t> f = p.get_future();
+	r.add_timer([&p]() { p.set_value(thread_cpu()); }, 0);
+	return f.get();
+}
+
+/*
+ * Sends a request on every connection, then reads the replies,
+ * until the deadline.
+ */
+static void
+client(std::vector<snf::net::socket> &conns, size_t first, size_t last,
+	int size, std::chrono::steady_clock::time_point deadline,
+	std::atomic<int64_t> &requests)
+{
+	std::vector<char> buf(size, 'x');
+	int64_t n = 0;
+	int bytes = 0;
+
+	while (std::chrono::steady_clock::now() < deadline) {
+		for (size_t i = first; i < last; ++i)
+			conns[i].writen(buf.data(), size, &bytes);
+		for (size_t i = first; i < last; ++i) {
+			if (conns[i].readn(buf.data(), size, &bytes) != E_ok)
+				return;
+		}
+		n += static_cast<int64_t>(last - first);
+	}
+
+	requests += n;
+}
+
+static int
+run(const arguments &args, snf::net::reactor_backend b)
+{
+	snf::net::reactor r(snf::net::POLL_WAIT_FOREVER, b);
+	if (r.backend() != b) {
+		std::cout << std::setw(8) << snf::net::backendstr(b)
+			<< "  not available" << std::endl;
+		return 0;
+	}
+
+	snf::net::socket_address sa(AF_INET, "127.0.0.1", 0);
+	snf::net::socket listener(AF_INET, snf::net::socket_type::tcp);
+	listener.reuseaddr(true);
+	listener.bind(sa);
+	listener.listen(args.conns);
+	in_port_t port = listener.local_address().port();
+
+	std::vector<snf::net::socket> clients;
+	std::vector<snf::net::socket> servers;
+
+	for (int i = 0; i < args.conns; ++i) {
+		snf::net::socket c(AF_INET, snf::net::socket_type::tcp);
+		c.connect(snf::net::socket_address(AF_INET, "127.0.0.1", port));
+		c.tcpnodelay(true);
+
+		snf::net::socket s = listener.accept();
+		s.tcpnodelay(true);
+		s.blocking(false);
+
+		clients.push_back(std::move(c));
+		servers.push_back(std::move(s));
+	}
+
+	for (auto &s : servers)
+		r.add_handler(s, snf::net::event::read, DBG_NEW echo_handler(args.size));
+
+	std::atomic<int64_t> requests { 0 };
+	std::vector<std::thread> threads;
+	int nthreads = std::min(args.threads, args.conns);
+	size_t per = clients.size() / nthreads;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point deadline = start + std::chrono::seconds(args.secs);
+	int64_t cpu0 = reactor_cpu(r);
+
+	for (int t = 0; t < nthreads; ++t) {
+		size_t first = t * per;
+		size_t last = (t == nthreads - 1) ? clients.size() : first + per;
+		threads.emplace_back(client, std::ref(clients), first, last,
+			args.size, deadline, std::ref(requests));
+	}
+
+	for (auto &t : threads)
+		t.join();
+
+	int64_t cpu1 = reactor_cpu(r);
+	double elapsed = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start).count();
+
+	for (auto &s : servers)
+		r.remove_handler(s);
+	r.stop();
+
+	int64_t n = requests;
+	std::cout << std::setw(8) << snf::net::backendstr(b)
+		<< std::setw(8) << args.conns
+		<< std::setw(12) << n
+		<< std::setw(12) << static_cast<int64_t>(n / elapsed)
+		<< std::setw(16) << std::fixed << std::setprecision(2)
+		<< ((n > 0) ? double(cpu1 - cpu0) / n : 0.0)
+		<< std::endl;
+
+	return 0;
+}
+
+static int
+usage(const std::string &prog)
+{
+	std::cerr << prog << " [-conns <connections>] [-threads <client-threads>]" << std::endl;
+	std::cerr << "    [-size <request-size>] [-secs <seconds>] [-backend <poll|epoll|all>]" << std::endl;
+	return 1;
+}
+
+static int
+parse_arguments(arguments &args, int argc, const char **argv)
+{
+	for (int i = 1; i < argc; ++i) {
+		if (!argv[i + 1])
+			return usage(argv[0]);
+
+		if (snf::streq("-conns", argv[i])) {
+			args.conns = atoi(argv[++i]);
+		} else if (snf::streq("-threads", argv[i])) {
+			args.threads = atoi(argv[++i]);
+		} else if (snf::streq("-size", argv[i])) {
+			args.size = atoi(argv[++i]);
+		} else if (snf::streq("-secs", argv[i])) {
+			args.secs = atoi(argv[++i]);
+		} else if (snf::streq("-backend", argv[i])) {
+			args.backend = argv[++i];
+		} else {
+			return usage(argv[0]);
+		}
+	}
+
+	if ((args.conns <= 0) || (args.threads <= 0) || (args.size <= 0) || (args.secs <= 0))
+		return usage(argv[0]);
+
+	return 0;
+}
+
+int
+main(int argc, const char **argv) try {
+	arguments args;
+
+	int retval = parse_arguments(args, argc, argv);
+	if (retval != 0)
+		return retval;
+
+	snf::net::initialize();
+
+	std::cout << std::setw(8) << "backend"
+		<< std::setw(8) << "conns"
+		<< std::setw(12) << "requests"
+		<< std::setw(12) << "req/s"
+		<< std::setw(16) << "cpu us/req"
+		<< std::endl;
+
+	const snf::net::reactor_backend backends[] = {
+		snf::net::reactor_backend::poll,
+		snf::net::reactor_backend::epoll
+	};
+
+	for (auto b : backends) {
+		if ((args.backend == "all") || (args.backend == snf::net::backendstr(b)))
+			run(args, b);
+	}
+
+	snf::net::finalize();
+	return 0;
+} catch (const std::system_error &ex) {
+	std::cerr << "Error Code: " << ex.code() << std::endl;
+	std::cerr << "Error: " << ex.what() << std::endl;
+	return 1;
+} catch (const std::exception &ex) {
+	std::cerr << ex.what() << std::endl;
+	return 1;
+}
@@ -4,6 +4,9 @@
 #include "key.h"
 #include "certificate.h"
 #include "sctx.h"
+#include "reactortest.h"
+#include "timerwheeltest.h"
+#include "niotest.h"
 
 namespace snf {
 namespace tf {
@@ -13,6 +16,9 @@ test *test_list[] = {
 	DBG_NEW priv_key(),
 	DBG_NEW certificate(),
 	DBG_NEW sctx(),
+	DBG_NEW reactor_test(),
+	DBG_NEW timer_wheel_test(),
+	DBG_NEW nio_test(),
 	0
 };
 
@@ -0,0 +1,203 @@
+#include "sock.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+class nio_test : public snf::tf::test
+{
+public:
+	nio_test() : snf::tf::test() {}
+	~nio_test() {}
+
+	virtual const char *name() const
+	{
+		return "VectoredIO";
+	}
+
+	virtual const char *description() const
+	{
+		return "Tests vectored socket reads and writes, sendfile, and buffered reads";
+	}
+
+	virtual bool execute(const snf::config *)
+	{
+		std::array<snf::net::socket, 2> sp = snf::net::socket::socketpair();
+		int retval;
+		int n = 0;
+
+		char h[] = "HTTP/1.1 200 OK\r\n";
+		char e[] = "";
+		char b[] = "hello, world";
+		snf::net::iobuf out[3] = {
+			{ h, strlen(h) },
+			{ e, 0 },
+			{ b, strlen(b) }
+		};
+		int total = static_cast<int>(strlen(h) + strlen(b));
+
+		retval = sp[0].writev(out, 3, &n);
+		ASSERT_EQ(int, retval, E_ok, "writev");
+		ASSERT_EQ(int, n, total, "bytes written");
+
+		// read back split differently
+		char r1[5], r2[64];
+		snf::net::iobuf in[2] = {
+			{ r1, sizeof(r1) },
+			{ r2, static_cast<size_t>(total) - sizeof(r1) }
+		};
+
+		n = 0;
+		retval = sp[1].readv(in, 2, &n);
+		ASSERT_EQ(int, retval, E_ok, "readv");
+		ASSERT_EQ(int, n, total, "bytes read");
+		ASSERT_EQ(std::string, std::string(r1, sizeof(r1)) + std::string(r2, total - sizeof(r1)),
+			std::string(h) + std::string(b), "data matches");
+
+		// more buffers than are written at once
+		std::vector<std::string> parts;
+		std::vector<snf::net::iobuf> many;
+		std::string all;
+		for (int i = 0; i < 200; ++i)
+			parts.push_back("part" + std::to_string(i) + ";");
+		for (auto &p : parts) {
+			many.push_back({ const_cast<char *>(p.data()), p.size() });
+			all += p;
+		}
+
+		n = 0;
+		retval = sp[0].writev(many.data(), static_cast<int>(many.size()), &n);
+		ASSERT_EQ(int, retval, E_ok, "writev 200 buffers");
+		ASSERT_EQ(int, n, static_cast<int>(all.size()), "bytes written");
+
+		std::vector<char> buf(all.size());
+		n = 0;
+		retval = sp[1].readn(buf.data(), static_cast<int>(buf.size()), &n);
+		ASSERT_EQ(int, retval, E_ok, "readn");
+		ASSERT_EQ(std::string, std::string(buf.data(), n), all, "data matches");
+
+		// length and string in one write
+		retval = sp[0].write_string("vectored");
+		ASSERT_EQ(int, retval, E_ok, "write_string");
+
+		std::string str;
+		retval = sp[1].read_string(str);
+		ASSERT_EQ(int, retval, E_ok, "read_string");
+		ASSERT_EQ(std::string, str, "vectored", "string matches");
+
+		// file data
+		std::string fdata;
+		for (int i = 0; i < 10000; ++i)
+			fdata += std::to_string(i) + "\n";
+
+		snf::file f("niotest.dat", 0022);
+		snf::file::open_flags oflags;
+		oflags.o_read = true;
+		oflags.o_write = true;
+		oflags.o_create = true;
+		oflags.o_truncate = true;
+		retval = f.open(oflags, 0600);
+		ASSERT_EQ(int, retval, E_ok, "file open");
+		retval = f.write(fdata.data(), static_cast<int>(fdata.size()), &n);
+		ASSERT_EQ(int, retval, E_ok, "file write");
+
+		int64_t sent = 0;
+		int64_t length = static_cast<int64_t>(fdata.size()) - 100;
+		retval = sp[0].sendfile(f, 100, length, &sent);
+		ASSERT_EQ(int, retval, E_ok, "sendfile");
+		ASSERT_EQ(int64_t, sent, length, "bytes sent");
+
+		buf.resize(fdata.size());
+		n = 0;
+		retval = sp[1].readn(buf.data(), static_cast<int>(length), &n);
+		ASSERT_EQ(int, retval, E_ok, "readn");
+		ASSERT_EQ(std::string, std::string(buf.data(), n), fdata.substr(100), "file data matches");
+
+		// read and written
+		retval = sp[0].nio::sendfile(f, 0, 1000, &sent);
+		ASSERT_EQ(int, retval, E_ok, "buffered sendfile");
+		ASSERT_EQ(int64_t, sent, int64_t(1000), "bytes sent");
+
+		n = 0;
+		retval = sp[1].readn(buf.data(), 1000, &n);
+		ASSERT_EQ(int, retval, E_ok, "readn");
+		ASSERT_EQ(std::string, std::string(buf.data(), n), fdata.substr(0, 1000), "file data matches");
+
+		// past the end of the file
+		retval = sp[0].sendfile(f, static_cast<int64_t>(fdata.size()) - 10, 100, &sent);
+		ASSERT_EQ(int, retval, E_ok, "sendfile");
+		ASSERT_EQ(int64_t, sent, int64_t(10), "bytes sent up to the end of file");
+
+		n = 0;
+		retval = sp[1].readn(buf.data(), 10, &n);
+		ASSERT_EQ(int, retval, E_ok, "readn");
+		ASSERT_EQ(std::string, std::string(buf.data(), n), fdata.substr(fdata.size() - 10), "file data matches");
+
+		f.close();
+		std::remove("niotest.dat");
+
+		// buffered reads
+		std::array<snf::net::socket, 2> bp = snf::net::socket::socketpair();
+		const char *data = nullptr;
+		int len = 0;
+
+		retval = bp[1].peek(&data, &len);
+		ASSERT_EQ(int, retval, E_invalid_state, "peek without buffer");
+
+		bp[1].setbuf(64);
+
+		std::string longline(100, 'x');
+		std::string lines = "GET / HTTP/1.1\r\nHost: localhost\r\n" + longline + "\r\n" +
+			std::string(h) + std::string(b);
+
+		retval = bp[0].writen(lines.data(), static_cast<int>(lines.size()), &n);
+		ASSERT_EQ(int, retval, E_ok, "writen");
+
+		std::string line;
+		retval = bp[1].readline(line);
+		ASSERT_EQ(int, retval, E_ok, "readline");
+		ASSERT_EQ(std::string, line, "GET / HTTP/1.1\r\n", "line matches");
+
+		line.clear();
+		retval = bp[1].readline(line);
+		ASSERT_EQ(int, retval, E_ok, "readline");
+		ASSERT_EQ(std::string, line, "Host: localhost\r\n", "line matches");
+
+		line.clear();
+		retval = bp[1].readline(line);
+		ASSERT_EQ(int, retval, E_ok, "readline longer than the buffer");
+		ASSERT_EQ(std::string, line, longline + "\r\n", "line matches");
+
+		retval = bp[1].peek(&data, &len);
+		ASSERT_EQ(int, retval, E_ok, "peek");
+		ASSERT_EQ(bool, len > 0, true, "data buffered");
+		ASSERT_EQ(int, bp[1].pending(), len, "data pending");
+		ASSERT_EQ(char, data[0], 'H', "first character");
+		bp[1].consume(1);
+
+		char c = 0;
+		retval = bp[1].get_char(c);
+		ASSERT_EQ(int, retval, E_ok, "get_char");
+		ASSERT_EQ(char, c, 'T', "second character");
+
+		in[0] = { r1, sizeof(r1) };
+		in[1] = { r2, static_cast<size_t>(total - 2) - sizeof(r1) };
+		n = 0;
+		retval = bp[1].readv(in, 2, &n);
+		ASSERT_EQ(int, retval, E_ok, "buffered readv");
+		ASSERT_EQ(int, n, total - 2, "bytes read");
+		ASSERT_EQ(std::string, std::string(r1, sizeof(r1)) + std::string(r2, total - 2 - sizeof(r1)),
+			(std::string(h) + std::string(b)).substr(2), "buffered data matches");
+
+		bp[0].close();
+
+		retval = bp[1].peek(&data, &len);
+		ASSERT_EQ(int, retval, E_ok, "peek at the end of file");
+		ASSERT_EQ(int, len, 0, "no data");
+
+		line.clear();
+		retval = bp[1].readline(line);
+		ASSERT_EQ(int, retval, E_read_failed, "readline at the end of file");
+
+		return true;
+	}
+};
@@ -0,0 +1,178 @@
+#include <atomic>
+#include "reactor.h"
+#include <chrono>
+#include <thread>
+
+class reactor_test : public snf::tf::test
+{
+private:
+	/*
+	 * Reads an integer per read event. Optionally registers
+	 * a handler for another socket the first time it is called.
+	 */
+	class count_handler : public snf::net::handler
+	{
+	private:
+		snf::net::socket            &m_sock;
+		std::atomic<int>            &m_reads;
+		std::atomic<int>            &m_timeouts;
+		bool                        m_keep;
+		snf::net::reactor           *m_reactor;
+		snf::net::handler           *m_next;
+		sock_t                      m_next_sock;
+
+	public:
+		count_handler(snf::net::socket &s, std::atomic<int> &reads,
+			std::atomic<int> &timeouts, bool keep)
+			: m_sock(s)
+			, m_reads(reads)
+			, m_timeouts(timeouts)
+			, m_keep(keep)
+			, m_reactor(nullptr)
+			, m_next(nullptr)
+			, m_next_sock(INVALID_SOCKET)
+		{
+		}
+
+		virtual ~count_handler() { delete m_next; }
+
+		void then_add(snf::net::reactor *r, sock_t s, snf::net::handler *h)
+		{
+			m_reactor = r;
+			m_next_sock = s;
+			m_next = h;
+		}
+
+		virtual const char *name() const { return "count-handler"; }
+
+		virtual bool operator()(sock_t, snf::net::event e) override
+		{
+			if (e == snf::net::event::timeout) {
+				m_timeouts++;
+				return false;
+			}
+
+			int dummy = 0;
+			m_sock.read_integral(&dummy, snf::net::POLL_WAIT_NONE);
+			m_reads++;
+
+			if (m_next) {
+				m_reactor->add_handler(m_next_sock, snf::net::event::read, m_next);
+				m_next = nullptr;
+			}
+
+			return m_keep;
+		}
+	};
+
+	static bool wait_for(std::atomic<int> &v, int expected)
+	{
+		for (int i = 0; (i < 2000) && (v < expected); ++i)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		return v == expected;
+	}
+
+public:
+	reactor_test() : snf::tf::test() {}
+	~reactor_test() {}
+
+	virtual const char *name() const
+	{
+		return "Reactor";
+	}
+
+	virtual const char *description() const
+	{
+		return "Tests the reactor handlers and timers with the poll and epoll backends";
+	}
+
+	bool run(snf::net::reactor_backend b)
+	{
+		std::array<snf::net::socket, 2> kept = snf::net::socket::socketpair();
+		std::array<snf::net::socket, 2> once = snf::net::socket::socketpair();
+		std::array<snf::net::socket, 2> added = snf::net::socket::socketpair();
+		std::array<snf::net::socket, 2> idle = snf::net::socket::socketpair();
+		std::atomic<int> kept_reads { 0 }, once_reads { 0 }, added_reads { 0 }, idle_reads { 0 };
+		std::atomic<int> timeouts { 0 };
+
+		// stopped before the sockets and counters are gone
+		snf::net::reactor r(50, b);
+
+		std::cout << "backend " << snf::net::backendstr(r.backend()) << std::endl;
+#if defined(__linux__)
+		ASSERT_EQ(std::string, snf::net::backendstr(r.backend()), snf::net::backendstr(b), "backend");
+#endif
+
+		count_handler *h = DBG_NEW count_handler(kept[0], kept_reads, timeouts, true);
+		h->then_add(&r, added[0], DBG_NEW count_handler(added[0], added_reads, timeouts, true));
+		r.add_handler(kept[0], snf::net::event::read, h);
+		r.add_handler(once[0], snf::net::event::read,
+			DBG_NEW count_handler(once[0], once_reads, timeouts, false));
+		r.add_handler(idle[0], snf::net::event::read,
+			DBG_NEW count_handler(idle[0], idle_reads, timeouts, false), 100);
+
+		for (int i = 1; i <= 3; ++i) {
+			kept[1].write_integral(i);
+			ASSERT_EQ(bool, wait_for(kept_reads, i), true, "read handler called");
+		}
+
+		// registered from the handler above
+		added[1].write_integral(1);
+		ASSERT_EQ(bool, wait_for(added_reads, 1), true, "handler added by a handler called");
+
+		once[1].write_integral(1);
+		ASSERT_EQ(bool, wait_for(once_reads, 1), true, "read handler called");
+		once[1].write_integral(2);
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		ASSERT_EQ(int, once_reads, 1, "handler removed");
+
+		ASSERT_EQ(bool, wait_for(timeouts, 1), true, "handler timed out");
+		ASSERT_EQ(int, idle_reads, 0, "no read");
+
+		r.remove_handler(kept[0], snf::net::event::read);
+		kept[1].write_integral(4);
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		ASSERT_EQ(int, kept_reads, 3, "handler removed");
+
+		r.remove_handler(added[0]);
+		r.stop();
+
+		return run_timers(b);
+	}
+
+	bool run_timers(snf::net::reactor_backend b)
+	{
+		std::atomic<int> fired { 0 }, cancelled { 0 };
+
+		// the wait is cut short by the timers only
+		snf::net::reactor r(snf::net::POLL_WAIT_FOREVER, b);
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		r.add_timer([&fired]() { fired++; }, 30);
+		ASSERT_EQ(bool, wait_for(fired, 1), true, "timer fired");
+		ASSERT_EQ(bool, std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(30),
+			true, "timer not early");
+
+		snf::net::timer_wheel::timer_id id = r.add_timer([&cancelled]() { cancelled++; }, 50);
+		ASSERT_EQ(bool, r.cancel_timer(id), true, "timer cancelled");
+		ASSERT_EQ(bool, r.cancel_timer(id), false, "timer cancelled already");
+
+		// a timer added from a timer
+		r.add_timer([&r, &fired]() {
+			r.add_timer([&fired]() { fired++; }, 10);
+			fired++;
+		}, 10);
+		ASSERT_EQ(bool, wait_for(fired, 3), true, "timers fired");
+		ASSERT_EQ(int, cancelled, 0, "cancelled timer not fired");
+
+		r.stop();
+		return true;
+	}
+
+	virtual bool execute(const snf::config *)
+	{
+		if (!run(snf::net::reactor_backend::poll))
+			return false;
+		return run(snf::net::reactor_backend::epoll);
+	}
+};
@@ -47,6 +47,20 @@ public:
 		return true;
 	}
 
+	bool reuseport(snf::net::socket &s)
+	{
+#if defined(SO_REUSEPORT)
+		ASSERT_EQ(bool, false, s.reuseport(), "reuse port is disabled by default");
+		s.reuseport(true);
+		ASSERT_EQ(bool, true, s.reuseport(), "reuse port is enabled");
+		s.reuseport(false);
+		ASSERT_EQ(bool, false, s.reuseport(), "reuse port is disabled");
+#else
+		ASSERT_EQ(bool, false, s.reuseport(), "reuse port is not supported");
+#endif
+		return true;
+	}
+
 	bool linger(snf::net::socket &s)
 	{
 		snf::net::socket::linger_type lt;
@@ -132,6 +146,7 @@ public:
 
 			ASSERT_EQ(bool, keepalive(s), true, "keep alive test passed");
 			ASSERT_EQ(bool, reuseaddr(s), true, "reuse address test passed");
+			ASSERT_EQ(bool, reuseport(s), true, "reuse port test passed");
 			ASSERT_EQ(bool, linger(s), true, "linger test passed");
 			ASSERT_EQ(bool, rcvbuf(s), true, "receive buffer test passed");
 			ASSERT_EQ(bool, sndbuf(s), true, "send buffer test passed");
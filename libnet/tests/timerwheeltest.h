@@ -0,0 +1,85 @@
+#include "timerwheel.h"
+#include <vector>
+
+class timer_wheel_test : public snf::tf::test
+{
+private:
+	/*
+	 * Advances the wheel tick by tick, calling the callbacks
+	 * of the timers as they expire.
+	 */
+	static void advance(snf::net::timer_wheel &tw, int64_t from, int64_t to)
+	{
+		for (int64_t t = from; t <= to; ++t) {
+			std::vector<snf::net::timer_wheel::callback> cbs;
+			tw.expire(t, cbs);
+			for (auto &cb : cbs)
+				cb();
+		}
+	}
+
+public:
+	timer_wheel_test() : snf::tf::test() {}
+	~timer_wheel_test() {}
+
+	virtual const char *name() const
+	{
+		return "TimerWheel";
+	}
+
+	virtual const char *description() const
+	{
+		return "Tests the hierarchical timer wheel";
+	}
+
+	virtual bool execute(const snf::config *)
+	{
+		const int64_t base = 1000;
+		const int64_t dues[] = { 1, 63, 64, 65, 4095, 4096, 4097, 300000, 20000000 };
+		std::vector<int64_t> fired(sizeof(dues) / sizeof(dues[0]), -1);
+		int64_t now = base;
+
+		snf::net::timer_wheel tw(base);
+		ASSERT_EQ(int64_t, tw.next_due(), snf::net::timer_wheel::never, "no timer");
+
+		for (size_t i = 0; i < sizeof(dues) / sizeof(dues[0]); ++i) {
+			int64_t *at = &fired[i];
+			tw.add(base + dues[i], [at, &now]() { *at = now; });
+		}
+
+		snf::net::timer_wheel::timer_id id = tw.add(base + 100, []() {});
+		ASSERT_EQ(size_t, tw.size(), size_t(10), "timers added");
+		ASSERT_EQ(bool, tw.cancel(id), true, "timer cancelled");
+		ASSERT_EQ(bool, tw.cancel(id), false, "timer cancelled already");
+		ASSERT_EQ(int64_t, tw.next_due(), base + 1, "next due");
+
+		// tick by tick through the lower levels
+		for (now = base; now <= base + 5000; ++now)
+			advance(tw, now, now);
+
+		// then jumping from one due time to the next, as the
+		// reactor does
+		while (tw.size() > 0) {
+			now = tw.next_due();
+			ASSERT_EQ(bool, now != snf::net::timer_wheel::never, true, "next due");
+			std::vector<snf::net::timer_wheel::callback> cbs;
+			tw.expire(now, cbs);
+			for (auto &cb : cbs)
+				cb();
+		}
+
+		for (size_t i = 0; i < sizeof(dues) / sizeof(dues[0]); ++i) {
+			m_strm << "timer due at +" << dues[i];
+			ASSERT_EQ(int64_t, fired[i], base + dues[i], m_strm.str());
+			m_strm.str("");
+		}
+
+		// overdue timers fire on the next expire
+		int count = 0;
+		tw.add(now - 10, [&count]() { count++; });
+		advance(tw, now + 1, now + 1);
+		ASSERT_EQ(int, count, 1, "overdue timer fired");
+
+		return true;
+	}
+};
@@ -3,13 +3,16 @@
 
 #include <list>
 #include <mutex>
+#include <vector>
 #include "dbfiles.h"
 #include "pagemgr.h"
+#include "stats.h"
 
 /* LRU cache node */
 typedef struct cnode
 {
 	key_page_node_t *c_kpn;     /* key page node */
+	KeyFile         *c_file;    /* file the page belongs to */
 	struct cnode    *c_prev;    /* previous LRU node */
 	struct cnode    *c_next;    /* next LRU node */
 } cnode_t;
@@ -36,12 +39,15 @@ private:
 	cnode_t     *head;
 	cnode_t     *tail;
 	std::mutex  mutex;
+	StripedCounter hits;        // pages found in the cache
+	StripedCounter misses;      // pages read into the cache
+	StripedCounter evictions;   // pages evicted from the cache
 
 	cnode_t *removeLast();
 	cnode_t *getCacheNode();
 	void add(cnode_t *);
 	void free(cnode_t *);
-	int getPage(key_page_t *&, int64_t offset = -1);
+	int getPage(key_page_t *&, int64_t, KeyFile *, const void *);
 
 public:
 	/**
@@ -85,10 +91,61 @@ public:
 		}
 	}
 
-	int  get(key_page_node_t *&, int64_t offset = -1L);
-	int  update(key_page_node_t *, int64_t offset = -1L);
+	/**
+	 * Gets the number of pages found in the cache.
+	 */
+	int64_t getHits() const
+	{
+		return hits.value();
+	}
+
+	/**
+	 * Gets the number of pages read into the cache.
+	 */
+	int64_t getMisses() const
+	{
+		return misses.value();
+	}
+
+	/**
+	 * Gets the number of pages evicted from the cache.
+	 */
+	int64_t getEvictions() const
+	{
+		return evictions.value();
+	}
+
+	/**
+	 * Gets the number of pages the cache can hold.
+	 */
+	int getNumberOfPages() const
+	{
+		return max;
+	}
+
+	/**
+	 * Gets the number of free pages in the page pool.
+	 */
+	int getNumberOfFreePages() const
+	{
+		return pageMgr->getNumberOfFreePages();
+	}
+
+	/**
+	 * Is the cache full i.e. would a page read in evict
+	 * another one?
+	 */
+	bool isFull()
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		return num >= max;
+	}
+
+	int  get(key_page_node_t *&, int64_t offset = -1L, KeyFile *file = 0, const void *data = 0);
+	int  update(key_page_node_t *, int64_t offset = -1L, KeyFile *file = 0, const void *data = 0);
 	void touch(key_page_node_t *);
 	void free(key_page_node_t *);
+	void getHotPages(std::vector<int64_t> &, int);
 };
 
 #endif // _CACHE_H
@@ -0,0 +1,169 @@
+#ifndef _SNF_RDB_CHECKER_H_
+#define _SNF_RDB_CHECKER_H_
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "file.h"
+#include "dbstruct.h"
+
+#ifndef RDB_CHECK_MAX_PROBLEMS
+#define RDB_CHECK_MAX_PROBLEMS  100
+#endif
+
+#ifndef RDB_CHECK_CHUNK_SIZE
+#define RDB_CHECK_CHUNK_SIZE    (4 * 1024 * 1024)
+#endif
+
+/**
+ * Result of a database integrity check, obtained using
+ * RdbChecker::check().
+ */
+class RdbCheckReport
+{
+public:
+	int64_t     keyPages;           // key pages in use
+	int64_t     freeKeyPages;       // free (deleted or empty) key pages
+	int64_t     keys;               // keys
+	int64_t     valuePages;         // value pages in use
+	int64_t     freeValuePages;     // free (deleted) value pages
+
+	/*
+	 * Problems found. A broken key page or chain, or a key
+	 * pointing to the wrong value page, damages the hash table
+	 * entry it belongs to; the damaged entries are the ones
+	 * rebuilt by a repair.
+	 */
+	int64_t     badKeyPages;        // key pages with a broken tree or key count
+	int64_t     badLinks;           // broken key page chain links
+	int64_t     badKeys;            // keys pointing to a missing or mismatching value page
+	int64_t     badFreePages;       // free list entries that are not free value pages
+	int64_t     lostFreePages;      // free value pages missing from the free list
+	int64_t     unreferencedValues; // value pages in use no key points to
+	int64_t     badChecksums;       // key and value pages not matching their checksums
+	std::vector<int>            damagedBuckets; // damaged hash table entries, in order
+	std::vector<std::string>    problems;       // the first RDB_CHECK_MAX_PROBLEMS problems
+
+	/*
+	 * Set by a repair.
+	 */
+	int64_t     repairedBuckets;    // hash table entries rebuilt
+	int64_t     recoveredKeys;      // keys put back in the rebuilt entries
+	int64_t     freedValuePages;    // value pages freed
+
+	RdbCheckReport();
+
+	void clear();
+	int64_t problemCount() const;
+
+	/**
+	 * Is the database free of problems?
+	 */
+	bool clean() const
+	{
+		return problemCount() == 0;
+	}
+};
+
+/**
+ * Checks the integrity of a database that is not open, and
+ * optionally repairs it. The check verifies that:
+ * - the key and value pages written with a checksum match it,
+ * - the key pages in use have a valid hash table index, a
+ *   binary tree of the keys in order, with the right heights,
+ *   and a key count matching the tree,
+ * - the key pages of a hash table entry make one chain, with
+ *   the previous and next page offsets matching,
+ * - every key points to a value page in use with the same key,
+ *   and no two keys point to the same value page,
+ * - the free value pages (<dbname>.fdp) are not in use.
+ *
+ * The key and value files are read in large sequential chunks,
+ * each thread reading its own part of the file; the chains are
+ * then checked in memory. The memory needed is proportional to
+ * the number of key pages and keys, not the size of the files.
+ *
+ * A repair rebuilds only the damaged hash table entries: their
+ * keys are recovered from the value pages in use that hash to
+ * them (preferring the value page a key still points to), and
+ * written to new key pages that replace the old ones. The value
+ * pages no key points to, or not matching their checksums, are
+ * freed, and the free value page list is written afresh. The
+ * ordered index, the shared hash table and the cache warm-up
+ * manifest are removed, as they refer to the old key pages; the
+ * ordered index is rebuilt on open.
+ */
+class RdbChecker
+{
+private:
+	/* Key page in use */
+	typedef struct page_info
+	{
+		int64_t     offset;     // page offset
+		int64_t     poff;       // offset of previous page
+		int64_t     noff;       // offset of next page
+		int         hash;       // hash table index (-1 if invalid)
+	} page_info_t;
+
+	/* Key record pointing to a value page */
+	typedef struct key_ref
+	{
+		int64_t     voff;       // value page offset
+		uint64_t    fp;         // fingerprint of the key
+		int         hash;       // hash table index
+	} key_ref_t;
+
+	/* Value page in use, recovered for a damaged entry */
+	typedef struct recovered_key
+	{
+		int         hash;       // hash table index
+		bool        referenced; // does a key point to it?
+		int64_t     voff;       // value page offset
+		int         klen;       // key length
+		char        key[MAX_KEY_LENGTH];
+	} recovered_key_t;
+
+	/* Called with the thread number, page offset and page */
+	typedef std::function<void(int, int64_t, const char *)> page_visitor_t;
+
+	std::string                 path;
+	std::string                 name;
+	int                         threads;
+	int                         kpSize;
+	int                         htSize;
+	int64_t                     idxSize;
+	int64_t                     dbSize;
+	std::vector<page_info_t>    pages;      // key pages in use, in offset order
+	std::vector<key_ref_t>      refs;       // key records, in value offset order
+	std::vector<int64_t>        freeList;   // <dbname>.fdp
+	std::vector<int64_t>        orphans;    // value pages to free: unreferenced or corrupt
+	std::vector<char>           damaged;    // damaged hash table entries
+	std::vector<char>           vstate;     // value page states
+	RdbCheckReport              *report;
+	std::mutex                  mutex;
+
+	std::string fileName(const char *) const;
+	void problem(int64_t &, const char *, ...);
+	void damage(int);
+	int scan(const std::string &, int, int64_t, const page_visitor_t &);
+	int checkTree(const key_page_t *, int64_t, std::vector<key_ref_t> &);
+	int checkKeyPages();
+	void checkChains();
+	int checkValues();
+	int checkFreeList();
+	int recoverKeys(std::vector<recovered_key_t> &);
+	int writeBucket(snf::file &, int, const recovered_key_t *, const recovered_key_t *,
+			std::vector<int64_t> &, int64_t &);
+	int freeValuePages(const std::vector<int64_t> &);
+	int writeFreeList();
+	int repair();
+
+public:
+	RdbChecker(const std::string &, const std::string &, int threads = 0);
+	~RdbChecker() {}
+
+	int check(RdbCheckReport &, bool repair = false);
+};
+
+#endif // _SNF_RDB_CHECKER_H_
@@ -0,0 +1,74 @@
+#ifndef _SNF_RDB_CKPT_H_
+#define _SNF_RDB_CKPT_H_
+
+#include <vector>
+#include "file.h"
+
+#ifndef CKPT_BLOCK_SIZE
+#define CKPT_BLOCK_SIZE     65536
+#endif
+
+/**
+ * Copies a database file to a checkpoint file while the
+ * database is in use. The copier is created when all the
+ * in-flight operations have drained; at that point the
+ * source file is consistent and its size is recorded.
+ *
+ * The source file is copied in blocks (a multiple of the
+ * page size). A block is copied exactly once, either:
+ * - by the checkpointer walking the file sequentially, or
+ * - by a writer, just before it modifies any part of the
+ *   block for the first time (copy-on-write).
+ *
+ * Either way the checkpoint file gets the content as it was
+ * when the copier was created. Blocks beyond the recorded
+ * size are never copied.
+ *
+ * A failure to preserve a block does not fail the write to
+ * the database; it is remembered and reported by status()
+ * so that the checkpoint can be discarded.
+ *
+ * The copier is not thread-safe. The caller must serialize
+ * calls with the I/O on the source file.
+ */
+class PageCopier
+{
+private:
+	snf::file           *source;    // database file
+	snf::file           *target;    // checkpoint file
+	int                 blockSize;  // copy unit
+	int64_t             limit;      // source size at the start
+	std::vector<bool>   copied;     // blocks already copied
+	char                *buf;       // copy buffer
+	int                 error;      // first copy error
+
+	int copy(int64_t);
+
+public:
+	PageCopier(snf::file *, snf::file *, int, int64_t);
+	~PageCopier();
+
+	/**
+	 * Gets the number of blocks to copy.
+	 */
+	int64_t numberOfBlocks() const
+	{
+		return int64_t(copied.size());
+	}
+
+	/**
+	 * Gets the copier status.
+	 *
+	 * @return E_ok if all the blocks copied so far are
+	 * copied successfully, -ve error code otherwise.
+	 */
+	int status() const
+	{
+		return error;
+	}
+
+	int copyBlock(int64_t);
+	void preserve(int64_t, int);
+};
+
+#endif // _SNF_RDB_CKPT_H_
@@ -0,0 +1,132 @@
+#ifndef _SNF_RDB_CLUSTER_H_
+#define _SNF_RDB_CLUSTER_H_
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "rdb.h"
+
+/**
+ * Visitor of RdbCluster::scanPrefix() and RdbCluster::scanRange().
+ * It is called with the shard number, the key and its value;
+ * the key and the value are valid only during the call. A
+ * non-E_ok return stops the scan.
+ */
+typedef std::function<int(int, const char *, int, const char *, int)> RdbScanVisitor;
+
+/**
+ * Hash-partitioned database made of N Rdb shards, each one
+ * with its own files, key page cache and locks, typically
+ * in directories on different disks. A key is routed to a
+ * shard by a hash independent of the one used for the hash
+ * table within the shard. The shards are opened, closed,
+ * rebuilt, scanned and queried for statistics in parallel,
+ * one thread per shard.
+ *
+ * Every shard records its shard number and the number of
+ * shards in <dbname>.shard; opening a shard as part of a
+ * cluster of a different size, or in a different position,
+ * fails with E_mismatch as the keys would be routed to the
+ * wrong shards.
+ */
+class RdbCluster
+{
+private:
+	std::string         name;
+	RdbOptions          options;
+	std::vector<Rdb *>  shards;
+	bool                opened;
+	std::mutex          openMutex;
+
+	void init(const std::vector<std::string> &, const std::string &,
+		int, int, const RdbOptions &);
+	int checkShard(int);
+	int forEachShard(const std::function<int(int, Rdb *)> &);
+
+public:
+	/**
+	 * Constructs the cluster. The default key page size and
+	 * hash table size are used for every shard.
+	 *
+	 * @param [in] paths - shard paths, one per shard.
+	 * @param [in] name  - database name.
+	 * @param [in] opt   - database options, of every shard.
+	 */
+	RdbCluster(const std::vector<std::string> &paths,
+		const std::string &name,
+		const RdbOptions &opt = RdbOptions())
+	{
+		init(paths, name, KEY_PAGE_SIZE, HASH_TABLE_SIZE, opt);
+	}
+
+	/**
+	 * Constructs the cluster.
+	 *
+	 * @param [in] paths  - shard paths, one per shard.
+	 * @param [in] name   - database name.
+	 * @param [in] kpsize - key page size.
+	 * @param [in] htsize - hash table size of every shard.
+	 * @param [in] opt    - database options, of every shard.
+	 */
+	RdbCluster(const std::vector<std::string> &paths,
+		const std::string &name,
+		int kpsize,
+		int htsize,
+		const RdbOptions &opt = RdbOptions())
+	{
+		init(paths, name, kpsize, htsize, opt);
+	}
+
+	virtual ~RdbCluster();
+
+	/**
+	 * Gets the database name.
+	 */
+	const char *getName() const
+	{
+		return name.c_str();
+	}
+
+	/**
+	 * Gets the number of shards.
+	 */
+	int getShardCount() const
+	{
+		return int(shards.size());
+	}
+
+	/**
+	 * Gets the shard; to use the Rdb API not exposed by
+	 * the cluster.
+	 *
+	 * @param [in] shard - shard number.
+	 *
+	 * @return the shard database, 0 if the shard number is
+	 * invalid.
+	 */
+	Rdb *getShard(int shard)
+	{
+		if ((shard < 0) || (shard >= int(shards.size())))
+			return 0;
+		return shards[shard];
+	}
+
+	int getShardIndex(const char *, int) const;
+
+	int open();
+	int get(const char *, int, char *, int *);
+	int set(const char *, int, const char *, int, Updater *updater = 0);
+	int setWithTTL(const char *, int, const char *, int, int, Updater *updater = 0);
+	int expire(const char *, int, int);
+	int increment(const char *, int, int64_t, int64_t *newval = 0);
+	int compareAndSet(const char *, int, const char *, int, const char *, int);
+	int remove(const char *, int);
+	int scanPrefix(const char *, int, const RdbScanVisitor &);
+	int scanRange(const char *, int, const char *, int, const RdbScanVisitor &);
+	int rebuild();
+	int getStats(RdbStats &, std::vector<RdbStats> *shardStats = 0, bool scan = false);
+	int close();
+};
+
+#endif // _SNF_RDB_CLUSTER_H_
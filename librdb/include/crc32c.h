@@ -0,0 +1,30 @@
+#ifndef _SNF_RDB_CRC32C_H_
+#define _SNF_RDB_CRC32C_H_
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Computes the CRC32C (Castagnoli) checksum of the buffer,
+ * continuing from the checksum of the preceding data: the
+ * checksum of a buffer split in two is
+ * Crc32c(second, len2, Crc32c(first, len1)).
+ *
+ * The SSE4.2 (x86-64) or ARMv8 CRC32 instructions are used
+ * if the processor has them, a lookup table otherwise.
+ *
+ * @param [in] buf - buffer.
+ * @param [in] len - buffer length.
+ * @param [in] crc - checksum of the preceding data; 0 to start.
+ *
+ * @return the checksum.
+ */
+uint32_t Crc32c(const void *buf, size_t len, uint32_t crc = 0);
+
+/**
+ * Is the checksum computed using the processor's CRC32
+ * instructions?
+ */
+bool Crc32cAccelerated();
+
+#endif // _SNF_RDB_CRC32C_H_
@@ -1,10 +1,14 @@
 #ifndef _SNF_RDB_DBFILES_H_
 #define _SNF_RDB_DBFILES_H_
 
+#include <memory>
 #include <mutex>
+#include <vector>
 #include "file.h"
 #include "dbstruct.h"
 #include "fdpmgr.h"
+#include "ckpt.h"
+#include "stats.h"
 
 /**
  * Manage DB attributes file.
@@ -55,20 +59,298 @@ public:
 		dbAttr.a_htsize = htSize;
 	}
 
-	int open();
+	int getVersion() const
+	{
+		return dbAttr.a_version;
+	}
+
+	void setVersion(int version)
+	{
+		dbAttr.a_version = version;
+	}
+
+	int open(bool rdonly = false);
+	int read();
+	int write();
+};
+
+/**
+ * Manages shard attributes (<dbname>.shard) of a database
+ * that is a shard of RdbCluster.
+ */
+class ShardFile : public snf::file
+{
+private:
+	shardattr_t shardAttr;
+
+public:
+	/**
+	 * Constructs shard attributes file manager object.
+	 *
+	 * @param [in] fname - file name
+	 * @param [in] mask  - umask to use when opening
+	 *                     the file.
+	 */
+	ShardFile(const char *fname, mode_t mask)
+		: snf::file(fname, mask)
+	{
+		memset(&shardAttr, 0, sizeof(shardattr_t));
+	}
+
+	/**
+	 * Destroys shard attributes file manager object.
+	 */
+	~ShardFile()
+	{
+	}
+
+	int getShard() const
+	{
+		return shardAttr.s_shard;
+	}
+
+	void setShard(int shard)
+	{
+		shardAttr.s_shard = shard;
+	}
+
+	int getShardCount() const
+	{
+		return shardAttr.s_shards;
+	}
+
+	void setShardCount(int shards)
+	{
+		shardAttr.s_shards = shards;
+	}
+
+	int open(bool rdonly = false);
 	int read();
 	int write();
 };
 
+/**
+ * Manages the change feed position (<dbname>.seq) of a
+ * database that is a replica, or a checkpoint, of a database
+ * with the change feed enabled.
+ */
+class SeqFile : public snf::file
+{
+private:
+	seqattr_t   seqAttr;
+
+public:
+	/**
+	 * Constructs sequence file manager object.
+	 *
+	 * @param [in] fname - file name
+	 * @param [in] mask  - umask to use when opening
+	 *                     the file.
+	 */
+	SeqFile(const char *fname, mode_t mask)
+		: snf::file(fname, mask)
+	{
+		memset(&seqAttr, 0, sizeof(seqattr_t));
+	}
+
+	/**
+	 * Destroys sequence file manager object.
+	 */
+	~SeqFile()
+	{
+	}
+
+	uint64_t getSequence() const
+	{
+		return seqAttr.s_seq;
+	}
+
+	void setSequence(uint64_t seq)
+	{
+		seqAttr.s_seq = seq;
+	}
+
+	int open(bool rdonly = false);
+	int read();
+	int write();
+};
+
+/**
+ * Manages the key page cache warm-up manifest (<dbname>.warm):
+ * the offsets of the key pages in the cache when the database
+ * was last closed, the most recently used first.
+ */
+class WarmFile : public snf::file
+{
+public:
+	/**
+	 * Constructs warm-up manifest manager object.
+	 *
+	 * @param [in] fname - file name
+	 * @param [in] mask  - umask to use when opening
+	 *                     the file.
+	 */
+	WarmFile(const char *fname, mode_t mask)
+		: snf::file(fname, mask)
+	{
+	}
+
+	/**
+	 * Destroys warm-up manifest manager object.
+	 */
+	~WarmFile()
+	{
+	}
+
+	int open(bool rdonly = false);
+	int read(int, std::vector<int64_t> &);
+	int write(int, const std::vector<int64_t> &);
+};
+
+/**
+ * Database file, optionally opened for direct I/O i.e.
+ * bypassing the file system cache. Direct I/O requires the
+ * file offset, the transfer size, and the buffer address to
+ * be aligned to DIRECT_IO_ALIGNMENT. The positional reads
+ * and writes that are not aligned go through an aligned
+ * bounce buffer: the blocks around the request are read,
+ * and, for writes, patched and written back. The file is
+ * truncated back if the last block written extends it.
+ *
+ * The bounce buffer is not protected; the caller must
+ * serialize the I/O on the file.
+ */
+class DbFile : public snf::file
+{
+private:
+	bool            direct;     // opened for direct I/O?
+	bool            synced;     // opened for synchronous writes?
+	char            *abuf;      // aligned bounce buffer
+	int             abufSize;   // bounce buffer size
+	int64_t         fsize;      // file size (direct I/O only)
+	StripedCounter  reads;      // reads done
+	StripedCounter  writes;     // writes done
+
+	int getBuffer(int);
+	int alignedRead(int64_t, void *, int, int *, int *);
+	int alignedWrite(int64_t, const void *, int, int *, int *);
+
+protected:
+	int             csumSize;   // checksummed page size (0: no checksums)
+	bool            verify;     // verify the checksums on read?
+	StripedCounter  verified;   // checksums verified
+	StripedCounter  failures;   // checksum mismatches
+
+public:
+	/**
+	 * Constructs the database file object.
+	 *
+	 * @param [in] fname - file name
+	 * @param [in] mask  - umask to use when opening
+	 *                     the file.
+	 */
+	DbFile(const char *fname, mode_t mask)
+		: snf::file(fname, mask),
+		  direct(false),
+		  synced(false),
+		  abuf(0),
+		  abufSize(0),
+		  fsize(0),
+		  csumSize(0),
+		  verify(false)
+	{
+	}
+
+	virtual ~DbFile();
+
+	/**
+	 * Sets the page checksums. Every page written in full
+	 * gets a checksum; the pages read are verified against
+	 * their checksums if verification is enabled.
+	 *
+	 * @param [in] pageSize - page size; 0 disables the
+	 *                        checksums.
+	 * @param [in] verify   - verify the checksums on read?
+	 */
+	void setChecksums(int pageSize, bool verify)
+	{
+		this->csumSize = pageSize;
+		this->verify = verify && (pageSize > 0);
+	}
+
+	/**
+	 * Gets the number of page checksums verified since the
+	 * file is opened.
+	 */
+	int64_t getChecksumsVerified() const
+	{
+		return verified.value();
+	}
+
+	/**
+	 * Gets the number of pages that did not match their
+	 * checksums since the file is opened.
+	 */
+	int64_t getChecksumFailures() const
+	{
+		return failures.value();
+	}
+
+	/**
+	 * Is the file opened for direct I/O?
+	 */
+	bool isDirect() const
+	{
+		return direct;
+	}
+
+	/**
+	 * Gets the number of reads done since the file is opened.
+	 */
+	int64_t getReads() const
+	{
+		return reads.value();
+	}
+
+	/**
+	 * Gets the number of writes done since the file is opened.
+	 */
+	int64_t getWrites() const
+	{
+		return writes.value();
+	}
+
+	/**
+	 * Gets the number of writes synced to disk (all of them
+	 * if the file is opened for synchronous writes).
+	 */
+	int64_t getSyncs() const
+	{
+		return synced ? writes.value() : 0;
+	}
+
+	int open(bool, bool);
+
+	using snf::file::read;
+	using snf::file::write;
+
+	virtual int read(int64_t, void *, int, int *, int *oserr = 0);
+	virtual int write(int64_t, const void *, int, int *, int *oserr = 0);
+	virtual int truncate(int64_t, int *oserr = 0);
+};
+
 /**
  * Manages key file.
  */
-class KeyFile : public snf::file
+class KeyFile : public DbFile
 {
 private:
 	FreeDiskPageMgr *fdpMgr;
+	PageCopier      *copier;
 	std::mutex      mutex;
 
+	int readForUpdate(int64_t, key_page_t **, std::unique_ptr<char[]> &);
+
 public:
 	/**
 	 * Constructs key file object.
@@ -78,8 +360,9 @@ public:
 	 *                     the file.
 	 */
 	KeyFile(const char *fname, mode_t mask)
-		: snf::file(fname, mask),
-		  fdpMgr(0)
+		: DbFile(fname, mask),
+		  fdpMgr(0),
+		  copier(0)
 	{
 	}
 
@@ -116,10 +399,27 @@ public:
 		this->fdpMgr = fdpMgr;
 	}
 
-	int open(bool);
+	/**
+	 * Sets the checkpoint page copier. Every write to
+	 * the file preserves the pages it overwrites using
+	 * the copier. Pass NULL to stop copying.
+	 *
+	 * @param [in] copier - checkpoint page copier.
+	 */
+	void setPageCopier(PageCopier *copier)
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		this->copier = copier;
+	}
+
+	int copyBlock(int64_t);
+
+	int open(bool, bool direct = false);
 	int read(int64_t, void *, int);
 	int write(int64_t, const void *, int);
+	int write(int64_t, key_page_t *, int);
 	int write(int64_t *, const void *, int);
+	int write(int64_t *, key_page_t *, int);
 	int writeFlags(int64_t, key_page_t *, int);
 	int writePrevOffset(int64_t, key_page_t *, int64_t);
 	int writeNextOffset(int64_t, key_page_t *, int64_t);
@@ -129,12 +429,15 @@ public:
 /**
  * Manages value file.
  */
-class ValueFile : public snf::file
+class ValueFile : public DbFile
 {
 private:
 	FreeDiskPageMgr *fdpMgr;
+	PageCopier      *copier;
 	std::mutex      mutex;
 
+	int readForUpdate(int64_t, value_page_t **, value_page_t *);
+
 public:
 	/**
 	 * Constructs value file manager object.
@@ -144,9 +447,10 @@ public:
 	 *                     the file.
 	 */
 	ValueFile(const char *fname, mode_t mask)
-		: snf::file(fname, mask)
+		: DbFile(fname, mask)
 	{
 		this->fdpMgr = 0;
+		this->copier = 0;
 	}
 
 	/**
@@ -182,13 +486,30 @@ public:
 		this->fdpMgr = fdpMgr;
 	}
 
-	int open(bool);
+	/**
+	 * Sets the checkpoint page copier. Every write to
+	 * the file preserves the pages it overwrites using
+	 * the copier. Pass NULL to stop copying.
+	 *
+	 * @param [in] copier - checkpoint page copier.
+	 */
+	void setPageCopier(PageCopier *copier)
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		this->copier = copier;
+	}
+
+	int copyBlock(int64_t);
+
+	int open(bool, bool direct = false);
 	int read(int64_t, value_page_t *);
 	int readFlags(int64_t, int *);
-	int write(int64_t, const value_page_t *);
-	int write(int64_t *, const value_page_t *);
+	int write(int64_t, value_page_t *);
+	int write(int64_t *, value_page_t *);
 	int writeFlags(int64_t, value_page_t *, int);
+	int writeValue(int64_t, value_page_t *, const char *, int);
 	int freePage(int64_t);
+	int freePages(const std::vector<int64_t> &);
 };
 
 #endif // _SNF_RDB_DBFILES_H_
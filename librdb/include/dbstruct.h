@@ -1,8 +1,12 @@
 #ifndef _SNF_RDB_DBSTRUCT_H_
 #define _SNF_RDB_DBSTRUCT_H_
 
+#include <atomic>
+#include <cstddef>
+#include <ctime>
 #include "common.h"
 #include "logmgr.h"
+#include "crc32c.h"
 
 #ifndef KEY_PAGE_HDR_SIZE
 #define KEY_PAGE_HDR_SIZE   64
@@ -24,14 +28,64 @@
 #define MAX_VALUE_LENGTH    192
 #endif
 
+#ifndef DIRECT_IO_ALIGNMENT
+#define DIRECT_IO_ALIGNMENT 4096
+#endif
+
+/*
+ * Allocates memory aligned for direct I/O. Use FreeAligned()
+ * to free it.
+ */
+inline void *
+AllocAligned(size_t size)
+{
+#if defined(_WIN32)
+	return _aligned_malloc(size, DIRECT_IO_ALIGNMENT);
+#else
+	void *addr = 0;
+	if (posix_memalign(&addr, DIRECT_IO_ALIGNMENT, size) != 0)
+		return 0;
+	return addr;
+#endif
+}
+
+/*
+ * Frees the memory allocated by AllocAligned().
+ */
+inline void
+FreeAligned(void *addr)
+{
+#if defined(_WIN32)
+	_aligned_free(addr);
+#else
+	::free(addr);
+#endif
+}
+
+/*
+ * On-disk format version of the database. Version 1, the
+ * attributes without a version, had 16-bit value page
+ * checksums; see value_page_v1_t.
+ */
+#define RDB_FORMAT_VERSION  2
+
 /* DB attributes */
 extern "C"
 typedef struct dbattr
 {
 	int a_kpsize;   // key page size
 	int a_htsize;   // hash table size
+	int a_version;  // format version (RDB_FORMAT_VERSION)
 } dbattr_t;
 
+/* Shard attributes of a cluster shard */
+extern "C"
+typedef struct shardattr
+{
+	int s_shard;    // shard number
+	int s_shards;   // number of shards in the cluster
+} shardattr_t;
+
 /* 64 bytes Key record */
 extern "C"
 typedef struct key_rec
@@ -64,12 +118,12 @@ InitKeyRecord(key_rec_t *kr)
 extern "C"
 typedef struct key_page
 {
-	short       kp_flags;   // Flags: 0|KPAGE_DELETED
+	short       kp_flags;   // Flags: 0|KPAGE_DELETED|KPAGE_CHECKSUM
 	short       kp_vcount;  // Valid key count
 	short       kp_root;    // Root index of balanced BST
 	short       kp_unused1;
 	int         kp_hash;    // Key hash
-	int         kp_unused2;
+	uint32_t    kp_checksum; // Page checksum (if KPAGE_CHECKSUM)
 	int64_t     kp_poff;    // Offset of previous page
 	int64_t     kp_noff;    // Offset of next page
 	int64_t     kp_unused3;
@@ -80,6 +134,7 @@ typedef struct key_page
 } key_page_t;
 
 #define KPAGE_DELETED   0x0001
+#define KPAGE_CHECKSUM  0x0002
 
 inline void
 InitKeyPage(key_page_t *kp, int kpsize)
@@ -99,6 +154,44 @@ IsKeyPageDeleted(const key_page_t *kp)
 	return false;
 }
 
+/*
+ * Computes the key page checksum: CRC32C of the page, with
+ * the checksum field taken as 0.
+ */
+inline uint32_t
+KeyPageChecksum(const key_page_t *kp, int kpsize)
+{
+	const char      *page = reinterpret_cast<const char *>(kp);
+	const size_t    off = offsetof(key_page_t, kp_checksum);
+	const uint32_t  zero = 0;
+
+	uint32_t crc = Crc32c(page, off);
+	crc = Crc32c(&zero, sizeof(zero), crc);
+	return Crc32c(page + off + sizeof(zero), kpsize - off - sizeof(zero), crc);
+}
+
+/*
+ * Sets the key page checksum; to be called when the page
+ * is about to be written.
+ */
+inline void
+SetKeyPageChecksum(key_page_t *kp, int kpsize)
+{
+	kp->kp_flags |= KPAGE_CHECKSUM;
+	kp->kp_checksum = KeyPageChecksum(kp, kpsize);
+}
+
+/*
+ * Does the key page match its checksum? The pages written
+ * without a checksum always match.
+ */
+inline bool
+IsKeyPageChecksumValid(const key_page_t *kp, int kpsize)
+{
+	return ((kp->kp_flags & KPAGE_CHECKSUM) != KPAGE_CHECKSUM) ||
+		(kp->kp_checksum == KeyPageChecksum(kp, kpsize));
+}
+
 struct cnode;
 
 typedef struct key_page_node
@@ -142,16 +235,20 @@ SetKeyInfo(key_info_t *ki, const char *key, int klen, int hash)
 extern "C"
 typedef struct value_page
 {
-	short   vp_flags;                   // flags: VPAGE_DELETED
-	short   vp_unused1;                 // not used yet
-	int     vp_unused2;                 // not used yet
-	int     vp_klen;                    // key length
-	int     vp_vlen;                    // value length
-	char    vp_key[MAX_KEY_LENGTH];     // key
-	char    vp_value[MAX_VALUE_LENGTH]; // value
+	short       vp_flags;                   // flags: VPAGE_DELETED|VPAGE_CHECKSUM
+	short       vp_klen;                    // key length
+	short       vp_vlen;                    // value length
+	short       vp_unused;
+	uint32_t    vp_checksum;                // page checksum (if VPAGE_CHECKSUM)
+	uint32_t    vp_expiry;                  // expiry time in seconds since epoch (0: never)
+	char        vp_key[MAX_KEY_LENGTH];     // key
+	char        vp_value[MAX_VALUE_LENGTH]; // value
 } value_page_t;
 
+static_assert(sizeof(value_page_t) == 256, "value page must be 256 bytes");
+
 #define VPAGE_DELETED   0x0001
+#define VPAGE_CHECKSUM  0x0002
 
 inline bool
 IsValuePageDeleted(const value_page_t *vp)
@@ -159,6 +256,50 @@ IsValuePageDeleted(const value_page_t *vp)
 	return (vp && ((vp->vp_flags & VPAGE_DELETED) == VPAGE_DELETED));
 }
 
+/*
+ * Computes the value page checksum: CRC32C of the page, with
+ * the checksum field taken as 0.
+ */
+inline uint32_t
+ValuePageChecksum(const value_page_t *vp)
+{
+	const char      *page = reinterpret_cast<const char *>(vp);
+	const size_t    off = offsetof(value_page_t, vp_checksum);
+	const uint32_t  zero = 0;
+
+	uint32_t crc = Crc32c(page, off);
+	crc = Crc32c(&zero, sizeof(zero), crc);
+	return Crc32c(page + off + sizeof(zero), sizeof(value_page_t) - off - sizeof(zero), crc);
+}
+
+/*
+ * Sets the value page checksum; to be called when the page
+ * is about to be written.
+ */
+inline void
+SetValuePageChecksum(value_page_t *vp)
+{
+	vp->vp_flags |= VPAGE_CHECKSUM;
+	vp->vp_checksum = ValuePageChecksum(vp);
+}
+
+/*
+ * Does the value page match its checksum? The pages written
+ * without a checksum always match.
+ */
+inline bool
+IsValuePageChecksumValid(const value_page_t *vp)
+{
+	return ((vp->vp_flags & VPAGE_CHECKSUM) != VPAGE_CHECKSUM) ||
+		(vp->vp_checksum == ValuePageChecksum(vp));
+}
+
+inline bool
+IsValuePageExpired(const value_page_t *vp, time_t now)
+{
+	return (vp && (vp->vp_expiry != 0) && (time_t(vp->vp_expiry) <= now));
+}
+
 inline void
 InitValuePage(value_page_t *vp, const char *key, int klen, const char *value, int vlen)
 {
@@ -169,4 +310,220 @@ InitValuePage(value_page_t *vp, const char *key, int klen, const char *value, in
 	vp->vp_vlen = vlen;
 }
 
+/*
+ * 256 bytes value page of format version 1, with the CRC32C
+ * folded to 16 bits. The pages are converted when the
+ * database is opened for writing.
+ */
+extern "C"
+typedef struct value_page_v1
+{
+	short       vp_flags;                   // flags: VPAGE_DELETED|VPAGE_CHECKSUM
+	uint16_t    vp_checksum;                // folded page checksum (if VPAGE_CHECKSUM)
+	uint32_t    vp_expiry;                  // expiry time in seconds since epoch (0: never)
+	int         vp_klen;                    // key length
+	int         vp_vlen;                    // value length
+	char        vp_key[MAX_KEY_LENGTH];     // key
+	char        vp_value[MAX_VALUE_LENGTH]; // value
+} value_page_v1_t;
+
+/*
+ * Computes the value page checksum of format version 1:
+ * CRC32C of the page, with the checksum field taken as 0,
+ * folded to 16 bits.
+ */
+inline uint16_t
+ValuePageChecksumV1(const value_page_v1_t *vp)
+{
+	const char      *page = reinterpret_cast<const char *>(vp);
+	const size_t    off = offsetof(value_page_v1_t, vp_checksum);
+	const uint16_t  zero = 0;
+
+	uint32_t crc = Crc32c(page, off);
+	crc = Crc32c(&zero, sizeof(zero), crc);
+	crc = Crc32c(page + off + sizeof(zero), sizeof(value_page_v1_t) - off - sizeof(zero), crc);
+	return uint16_t(crc ^ (crc >> 16));
+}
+
+/*
+ * Converts a value page of format version 1. A page that
+ * does not match its folded checksum gets a checksum that
+ * it does not match either, so that the damage is still
+ * detected.
+ */
+inline void
+UpgradeValuePage(const value_page_v1_t *ovp, value_page_t *vp)
+{
+	memset(vp, 0, sizeof(value_page_t));
+	vp->vp_flags = short(ovp->vp_flags & ~VPAGE_CHECKSUM);
+	vp->vp_klen = short(ovp->vp_klen);
+	vp->vp_vlen = short(ovp->vp_vlen);
+	vp->vp_expiry = ovp->vp_expiry;
+	memcpy(vp->vp_key, ovp->vp_key, MAX_KEY_LENGTH);
+	memcpy(vp->vp_value, ovp->vp_value, MAX_VALUE_LENGTH);
+	SetValuePageChecksum(vp);
+
+	if (((ovp->vp_flags & VPAGE_CHECKSUM) == VPAGE_CHECKSUM) &&
+		(ovp->vp_checksum != ValuePageChecksumV1(ovp)))
+		vp->vp_checksum = ~vp->vp_checksum;
+}
+
+/* 64 bytes ordered index header (page 0 of <dbname>.oix) */
+extern "C"
+typedef struct oix_meta
+{
+	short   om_flags;       // Flags: OMETA_DIRTY
+	short   om_height;      // Tree height (1: the root is a leaf)
+	int     om_kpsize;      // Page size
+	int64_t om_root;        // Offset of the root page
+	int64_t om_unused[6];
+} oix_meta_t;
+
+#define OMETA_DIRTY     0x0001
+
+/* 64 bytes ordered index record */
+extern "C"
+typedef struct oix_rec
+{
+	short   or_klen;                // Key length
+	short   or_unused1;
+	int     or_unused2;
+	char    or_key[MAX_KEY_LENGTH]; // Key
+	int64_t or_off;                 // Value offset (leaf) or child page offset (branch)
+} oix_rec_t;
+
+#define NUM_OF_RECS_IN_OPAGE(B) int(((B) - KEY_PAGE_HDR_SIZE) / sizeof(oix_rec_t))
+
+/* 64 bytes header followed by N records sorted by key */
+extern "C"
+typedef struct oix_page
+{
+	short       op_flags;   // Flags: 0|OPAGE_LEAF
+	short       op_count;   // Record count
+	int         op_unused1;
+	int64_t     op_noff;    // Offset of the next leaf page
+	int64_t     op_unused2[6];
+	oix_rec_t   op_recs[1]; // Array of records
+} oix_page_t;
+
+#define OPAGE_LEAF      0x0001
+
+inline bool
+IsLeafPage(const oix_page_t *op)
+{
+	return (op && ((op->op_flags & OPAGE_LEAF) == OPAGE_LEAF));
+}
+
+/* 64 bytes persisted hash table header (<dbname>.hti) */
+typedef struct hti_header
+{
+	int                     hh_magic;       // HTI_MAGIC
+	int                     hh_flags;       // Flags: HTI_VALID
+	int                     hh_htsize;      // Hash table size
+	int                     hh_kpsize;      // Key page size
+	std::atomic<uint64_t>   hh_gen;         // Bumped on every update
+	int64_t                 hh_unused[5];
+} hti_header_t;
+
+#define HTI_MAGIC       0x48424452      // "RDBH"
+#define HTI_VALID       0x0001
+
+/*
+ * 16 bytes persisted hash table entry. The header is followed
+ * by an entry for every hash table index. The entries are
+ * shared by the processes mapping the file, hence atomic.
+ */
+typedef struct hti_entry
+{
+	std::atomic<int64_t>    he_offset;      // Offset of the first key page
+	std::atomic<uint32_t>   he_seq;         // Odd while the entry is being updated
+	uint32_t                he_unused;
+} hti_entry_t;
+
+static_assert(std::atomic<int64_t>::is_always_lock_free &&
+	std::atomic<uint64_t>::is_always_lock_free &&
+	std::atomic<uint32_t>::is_always_lock_free,
+	"shared hash table needs lock-free atomics");
+
+inline hti_entry_t *
+HashTableEntries(hti_header_t *hh)
+{
+	return reinterpret_cast<hti_entry_t *>(hh + 1);
+}
+
+/*
+ * 32 bytes transaction log record header (<dbname>.txn). It
+ * is followed by th_count writes, each a txn_write_t followed
+ * by the key and the value.
+ */
+extern "C"
+typedef struct txn_header
+{
+	int         th_magic;       // TXN_MAGIC
+	int         th_flags;       // Flags: TXN_DONE
+	int         th_count;       // Number of writes
+	int         th_length;      // Length of the writes
+	uint32_t    th_checksum;    // Checksum of the writes
+	int         th_unused[3];
+} txn_header_t;
+
+#define TXN_MAGIC       0x54424452      // "RDBT"
+#define TXN_DONE        0x0001
+
+/* 12 bytes transaction log write */
+extern "C"
+typedef struct txn_write
+{
+	int     tw_flags;       // Flags: TXN_REMOVE
+	int     tw_klen;        // Key length
+	int     tw_vlen;        // Value length (0 if removed)
+} txn_write_t;
+
+#define TXN_REMOVE      0x0001
+
+/*
+ * Change feed record (<dbname>.feed.<first sequence>). A record
+ * is written for every change committed to the database; the
+ * sequence number grows by one with every record.
+ */
+extern "C"
+typedef struct change_rec
+{
+	uint64_t    cr_seq;                     // Sequence number
+	int         cr_magic;                   // CHANGE_MAGIC
+	short       cr_op;                      // CHANGE_SET or CHANGE_REMOVE
+	short       cr_klen;                    // Key length
+	short       cr_vlen;                    // Value length (0 if removed)
+	short       cr_unused;
+	uint32_t    cr_expiry;                  // Expiry time (0: never expires)
+	char        cr_key[MAX_KEY_LENGTH];     // Key
+	char        cr_value[MAX_VALUE_LENGTH]; // Value
+} change_rec_t;
+
+#define CHANGE_MAGIC    0x43424452      // "RDBC"
+#define CHANGE_SET      1
+#define CHANGE_REMOVE   2
+
+/* Sequence number of the last change in a replica or a checkpoint */
+extern "C"
+typedef struct seqattr
+{
+	uint64_t    s_seq;      // Sequence number
+} seqattr_t;
+
+#define WARM_MAGIC      0x4d524157  // "WARM"
+
+/*
+ * Header of the key page cache warm-up manifest; followed by
+ * w_count key page offsets, the most recently used first.
+ */
+extern "C"
+typedef struct warmattr
+{
+	int         w_magic;    // WARM_MAGIC
+	int         w_kpsize;   // Key page size
+	int         w_count;    // Number of key page offsets
+	int         w_unused;
+} warmattr_t;
+
 #endif // _SNF_RDB_DBSTRUCT_H_
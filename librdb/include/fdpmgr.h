@@ -2,6 +2,7 @@
 #define _FDPMGR_H_
 
 #include <stack>
+#include <vector>
 #include <mutex>
 #include "file.h"
 
@@ -33,6 +34,7 @@ private:
 	std::mutex          mutex;
 
 	int addOffsetToFile(int64_t);
+	int addOffsetsToFile(const std::vector<int64_t> &);
 	int removeOffsetFromFile();
 	
 public:
@@ -73,6 +75,7 @@ public:
 	int init();
 	int64_t get();
 	int free(int64_t);
+	int free(const std::vector<int64_t> &);
 	int reset();
 
 	/**
@@ -0,0 +1,92 @@
+#ifndef _SNF_RDB_FEED_H_
+#define _SNF_RDB_FEED_H_
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "file.h"
+#include "dbstruct.h"
+
+/**
+ * Change feed (<dbname>.feed.<first sequence>). Every change
+ * committed to the database, a set or a remove, is appended
+ * to the feed as a fixed size record with the next sequence
+ * number, so the record of a sequence number is found at a
+ * known offset. The changes to a key are appended with its
+ * hash table entry locked; they are in the feed in the order
+ * they are applied.
+ *
+ * The feed is split into segments of a fixed number of
+ * records, named after the sequence number of their first
+ * record. Once there are more segments than asked for, the
+ * oldest one is removed: a reader that falls that far behind
+ * has to start over from a checkpoint.
+ *
+ * A record that could not be written leaves a gap in the
+ * feed and the next record starts a new segment; a reader
+ * reaching the gap has to start over from a checkpoint as
+ * well. The database update itself is not failed.
+ */
+class ChangeFeed
+{
+private:
+	std::string             path;       // database path
+	std::string             name;       // database name
+	int                     segSize;    // records in a segment
+	int                     maxSegs;    // segments kept
+	bool                    sync;       // sync every record?
+	std::deque<uint64_t>    segments;   // first sequence of the segments, oldest first
+	snf::file               *tail;      // last segment
+	uint64_t                lastSeq;    // sequence of the last record
+	bool                    broken;     // last append failed?
+	std::mutex              mutex;
+	std::condition_variable cond;
+
+	std::string segmentName(uint64_t) const;
+	int openSegment(snf::file *, bool, bool);
+	int recover();
+	int roll(uint64_t);
+
+public:
+	/**
+	 * Constructs the change feed object.
+	 *
+	 * @param [in] path    - database path.
+	 * @param [in] name    - database name.
+	 * @param [in] segsize - records in a segment.
+	 * @param [in] maxsegs - segments kept.
+	 * @param [in] sync    - sync every record to disk?
+	 */
+	ChangeFeed(const std::string &path, const std::string &name,
+		int segsize, int maxsegs, bool sync)
+		: path(path),
+		  name(name),
+		  segSize(segsize),
+		  maxSegs(maxsegs),
+		  sync(sync),
+		  tail(0),
+		  lastSeq(0),
+		  broken(false)
+	{
+	}
+
+	/**
+	 * Destroys the change feed object.
+	 */
+	~ChangeFeed()
+	{
+		close();
+	}
+
+	int open(uint64_t);
+	void close();
+	uint64_t firstSequence();
+	uint64_t lastSequence();
+	void append(int, const char *, int, const char *, int, uint32_t);
+	int read(uint64_t, int, std::vector<change_rec_t> &);
+	int wait(uint64_t, int);
+};
+
+#endif // _SNF_RDB_FEED_H_
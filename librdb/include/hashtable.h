@@ -1,9 +1,11 @@
 #ifndef _SNF_RDB_HASHTABLE_H_
 #define _SNF_RDB_HASHTABLE_H_
 
+#include <map>
 #include <mutex>
 #include "dbstruct.h"
 #include "rwlock.h"
+#include "stats.h"
 
 #ifndef HASH_TABLE_SIZE
 #define HASH_TABLE_SIZE 500000
@@ -54,9 +56,22 @@ private:
 	int             htsize;
 	std::mutex      mutex;
 	RWLockPool      *rwlockPool;
+	hti_header_t    *shared;
+	StripedCounter  lockWaits;      // locks waited for
+	StripedCounter  lockWaitUsec;   // time waited, in microseconds
 
 	void initHashEntry(hash_entry_t *);
 
+	/*
+	 * Publishes the first key page offset to the shared
+	 * hash table, if any.
+	 */
+	void publish(int index, int64_t offset)
+	{
+		if (shared)
+			HashTableEntries(shared)[index].he_offset.store(offset);
+	}
+
 public:
 	/**
 	 * Constructs the hash table object.
@@ -64,7 +79,8 @@ public:
 	HashTable()
 		: ht(0),
 		  htsize(0),
-		  rwlockPool(DBG_NEW RWLockPool())
+		  rwlockPool(DBG_NEW RWLockPool()),
+		  shared(0)
 	{
 	}
 
@@ -90,7 +106,26 @@ public:
 		return htsize;
 	}
 
+	/**
+	 * Gets the number of entry locks that could not be
+	 * acquired without waiting.
+	 */
+	int64_t getLockWaits() const
+	{
+		return lockWaits.value();
+	}
+
+	/**
+	 * Gets the time spent waiting for the entry locks,
+	 * in microseconds.
+	 */
+	int64_t getLockWaitTime() const
+	{
+		return lockWaitUsec.value();
+	}
+
 	int allocate(int);
+	void share(hti_header_t *);
 	void rdlock(int);
 	void rdunlock(int);
 	void wrlock(int);
@@ -136,4 +171,43 @@ public:
 	}
 };
 
+/**
+ * Locks a set of hash table entries, in index order so that
+ * two guards locking overlapping sets do not deadlock. The
+ * entries are given as index -> exclusive?
+ */
+class HTMultiLockGuard
+{
+private:
+	HashTable                   *hashTable;
+	const std::map<int, bool>   &indices;
+
+public:
+	HTMultiLockGuard(HashTable *ht, const std::map<int, bool> &idx)
+		: hashTable(ht),
+		  indices(idx)
+	{
+		ASSERT((hashTable != 0), "HTMultiLockGuard", 0,
+			"invalid hash table");
+
+		for (const std::pair<const int, bool> &i : indices) {
+			if (i.second)
+				hashTable->wrlock(i.first);
+			else
+				hashTable->rdlock(i.first);
+		}
+	}
+
+	~HTMultiLockGuard()
+	{
+		std::map<int, bool>::const_reverse_iterator I;
+		for (I = indices.rbegin(); I != indices.rend(); ++I) {
+			if (I->second)
+				hashTable->wrunlock(I->first);
+			else
+				hashTable->rdunlock(I->first);
+		}
+	}
+};
+
 #endif // _SNF_RDB_HASHTABLE_H_
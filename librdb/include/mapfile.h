@@ -0,0 +1,69 @@
+#ifndef _SNF_RDB_MAPFILE_H_
+#define _SNF_RDB_MAPFILE_H_
+
+#include "file.h"
+
+/**
+ * A file mapped in memory. The mapping is shared i.e. the
+ * updates made to the file by other processes, using the
+ * mapping or regular writes, are visible in the mapping.
+ *
+ * Only the part of the file that exists at the time of
+ * map() is mapped; if the file grows, remap it to see the
+ * new pages.
+ */
+class MappedFile : public snf::file
+{
+private:
+	char    *addr;      // mapped address
+	int64_t len;        // mapped length
+	bool    writable;   // mapped for writing?
+
+public:
+	/**
+	 * Constructs the mapped file object.
+	 *
+	 * @param [in] fname - file name.
+	 * @param [in] mask  - umask to use when opening
+	 *                     the file.
+	 */
+	MappedFile(const char *fname, mode_t mask)
+		: snf::file(fname, mask),
+		  addr(0),
+		  len(0),
+		  writable(false)
+	{
+	}
+
+	/**
+	 * Destroys the mapped file object.
+	 */
+	virtual ~MappedFile()
+	{
+		unmap();
+	}
+
+	/**
+	 * Gets the mapped address.
+	 */
+	char *data() const
+	{
+		return addr;
+	}
+
+	/**
+	 * Gets the mapped length.
+	 */
+	int64_t length() const
+	{
+		return len;
+	}
+
+	int open(bool);
+	int map(int64_t);
+	int remap();
+	int flush();
+	void unmap();
+};
+
+#endif // _SNF_RDB_MAPFILE_H_
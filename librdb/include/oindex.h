@@ -0,0 +1,85 @@
+#ifndef _SNF_RDB_OINDEX_H_
+#define _SNF_RDB_OINDEX_H_
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "cache.h"
+#include "dbfiles.h"
+
+#ifndef OINDEX_SCAN_COUNT
+#define OINDEX_SCAN_COUNT   64
+#endif
+
+/*
+ * Compares the keys byte-wise. A key sorts before the keys
+ * it is a prefix of.
+ *
+ * @return < 0, 0, or > 0 if the first key is less than,
+ * equal to, or greater than the second key.
+ */
+inline int
+CompareKeys(const char *k1, int l1, const char *k2, int l2)
+{
+	int cmp = memcmp(k1, k2, (l1 < l2) ? l1 : l2);
+	if (cmp == 0)
+		cmp = l1 - l2;
+	return cmp;
+}
+
+/**
+ * Ordered (secondary) index of the database keys. It is a
+ * B+-tree persisted in <dbname>.oix:
+ * - Page 0 is the header; it records the root page.
+ * - Branch pages hold (key, child page offset) records. The
+ *   child of record i holds the keys >= key i and < key i+1;
+ *   the child of the first record holds all the keys less
+ *   than the key of the second record.
+ * - Leaf pages hold (key, value page offset) records and are
+ *   chained in key order.
+ *
+ * The pages are of key page size and are cached in the key
+ * page LRU cache i.e. they share the page pool with the key
+ * pages. Pages are split when full but are never merged; a
+ * leaf emptied by removals stays in the chain and is reused
+ * by the keys that fall in its range.
+ *
+ * The header is marked dirty while the index is open. An
+ * index that was not closed cleanly is discarded when it is
+ * opened and must be rebuilt from the key file.
+ */
+class OrderedIndex
+{
+private:
+	KeyFile                                         *file;
+	LRUCache                                        *cache;
+	int                                             kpSize;
+	int                                             maxRecs;
+	bool                                            opened;
+	oix_meta_t                                      meta;
+	std::unordered_map<int64_t, key_page_node_t *>  nodes;
+	std::mutex                                      mutex;
+
+	int format();
+	int writeMeta();
+	int getPage(int64_t, oix_page_t *&);
+	int addPage(int64_t *, const oix_page_t *);
+	int writePage(int64_t, const oix_page_t *);
+	void dropPage(int64_t);
+	int findLeaf(const char *, int, int64_t *, oix_page_t *&, std::vector<int64_t> *);
+	int insertRecord(std::vector<int64_t> &, int64_t, oix_page_t *, int, const oix_rec_t &);
+	void freeNodes();
+
+public:
+	OrderedIndex(const char *, int, LRUCache *);
+	~OrderedIndex();
+
+	int open(bool, bool, bool *);
+	int close();
+	int insert(const char *, int, int64_t);
+	int remove(const char *, int);
+	int keys(const char *, int, bool, int, std::vector<std::string> &);
+};
+
+#endif // _SNF_RDB_OINDEX_H_
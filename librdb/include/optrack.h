@@ -0,0 +1,70 @@
+#ifndef _SNF_RDB_OPTRACK_H_
+#define _SNF_RDB_OPTRACK_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include "stats.h"
+
+/**
+ * Tracks the database operations in flight, so that they
+ * can be paused (checkpoint) or drained (close).
+ *
+ * The operations in flight are counted in cache line sized
+ * stripes, like StripedCounter, every thread counting in its
+ * own stripe. Starting and ending an operation is an atomic
+ * increment (decrement) of the thread's stripe and a read of
+ * the shared state, which changes only when the operations
+ * are paused or stopped; no lock is taken and no cache line
+ * is written by more than one thread (with no more threads
+ * than stripes).
+ *
+ * To pause, the state is set to paused and the stripes are
+ * added up until there is no operation in flight. An
+ * operation that starts meanwhile sees the state after its
+ * increment, backs off, and waits for the state to change.
+ * As the increment comes before the state is read, and the
+ * state is set before the stripes are read, either the
+ * operation backs off or the pause waits for it.
+ *
+ * The stripes of an operation started and ended by different
+ * threads do not add up to 0 on their own, but their sum is
+ * still the number of operations in flight.
+ */
+class OpTracker
+{
+private:
+	enum
+	{
+		OPS_STOPPED,    // no operation allowed (database closed)
+		OPS_RUNNING,    // operations allowed
+		OPS_PAUSED      // new operations wait
+	};
+
+	struct alignas(64) stripe_t
+	{
+		std::atomic<int64_t>    ops;
+	};
+
+	stripe_t                stripes[RDB_STATS_STRIPES];
+	std::atomic<int>        state;
+	std::mutex              mutex;
+	std::condition_variable cond;
+
+	int64_t inFlight() const;
+	void setState(int);
+
+public:
+	OpTracker();
+	~OpTracker() {}
+
+	int enter();
+	void leave();
+	void hold();
+	void start();
+	void pause();
+	void stop();
+};
+
+#endif // _SNF_RDB_OPTRACK_H_
@@ -4,6 +4,7 @@
 #include <stack>
 #include <mutex>
 #include "common.h"
+#include "dbstruct.h"
 
 class PageMgr
 {
@@ -23,7 +24,7 @@ public:
 	~PageMgr()
 	{
 		if (pool) {
-			::free(pool);
+			FreeAligned(pool);
 			pool = 0;
 		}
 
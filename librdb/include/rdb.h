@@ -1,10 +1,24 @@
 #ifndef _SNF_RDB_RDB_H_
 #define _SNF_RDB_RDB_H_
 
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 #include "error.h"
 #include "cache.h"
 #include "dbfiles.h"
+#include "feed.h"
 #include "hashtable.h"
+#include "mapfile.h"
+#include "oindex.h"
+#include "optrack.h"
+#include "reader.h"
+#include "stats.h"
+#include "txnlog.h"
 
 int NextPrime(int); // from librdb/prime.cpp
 
@@ -24,6 +38,17 @@ private:
 	int         o_memusage;     // memory usage for key pages in %
 	bool        o_syncdata;     // always sync db file
 	bool        o_syncidx;      // always sync index file
+	int         o_sweepint;     // expired key sweep interval in ms (0: no sweep)
+	int         o_sweepcnt;     // hash table entries visited per sweep
+	bool        o_oindex;       // maintain the ordered index
+	bool        o_directio;     // bypass the OS page cache
+	bool        o_rdonly;       // open the database read-only
+	bool        o_shareht;      // share the hash table with read-only openers
+	bool        o_feed;         // maintain the change feed
+	int         o_feedsegsize;  // records in a change feed segment
+	int         o_feedsegs;     // change feed segments kept
+	bool        o_warmup;       // warm the key page cache on open
+	bool        o_verify;       // verify the page checksums on read
 
 public:
 	/**
@@ -34,6 +59,17 @@ public:
 		o_memusage = 75;
 		o_syncdata = true;
 		o_syncidx = false;
+		o_sweepint = 0;
+		o_sweepcnt = 1024;
+		o_oindex = false;
+		o_directio = false;
+		o_rdonly = false;
+		o_shareht = false;
+		o_feed = false;
+		o_feedsegsize = 65536;
+		o_feedsegs = 8;
+		o_warmup = true;
+		o_verify = true;
 	}
 
 	/**
@@ -44,6 +80,17 @@ public:
 		o_memusage = opt.o_memusage;
 		o_syncdata = opt.o_syncdata;
 		o_syncidx = opt.o_syncidx;
+		o_sweepint = opt.o_sweepint;
+		o_sweepcnt = opt.o_sweepcnt;
+		o_oindex = opt.o_oindex;
+		o_directio = opt.o_directio;
+		o_rdonly = opt.o_rdonly;
+		o_shareht = opt.o_shareht;
+		o_feed = opt.o_feed;
+		o_feedsegsize = opt.o_feedsegsize;
+		o_feedsegs = opt.o_feedsegs;
+		o_warmup = opt.o_warmup;
+		o_verify = opt.o_verify;
 	}
 
 	/**
@@ -108,6 +155,246 @@ public:
 		o_syncidx = syncidx;
 	}
 
+	/**
+	 * Gets the interval, in milliseconds, between the
+	 * background sweeps of expired keys. 0 means the
+	 * background sweep is disabled.
+	 */
+	int getSweepInterval() const
+	{
+		return o_sweepint;
+	}
+
+	/**
+	 * Sets the interval, in milliseconds, between the
+	 * background sweeps of expired keys.
+	 *
+	 * @param [in] sweepint - sweep interval; 0 disables
+	 *                        the background sweep.
+	 *
+	 * @return E_ok on success, -ve error code on failure.
+	 */
+	int setSweepInterval(int sweepint)
+	{
+		if (sweepint < 0) {
+			LOG_ERROR("RdbOptions",
+				"invalid sweep interval (%d)", sweepint);
+			return E_invalid_arg;
+		}
+
+		o_sweepint = sweepint;
+		return E_ok;
+	}
+
+	/**
+	 * Gets the number of hash table entries visited
+	 * in one sweep.
+	 */
+	int getSweepCount() const
+	{
+		return o_sweepcnt;
+	}
+
+	/**
+	 * Sets the number of hash table entries visited
+	 * in one sweep.
+	 *
+	 * @param [in] sweepcnt - hash table entries per sweep.
+	 *
+	 * @return E_ok on success, -ve error code on failure.
+	 */
+	int setSweepCount(int sweepcnt)
+	{
+		if (sweepcnt <= 0) {
+			LOG_ERROR("RdbOptions",
+				"invalid sweep count (%d)", sweepcnt);
+			return E_invalid_arg;
+		}
+
+		o_sweepcnt = sweepcnt;
+		return E_ok;
+	}
+
+	/**
+	 * Should the ordered index, used for prefix and range
+	 * scans, be maintained?
+	 */
+	bool orderedIndex() const
+	{
+		return o_oindex;
+	}
+
+	/**
+	 * Sets whether the ordered index is maintained.
+	 */
+	void orderedIndex(bool oindex)
+	{
+		o_oindex = oindex;
+	}
+
+	/**
+	 * Should the DB files be accessed using direct I/O, i.e.
+	 * bypassing the OS page cache?
+	 */
+	bool directIO() const
+	{
+		return o_directio;
+	}
+
+	/**
+	 * Sets whether the DB files are accessed using direct I/O.
+	 */
+	void directIO(bool directio)
+	{
+		o_directio = directio;
+	}
+
+	/**
+	 * Is the database opened read-only? A read-only database
+	 * is mapped in memory and can only be read (get);
+	 * any number of processes can open it this way while one
+	 * process updates it.
+	 */
+	bool readOnly() const
+	{
+		return o_rdonly;
+	}
+
+	/**
+	 * Sets whether the database is opened read-only.
+	 */
+	void readOnly(bool rdonly)
+	{
+		o_rdonly = rdonly;
+	}
+
+	/**
+	 * Should the hash table be shared, in <dbname>.hti, with
+	 * the processes that open the database read-only?
+	 */
+	bool shareHashTable() const
+	{
+		return o_shareht;
+	}
+
+	/**
+	 * Sets whether the hash table is shared with the processes
+	 * that open the database read-only.
+	 */
+	void shareHashTable(bool shareht)
+	{
+		o_shareht = shareht;
+	}
+
+	/**
+	 * Should the change feed (<dbname>.feed.*), from which
+	 * the replicas are kept up to date, be maintained?
+	 */
+	bool changeFeed() const
+	{
+		return o_feed;
+	}
+
+	/**
+	 * Sets whether the change feed is maintained.
+	 */
+	void changeFeed(bool feed)
+	{
+		o_feed = feed;
+	}
+
+	/**
+	 * Gets the number of changes in a change feed segment.
+	 */
+	int getFeedSegmentSize() const
+	{
+		return o_feedsegsize;
+	}
+
+	/**
+	 * Sets the number of changes in a change feed segment.
+	 *
+	 * @param [in] segsize - changes in a segment.
+	 *
+	 * @return E_ok on success, -ve error code on failure.
+	 */
+	int setFeedSegmentSize(int segsize)
+	{
+		if (segsize <= 0) {
+			LOG_ERROR("RdbOptions",
+				"invalid feed segment size (%d)", segsize);
+			return E_invalid_arg;
+		}
+
+		o_feedsegsize = segsize;
+		return E_ok;
+	}
+
+	/**
+	 * Gets the number of change feed segments kept. A replica
+	 * that falls further behind has to start over from a
+	 * checkpoint.
+	 */
+	int getFeedSegments() const
+	{
+		return o_feedsegs;
+	}
+
+	/**
+	 * Sets the number of change feed segments kept.
+	 *
+	 * @param [in] segs - segments kept.
+	 *
+	 * @return E_ok on success, -ve error code on failure.
+	 */
+	int setFeedSegments(int segs)
+	{
+		if (segs <= 0) {
+			LOG_ERROR("RdbOptions",
+				"invalid feed segment count (%d)", segs);
+			return E_invalid_arg;
+		}
+
+		o_feedsegs = segs;
+		return E_ok;
+	}
+
+	/**
+	 * Should the key page cache be warmed up on open, in the
+	 * background, with the key pages that were in the cache
+	 * when the database was last closed (<dbname>.warm)?
+	 */
+	bool warmCache() const
+	{
+		return o_warmup;
+	}
+
+	/**
+	 * Sets whether the key page cache is warmed up on open.
+	 */
+	void warmCache(bool warmup)
+	{
+		o_warmup = warmup;
+	}
+
+	/**
+	 * Should the key and value pages be verified against
+	 * their checksums when they are read? The checksums are
+	 * written regardless.
+	 */
+	bool verifyChecksums() const
+	{
+		return o_verify;
+	}
+
+	/**
+	 * Sets whether the page checksums are verified on read.
+	 */
+	void verifyChecksums(bool verify)
+	{
+		o_verify = verify;
+	}
+
 	/**
 	 * Copy operator.
 	 */
@@ -117,6 +404,17 @@ public:
 			o_memusage = opt.o_memusage;
 			o_syncdata = opt.o_syncdata;
 			o_syncidx = opt.o_syncidx;
+			o_sweepint = opt.o_sweepint;
+			o_sweepcnt = opt.o_sweepcnt;
+			o_oindex = opt.o_oindex;
+			o_directio = opt.o_directio;
+			o_rdonly = opt.o_rdonly;
+			o_shareht = opt.o_shareht;
+			o_feed = opt.o_feed;
+			o_feedsegsize = opt.o_feedsegsize;
+			o_feedsegs = opt.o_feedsegs;
+			o_warmup = opt.o_warmup;
+			o_verify = opt.o_verify;
 		}
 
 		return *this;
@@ -159,12 +457,97 @@ public:
 	virtual int getUpdatedValue(char *nval, int *nlen) = 0;
 };
 
+class Rdb;
+
+/**
+ * Iterates over the keys, in key order, selected by
+ * Rdb::scanPrefix() or Rdb::scanRange(). The keys are read
+ * from the ordered index in batches and their values are
+ * read using Rdb::get(). The keys added or removed while
+ * the scan is in progress may or may not be seen; the keys
+ * removed or expired are skipped.
+ */
+class RdbIterator
+{
+private:
+	friend class Rdb;
+
+	Rdb                         *rdb;
+	std::string                 from;       // key to resume the scan from
+	bool                        inclusive;  // include the key to resume from?
+	std::string                 prefix;     // prefix scan: key prefix
+	std::string                 to;         // range scan: end key (excluded)
+	bool                        bounded;    // range scan: is end key set?
+	std::vector<std::string>    batch;      // keys read from the index
+	size_t                      pos;        // next key in the batch
+	bool                        exhausted;  // no more keys in the index?
+
+	void reset(Rdb *);
+	bool inRange(const std::string &) const;
+
+public:
+	/**
+	 * Constructs the iterator. Use Rdb::scanPrefix() or
+	 * Rdb::scanRange() to start the scan.
+	 */
+	RdbIterator()
+		: rdb(0),
+		  inclusive(true),
+		  bounded(false),
+		  pos(0),
+		  exhausted(true)
+	{
+	}
+
+	int next(char *, int *, char *, int *);
+};
+
 /**
  * The main database class.
  */
 class Rdb
 {
 private:
+	friend class RdbIterator;
+
+	/*
+	 * A key read by a transaction: what was found, to be
+	 * checked again at commit.
+	 */
+	typedef struct txn_read
+	{
+		int         status;     // E_ok or E_not_found
+		std::string value;      // value read
+		uint32_t    expiry;     // expiry of the value read
+	} txn_read_t;
+
+	typedef std::map<std::string, txn_read_t> txn_reads_t;
+
+	/*
+	 * A pending counter increment.
+	 */
+	typedef struct counter_op
+	{
+		int64_t     delta;      // increment
+		int64_t     result;     // counter value after the increment
+		int         status;     // E_ok or -ve error code
+		bool        done;       // applied?
+	} counter_op_t;
+
+	/*
+	 * Increments of a key waiting to be applied. The first
+	 * thread to find the slot idle becomes the combiner; it
+	 * applies all the pending increments with a single
+	 * write while the others wait.
+	 */
+	typedef struct counter_slot
+	{
+		std::vector<counter_op_t *> pending;
+		bool                        busy;
+		int                         refs;
+		std::condition_variable     cond;
+	} counter_slot_t;
+
 	std::string path;
 	std::string name;
 	int         kpSize;
@@ -174,10 +557,30 @@ private:
 	KeyFile     *keyFile;
 	ValueFile   *valueFile;
 	LRUCache    *cache;
+	OrderedIndex *oindex;
+	MappedFile  *htiFile;
+	RdbReader   *reader;
+	TxnLog      *txnLog;
+	ChangeFeed  *feed;
+	SeqFile     *seqFile;
+	std::atomic<uint64_t> appliedSeq;
+	std::mutex  applyMutex;
 	bool        opened;
 	std::mutex  openMutex;
-	int         opCount;
-	std::mutex  opMutex;
+	OpTracker   ops;
+	std::mutex  ckptMutex;
+	std::thread sweeper;
+	std::thread warmer;
+	std::atomic<bool> warmStop;
+	bool        sweepStop;
+	int         sweepIndex;
+	std::mutex  sweepMutex;
+	std::condition_variable sweepCond;
+	std::mutex  counterMutex;
+	std::unordered_map<std::string, counter_slot_t *> counters;
+	LatencyHistogram getLatency;
+	LatencyHistogram setLatency;
+	LatencyHistogram removeLatency;
 
 	inline void init(
 		const std::string &path,
@@ -204,19 +607,64 @@ private:
 		this->keyFile = 0;
 		this->valueFile = 0;
 		this->cache = 0;
+		this->oindex = 0;
+		this->htiFile = 0;
+		this->reader = 0;
+		this->txnLog = 0;
+		this->feed = 0;
+		this->seqFile = 0;
+		this->appliedSeq = 0;
 		this->opened = false;
-		this->opCount = 0;
+		this->sweepStop = false;
+		this->sweepIndex = 0;
+		this->warmStop = false;
 	}
 
 	int populateHashTable();
 	int populateFreePages(const char *);
+	int populateOrderedIndex();
+	int openSharedHashTable(const char *);
+	int openReadOnly(const char *, const char *, const char *, const char *);
+	int orderedKeys(const std::string &, bool, std::vector<std::string> &);
 	int addNewPage(key_info_t *);
 	int processKeyPages(key_info_t *, op_t);
+	int visitKeyPages(int, const std::function<int(key_page_t *)> &);
+	int findValue(key_info_t *, value_page_t *);
+	int store(key_info_t *, const char *, int, int64_t, Updater *);
+	int setValue(const char *, int, const char *, int, int64_t, Updater *);
+	int removeKey(key_info_t *, std::vector<int64_t> *);
+	void logChange(int, const char *, int, const char *, int, uint32_t);
+	int applyChange(const change_rec_t *);
+	int openSeqFile(const char *);
+	int readKey(const std::string &, txn_read_t *);
+	int lookupKey(key_info_t *, txn_read_t *);
+	int applyWrites(const txn_writes_t &);
+	int replayWrites(const txn_writes_t &);
+	int commitTransaction(const txn_reads_t &, const txn_writes_t &);
+	int sweepBucket(int, time_t, std::vector<int64_t> *);
+	void applyIncrements(const char *, int, std::vector<counter_op_t *> &);
+	void sweep();
+	void startSweeper();
+	void stopSweeper();
+	void warmUp(std::vector<int64_t>);
+	int warmKeyPage(int64_t, const std::unordered_map<int64_t, key_page_t *> &, bool);
+	void startWarmer(const char *);
+	void stopWarmer();
+	void saveHotPages();
 	int backupFile(const char *);
 	int restoreFile(const char *);
 	int removeBackupFile(const char *);
+	int beginOp();
+	void endOp();
+	int copyFile(const char *, const char *);
+	int upgradeFormat(AttrFile *, const char *);
+	int cloneFile(snf::file *, snf::file *);
+	int openCheckpointFile(snf::file *);
+	int scanKeyPages(RdbStats &);
 
 public:
+	class Transaction;
+
 	/**
 	 * Constructs the Rdb object. The default values are
 	 * used for:
@@ -293,6 +741,8 @@ public:
 	virtual ~Rdb()
 	{
 		close();
+		stopWarmer();
+		stopSweeper();
 	}
 
 	/**
@@ -334,9 +784,75 @@ public:
 	int open();
 	int get(const char *, int, char *, int *);
 	int set(const char *, int, const char *, int, Updater *updater = 0);
+	int setWithTTL(const char *, int, const char *, int, int, Updater *updater = 0);
+	int expire(const char *, int, int);
+	int increment(const char *, int, int64_t, int64_t *newval = 0);
+	int compareAndSet(const char *, int, const char *, int, const char *, int);
 	int remove(const char *, int);
+	int scanPrefix(const char *, int, RdbIterator &);
+	int scanRange(const char *, int, const char *, int, RdbIterator &);
+	int sweepExpired(int);
 	int rebuild();
+	int checkpoint(const std::string &);
+	uint64_t lastSequence();
+	int readChanges(uint64_t, int, std::vector<change_rec_t> &);
+	int waitForChanges(uint64_t, int);
+	int applyChanges(const std::vector<change_rec_t> &);
+	uint64_t generation();
+	int getStats(RdbStats &, bool scan = false);
 	int close();
 };
 
+/**
+ * Optimistic multi-key transaction. The reads are done
+ * without holding any lock and are remembered; the writes
+ * are buffered and are seen only by the reads of the same
+ * transaction. On commit the hash table entries of all the
+ * keys touched are locked, in index order, the keys read
+ * are checked to be unchanged, and the writes are written
+ * to the transaction log and applied together. If a key
+ * read was changed by someone else, the commit fails with
+ * E_try_again and the transaction should be run again.
+ * The transactions touching different hash table entries
+ * commit in parallel.
+ *
+ * A transaction can have at most RDB_TXN_MAX_WRITES keys
+ * written. It is not thread-safe; use one per thread.
+ */
+class Rdb::Transaction
+{
+private:
+	Rdb             *rdb;
+	txn_reads_t     reads;      // keys read
+	txn_writes_t    writes;     // writes buffered
+
+	int validate(const char *, int) const;
+
+public:
+	/**
+	 * Starts a transaction on the database.
+	 *
+	 * @param [in] rdb - the database; it must be open
+	 *                   until the transaction is done.
+	 */
+	Transaction(Rdb *rdb)
+		: rdb(rdb)
+	{
+	}
+
+	/**
+	 * Destroys the transaction. The buffered writes, if
+	 * not committed, are discarded.
+	 */
+	~Transaction()
+	{
+	}
+
+	int get(const char *, int, char *, int *);
+	int set(const char *, int, const char *, int);
+	int remove(const char *, int);
+	int commit();
+	void rollback();
+};
+
 #endif // _SNF_RDB_RDB_H_
@@ -0,0 +1,58 @@
+#ifndef _SNF_RDB_READER_H_
+#define _SNF_RDB_READER_H_
+
+#include <string>
+#include <vector>
+#include "dbstruct.h"
+#include "mapfile.h"
+#include "rwlock.h"
+
+#ifndef RDB_READ_RETRIES
+#define RDB_READ_RETRIES    1000
+#endif
+
+/**
+ * Read-only view of the database, used when the database is
+ * opened read-only. The key file, the value file and the
+ * shared hash table (<dbname>.hti) are mapped in memory, so
+ * all the processes reading the database share the OS page
+ * cache, and nothing is read at open.
+ *
+ * The process updating the database (the one that opened it
+ * for writing with the hash table shared) keeps the shared
+ * hash table up to date. Its write lock on a hash table
+ * entry makes the entry sequence number odd until the lock
+ * is released. A lookup reads the sequence number before and
+ * after walking the key pages; if the number is odd or has
+ * changed, the writer was at work and the lookup is retried.
+ *
+ * If the shared hash table is missing, or is of a different
+ * database, a private one is built from the key file. The
+ * lookups are then not protected from a concurrent writer.
+ */
+class RdbReader
+{
+private:
+	int                     kpSize;
+	int                     htSize;
+	MappedFile              idxFile;
+	MappedFile              dbFile;
+	MappedFile              htiFile;
+	hti_header_t            *hti;
+	std::vector<int64_t>    offsets;    // private hash table
+	RWLock                  mapLock;
+
+	int buildHashTable();
+	int lookup(const key_info_t *, int64_t, value_page_t *);
+	int remap();
+
+public:
+	RdbReader(const char *, const char *, const char *, int, int);
+	~RdbReader();
+
+	int open();
+	int get(const char *, int, char *, int *);
+	uint64_t generation() const;
+};
+
+#endif // _SNF_RDB_READER_H_
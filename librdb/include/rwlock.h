@@ -9,6 +9,7 @@
 #endif
 
 #include <list>
+#include <atomic>
 
 /**
  * Read-write lock. Use Slim Read-Write Locks on
@@ -17,7 +18,8 @@
 class RWLock
 {
 private:
-	int                 cnt;
+	std::atomic<int>    cnt;
+	int                 users;
 
 #if defined(_WIN32)
 	SRWLOCK             lock;
@@ -38,6 +40,29 @@ public:
 		return cnt;
 	}
 
+	/**
+	 * Adds a user i.e. a thread that holds or is about to
+	 * wait for the lock. Like the lock pool, the user count
+	 * is not mutex protected; the caller serializes the calls.
+	 *
+	 * @return the new user count.
+	 */
+	int addUser()
+	{
+		return ++users;
+	}
+
+	/**
+	 * Removes a user. The lock can be returned to the pool
+	 * once there are no users.
+	 *
+	 * @return the new user count.
+	 */
+	int removeUser()
+	{
+		return --users;
+	}
+
 	int rdlock(int *oserr = 0);
 	int tryrdlock(int *oserr = 0);
 	int rdunlock(int *oserr = 0);
@@ -0,0 +1,198 @@
+#ifndef _SNF_RDB_STATS_H_
+#define _SNF_RDB_STATS_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#ifndef RDB_STATS_STRIPES
+#define RDB_STATS_STRIPES   16
+#endif
+
+#define RDB_LATENCY_BUCKETS 32
+#define RDB_CHAIN_LENGTHS   32
+
+int StatsStripe();
+
+/**
+ * Counter updated without locks. The counter is split in
+ * cache line sized stripes and every thread updates its own
+ * stripe, so the threads do not contend on the same cache
+ * line. The threads are assigned the stripes round-robin;
+ * with more threads than stripes, a stripe is shared (and
+ * updated atomically). Reading the counter adds up the
+ * stripes.
+ */
+class StripedCounter
+{
+private:
+	struct alignas(64) stripe_t
+	{
+		std::atomic<int64_t>    value;
+	};
+
+	stripe_t    stripes[RDB_STATS_STRIPES];
+
+public:
+	StripedCounter()
+	{
+		for (int i = 0; i < RDB_STATS_STRIPES; ++i)
+			stripes[i].value.store(0, std::memory_order_relaxed);
+	}
+
+	/**
+	 * Adds to the counter.
+	 *
+	 * @param [in] n - number to add.
+	 */
+	void add(int64_t n = 1)
+	{
+		stripes[StatsStripe()].value.fetch_add(n, std::memory_order_relaxed);
+	}
+
+	/**
+	 * Gets the counter value.
+	 */
+	int64_t value() const
+	{
+		int64_t v = 0;
+		for (int i = 0; i < RDB_STATS_STRIPES; ++i)
+			v += stripes[i].value.load(std::memory_order_relaxed);
+		return v;
+	}
+};
+
+/**
+ * Snapshot of the latencies of an operation. Bucket 0
+ * counts the operations that took less than 1 microsecond,
+ * bucket n (n > 0) the ones that took [2^(n-1), 2^n)
+ * microseconds. The last bucket also counts the longer
+ * ones.
+ */
+class RdbLatency
+{
+public:
+	int64_t     count;                          // number of operations
+	int64_t     usec;                           // total time in microseconds
+	int64_t     buckets[RDB_LATENCY_BUCKETS];   // latency histogram
+
+	RdbLatency()
+		: count(0),
+		  usec(0)
+	{
+		for (int i = 0; i < RDB_LATENCY_BUCKETS; ++i)
+			buckets[i] = 0;
+	}
+
+	/**
+	 * Gets the average latency in microseconds.
+	 */
+	int64_t average() const
+	{
+		return count ? (usec / count) : 0;
+	}
+
+	void add(const RdbLatency &);
+	int64_t percentile(double) const;
+};
+
+/**
+ * Latency histogram of an operation, updated without locks
+ * (see StripedCounter).
+ */
+class LatencyHistogram
+{
+private:
+	struct alignas(64) stripe_t
+	{
+		std::atomic<int64_t>    count;
+		std::atomic<int64_t>    usec;
+		std::atomic<int64_t>    buckets[RDB_LATENCY_BUCKETS];
+	};
+
+	stripe_t    stripes[RDB_STATS_STRIPES];
+
+public:
+	LatencyHistogram();
+
+	void add(int64_t);
+	void get(RdbLatency &) const;
+};
+
+/**
+ * Times the scope and adds the time taken to the latency
+ * histogram.
+ */
+class LatencyTimer
+{
+private:
+	LatencyHistogram                        &histogram;
+	std::chrono::steady_clock::time_point   start;
+
+public:
+	LatencyTimer(LatencyHistogram &h)
+		: histogram(h),
+		  start(std::chrono::steady_clock::now())
+	{
+	}
+
+	~LatencyTimer()
+	{
+		histogram.add(std::chrono::duration_cast<std::chrono::microseconds>(
+				std::chrono::steady_clock::now() - start).count());
+	}
+};
+
+/**
+ * Database statistics, obtained using Rdb::getStats(). The
+ * counters are cumulative since the Rdb object is created
+ * (operation latencies) or the database is opened (the
+ * rest).
+ */
+class RdbStats
+{
+public:
+	RdbLatency  gets;               // Rdb::get()
+	RdbLatency  sets;               // Rdb::set(), Rdb::setWithTTL()
+	RdbLatency  removes;            // Rdb::remove()
+
+	int64_t     cacheHits;          // key pages found in the cache
+	int64_t     cacheMisses;        // key pages read into the cache
+	int64_t     cacheEvictions;     // key pages evicted from the cache
+	int         cachePages;         // key pages the cache can hold
+	int         cacheFreePages;     // free pages in the page pool
+
+	int64_t     keyPageReads;       // key file reads
+	int64_t     keyPageWrites;      // key file writes
+	int64_t     keyPageSyncs;       // key file writes synced to disk
+	int64_t     valuePageReads;     // value file reads
+	int64_t     valuePageWrites;    // value file writes
+	int64_t     valuePageSyncs;     // value file writes synced to disk
+	int64_t     freeKeyPages;       // free key pages in the key file
+	int64_t     freeValuePages;     // free value pages in the value file
+	int64_t     checksumsVerified;  // key and value page checksums verified
+	int64_t     checksumFailures;   // key and value pages not matching their checksums
+
+	int64_t     lockWaits;          // hash table locks waited for
+	int64_t     lockWaitUsec;       // time waited for them, in microseconds
+	int         htSize;             // hash table size
+
+	/*
+	 * Set only if the key pages are scanned. chainLengths[n]
+	 * is the number of hash table entries with n key pages;
+	 * there are at most RDB_CHAIN_LENGTHS elements, the last
+	 * one also counts the longer chains.
+	 */
+	int64_t                 keyPages;       // key pages in use
+	int64_t                 keys;           // keys (including the expired ones)
+	int                     maxChainLength; // longest chain, in key pages
+	std::vector<int64_t>    chainLengths;   // chain length distribution
+
+	RdbStats();
+
+	void clear();
+	void add(const RdbStats &);
+};
+
+#endif // _SNF_RDB_STATS_H_
@@ -0,0 +1,82 @@
+#ifndef _SNF_RDB_TXNLOG_H_
+#define _SNF_RDB_TXNLOG_H_
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "file.h"
+#include "dbstruct.h"
+
+#ifndef RDB_TXN_MAX_WRITES
+#define RDB_TXN_MAX_WRITES  32
+#endif
+
+/*
+ * A write of a transaction, keyed by the database key.
+ */
+typedef struct txn_op
+{
+	bool        remove;     // remove the key?
+	std::string value;      // value to set
+} txn_op_t;
+
+typedef std::map<std::string, txn_op_t> txn_writes_t;
+
+/**
+ * Transaction log (<dbname>.txn). The writes of a transaction
+ * are written to the log, synchronously, before they are
+ * applied to the database, and the record is marked done
+ * once they are applied. If the process dies in between, the
+ * pending records are applied again when the database is
+ * opened, so the writes of a transaction are applied either
+ * all or none.
+ *
+ * The log is made of fixed size slots, big enough for a
+ * transaction of RDB_TXN_MAX_WRITES writes. A transaction
+ * takes a free slot for its record, so the transactions
+ * commit in parallel. The log is emptied on open.
+ */
+class TxnLog : public snf::file
+{
+private:
+	int                 slotSize;   // slot size
+	int                 numSlots;   // slots in the file
+	std::vector<int>    freeSlots;  // slots not in use
+	std::mutex          mutex;
+
+	int getSlot();
+	void putSlot(int);
+
+public:
+	/**
+	 * Constructs the transaction log object.
+	 *
+	 * @param [in] fname - file name.
+	 * @param [in] mask  - umask to use when opening
+	 *                     the file.
+	 */
+	TxnLog(const char *fname, mode_t mask)
+		: snf::file(fname, mask),
+		  numSlots(0)
+	{
+		int size = int(sizeof(txn_header_t)) + RDB_TXN_MAX_WRITES *
+				int(sizeof(txn_write_t) + MAX_KEY_LENGTH + MAX_VALUE_LENGTH);
+		slotSize = ((size + 4095) / 4096) * 4096;
+	}
+
+	/**
+	 * Destroys the transaction log object.
+	 */
+	~TxnLog()
+	{
+	}
+
+	int open();
+	int replay(const std::function<int(const txn_writes_t &)> &);
+	int write(const txn_writes_t &, int *);
+	int done(int);
+};
+
+#endif // _SNF_RDB_TXNLOG_H_
@@ -27,6 +27,7 @@ LRUCache::removeLast()
 
 		if (cn->c_kpn) {
 			if (cn->c_kpn->kpn_kp) {
+				evictions.add();
 				pageMgr->free(cn->c_kpn->kpn_kp);
 				cn->c_kpn->kpn_kp = 0;
 			}
@@ -123,11 +124,13 @@ LRUCache::free(cnode_t *cn)
  *
  * @param [inout] kp  - Key Page
  * @param [in] offset - Page offset in the key file.
+ * @param [in] file   - File to read the page from.
+ * @param [in] data   - Page content, if already read.
  *
  * @return E_ok on success, -ve error code on failure.
  */
 int
-LRUCache::getPage(key_page_t *&kp, int64_t offset)
+LRUCache::getPage(key_page_t *&kp, int64_t offset, KeyFile *file, const void *data)
 {
 	int retval = E_ok;
 
@@ -137,12 +140,16 @@ LRUCache::getPage(key_page_t *&kp, int64_t offset)
 			<< "unable to get in-memory page"
 			<< snf::log::record::endl;
 		retval = E_no_memory;
+	} else if ((offset != -1L) && data) {
+		misses.add();
+		memcpy(kp, data, kpSize);
 	} else if (offset != -1L) {
-		retval = keyFile->read(offset, kp, kpSize);
+		misses.add();
+		retval = file->read(offset, kp, kpSize);
 		if (retval != E_ok) {
 			ERROR_STRM("LRUCache")
 				<< "unable to read page at offset " << offset
-				<< " from " << keyFile->name()
+				<< " from " << file->name()
 				<< snf::log::record::endl;
 			pageMgr->free(kp);
 		}
@@ -158,11 +165,17 @@ LRUCache::getPage(key_page_t *&kp, int64_t offset)
  *
  * @param [inout] kpn - Key page node.
  * @param [in] offset - Page offset in the key file.
+ * @param [in] file   - File to read the page from. The
+ *                      key file is used if NULL. The pages
+ *                      of other files sized like the key
+ *                      pages share the same page pool.
+ * @param [in] data   - Page content, if already read; the
+ *                      page is not read from the file.
  *
  * @return E_ok on success, -ve error code on failure.
  */
 int
-LRUCache::get(key_page_node_t *&kpn, int64_t offset)
+LRUCache::get(key_page_node_t *&kpn, int64_t offset, KeyFile *file, const void *data)
 {
 	int         retval;
 	key_page_t  *kp = 0;
@@ -185,7 +198,10 @@ LRUCache::get(key_page_node_t *&kpn, int64_t offset)
 		return E_no_memory;
 	}
 
-	retval = getPage(kp, offset);
+	if (file == 0)
+		file = keyFile;
+
+	retval = getPage(kp, offset, file, data);
 	if (retval != E_ok) {
 		::free(kpn);
 		::free(cn);
@@ -195,6 +211,7 @@ LRUCache::get(key_page_node_t *&kpn, int64_t offset)
 		kpn->kpn_cnode = cn;
 		kpn->kpn_prev = kpn->kpn_next = 0;
 		cn->c_kpn = kpn;
+		cn->c_file = file;
 		add(cn);
 	}
 
@@ -208,11 +225,15 @@ LRUCache::get(key_page_node_t *&kpn, int64_t offset)
  *
  * @param [in] kpn    - Key page node
  * @param [in] offset - Key page offset
+ * @param [in] file   - File to read the page from. The
+ *                      key file is used if NULL.
+ * @param [in] data   - Page content, if already read; the
+ *                      page is not read from the file.
  *
  * @return E_ok on success, -ve error code on failure.
  */
 int
-LRUCache::update(key_page_node_t *kpn, int64_t offset)
+LRUCache::update(key_page_node_t *kpn, int64_t offset, KeyFile *file, const void *data)
 {
 	int         retval = E_ok;
 	key_page_t  *kp = 0;
@@ -226,7 +247,10 @@ LRUCache::update(key_page_node_t *kpn, int64_t offset)
 		return E_no_memory;
 	}
 
-	retval = getPage(kp, offset);
+	if (file == 0)
+		file = keyFile;
+
+	retval = getPage(kp, offset, file, data);
 	if (retval != E_ok) {
 		::free(cn);
 	} else {
@@ -235,6 +259,7 @@ LRUCache::update(key_page_node_t *kpn, int64_t offset)
 		kpn->kpn_cnode = cn;
 		kpn->kpn_prev = kpn->kpn_next = 0;
 		cn->c_kpn = kpn;
+		cn->c_file = file;
 		add(cn);
 	}
 
@@ -264,6 +289,8 @@ LRUCache::touch(key_page_node_t *kpn)
 		return;
 	}
 
+	hits.add();
+
 	cnode_t *cn = (cnode_t *) (kpn->kpn_cnode);
 
 	if (cn->c_prev) {
@@ -311,3 +338,25 @@ LRUCache::free(key_page_node_t *kpn)
 
 	::free(kpn);
 }
+
+/**
+ * Gets the offsets of the key file pages in the cache, the
+ * most recently used first. The pages of the other files
+ * sharing the page pool are left out.
+ *
+ * @param [out] offsets - key page offsets.
+ * @param [in]  count   - maximum number of offsets.
+ */
+void
+LRUCache::getHotPages(std::vector<int64_t> &offsets, int count)
+{
+	std::lock_guard<std::mutex> guard(mutex);
+
+	offsets.clear();
+
+	for (cnode_t *cn = head; cn && (int(offsets.size()) < count); cn = cn->c_next) {
+		key_page_node_t *kpn = cn->c_kpn;
+		if (kpn && kpn->kpn_kp && (kpn->kpn_kpoff != -1L) && (cn->c_file == keyFile))
+			offsets.push_back(kpn->kpn_kpoff);
+	}
+}
@@ -0,0 +1,1241 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdarg>
+#include <thread>
+#include "checker.h"
+#include "dbfiles.h"
+#include "filesystem.h"
+#include "hashtable.h"
+#include "keyrec.h"
+#include "logmgr.h"
+#include "error.h"
+
+#define VPAGE_SIZE          int64_t(sizeof(value_page_t))
+
+/* Value page states */
+#define VSTATE_UNUSED       char(0)     // never written (zero-filled)
+#define VSTATE_FREE         char(1)     // deleted
+#define VSTATE_INUSE        char(2)     // in use, no key points to it
+#define VSTATE_REFERENCED   char(3)     // in use, a key points to it
+
+/*
+ * Fingerprint (64-bit FNV-1a) of the key, to match the keys
+ * of the key records with the keys of the value pages.
+ */
+static uint64_t
+Fingerprint(const char *key, int klen)
+{
+	uint64_t h = 0xCBF29CE484222325ULL;
+	for (int i = 0; i < klen; ++i) {
+		h ^= uint8_t(key[i]);
+		h *= 0x100000001B3ULL;
+	}
+	return h;
+}
+
+/*
+ * Compares the keys of the key records the way KeyRecords
+ * orders them: by length, and then by content.
+ */
+static int
+KeyCompare(const key_rec_t *kr1, const key_rec_t *kr2)
+{
+	int cmp = kr1->kr_klen - kr2->kr_klen;
+	if (cmp == 0)
+		cmp = memcmp(kr1->kr_key, kr2->kr_key, kr1->kr_klen);
+	return cmp;
+}
+
+/*
+ * Is the value page in use, with a valid key and value?
+ */
+static bool
+IsValuePageInUse(const value_page_t *vp)
+{
+	return ((vp->vp_flags & VPAGE_DELETED) != VPAGE_DELETED) &&
+		(vp->vp_klen > 0) && (vp->vp_klen <= MAX_KEY_LENGTH) &&
+		(vp->vp_vlen >= 0) && (vp->vp_vlen <= MAX_VALUE_LENGTH);
+}
+
+/* State of the walk of a key page tree */
+typedef struct tree_walk
+{
+	const key_page_t    *kp;
+	int                 numKeys;
+	std::vector<char>   seen;       // key records visited
+	const key_rec_t     *prev;      // previous key in order
+	int                 count;      // keys visited
+	const char          *error;     // problem found
+	short               errIdx;     // key record with the problem
+} tree_walk_t;
+
+/*
+ * Walks the sub tree in order, checking the links, the key
+ * order and the heights. The balance is not checked: removing
+ * a key can leave a sub tree off balance by two (see
+ * KeyRecords::balanceTree()), which does not affect lookups.
+ *
+ * @param [in] tw  - tree walk state.
+ * @param [in] idx - root of the sub tree.
+ *
+ * @return the height of the sub tree, -1 if it is broken
+ * (tw->error is set).
+ */
+static int
+WalkTree(tree_walk_t *tw, short idx)
+{
+	if (idx == -1)
+		return 0;
+
+	tw->errIdx = idx;
+
+	if ((idx < 0) || (idx >= tw->numKeys)) {
+		tw->error = "key record index out of range";
+		return -1;
+	}
+
+	if (tw->seen[idx]) {
+		tw->error = "key record linked twice";
+		return -1;
+	}
+	tw->seen[idx] = 1;
+
+	const key_rec_t *kr = &tw->kp->kp_keys[idx];
+
+	if (kr->kr_flags != KEY_INUSE) {
+		tw->error = "free key record in the tree";
+		return -1;
+	}
+
+	if ((kr->kr_klen <= 0) || (kr->kr_klen > MAX_KEY_LENGTH)) {
+		tw->error = "invalid key length";
+		return -1;
+	}
+
+	int lh = WalkTree(tw, kr->kr_left);
+	if (lh < 0)
+		return -1;
+
+	if (tw->prev && (KeyCompare(tw->prev, kr) >= 0)) {
+		tw->errIdx = idx;
+		tw->error = "keys out of order";
+		return -1;
+	}
+	tw->prev = kr;
+	tw->count++;
+
+	int rh = WalkTree(tw, kr->kr_right);
+	if (rh < 0)
+		return -1;
+
+	tw->errIdx = idx;
+
+	int h = 1 + std::max(lh, rh);
+	if (kr->kr_height != h) {
+		tw->error = "wrong height";
+		return -1;
+	}
+
+	return h;
+}
+
+/**
+ * Constructs the check report.
+ */
+RdbCheckReport::RdbCheckReport()
+{
+	clear();
+}
+
+/**
+ * Clears the check report.
+ */
+void
+RdbCheckReport::clear()
+{
+	keyPages = 0;
+	freeKeyPages = 0;
+	keys = 0;
+	valuePages = 0;
+	freeValuePages = 0;
+	badKeyPages = 0;
+	badLinks = 0;
+	badKeys = 0;
+	badFreePages = 0;
+	lostFreePages = 0;
+	unreferencedValues = 0;
+	badChecksums = 0;
+	damagedBuckets.clear();
+	problems.clear();
+	repairedBuckets = 0;
+	recoveredKeys = 0;
+	freedValuePages = 0;
+}
+
+/**
+ * Gets the number of problems found.
+ */
+int64_t
+RdbCheckReport::problemCount() const
+{
+	return badKeyPages + badLinks + badKeys + badFreePages +
+		lostFreePages + unreferencedValues + badChecksums;
+}
+
+/**
+ * Constructs the checker object.
+ *
+ * @param [in] path    - database path.
+ * @param [in] name    - database name.
+ * @param [in] threads - threads reading the files (0: as many
+ *                       as the processors).
+ */
+RdbChecker::RdbChecker(const std::string &path, const std::string &name, int threads)
+	: path(path),
+	  name(name),
+	  threads(threads),
+	  kpSize(0),
+	  htSize(0),
+	  idxSize(0),
+	  dbSize(0),
+	  report(0)
+{
+	if (this->threads <= 0)
+		this->threads = std::max(1, int(std::thread::hardware_concurrency()));
+}
+
+/*
+ * Gets the name of the database file with the extension.
+ */
+std::string
+RdbChecker::fileName(const char *ext) const
+{
+	char    fname[MAXPATHLEN + 1];
+
+	snprintf(fname, MAXPATHLEN, "%s%c%s%s", path.c_str(), snf::pathsep(), name.c_str(), ext);
+	return fname;
+}
+
+/*
+ * Records a problem found.
+ *
+ * @param [in] counter - report counter of the problem.
+ * @param [in] fmt     - problem description format.
+ */
+void
+RdbChecker::problem(int64_t &counter, const char *fmt, ...)
+{
+	char    buf[512];
+	va_list args;
+
+	std::lock_guard<std::mutex> guard(mutex);
+
+	counter++;
+
+	if (report->problems.size() < RDB_CHECK_MAX_PROBLEMS) {
+		va_start(args, fmt);
+		vsnprintf(buf, sizeof(buf), fmt, args);
+		va_end(args);
+		report->problems.push_back(buf);
+	}
+}
+
+/*
+ * Marks the hash table entry damaged.
+ *
+ * @param [in] hindex - hash table index.
+ */
+void
+RdbChecker::damage(int hindex)
+{
+	if ((hindex >= 0) && (hindex < htSize)) {
+		std::lock_guard<std::mutex> guard(mutex);
+		damaged[hindex] = 1;
+	}
+}
+
+/*
+ * Reads the file in parallel, in large sequential chunks:
+ * every thread reads its own contiguous part of the file, and
+ * calls the visitor for each page, with the thread number.
+ * An incomplete page at the end of the file is ignored.
+ *
+ * @param [in] fname    - file name.
+ * @param [in] pageSize - page size.
+ * @param [in] fsize    - file size.
+ * @param [in] visitor  - page visitor.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+RdbChecker::scan(const std::string &fname, int pageSize, int64_t fsize, const page_visitor_t &visitor)
+{
+	int64_t             npages = fsize / pageSize;
+	int64_t             perChunk = std::max(1, RDB_CHECK_CHUNK_SIZE / pageSize);
+	int                 nthreads = int(std::min(int64_t(threads), npages));
+	std::atomic<int>    status(E_ok);
+	std::vector<std::thread> workers;
+
+	for (int t = 0; t < nthreads; ++t) {
+		int64_t first = (npages * t) / nthreads;
+		int64_t last = (npages * (t + 1)) / nthreads;
+
+		workers.emplace_back([&, t, first, last] {
+			int                     retval;
+			int                     oserr = 0;
+			int                     bRead = 0;
+			snf::file               file(fname, 0022);
+			snf::file::open_flags   oflags;
+			std::vector<char>       buf(size_t(perChunk * pageSize));
+
+			oflags.o_read = true;
+
+			retval = file.open(oflags, 0600, &oserr);
+			if (retval != E_ok) {
+				ERROR_STRM("RdbChecker", oserr)
+					<< "failed to open file " << fname
+					<< snf::log::record::endl;
+				status = retval;
+				return;
+			}
+
+			for (int64_t p = first; (p < last) && (status == E_ok); p += perChunk) {
+				int n = int(std::min(perChunk, last - p));
+
+				retval = file.read(p * pageSize, buf.data(), n * pageSize, &bRead, &oserr);
+				if ((retval == E_ok) && (bRead != (n * pageSize)))
+					retval = E_read_failed;
+
+				if (retval != E_ok) {
+					ERROR_STRM("RdbChecker", oserr)
+						<< "failed to read file " << fname
+						<< " at offset " << (p * pageSize)
+						<< snf::log::record::endl;
+					status = retval;
+					break;
+				}
+
+				for (int i = 0; i < n; ++i)
+					visitor(t, (p + i) * pageSize, buf.data() + (i * pageSize));
+			}
+		});
+	}
+
+	for (std::thread &worker : workers)
+		worker.join();
+
+	return status;
+}
+
+/*
+ * Checks the key page tree and collects the key records. A
+ * broken page damages its hash table entry.
+ *
+ * @param [in]  kp     - key page.
+ * @param [in]  offset - key page offset.
+ * @param [out] krefs  - key records of the page.
+ *
+ * @return the number of keys collected.
+ */
+int
+RdbChecker::checkTree(const key_page_t *kp, int64_t offset, std::vector<key_ref_t> &krefs)
+{
+	tree_walk_t tw;
+
+	tw.kp = kp;
+	tw.numKeys = NUM_OF_KEYS_IN_PAGE(kpSize);
+	tw.seen.assign(size_t(tw.numKeys), 0);
+	tw.prev = 0;
+	tw.count = 0;
+	tw.error = 0;
+	tw.errIdx = kp->kp_root;
+
+	if (WalkTree(&tw, kp->kp_root) >= 0) {
+		int inuse = 0;
+		for (int i = 0; i < tw.numKeys; ++i) {
+			if (kp->kp_keys[i].kr_flags != KEY_FREE)
+				inuse++;
+		}
+
+		if (tw.count != kp->kp_vcount)
+			tw.error = "key count does not match the tree";
+		else if (inuse != tw.count)
+			tw.error = "key records in use missing from the tree";
+	}
+
+	if (tw.error) {
+		problem(report->badKeyPages,
+			"key page %" PRId64 " (hash table entry %d): %s (key record %d)",
+			offset, kp->kp_hash, tw.error, tw.errIdx);
+		damage(kp->kp_hash);
+		return 0;
+	}
+
+	for (int i = 0; i < tw.numKeys; ++i) {
+		const key_rec_t *kr = &kp->kp_keys[i];
+		if (kr->kr_flags == KEY_FREE)
+			continue;
+
+		if (hash(kr->kr_key, kr->kr_klen, htSize) != kp->kp_hash) {
+			problem(report->badKeyPages,
+				"key page %" PRId64 " (hash table entry %d): key record %d "
+				"belongs to hash table entry %d",
+				offset, kp->kp_hash, i, hash(kr->kr_key, kr->kr_klen, htSize));
+			damage(kp->kp_hash);
+		} else if ((kr->kr_voff < 0) || ((kr->kr_voff % VPAGE_SIZE) != 0) ||
+			(kr->kr_voff >= dbSize)) {
+			problem(report->badKeys,
+				"key page %" PRId64 " (hash table entry %d): key record %d "
+				"points to invalid value offset %" PRId64,
+				offset, kp->kp_hash, i, kr->kr_voff);
+			damage(kp->kp_hash);
+		} else {
+			key_ref_t kref;
+			kref.voff = kr->kr_voff;
+			kref.fp = Fingerprint(kr->kr_key, kr->kr_klen);
+			kref.hash = kp->kp_hash;
+			krefs.push_back(kref);
+		}
+	}
+
+	return tw.count;
+}
+
+/*
+ * Reads the key file, checks the key pages in use and
+ * collects them along with their key records.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+RdbChecker::checkKeyPages()
+{
+	typedef struct key_scan
+	{
+		std::vector<page_info_t>    pages;
+		std::vector<key_ref_t>      refs;
+		int64_t                     keyPages = 0;
+		int64_t                     freeKeyPages = 0;
+		int64_t                     keys = 0;
+	} key_scan_t;
+
+	std::vector<key_scan_t> scans(threads);
+
+	int retval = scan(fileName(".idx"), kpSize, idxSize,
+		[this, &scans] (int t, int64_t offset, const char *page) {
+			const key_page_t    *kp = reinterpret_cast<const key_page_t *>(page);
+			key_scan_t          &ks = scans[t];
+			page_info_t         pi;
+
+			if (IsKeyPageDeleted(kp) || (kp->kp_vcount <= 0)) {
+				ks.freeKeyPages++;
+				return;
+			}
+
+			pi.offset = offset;
+			pi.poff = kp->kp_poff;
+			pi.noff = kp->kp_noff;
+			pi.hash = kp->kp_hash;
+
+			if ((kp->kp_hash < 0) || (kp->kp_hash >= htSize)) {
+				problem(report->badKeyPages,
+					"key page %" PRId64 ": hash table index %d out of range",
+					offset, kp->kp_hash);
+				pi.hash = -1;
+			} else if (!IsKeyPageChecksumValid(kp, kpSize)) {
+				// the keys are recovered from the value pages
+				problem(report->badChecksums,
+					"key page %" PRId64 " (hash table entry %d): checksum mismatch",
+					offset, kp->kp_hash);
+				damage(kp->kp_hash);
+			} else {
+				checkTree(kp, offset, ks.refs);
+			}
+
+			ks.keyPages++;
+			ks.keys += kp->kp_vcount;
+			ks.pages.push_back(pi);
+		});
+
+	for (key_scan_t &ks : scans) {
+		pages.insert(pages.end(), ks.pages.begin(), ks.pages.end());
+		refs.insert(refs.end(), ks.refs.begin(), ks.refs.end());
+		report->keyPages += ks.keyPages;
+		report->freeKeyPages += ks.freeKeyPages;
+		report->keys += ks.keys;
+	}
+
+	std::sort(pages.begin(), pages.end(),
+		[] (const page_info_t &p1, const page_info_t &p2) { return p1.offset < p2.offset; });
+	std::sort(refs.begin(), refs.end(),
+		[] (const key_ref_t &r1, const key_ref_t &r2) { return r1.voff < r2.voff; });
+
+	return retval;
+}
+
+/*
+ * Checks that the key pages of every hash table entry make
+ * one chain, starting with the page with no previous page,
+ * and that the pages link back to their previous page.
+ */
+void
+RdbChecker::checkChains()
+{
+	std::vector<int64_t>    heads(size_t(htSize), -1L);
+	std::vector<char>       linked(pages.size(), 0);
+
+	for (size_t i = 0; i < pages.size(); ++i) {
+		int h = pages[i].hash;
+		if ((h < 0) || (pages[i].poff != -1L))
+			continue;
+
+		if (heads[h] == -1L) {
+			heads[h] = int64_t(i);
+		} else {
+			problem(report->badLinks,
+				"hash table entry %d: key pages %" PRId64 " and %" PRId64 " both start the chain",
+				h, pages[heads[h]].offset, pages[i].offset);
+			damage(h);
+		}
+	}
+
+	for (int h = 0; h < htSize; ++h) {
+		if (heads[h] == -1L)
+			continue;
+
+		size_t i = size_t(heads[h]);
+
+		while (true) {
+			linked[i] = 1;
+
+			int64_t noff = pages[i].noff;
+			if (noff == -1L)
+				break;
+
+			std::vector<page_info_t>::const_iterator it = std::lower_bound(
+				pages.begin(), pages.end(), noff,
+				[] (const page_info_t &p, int64_t off) { return p.offset < off; });
+
+			if ((it == pages.end()) || (it->offset != noff)) {
+				problem(report->badLinks,
+					"key page %" PRId64 " (hash table entry %d): next key page %" PRId64
+					" is not in use", pages[i].offset, h, noff);
+				damage(h);
+				break;
+			}
+
+			size_t j = size_t(it - pages.begin());
+
+			if (pages[j].hash != h) {
+				problem(report->badLinks,
+					"key page %" PRId64 " (hash table entry %d): next key page %" PRId64
+					" belongs to hash table entry %d", pages[i].offset, h, noff, pages[j].hash);
+				damage(h);
+				damage(pages[j].hash);
+				break;
+			}
+
+			if (pages[j].poff != pages[i].offset) {
+				problem(report->badLinks,
+					"key page %" PRId64 " (hash table entry %d): next key page %" PRId64
+					" links back to %" PRId64, pages[i].offset, h, noff, pages[j].poff);
+				damage(h);
+				break;
+			}
+
+			if (linked[j]) {
+				problem(report->badLinks,
+					"key page %" PRId64 " (hash table entry %d): chain loops back to %" PRId64,
+					pages[i].offset, h, noff);
+				damage(h);
+				break;
+			}
+
+			i = j;
+		}
+	}
+
+	for (size_t i = 0; i < pages.size(); ++i) {
+		if (!linked[i] && (pages[i].hash >= 0)) {
+			problem(report->badLinks,
+				"key page %" PRId64 " (hash table entry %d) is not in the chain",
+				pages[i].offset, pages[i].hash);
+			damage(pages[i].hash);
+		}
+	}
+}
+
+/*
+ * Reads the value file, and checks that every key points to
+ * a value page in use with the same key, and that no two keys
+ * point to the same value page. Finds the value pages in use
+ * that no key points to, and the ones not matching their
+ * checksums.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+RdbChecker::checkValues()
+{
+	typedef struct value_scan
+	{
+		std::vector<std::pair<int64_t, int>>    unreferenced;   // offset, hash table index
+		std::vector<int64_t>                    corrupt;        // offset
+		int64_t                                 valuePages = 0;
+		int64_t                                 freeValuePages = 0;
+	} value_scan_t;
+
+	std::vector<value_scan_t> scans(threads);
+
+	vstate.assign(size_t(dbSize / VPAGE_SIZE), VSTATE_UNUSED);
+
+	for (size_t i = 1; i < refs.size(); ++i) {
+		if (refs[i].voff == refs[i - 1].voff) {
+			problem(report->badKeys,
+				"value page %" PRId64 " is pointed to by two keys (hash table entries %d and %d)",
+				refs[i].voff, refs[i - 1].hash, refs[i].hash);
+			damage(refs[i - 1].hash);
+			damage(refs[i].hash);
+		}
+	}
+
+	int retval = scan(fileName(".db"), int(VPAGE_SIZE), dbSize,
+		[this, &scans] (int t, int64_t offset, const char *page) {
+			const value_page_t  *vp = reinterpret_cast<const value_page_t *>(page);
+			value_scan_t        &vs = scans[t];
+			size_t              idx = size_t(offset / VPAGE_SIZE);
+
+			if (!IsValuePageChecksumValid(vp)) {
+				// neither free nor in use; freed by a repair
+				problem(report->badChecksums,
+					"value page %" PRId64 ": checksum mismatch", offset);
+				vs.corrupt.push_back(offset);
+			} else if ((vp->vp_flags & VPAGE_DELETED) == VPAGE_DELETED) {
+				vstate[idx] = VSTATE_FREE;
+				vs.freeValuePages++;
+			} else if (IsValuePageInUse(vp)) {
+				vstate[idx] = VSTATE_INUSE;
+				vs.valuePages++;
+			}
+
+			std::vector<key_ref_t>::const_iterator it = std::lower_bound(
+				refs.begin(), refs.end(), offset,
+				[] (const key_ref_t &r, int64_t off) { return r.voff < off; });
+
+			for (; (it != refs.end()) && (it->voff == offset); ++it) {
+				if (vstate[idx] == VSTATE_FREE || vstate[idx] == VSTATE_UNUSED) {
+					problem(report->badKeys,
+						"hash table entry %d: key points to value page %" PRId64
+						" that is not in use", it->hash, offset);
+					damage(it->hash);
+				} else if (Fingerprint(vp->vp_key, vp->vp_klen) != it->fp) {
+					problem(report->badKeys,
+						"hash table entry %d: key points to value page %" PRId64
+						" of another key", it->hash, offset);
+					damage(it->hash);
+				} else {
+					vstate[idx] = VSTATE_REFERENCED;
+				}
+			}
+
+			if (vstate[idx] == VSTATE_INUSE) {
+				vs.unreferenced.push_back(std::make_pair(offset,
+					hash(vp->vp_key, vp->vp_klen, htSize)));
+			}
+		});
+
+	for (value_scan_t &vs : scans) {
+		report->valuePages += vs.valuePages;
+		report->freeValuePages += vs.freeValuePages;
+		orphans.insert(orphans.end(), vs.corrupt.begin(), vs.corrupt.end());
+
+		// the keys of a damaged hash table entry are recovered
+		// from its value pages
+		for (const std::pair<int64_t, int> &u : vs.unreferenced) {
+			if (!damaged[u.second]) {
+				problem(report->unreferencedValues,
+					"value page %" PRId64 " (hash table entry %d) is in use but no key points to it",
+					u.first, u.second);
+				orphans.push_back(u.first);
+			}
+		}
+	}
+
+	return retval;
+}
+
+/*
+ * Reads the free value pages (<dbname>.fdp) and checks that
+ * they are not in use, and that all the free value pages are
+ * there. The first entry is the end of the value file.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+RdbChecker::checkFreeList()
+{
+	int                     retval = E_ok;
+	int                     oserr = 0;
+	int                     bRead = 0;
+	int64_t                 fsize;
+	snf::file               file(fileName(".fdp"), 0022);
+	snf::file::open_flags   oflags;
+
+	freeList.clear();
+
+	if (!snf::fs::exists(file.name()))
+		fsize = 0;
+	else {
+		oflags.o_read = true;
+
+		retval = file.open(oflags, 0600, &oserr);
+		if (retval != E_ok) {
+			ERROR_STRM("RdbChecker", oserr)
+				<< "failed to open file " << file.name()
+				<< snf::log::record::endl;
+			return retval;
+		}
+
+		fsize = file.size(&oserr);
+		if (fsize < 0) {
+			ERROR_STRM("RdbChecker", oserr)
+				<< "failed to get size of file " << file.name()
+				<< snf::log::record::endl;
+			return int(fsize);
+		}
+	}
+
+	freeList.resize(size_t(fsize / int64_t(sizeof(int64_t))));
+
+	if (!freeList.empty()) {
+		int toRead = int(freeList.size() * sizeof(int64_t));
+		retval = file.read(0L, freeList.data(), toRead, &bRead, &oserr);
+		if ((retval == E_ok) && (bRead != toRead))
+			retval = E_read_failed;
+		if (retval != E_ok) {
+			ERROR_STRM("RdbChecker", oserr)
+				<< "failed to read file " << file.name()
+				<< snf::log::record::endl;
+			return retval;
+		}
+	}
+
+	std::vector<int64_t> listed;
+
+	for (size_t i = 0; i < freeList.size(); ++i) {
+		int64_t off = freeList[i];
+
+		if ((off < 0) || ((off % VPAGE_SIZE) != 0)) {
+			problem(report->badFreePages,
+				"free list entry %zu: %" PRId64 " is not a value page offset", i, off);
+		} else if (off >= dbSize) {
+			if (i != 0) {
+				problem(report->badFreePages,
+					"free list entry %zu: %" PRId64 " is past the end of the value file", i, off);
+			}
+		} else if (vstate[size_t(off / VPAGE_SIZE)] >= VSTATE_INUSE) {
+			problem(report->badFreePages,
+				"free list entry %zu: value page %" PRId64 " is in use", i, off);
+		} else {
+			listed.push_back(off);
+		}
+	}
+
+	std::sort(listed.begin(), listed.end());
+
+	for (size_t i = 1; i < listed.size(); ++i) {
+		if (listed[i] == listed[i - 1]) {
+			problem(report->badFreePages,
+				"value page %" PRId64 " is in the free list more than once", listed[i]);
+		}
+	}
+
+	std::vector<int64_t>::const_iterator it = listed.begin();
+	for (size_t idx = 0; idx < vstate.size(); ++idx) {
+		if (vstate[idx] != VSTATE_FREE)
+			continue;
+
+		int64_t off = int64_t(idx) * VPAGE_SIZE;
+		while ((it != listed.end()) && (*it < off))
+			++it;
+
+		if ((it == listed.end()) || (*it != off)) {
+			problem(report->lostFreePages,
+				"free value page %" PRId64 " is not in the free list", off);
+		}
+	}
+
+	return E_ok;
+}
+
+/*
+ * Reads the value file and collects the keys of the value
+ * pages in use that belong to the damaged hash table entries.
+ *
+ * @param [out] keys - keys recovered.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+RdbChecker::recoverKeys(std::vector<recovered_key_t> &keys)
+{
+	std::vector<std::vector<recovered_key_t>> scans(threads);
+
+	int retval = scan(fileName(".db"), int(VPAGE_SIZE), dbSize,
+		[this, &scans] (int t, int64_t offset, const char *page) {
+			const value_page_t  *vp = reinterpret_cast<const value_page_t *>(page);
+			char                state = vstate[size_t(offset / VPAGE_SIZE)];
+
+			if ((state < VSTATE_INUSE) || !IsValuePageInUse(vp))
+				return;
+
+			int h = hash(vp->vp_key, vp->vp_klen, htSize);
+			if (!damaged[h])
+				return;
+
+			recovered_key_t rk;
+			rk.hash = h;
+			rk.referenced = (state == VSTATE_REFERENCED);
+			rk.voff = offset;
+			rk.klen = vp->vp_klen;
+			memcpy(rk.key, vp->vp_key, vp->vp_klen);
+			scans[t].push_back(rk);
+		});
+
+	for (std::vector<recovered_key_t> &s : scans)
+		keys.insert(keys.end(), s.begin(), s.end());
+
+	// by hash table entry and key; the value page a key points
+	// to comes first, then the most recently written one
+	std::sort(keys.begin(), keys.end(),
+		[] (const recovered_key_t &k1, const recovered_key_t &k2) {
+			if (k1.hash != k2.hash)
+				return k1.hash < k2.hash;
+			if (k1.klen != k2.klen)
+				return k1.klen < k2.klen;
+			int cmp = memcmp(k1.key, k2.key, k1.klen);
+			if (cmp != 0)
+				return cmp < 0;
+			if (k1.referenced != k2.referenced)
+				return k1.referenced;
+			return k1.voff > k2.voff;
+		});
+
+	return retval;
+}
+
+/*
+ * Writes the keys of a hash table entry to new key pages.
+ *
+ * @param [in]    file  - key file.
+ * @param [in]    h     - hash table index.
+ * @param [in]    first - first key.
+ * @param [in]    last  - past the last key.
+ * @param [inout] spare - key pages to reuse, the highest
+ *                        offset first.
+ * @param [inout] end   - end of the key file.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+RdbChecker::writeBucket(snf::file &file, int h, const recovered_key_t *first,
+	const recovered_key_t *last, std::vector<int64_t> &spare, int64_t &end)
+{
+	int                     retval = E_ok;
+	int                     oserr = 0;
+	int                     bWritten = 0;
+	int                     perPage = NUM_OF_KEYS_IN_PAGE(kpSize);
+	int64_t                 poff = -1L;
+	int64_t                 offset;
+	std::vector<char>       buf(kpSize);
+	key_page_t              *kp = reinterpret_cast<key_page_t *>(buf.data());
+	key_info_t              ki;
+
+	auto allocate = [&spare, &end, this] () {
+		int64_t off;
+		if (!spare.empty()) {
+			off = spare.back();
+			spare.pop_back();
+		} else {
+			off = end;
+			end += kpSize;
+		}
+		return off;
+	};
+
+	if (first == last)
+		return E_ok;
+
+	offset = allocate();
+
+	while ((first < last) && (retval == E_ok)) {
+		InitKeyPage(kp, kpSize);
+		kp->kp_hash = h;
+		kp->kp_poff = poff;
+
+		KeyRecords krecs(kp, kpSize);
+		for (int n = 0; (n < perPage) && (first < last); ++n, ++first) {
+			SetKeyInfo(&ki, first->key, first->klen, h);
+			ki.ki_voff = first->voff;
+			krecs.put(&ki);
+		}
+
+		kp->kp_noff = (first < last) ? allocate() : -1L;
+		SetKeyPageChecksum(kp, kpSize);
+
+		retval = file.write(offset, kp, kpSize, &bWritten, &oserr);
+		if ((retval == E_ok) && (bWritten != kpSize))
+			retval = E_write_failed;
+
+		if (retval != E_ok) {
+			ERROR_STRM("RdbChecker", oserr)
+				<< "failed to write key page " << offset
+				<< " to file " << file.name()
+				<< snf::log::record::endl;
+		}
+
+		poff = offset;
+		offset = kp->kp_noff;
+	}
+
+	return retval;
+}
+
+/*
+ * Marks the value pages deleted: each is written afresh, as
+ * a deleted page with its checksum.
+ *
+ * @param [in] offsets - value page offsets.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+RdbChecker::freeValuePages(const std::vector<int64_t> &offsets)
+{
+	int                     retval = E_ok;
+	int                     oserr = 0;
+	int                     bWritten = 0;
+	value_page_t            vp;
+	snf::file               file(fileName(".db"), 0022);
+	snf::file::open_flags   oflags;
+
+	if (offsets.empty())
+		return E_ok;
+
+	oflags.o_read = true;
+	oflags.o_write = true;
+
+	retval = file.open(oflags, 0600, &oserr);
+	if (retval != E_ok) {
+		ERROR_STRM("RdbChecker", oserr)
+			<< "failed to open file " << file.name()
+			<< snf::log::record::endl;
+		return retval;
+	}
+
+	memset(&vp, 0, sizeof(vp));
+	vp.vp_flags = VPAGE_DELETED;
+	SetValuePageChecksum(&vp);
+
+	for (int64_t off : offsets) {
+		retval = file.write(off, &vp, int(sizeof(vp)), &bWritten, &oserr);
+		if ((retval == E_ok) && (bWritten != int(sizeof(vp))))
+			retval = E_write_failed;
+
+		if (retval != E_ok) {
+			ERROR_STRM("RdbChecker", oserr)
+				<< "failed to free value page " << off
+				<< " in file " << file.name()
+				<< snf::log::record::endl;
+			break;
+		}
+
+		vstate[size_t(off / VPAGE_SIZE)] = VSTATE_FREE;
+		report->freedValuePages++;
+	}
+
+	return retval;
+}
+
+/*
+ * Writes the free value pages (<dbname>.fdp) afresh: the end
+ * of the value file first, then the free value pages, the
+ * lowest offset last so that it is reused first.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+RdbChecker::writeFreeList()
+{
+	int                     retval = E_ok;
+	int                     oserr = 0;
+	int                     bWritten = 0;
+	snf::file               file(fileName(".fdp"), 0022);
+	snf::file::open_flags   oflags;
+	std::vector<int64_t>    offsets;
+
+	offsets.push_back(int64_t(vstate.size()) * VPAGE_SIZE);
+	for (size_t idx = vstate.size(); idx > 0; --idx) {
+		if (vstate[idx - 1] == VSTATE_FREE)
+			offsets.push_back(int64_t(idx - 1) * VPAGE_SIZE);
+	}
+
+	oflags.o_read = true;
+	oflags.o_write = true;
+	oflags.o_create = true;
+	oflags.o_truncate = true;
+
+	retval = file.open(oflags, 0600, &oserr);
+	if (retval == E_ok) {
+		int toWrite = int(offsets.size() * sizeof(int64_t));
+		retval = file.write(0L, offsets.data(), toWrite, &bWritten, &oserr);
+		if ((retval == E_ok) && (bWritten != toWrite))
+			retval = E_write_failed;
+	}
+
+	if (retval != E_ok) {
+		ERROR_STRM("RdbChecker", oserr)
+			<< "failed to write file " << file.name()
+			<< snf::log::record::endl;
+	}
+
+	return retval;
+}
+
+/*
+ * Repairs the database: rebuilds the damaged hash table
+ * entries, frees the value pages no key points to, and
+ * writes the free value pages afresh.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+RdbChecker::repair()
+{
+	int                             retval = E_ok;
+	int                             oserr = 0;
+	std::vector<recovered_key_t>    keys;
+	std::vector<int64_t>            freed(orphans);
+
+	if (!report->damagedBuckets.empty()) {
+		snf::file               file(fileName(".idx"), 0022);
+		snf::file::open_flags   oflags;
+		std::vector<int64_t>    spare;
+		int64_t                 end = (idxSize / kpSize) * kpSize;
+
+		retval = recoverKeys(keys);
+		if (retval != E_ok)
+			return retval;
+
+		// the older copies of a key are freed
+		size_t n = 0;
+		for (size_t i = 0; i < keys.size(); ++i) {
+			if ((n > 0) && (keys[n - 1].hash == keys[i].hash) &&
+				(keys[n - 1].klen == keys[i].klen) &&
+				(memcmp(keys[n - 1].key, keys[i].key, keys[i].klen) == 0))
+				freed.push_back(keys[i].voff);
+			else
+				keys[n++] = keys[i];
+		}
+		keys.resize(n);
+
+		// the key pages of the damaged entries are replaced
+		for (const page_info_t &pi : pages) {
+			if ((pi.hash < 0) || damaged[pi.hash])
+				spare.push_back(pi.offset);
+		}
+		std::sort(spare.rbegin(), spare.rend());
+
+		oflags.o_read = true;
+		oflags.o_write = true;
+
+		retval = file.open(oflags, 0600, &oserr);
+		if (retval != E_ok) {
+			ERROR_STRM("RdbChecker", oserr)
+				<< "failed to open file " << file.name()
+				<< snf::log::record::endl;
+			return retval;
+		}
+
+		size_t first = 0;
+		for (int h : report->damagedBuckets) {
+			while ((first < keys.size()) && (keys[first].hash < h))
+				++first;
+
+			size_t next = first;
+			while ((next < keys.size()) && (keys[next].hash == h))
+				++next;
+
+			retval = writeBucket(file, h, keys.data() + first, keys.data() + next, spare, end);
+			if (retval != E_ok)
+				return retval;
+
+			LOG_DEBUG("RdbChecker", "rebuilt hash table entry %d with %d keys",
+				h, int(next - first));
+
+			report->repairedBuckets++;
+			report->recoveredKeys += int64_t(next - first);
+			first = next;
+		}
+
+		// the key pages left over are deleted
+		std::vector<char> buf(kpSize);
+		key_page_t *kp = reinterpret_cast<key_page_t *>(buf.data());
+		InitKeyPage(kp, kpSize);
+		kp->kp_flags = KPAGE_DELETED;
+		SetKeyPageChecksum(kp, kpSize);
+
+		for (int64_t off : spare) {
+			int bWritten = 0;
+			retval = file.write(off, kp, kpSize, &bWritten, &oserr);
+			if ((retval == E_ok) && (bWritten != kpSize))
+				retval = E_write_failed;
+			if (retval != E_ok) {
+				ERROR_STRM("RdbChecker", oserr)
+					<< "failed to delete key page " << off
+					<< " in file " << file.name()
+					<< snf::log::record::endl;
+				return retval;
+			}
+		}
+
+		// derived from the old key pages
+		const char *derived[] = { ".oix", ".hti", ".warm" };
+		for (const char *ext : derived) {
+			std::string fname = fileName(ext);
+			if (snf::fs::exists(fname.c_str()))
+				snf::fs::remove_file(fname.c_str());
+		}
+	}
+
+	retval = freeValuePages(freed);
+	if (retval == E_ok)
+		retval = writeFreeList();
+
+	return retval;
+}
+
+/**
+ * Checks the integrity of the database, and optionally repairs
+ * it. The database must not be open.
+ *
+ * @param [out] rpt    - check report.
+ * @param [in]  repair - repair the problems found?
+ *
+ * @return E_ok on success (even if problems are found; see
+ * RdbCheckReport::clean()), -ve error code on failure.
+ */
+int
+RdbChecker::check(RdbCheckReport &rpt, bool repair)
+{
+	int         retval = E_ok;
+	int         oserr = 0;
+	std::string attrPath = fileName(".attr");
+	std::string idxPath = fileName(".idx");
+	std::string dbPath = fileName(".db");
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	rpt.clear();
+	report = &rpt;
+
+	if (!snf::fs::exists(attrPath.c_str()) ||
+		!snf::fs::exists(idxPath.c_str()) ||
+		!snf::fs::exists(dbPath.c_str())) {
+		LOG_ERROR("RdbChecker", "database %s not found in %s", name.c_str(), path.c_str());
+		return E_not_found;
+	}
+
+	{
+		AttrFile attrFile(attrPath.c_str(), 0022);
+		retval = attrFile.open(true);
+		if (retval == E_ok)
+			retval = attrFile.read();
+		if (retval != E_ok)
+			return retval;
+
+		if (attrFile.getVersion() != RDB_FORMAT_VERSION) {
+			LOG_ERROR("RdbChecker", "database %s is of format version %d; open it for writing to upgrade",
+				name.c_str(), attrFile.getVersion());
+			return E_mismatch;
+		}
+
+		kpSize = attrFile.getKeyPageSize();
+		htSize = attrFile.getHashTableSize();
+	}
+
+	if ((NUM_OF_KEYS_IN_PAGE(kpSize) <= 0) || (htSize <= 0)) {
+		LOG_ERROR("RdbChecker", "invalid key page size (%d) or hash table size (%d)",
+			kpSize, htSize);
+		return E_mismatch;
+	}
+
+	{
+		snf::file idxFile(idxPath, 0022);
+		snf::file dbFile(dbPath, 0022);
+		snf::file::open_flags oflags;
+		oflags.o_read = true;
+
+		if (((retval = idxFile.open(oflags, 0600, &oserr)) != E_ok) ||
+			((retval = dbFile.open(oflags, 0600, &oserr)) != E_ok)) {
+			ERROR_STRM("RdbChecker", oserr)
+				<< "failed to open the files of database " << name
+				<< snf::log::record::endl;
+			return retval;
+		}
+
+		idxSize = idxFile.size(&oserr);
+		dbSize = dbFile.size(&oserr);
+		if ((idxSize < 0) || (dbSize < 0))
+			return E_stat_failed;
+
+		dbSize -= dbSize % VPAGE_SIZE;
+	}
+
+	pages.clear();
+	refs.clear();
+	orphans.clear();
+	damaged.assign(size_t(htSize), 0);
+
+	retval = checkKeyPages();
+	if (retval == E_ok) {
+		checkChains();
+		retval = checkValues();
+	}
+
+	if (retval == E_ok)
+		retval = checkFreeList();
+
+	if (retval == E_ok) {
+		for (int h = 0; h < htSize; ++h) {
+			if (damaged[h])
+				rpt.damagedBuckets.push_back(h);
+		}
+
+		LOG_INFO("RdbChecker", "checked %s: %" PRId64 " keys, %" PRId64
+			" problems, %d damaged hash table entries in %d ms",
+			name.c_str(), rpt.keys, rpt.problemCount(), int(rpt.damagedBuckets.size()),
+			int(std::chrono::duration_cast<std::chrono::milliseconds>(
+				std::chrono::steady_clock::now() - start).count()));
+
+		if (repair && !rpt.clean()) {
+			retval = this->repair();
+			LOG_INFO("RdbChecker", "repaired %s: %" PRId64 " hash table entries rebuilt with %"
+				PRId64 " keys, %" PRId64 " value pages freed (status %d)",
+				name.c_str(), rpt.repairedBuckets, rpt.recoveredKeys,
+				rpt.freedValuePages, retval);
+		}
+	}
+
+	pages.clear();
+	refs.clear();
+	freeList.clear();
+	orphans.clear();
+	vstate.clear();
+	damaged.clear();
+	report = 0;
+
+	return retval;
+}
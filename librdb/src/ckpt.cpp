@@ -0,0 +1,138 @@
+#include "ckpt.h"
+#include "logmgr.h"
+#include "error.h"
+
+/**
+ * Constructs the page copier.
+ *
+ * @param [in] source   - database file to copy.
+ * @param [in] target   - checkpoint file.
+ * @param [in] pageSize - page size of the database file. The
+ *                        copy block size is rounded down to a
+ *                        multiple of it.
+ * @param [in] limit    - size of the database file at the start
+ *                        of the checkpoint.
+ */
+PageCopier::PageCopier(snf::file *source, snf::file *target, int pageSize, int64_t limit)
+	: source(source),
+	  target(target),
+	  limit(limit),
+	  error(E_ok)
+{
+	blockSize = (CKPT_BLOCK_SIZE / pageSize) * pageSize;
+	if (blockSize < pageSize)
+		blockSize = pageSize;
+
+	int64_t nblocks = (limit + blockSize - 1) / blockSize;
+	copied.assign(size_t(nblocks), false);
+
+	buf = DBG_NEW char[blockSize];
+}
+
+/**
+ * Destroys the page copier.
+ */
+PageCopier::~PageCopier()
+{
+	delete [] buf;
+}
+
+/*
+ * Copies the block from the source to the target.
+ *
+ * @param [in] idx - block index.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+PageCopier::copy(int64_t idx)
+{
+	int     retval = E_ok;
+	int     oserr = 0;
+	int     bRead = 0;
+	int     bWritten = 0;
+	int64_t offset = idx * blockSize;
+	int     toCopy = blockSize;
+
+	if ((offset + toCopy) > limit)
+		toCopy = int(limit - offset);
+
+	retval = source->read(offset, buf, toCopy, &bRead, &oserr);
+	if (retval != E_ok) {
+		ERROR_STRM("PageCopier", oserr)
+			<< "failed to read file " << source->name()
+			<< " at offset " << offset
+			<< snf::log::record::endl;
+		return retval;
+	}
+
+	if (bRead > 0) {
+		retval = target->write(offset, buf, bRead, &bWritten, &oserr);
+		if (retval != E_ok) {
+			ERROR_STRM("PageCopier", oserr)
+				<< "failed to write file " << target->name()
+				<< " at offset " << offset
+				<< snf::log::record::endl;
+			return retval;
+		} else if (bWritten != bRead) {
+			ERROR_STRM("PageCopier")
+				<< "expected to write " << bRead
+				<< " bytes, wrote only " << bWritten << " bytes"
+				<< snf::log::record::endl;
+			return E_write_failed;
+		}
+	}
+
+	if (retval == E_ok)
+		copied[size_t(idx)] = true;
+	return retval;
+}
+
+/**
+ * Copies the block at the specified index, unless it is
+ * already copied.
+ *
+ * @param [in] idx - block index.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+PageCopier::copyBlock(int64_t idx)
+{
+	if ((idx < 0) || (idx >= numberOfBlocks()))
+		return E_invalid_arg;
+
+	if (error != E_ok)
+		return error;
+
+	if (copied[size_t(idx)])
+		return E_ok;
+
+	error = copy(idx);
+	return error;
+}
+
+/**
+ * Preserves the blocks that are about to be modified. Must
+ * be called before writing to the source file.
+ *
+ * @param [in] offset - source file offset to be written.
+ * @param [in] len    - number of bytes to be written.
+ */
+void
+PageCopier::preserve(int64_t offset, int len)
+{
+	if ((error != E_ok) || (len <= 0) || (offset >= limit))
+		return;
+
+	int64_t first = offset / blockSize;
+	int64_t last = (offset + len - 1) / blockSize;
+
+	if (last >= numberOfBlocks())
+		last = numberOfBlocks() - 1;
+
+	for (int64_t idx = first; (error == E_ok) && (idx <= last); ++idx) {
+		if (!copied[size_t(idx)])
+			error = copy(idx);
+	}
+}
@@ -0,0 +1,486 @@
+#include <atomic>
+#include <memory>
+#include <thread>
+#include "cluster.h"
+#include "filesystem.h"
+#include "logmgr.h"
+#include "error.h"
+
+/*
+ * Hash function (32-bit FNV-1a) routing the keys to the
+ * shards. It must not be the one used for the hash table
+ * within the shard: with the same hash, the keys of a shard
+ * would all share the same remainder and fill only a part
+ * of its hash table.
+ */
+static uint32_t
+ShardHash(const char *key, int klen)
+{
+	uint32_t h = 2166136261U;
+
+	for (int i = 0; i < klen; ++i) {
+		h ^= uint8_t(key[i]);
+		h *= 16777619U;
+	}
+
+	return h;
+}
+
+/*
+ * Creates the shards.
+ */
+void
+RdbCluster::init(
+	const std::vector<std::string> &paths,
+	const std::string &name,
+	int kpsize,
+	int htsize,
+	const RdbOptions &opt)
+{
+	ASSERT(!paths.empty(), "RdbCluster", 0, "no shard paths specified");
+
+	this->name = name;
+	this->options = opt;
+	this->opened = false;
+
+	for (const std::string &path : paths)
+		shards.push_back(DBG_NEW Rdb(path, name, kpsize, htsize, opt));
+}
+
+/**
+ * Destroys the cluster, closing the shards.
+ */
+RdbCluster::~RdbCluster()
+{
+	close();
+
+	for (Rdb *rdb : shards)
+		delete rdb;
+	shards.clear();
+}
+
+/**
+ * Gets the shard the key is routed to.
+ *
+ * @param [in] key  - database key.
+ * @param [in] klen - database key length.
+ *
+ * @return the shard number, -1 if the key is invalid.
+ */
+int
+RdbCluster::getShardIndex(const char *key, int klen) const
+{
+	if ((key == 0) || (*key == '\0') || (klen <= 0)) {
+		LOG_ERROR("RdbCluster", "invalid key specified");
+		return -1;
+	}
+
+	return int(ShardHash(key, klen) % uint32_t(shards.size()));
+}
+
+/*
+ * Checks, or records if the shard is new, the position of the
+ * shard in the cluster. Creates the shard directory if it
+ * does not exist.
+ *
+ * @param [in] shard - shard number.
+ *
+ * @return E_ok on success, E_mismatch if the shard belongs
+ * to another position or cluster size, -ve error code on
+ * failure.
+ */
+int
+RdbCluster::checkShard(int shard)
+{
+	int     retval = E_ok;
+	int     oserr = 0;
+	char    shardPath[MAXPATHLEN + 1];
+	Rdb     *rdb = shards[shard];
+
+	if (!options.readOnly()) {
+		retval = snf::fs::mkdir(rdb->getPath(), 0700, &oserr);
+		if (retval != E_ok) {
+			LOG_SYSERR("RdbCluster", oserr, "failed to create directory %s",
+				rdb->getPath());
+			return retval;
+		}
+	}
+
+	snprintf(shardPath, MAXPATHLEN, "%s%c%s.shard",
+		rdb->getPath(), snf::pathsep(), name.c_str());
+
+	std::unique_ptr<ShardFile> shardFile(DBG_NEW ShardFile(shardPath, 0022));
+	retval = shardFile->open(options.readOnly());
+	if (retval != E_ok) {
+		return retval;
+	}
+
+	retval = shardFile->read();
+	if ((retval == E_eof_detected) && !options.readOnly()) {
+		shardFile->setShard(shard);
+		shardFile->setShardCount(getShardCount());
+		retval = shardFile->write();
+	} else if (retval == E_ok) {
+		if ((shardFile->getShard() != shard) ||
+			(shardFile->getShardCount() != getShardCount())) {
+			LOG_ERROR("RdbCluster",
+				"%s is shard %d of %d, not shard %d of %d",
+				rdb->getPath(),
+				shardFile->getShard(), shardFile->getShardCount(),
+				shard, getShardCount());
+			retval = E_mismatch;
+		}
+	}
+
+	shardFile->close();
+
+	return retval;
+}
+
+/*
+ * Calls the function for every shard, in parallel.
+ *
+ * @param [in] func - function to call with the shard
+ *                    number and the shard.
+ *
+ * @return E_ok if the function succeeds for every shard,
+ * the first -ve error code (in shard order) otherwise.
+ */
+int
+RdbCluster::forEachShard(const std::function<int(int, Rdb *)> &func)
+{
+	std::vector<int>            status(shards.size(), E_ok);
+	std::vector<std::thread>    threads;
+
+	for (size_t i = 1; i < shards.size(); ++i) {
+		threads.push_back(std::thread([this, i, &func, &status] () {
+			status[i] = func(int(i), shards[i]);
+		}));
+	}
+
+	// The first shard is done in the calling thread
+	status[0] = func(0, shards[0]);
+
+	for (std::thread &t : threads)
+		t.join();
+
+	for (int s : status) {
+		if (s != E_ok)
+			return s;
+	}
+
+	return E_ok;
+}
+
+/**
+ * Opens the cluster, opening the shards in parallel. If a
+ * shard fails to open, the ones opened are closed.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+RdbCluster::open()
+{
+	int retval = E_ok;
+
+	std::lock_guard<std::mutex> guard(openMutex);
+	if (opened) {
+		return E_ok;
+	}
+
+	retval = forEachShard([this] (int shard, Rdb *rdb) {
+		int retval = checkShard(shard);
+		if (retval == E_ok)
+			retval = rdb->open();
+		return retval;
+	});
+
+	if (retval != E_ok) {
+		forEachShard([] (int, Rdb *rdb) { return rdb->close(); });
+	} else {
+		opened = true;
+	}
+
+	return retval;
+}
+
+/**
+ * Gets the value for the key. See Rdb::get().
+ *
+ * @return E_ok on success, E_not_found if the value is not
+ * found (or is expired), -ve error code on failure.
+ */
+int
+RdbCluster::get(const char *key, int klen, char *value, int *vlen)
+{
+	int shard = getShardIndex(key, klen);
+	if (shard < 0) {
+		return E_invalid_arg;
+	}
+
+	return shards[shard]->get(key, klen, value, vlen);
+}
+
+/**
+ * Sets the key/value pair. See Rdb::set().
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+RdbCluster::set(const char *key, int klen, const char *value, int vlen, Updater *updater)
+{
+	int shard = getShardIndex(key, klen);
+	if (shard < 0) {
+		return E_invalid_arg;
+	}
+
+	return shards[shard]->set(key, klen, value, vlen, updater);
+}
+
+/**
+ * Sets the key/value pair with time to live. See
+ * Rdb::setWithTTL().
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+RdbCluster::setWithTTL(const char *key, int klen, const char *value, int vlen,
+	int ttl, Updater *updater)
+{
+	int shard = getShardIndex(key, klen);
+	if (shard < 0) {
+		return E_invalid_arg;
+	}
+
+	return shards[shard]->setWithTTL(key, klen, value, vlen, ttl, updater);
+}
+
+/**
+ * Sets the time to live of the key. See Rdb::expire().
+ *
+ * @return E_ok on success, E_not_found if the key is not
+ * found, -ve error code on failure.
+ */
+int
+RdbCluster::expire(const char *key, int klen, int ttl)
+{
+	int shard = getShardIndex(key, klen);
+	if (shard < 0) {
+		return E_invalid_arg;
+	}
+
+	return shards[shard]->expire(key, klen, ttl);
+}
+
+/**
+ * Increments the counter. See Rdb::increment().
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+RdbCluster::increment(const char *key, int klen, int64_t delta, int64_t *newval)
+{
+	int shard = getShardIndex(key, klen);
+	if (shard < 0) {
+		return E_invalid_arg;
+	}
+
+	return shards[shard]->increment(key, klen, delta, newval);
+}
+
+/**
+ * Sets the value if the current value is the expected one.
+ * See Rdb::compareAndSet().
+ *
+ * @return E_ok on success, E_mismatch if the current value
+ * is not the expected one, -ve error code on failure.
+ */
+int
+RdbCluster::compareAndSet(const char *key, int klen,
+	const char *expected, int elen,
+	const char *desired, int dlen)
+{
+	int shard = getShardIndex(key, klen);
+	if (shard < 0) {
+		return E_invalid_arg;
+	}
+
+	return shards[shard]->compareAndSet(key, klen, expected, elen, desired, dlen);
+}
+
+/**
+ * Removes the key. See Rdb::remove().
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+RdbCluster::remove(const char *key, int klen)
+{
+	int shard = getShardIndex(key, klen);
+	if (shard < 0) {
+		return E_invalid_arg;
+	}
+
+	return shards[shard]->remove(key, klen);
+}
+
+/*
+ * Visits the keys of a shard scan. The scan stops when the
+ * visitor fails or another shard's scan fails.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+static int
+VisitScan(int shard, RdbIterator &iter, const RdbScanVisitor &visitor,
+	std::atomic<bool> &stop)
+{
+	int     retval = E_ok;
+	int     klen;
+	int     vlen;
+	char    key[MAX_KEY_LENGTH];
+	char    value[MAX_VALUE_LENGTH];
+
+	while (!stop.load(std::memory_order_relaxed)) {
+		klen = int(sizeof(key));
+		vlen = int(sizeof(value));
+
+		retval = iter.next(key, &klen, value, &vlen);
+		if (retval == E_eof_detected) {
+			retval = E_ok;
+			break;
+		}
+
+		if (retval == E_ok) {
+			retval = visitor(shard, key, klen, value, vlen);
+		}
+
+		if (retval != E_ok) {
+			stop.store(true, std::memory_order_relaxed);
+			break;
+		}
+	}
+
+	return retval;
+}
+
+/**
+ * Scans the keys starting with the prefix, all the shards
+ * in parallel. The keys of a shard are visited in key order
+ * but the visitor is called concurrently for the different
+ * shards. The shards must have the ordered index enabled.
+ *
+ * @param [in] prefix  - key prefix.
+ * @param [in] plen    - key prefix length.
+ * @param [in] visitor - called for every key.
+ *
+ * @return E_ok on success, -ve error code on failure, or
+ * the error returned by the visitor.
+ */
+int
+RdbCluster::scanPrefix(const char *prefix, int plen, const RdbScanVisitor &visitor)
+{
+	std::atomic<bool> stop(false);
+
+	return forEachShard([&] (int shard, Rdb *rdb) {
+		RdbIterator iter;
+		int retval = rdb->scanPrefix(prefix, plen, iter);
+		if (retval == E_ok)
+			retval = VisitScan(shard, iter, visitor, stop);
+		return retval;
+	});
+}
+
+/**
+ * Scans the keys in the range [from, to), all the shards in
+ * parallel. See RdbCluster::scanPrefix().
+ *
+ * @param [in] from    - start key, 0 for the first key.
+ * @param [in] flen    - start key length.
+ * @param [in] to      - end key (excluded), 0 for none.
+ * @param [in] tlen    - end key length.
+ * @param [in] visitor - called for every key.
+ *
+ * @return E_ok on success, -ve error code on failure, or
+ * the error returned by the visitor.
+ */
+int
+RdbCluster::scanRange(const char *from, int flen, const char *to, int tlen,
+	const RdbScanVisitor &visitor)
+{
+	std::atomic<bool> stop(false);
+
+	return forEachShard([&] (int shard, Rdb *rdb) {
+		RdbIterator iter;
+		int retval = rdb->scanRange(from, flen, to, tlen, iter);
+		if (retval == E_ok)
+			retval = VisitScan(shard, iter, visitor, stop);
+		return retval;
+	});
+}
+
+/**
+ * Rebuilds the shards in parallel. See Rdb::rebuild(). The
+ * cluster must not be in use for this operation.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+RdbCluster::rebuild()
+{
+	return forEachShard([] (int, Rdb *rdb) { return rdb->rebuild(); });
+}
+
+/**
+ * Gets the statistics of the shards, in parallel, and their
+ * totals. See Rdb::getStats().
+ *
+ * @param [out] stats      - totals of all the shards.
+ * @param [out] shardStats - statistics of every shard, if
+ *                           not 0.
+ * @param [in]  scan       - scan the key pages?
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+RdbCluster::getStats(RdbStats &stats, std::vector<RdbStats> *shardStats, bool scan)
+{
+	std::vector<RdbStats> all(shards.size());
+
+	int retval = forEachShard([&all, scan] (int shard, Rdb *rdb) {
+		return rdb->getStats(all[shard], scan);
+	});
+
+	if (retval == E_ok) {
+		stats.clear();
+		for (const RdbStats &s : all)
+			stats.add(s);
+
+		if (shardStats)
+			shardStats->swap(all);
+	}
+
+	return retval;
+}
+
+/**
+ * Closes the cluster, closing the shards in parallel.
+ *
+ * @return E_ok on success, -ve error code on failure. On
+ * E_try_again (operations in progress on a shard), the
+ * call can be retried.
+ */
+int
+RdbCluster::close()
+{
+	std::lock_guard<std::mutex> guard(openMutex);
+	if (!opened) {
+		return E_ok;
+	}
+
+	int retval = forEachShard([] (int, Rdb *rdb) { return rdb->close(); });
+	if (retval == E_ok) {
+		opened = false;
+	}
+
+	return retval;
+}
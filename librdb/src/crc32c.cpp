@@ -0,0 +1,167 @@
+#include <cstring>
+#include "crc32c.h"
+
+#if defined(_M_X64)
+#include <intrin.h>
+#include <nmmintrin.h>
+#define CRC32C_SSE42
+#elif defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+#define CRC32C_SSE42
+#define CRC32C_TARGET   __attribute__((target("sse4.2")))
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define CRC32C_ARMV8
+#endif
+
+#if !defined(CRC32C_TARGET)
+#define CRC32C_TARGET
+#endif
+
+typedef uint32_t (*crc32c_fn_t)(uint32_t, const unsigned char *, size_t);
+
+/* Lookup table of the reflected polynomial 0x82F63B78 */
+struct crc32c_table
+{
+	uint32_t    entries[256];
+
+	crc32c_table()
+	{
+		for (uint32_t i = 0; i < 256; ++i) {
+			uint32_t c = i;
+			for (int j = 0; j < 8; ++j)
+				c = (c & 1) ? ((c >> 1) ^ 0x82F63B78U) : (c >> 1);
+			entries[i] = c;
+		}
+	}
+};
+
+/*
+ * Computes the checksum a byte at a time using the
+ * lookup table.
+ */
+static uint32_t
+Crc32cTable(uint32_t crc, const unsigned char *p, size_t len)
+{
+	static const crc32c_table table;
+
+	while (len-- > 0)
+		crc = table.entries[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+
+	return crc;
+}
+
+#if defined(CRC32C_SSE42)
+
+/*
+ * Computes the checksum 8 bytes at a time using the SSE4.2
+ * crc32 instruction.
+ */
+CRC32C_TARGET static uint32_t
+Crc32cSse42(uint32_t crc, const unsigned char *p, size_t len)
+{
+	uint64_t c = crc;
+	uint64_t v;
+
+	for (; (len > 0) && ((uintptr_t(p) & 7) != 0); --len)
+		c = _mm_crc32_u8(uint32_t(c), *p++);
+
+	for (; len >= 8; len -= 8, p += 8) {
+		memcpy(&v, p, sizeof(v));
+		c = _mm_crc32_u64(c, v);
+	}
+
+	for (; len > 0; --len)
+		c = _mm_crc32_u8(uint32_t(c), *p++);
+
+	return uint32_t(c);
+}
+
+/*
+ * Does the processor support SSE4.2?
+ */
+static bool
+HasSse42()
+{
+#if defined(_M_X64)
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 20)) != 0;
+#else
+	return __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+#elif defined(CRC32C_ARMV8)
+
+/*
+ * Computes the checksum 8 bytes at a time using the ARMv8
+ * crc32c instructions.
+ */
+static uint32_t
+Crc32cArmv8(uint32_t crc, const unsigned char *p, size_t len)
+{
+	uint64_t v;
+
+	for (; (len > 0) && ((uintptr_t(p) & 7) != 0); --len)
+		crc = __crc32cb(crc, *p++);
+
+	for (; len >= 8; len -= 8, p += 8) {
+		memcpy(&v, p, sizeof(v));
+		crc = __crc32cd(crc, v);
+	}
+
+	for (; len > 0; --len)
+		crc = __crc32cb(crc, *p++);
+
+	return crc;
+}
+
+#endif
+
+/*
+ * Selects the checksum implementation for the processor.
+ */
+static crc32c_fn_t
+SelectCrc32c()
+{
+#if defined(CRC32C_SSE42)
+	if (HasSse42())
+		return Crc32cSse42;
+#elif defined(CRC32C_ARMV8)
+	return Crc32cArmv8;
+#endif
+	return Crc32cTable;
+}
+
+static crc32c_fn_t
+GetCrc32c()
+{
+	static const crc32c_fn_t fn = SelectCrc32c();
+	return fn;
+}
+
+/**
+ * Computes the CRC32C checksum of the buffer.
+ *
+ * @param [in] buf - buffer.
+ * @param [in] len - buffer length.
+ * @param [in] crc - checksum of the preceding data; 0 to start.
+ *
+ * @return the checksum.
+ */
+uint32_t
+Crc32c(const void *buf, size_t len, uint32_t crc)
+{
+	return ~GetCrc32c()(~crc, static_cast<const unsigned char *>(buf), len);
+}
+
+/**
+ * Is the checksum computed using the processor's CRC32
+ * instructions?
+ */
+bool
+Crc32cAccelerated()
+{
+	return GetCrc32c() != Crc32cTable;
+}
@@ -4,20 +4,21 @@
 #include "error.h"
 
 /*
- * Opens the database file.
+ * Opens the database file. The file is created if it does
+ * not exist, unless it is opened read-only.
  *
  * @return E_ok on success, -ve error code on failure.
  */
 static int
-OpenFile(snf::file *file, bool sync = false)
+OpenFile(snf::file *file, bool sync = false, bool rdonly = false)
 {
 	int                  retval = E_ok;
 	int                  oserr = 0;
 	snf::file::open_flags oflags;
 
 	oflags.o_read = true;
-	oflags.o_write = true;
-	oflags.o_create = true;
+	oflags.o_write = !rdonly;
+	oflags.o_create = !rdonly;
 	if (sync)
 		oflags.o_sync = true;
 
@@ -94,26 +95,353 @@ WriteFile(snf::file *file, int64_t offset, const void *buf, int toWrite)
 	return retval;
 }
 
+/**
+ * Writes the database file, preserving the pages about to be
+ * overwritten if a checkpoint is in progress.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+static int
+WriteFile(snf::file *file, PageCopier *copier, int64_t offset, const void *buf, int toWrite)
+{
+	if (copier)
+		copier->preserve(offset, toWrite);
+
+	return WriteFile(file, offset, buf, toWrite);
+}
+
+/**
+ * Copies the block to the checkpoint file unless it is
+ * already copied.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+static int
+CopyBlock(PageCopier *copier, int64_t idx)
+{
+	if (copier == 0) {
+		ERROR_STRM(nullptr)
+			<< "checkpoint page copier is not set"
+			<< snf::log::record::endl;
+		return E_invalid_state;
+	}
+
+	return copier->copyBlock(idx);
+}
+
+/**
+ * Destroys the database file object.
+ */
+DbFile::~DbFile()
+{
+	if (abuf) {
+		FreeAligned(abuf);
+		abuf = 0;
+	}
+}
+
+/*
+ * Is the I/O request aligned for direct I/O?
+ */
+static bool
+IsAligned(int64_t offset, const void *buf, int len)
+{
+	return (((offset % DIRECT_IO_ALIGNMENT) == 0) &&
+		((len % DIRECT_IO_ALIGNMENT) == 0) &&
+		((reinterpret_cast<uintptr_t>(buf) % DIRECT_IO_ALIGNMENT) == 0));
+}
+
+/*
+ * Makes sure that the bounce buffer is at least of the
+ * specified size.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+DbFile::getBuffer(int len)
+{
+	if (len > abufSize) {
+		if (abuf)
+			FreeAligned(abuf);
+
+		abuf = static_cast<char *>(AllocAligned(len));
+		if (abuf == 0) {
+			abufSize = 0;
+			ERROR_STRM("DbFile")
+				<< "failed to allocate " << len
+				<< " bytes of aligned memory"
+				<< snf::log::record::endl;
+			return E_no_memory;
+		}
+
+		abufSize = len;
+	}
+
+	return E_ok;
+}
+
+/*
+ * Reads the aligned blocks around the request into the
+ * bounce buffer and copies the requested bytes out.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+DbFile::alignedRead(int64_t offset, void *buf, int toRead, int *bRead, int *oserr)
+{
+	int     retval;
+	int     got = 0;
+	int64_t start = offset - (offset % DIRECT_IO_ALIGNMENT);
+	int64_t end = offset + toRead;
+	int     skip = int(offset - start);
+
+	if ((end % DIRECT_IO_ALIGNMENT) != 0)
+		end += DIRECT_IO_ALIGNMENT - (end % DIRECT_IO_ALIGNMENT);
+
+	*bRead = 0;
+
+	retval = getBuffer(int(end - start));
+	if (retval != E_ok)
+		return retval;
+
+	retval = snf::file::read(start, abuf, int(end - start), &got, oserr);
+	if ((retval == E_ok) && (got > skip)) {
+		*bRead = ((got - skip) < toRead) ? (got - skip) : toRead;
+		memcpy(buf, abuf + skip, *bRead);
+	}
+
+	return retval;
+}
+
+/*
+ * Reads the aligned blocks around the request into the
+ * bounce buffer (unless the request covers them fully),
+ * patches in the bytes to write, and writes the blocks
+ * back. If the blocks extend the file beyond the last byte
+ * written, the file is truncated back.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+DbFile::alignedWrite(int64_t offset, const void *buf, int toWrite, int *bWritten, int *oserr)
+{
+	int     retval;
+	int     done = 0;
+	int64_t start = offset - (offset % DIRECT_IO_ALIGNMENT);
+	int64_t end = offset + toWrite;
+	int     skip = int(offset - start);
+	int     len;
+
+	if ((end % DIRECT_IO_ALIGNMENT) != 0)
+		end += DIRECT_IO_ALIGNMENT - (end % DIRECT_IO_ALIGNMENT);
+	len = int(end - start);
+
+	*bWritten = 0;
+
+	retval = getBuffer(len);
+	if (retval != E_ok)
+		return retval;
+
+	if ((skip != 0) || (len != toWrite)) {
+		retval = snf::file::read(start, abuf, len, &done, oserr);
+		if (retval != E_ok)
+			return retval;
+		if (done < len)
+			memset(abuf + done, 0, len - done);
+	}
+
+	memcpy(abuf + skip, buf, toWrite);
+
+	retval = snf::file::write(start, abuf, len, &done, oserr);
+	if (retval == E_ok) {
+		if (done > skip)
+			*bWritten = ((done - skip) < toWrite) ? (done - skip) : toWrite;
+
+		if (end > fsize) {
+			int64_t last = offset + *bWritten;
+			if (last < fsize)
+				last = fsize;
+			retval = snf::file::truncate(last, oserr);
+			if (retval == E_ok)
+				fsize = last;
+		}
+	}
+
+	return retval;
+}
+
+/**
+ * Opens the database file.
+ *
+ * @param [in] sync   - sync the file on every write?
+ * @param [in] direct - open the file for direct I/O? If the
+ *                      file system does not support direct
+ *                      I/O, the file is opened for buffered
+ *                      I/O.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+DbFile::open(bool sync, bool direct)
+{
+	int                  retval = E_ok;
+	int                  oserr = 0;
+	snf::file::open_flags oflags;
+
+	oflags.o_read = true;
+	oflags.o_write = true;
+	oflags.o_create = true;
+	oflags.o_sync = sync;
+	oflags.o_direct = direct;
+
+	retval = snf::file::open(oflags, 0600, &oserr);
+	if ((retval != E_ok) && direct) {
+		WARNING_STRM("DbFile", oserr)
+			<< "failed to open file " << name()
+			<< " for direct I/O; retrying with buffered I/O"
+			<< snf::log::record::endl;
+		oflags.o_direct = false;
+		direct = false;
+		retval = snf::file::open(oflags, 0600, &oserr);
+	}
+
+	if (retval != E_ok) {
+		ERROR_STRM("DbFile", oserr)
+			<< "failed to open file " << name()
+			<< snf::log::record::endl;
+	} else {
+		this->direct = direct;
+		this->synced = sync;
+		if (direct) {
+			fsize = size(&oserr);
+			if (fsize < 0) {
+				ERROR_STRM("DbFile", oserr)
+					<< "failed to get size of file " << name()
+					<< snf::log::record::endl;
+				retval = int(fsize);
+			}
+		}
+	}
+
+	return retval;
+}
+
+/**
+ * Reads from the file starting at the specified offset.
+ * With direct I/O, an unaligned request is served from
+ * the aligned bounce buffer.
+ *
+ * @param [in]  offset - Starting read offset.
+ * @param [out] buf    - Buffer to read the data into.
+ * @param [in]  toRead - Number of bytes to read.
+ * @param [out] bRead  - Number of bytes read.
+ * @param [out] oserr  - OS error code.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+DbFile::read(int64_t offset, void *buf, int toRead, int *bRead, int *oserr)
+{
+	reads.add();
+
+	if (direct && (buf != 0) && (toRead > 0) && (bRead != 0) &&
+		!IsAligned(offset, buf, toRead)) {
+		if (oserr) *oserr = 0;
+		return alignedRead(offset, buf, toRead, bRead, oserr);
+	}
+
+	return snf::file::read(offset, buf, toRead, bRead, oserr);
+}
+
+/**
+ * Writes to the file starting at the specified offset.
+ * With direct I/O, an unaligned request is written using
+ * the aligned bounce buffer.
+ *
+ * @param [in]  offset   - Starting write offset.
+ * @param [in]  buf      - Buffer to write.
+ * @param [in]  toWrite  - Number of bytes to write.
+ * @param [out] bWritten - Number of bytes written.
+ * @param [out] oserr    - OS error code.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+DbFile::write(int64_t offset, const void *buf, int toWrite, int *bWritten, int *oserr)
+{
+	int retval;
+
+	writes.add();
+
+	if (!direct)
+		return snf::file::write(offset, buf, toWrite, bWritten, oserr);
+
+	if ((buf != 0) && (toWrite > 0) && (bWritten != 0) &&
+		!IsAligned(offset, buf, toWrite)) {
+		if (oserr) *oserr = 0;
+		return alignedWrite(offset, buf, toWrite, bWritten, oserr);
+	}
+
+	retval = snf::file::write(offset, buf, toWrite, bWritten, oserr);
+	if ((retval == E_ok) && ((offset + *bWritten) > fsize))
+		fsize = offset + *bWritten;
+
+	return retval;
+}
+
+/**
+ * Truncates the file to the specified size.
+ *
+ * @param [in]  size  - New file size.
+ * @param [out] oserr - OS error code.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+DbFile::truncate(int64_t size, int *oserr)
+{
+	int retval = snf::file::truncate(size, oserr);
+	if (retval == E_ok)
+		fsize = size;
+	return retval;
+}
+
 /**
  * Opens the database attributes file.
  *
+ * @param [in] rdonly - open the file read-only?
+ *
  * @return E_ok on success, -ve error code on failure.
  */
 int
-AttrFile::open()
+AttrFile::open(bool rdonly)
 {
-	return OpenFile(this);
+	return OpenFile(this, false, rdonly);
 }
 
 /**
- * Reads database attributes from the file.
+ * Reads database attributes from the file. The attributes
+ * written without the format version are of version 1.
  *
  * @return E_ok on success, -ve error code on failure.
  */
 int
 AttrFile::read()
 {
-	return ReadFile(this, 0L, &dbAttr, int(sizeof(dbAttr)));
+	const int   vOffset = int(offsetof(dbattr_t, a_version));
+	int         retval;
+
+	retval = ReadFile(this, 0L, &dbAttr, vOffset);
+	if (retval == E_ok) {
+		retval = ReadFile(this, int64_t(vOffset), &dbAttr.a_version,
+				int(sizeof(dbAttr)) - vOffset);
+		if (retval == E_eof_detected) {
+			dbAttr.a_version = 1;
+			retval = E_ok;
+		}
+	}
+
+	return retval;
 }
 
 /**
@@ -127,35 +455,225 @@ AttrFile::write()
 	return WriteFile(this, 0L, &dbAttr, int(sizeof(dbAttr)));
 }
 
+/**
+ * Opens the shard attributes file.
+ *
+ * @param [in] rdonly - open the file read-only?
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+ShardFile::open(bool rdonly)
+{
+	return OpenFile(this, false, rdonly);
+}
+
+/**
+ * Reads shard attributes from the file.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+ShardFile::read()
+{
+	return ReadFile(this, 0L, &shardAttr, int(sizeof(shardAttr)));
+}
+
+/**
+ * Writes shard attributes to the file.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+ShardFile::write()
+{
+	return WriteFile(this, 0L, &shardAttr, int(sizeof(shardAttr)));
+}
+
+/**
+ * Opens the sequence file.
+ *
+ * @param [in] rdonly - open the file read-only?
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+SeqFile::open(bool rdonly)
+{
+	return OpenFile(this, false, rdonly);
+}
+
+/**
+ * Reads the sequence number from the file.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+SeqFile::read()
+{
+	return ReadFile(this, 0L, &seqAttr, int(sizeof(seqAttr)));
+}
+
+/**
+ * Writes the sequence number to the file.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+SeqFile::write()
+{
+	return WriteFile(this, 0L, &seqAttr, int(sizeof(seqAttr)));
+}
+
+/**
+ * Opens the warm-up manifest.
+ *
+ * @param [in] rdonly - open the file read-only?
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+WarmFile::open(bool rdonly)
+{
+	return OpenFile(this, false, rdonly);
+}
+
+/**
+ * Reads the key page offsets from the manifest.
+ *
+ * @param [in]  kpsize  - key page size of the database; a
+ *                        manifest of another page size is
+ *                        ignored.
+ * @param [out] offsets - key page offsets, the most recently
+ *                        used first.
+ *
+ * @return E_ok on success, E_mismatch if the manifest is not
+ * valid, -ve error code on failure.
+ */
+int
+WarmFile::read(int kpsize, std::vector<int64_t> &offsets)
+{
+	int         retval;
+	warmattr_t  warmAttr;
+
+	offsets.clear();
+
+	retval = ReadFile(this, 0L, &warmAttr, int(sizeof(warmAttr)));
+	if (retval != E_ok)
+		return retval;
+
+	if ((warmAttr.w_magic != WARM_MAGIC) ||
+		(warmAttr.w_kpsize != kpsize) ||
+		(warmAttr.w_count < 0)) {
+		LOG_WARNING("WarmFile", "ignoring invalid manifest %s", name());
+		return E_mismatch;
+	}
+
+	if (warmAttr.w_count > 0) {
+		offsets.resize(warmAttr.w_count);
+		retval = ReadFile(this, int64_t(sizeof(warmAttr)), offsets.data(),
+				warmAttr.w_count * int(sizeof(int64_t)));
+		if (retval != E_ok)
+			offsets.clear();
+	}
+
+	return retval;
+}
+
+/**
+ * Writes the key page offsets to the manifest.
+ *
+ * @param [in] kpsize  - key page size of the database.
+ * @param [in] offsets - key page offsets, the most recently
+ *                       used first.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+WarmFile::write(int kpsize, const std::vector<int64_t> &offsets)
+{
+	int         retval;
+	int         oserr = 0;
+	warmattr_t  warmAttr;
+
+	memset(&warmAttr, 0, sizeof(warmAttr));
+	warmAttr.w_magic = WARM_MAGIC;
+	warmAttr.w_kpsize = kpsize;
+	warmAttr.w_count = int(offsets.size());
+
+	retval = WriteFile(this, 0L, &warmAttr, int(sizeof(warmAttr)));
+	if ((retval == E_ok) && !offsets.empty()) {
+		retval = WriteFile(this, int64_t(sizeof(warmAttr)), offsets.data(),
+				warmAttr.w_count * int(sizeof(int64_t)));
+	}
+
+	if (retval == E_ok) {
+		retval = truncate(int64_t(sizeof(warmAttr)) + warmAttr.w_count * int64_t(sizeof(int64_t)), &oserr);
+		if (retval != E_ok) {
+			ERROR_STRM("WarmFile", oserr)
+				<< "failed to truncate file " << name()
+				<< snf::log::record::endl;
+		}
+	}
+
+	return retval;
+}
+
 /**
  * Opens the database key file.
  *
  * @return E_ok on success, -ve error code on failure.
  */
 int
-KeyFile::open(bool sync)
+KeyFile::open(bool sync, bool direct)
 {
-	return OpenFile(this, sync);
+	return DbFile::open(sync, direct);
 }
 
 /**
- * Reads key page at the given offset from the key file.
+ * Reads key pages at the given offset from the key file.
+ * If checksum verification is enabled, the pages read in
+ * full are verified against their checksums.
  *
  * @param [in]  offset - key file offset.
  * @param [out] buf    - key page buffer.
  * @param [in]  toRead - bytes to read.
  *
- * @return E_ok on success, -ve error code on failure.
+ * @return E_ok on success, E_checksum_failed if a page
+ * does not match its checksum, -ve error code on failure.
  */
 int
 KeyFile::read(int64_t offset, void *buf, int toRead)
 {
-	std::lock_guard<std::mutex> guard(mutex);
-	return ReadFile(this, offset, buf, toRead);
+	int retval = E_ok;
+
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		retval = ReadFile(this, offset, buf, toRead);
+	}
+
+	if ((retval != E_ok) || !verify || ((toRead % csumSize) != 0))
+		return retval;
+
+	for (int i = 0; i < toRead; i += csumSize) {
+		const key_page_t *kp =
+			reinterpret_cast<const key_page_t *>(static_cast<const char *>(buf) + i);
+
+		verified.add();
+		if (!IsKeyPageChecksumValid(kp, csumSize)) {
+			failures.add();
+			LOG_ERROR("KeyFile",
+				"checksum mismatch for page at offset %" PRId64 " in %s",
+				offset + i, name());
+			retval = E_checksum_failed;
+		}
+	}
+
+	return retval;
 }
 
 /**
- * Writes key page at the given offset in the key file.
+ * Writes at the given offset in the key file, as it is.
  *
  * @param [in] offset  - key file offset.
  * @param [in] buf     - buffer to write.
@@ -167,12 +685,32 @@ int
 KeyFile::write(int64_t offset, const void *buf, int toWrite)
 {
 	std::lock_guard<std::mutex> guard(mutex);
-	return WriteFile(this, offset, buf, toWrite);
+	return WriteFile(this, copier, offset, buf, toWrite);
+}
+
+/**
+ * Writes key page at the given offset in the key file. If
+ * checksums are enabled, the page checksum is set in the
+ * page before it is written.
+ *
+ * @param [in] offset  - key file offset.
+ * @param [in] kp      - key page.
+ * @param [in] toWrite - bytes to write.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+KeyFile::write(int64_t offset, key_page_t *kp, int toWrite)
+{
+	if (csumSize && (toWrite == csumSize))
+		SetKeyPageChecksum(kp, csumSize);
+
+	return write(offset, static_cast<const void *>(kp), toWrite);
 }
 
 /**
  * Obtains the key offset and write the key page
- * at the offset in the key file.
+ * at the offset in the key file, as it is.
  *
  * @param [out] offset  - key file offset where the page is written.
  * @param [in]  buf     - key page buffer.
@@ -204,7 +742,71 @@ KeyFile::write(int64_t *offset, const void *buf, int toWrite)
 }
 
 /**
- * Writes the flags field in the key page.
+ * Obtains the key offset and write the key page
+ * at the offset in the key file. If checksums are
+ * enabled, the page checksum is set in the page
+ * before it is written.
+ *
+ * @param [out] offset  - key file offset where the page is written.
+ * @param [in]  kp      - key page.
+ * @param [in]  toWrite - bytes to write.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+KeyFile::write(int64_t *offset, key_page_t *kp, int toWrite)
+{
+	if (csumSize && (toWrite == csumSize))
+		SetKeyPageChecksum(kp, csumSize);
+
+	return write(offset, static_cast<const void *>(kp), toWrite);
+}
+
+/*
+ * Gets the key page to update a field of, when checksums
+ * are enabled: the page given or, if none is given, the
+ * page read into the buffer. The page read must match its
+ * checksum, as it is written back with a fresh one.
+ *
+ * @return E_ok on success, E_checksum_failed if the page
+ * read does not match its checksum, -ve error code on
+ * failure.
+ */
+int
+KeyFile::readForUpdate(int64_t offset, key_page_t **kp, std::unique_ptr<char[]> &buf)
+{
+	int         retval = E_ok;
+	key_page_t  *page;
+
+	if (*kp)
+		return E_ok;
+
+	buf.reset(DBG_NEW char[csumSize]);
+	page = reinterpret_cast<key_page_t *>(buf.get());
+
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		retval = ReadFile(this, offset, page, csumSize);
+	}
+
+	if ((retval == E_ok) && !IsKeyPageChecksumValid(page, csumSize)) {
+		failures.add();
+		LOG_ERROR("KeyFile",
+			"checksum mismatch for page at offset %" PRId64 " in %s",
+			offset, name());
+		retval = E_checksum_failed;
+	}
+
+	if (retval == E_ok)
+		*kp = page;
+
+	return retval;
+}
+
+/**
+ * Writes the flags field in the key page. If checksums are
+ * enabled, the whole page is written with its checksum
+ * updated; the page is read first if it is not given.
  *
  * @param [in]  offset  - page offset in the key file.
  * @param [out] kp      - key page. If kp is not NULL,
@@ -219,17 +821,32 @@ KeyFile::writeFlags(int64_t offset, key_page_t *kp, int flags)
 {
 	int retval = E_ok;
 
-	offset += offsetof(key_page_t, kp_flags);
-	retval = write(offset, &flags, int(sizeof(flags)));
-	if (retval == E_ok) {
-		if (kp) {
-			int oflags = kp->kp_flags;
-			kp->kp_flags = flags;
+	flags &= ~KPAGE_CHECKSUM;
 
-			LOG_DEBUG("KeyFile",
-				"flags for page at offset %" PRId64 " changed: old 0x%04x, new 0x%04x",
-				offset, oflags, flags);
+	if (csumSize) {
+		std::unique_ptr<char[]> buf;
+		key_page_t *page = kp;
+
+		retval = readForUpdate(offset, &page, buf);
+		if (retval == E_ok) {
+			short oflags = page->kp_flags;
+			page->kp_flags = short(flags);
+			retval = write(offset, page, csumSize);
+			if (retval != E_ok)
+				page->kp_flags = oflags;
 		}
+	} else {
+		short sflags = short(flags);
+		retval = write(offset + int64_t(offsetof(key_page_t, kp_flags)),
+				static_cast<const void *>(&sflags), int(sizeof(sflags)));
+		if ((retval == E_ok) && kp)
+			kp->kp_flags = sflags;
+	}
+
+	if (retval == E_ok) {
+		LOG_DEBUG("KeyFile",
+			"flags for page at offset %" PRId64 " changed to 0x%04x",
+			offset, flags);
 	} else {
 		LOG_ERROR("KeyFile",
 			"failed to set flags to 0x%04x for page at offset %" PRId64,
@@ -240,7 +857,10 @@ KeyFile::writeFlags(int64_t offset, key_page_t *kp, int flags)
 }
 
 /**
- * Writes the previous offset field in the key page.
+ * Writes the previous offset field in the key page. If
+ * checksums are enabled, the whole page is written with
+ * its checksum updated; the page is read first if it is
+ * not given.
  *
  * @param [in]  offset      - page offset in the key file.
  * @param [out] kp          - key page. If kp is not NULL,
@@ -253,20 +873,33 @@ KeyFile::writeFlags(int64_t offset, key_page_t *kp, int flags)
 int
 KeyFile::writePrevOffset(int64_t offset, key_page_t *kp, int64_t prevOffset)
 {
-	int retval = E_ok;
+	int     retval = E_ok;
+	int64_t opoff = kp ? kp->kp_poff : -1L;
 
-	offset += offsetof(key_page_t, kp_poff);
-	retval = write(offset, &prevOffset, int(sizeof(prevOffset)));
-	if (retval == E_ok) {
-		if (kp) {
-			int64_t opoff = kp->kp_poff;
-			kp->kp_poff = prevOffset;
+	if (csumSize) {
+		std::unique_ptr<char[]> buf;
+		key_page_t *page = kp;
 
-			LOG_DEBUG("KeyFile",
-				"previous offset for page at offset %" PRId64
-				" changed: old %" PRId64 ", new %" PRId64,
-				offset, opoff, prevOffset);
+		retval = readForUpdate(offset, &page, buf);
+		if (retval == E_ok) {
+			opoff = page->kp_poff;
+			page->kp_poff = prevOffset;
+			retval = write(offset, page, csumSize);
+			if (retval != E_ok)
+				page->kp_poff = opoff;
 		}
+	} else {
+		retval = write(offset + int64_t(offsetof(key_page_t, kp_poff)),
+				static_cast<const void *>(&prevOffset), int(sizeof(prevOffset)));
+		if ((retval == E_ok) && kp)
+			kp->kp_poff = prevOffset;
+	}
+
+	if (retval == E_ok) {
+		LOG_DEBUG("KeyFile",
+			"previous offset for page at offset %" PRId64
+			" changed: old %" PRId64 ", new %" PRId64,
+			offset, opoff, prevOffset);
 	} else {
 		LOG_ERROR("KeyFile",
 			"failed to set previous offset to %" PRId64
@@ -278,7 +911,9 @@ KeyFile::writePrevOffset(int64_t offset, key_page_t *kp, int64_t prevOffset)
 }
 
 /**
- * Writes the next offset field in the key page.
+ * Writes the next offset field in the key page. If checksums
+ * are enabled, the whole page is written with its checksum
+ * updated; the page is read first if it is not given.
  *
  * @param [in]  offset      - page offset in the key file.
  * @param [out] kp          - key page. If kp is not NULL,
@@ -291,20 +926,33 @@ KeyFile::writePrevOffset(int64_t offset, key_page_t *kp, int64_t prevOffset)
 int
 KeyFile::writeNextOffset(int64_t offset, key_page_t *kp, int64_t nextOffset)
 {
-	int retval = E_ok;
+	int     retval = E_ok;
+	int64_t onoff = kp ? kp->kp_noff : -1L;
 
-	offset += offsetof(key_page_t, kp_noff);
-	retval = write(offset, &nextOffset, int(sizeof(nextOffset)));
-	if (retval == E_ok) {
-		if (kp) {
-			int64_t onoff = kp->kp_noff;
-			kp->kp_noff = nextOffset;
+	if (csumSize) {
+		std::unique_ptr<char[]> buf;
+		key_page_t *page = kp;
 
-			LOG_DEBUG("KeyFile",
-				"next offset for page at offset %" PRId64
-				" changed: old %" PRId64 ", new %" PRId64,
-				offset, onoff, nextOffset);
+		retval = readForUpdate(offset, &page, buf);
+		if (retval == E_ok) {
+			onoff = page->kp_noff;
+			page->kp_noff = nextOffset;
+			retval = write(offset, page, csumSize);
+			if (retval != E_ok)
+				page->kp_noff = onoff;
 		}
+	} else {
+		retval = write(offset + int64_t(offsetof(key_page_t, kp_noff)),
+				static_cast<const void *>(&nextOffset), int(sizeof(nextOffset)));
+		if ((retval == E_ok) && kp)
+			kp->kp_noff = nextOffset;
+	}
+
+	if (retval == E_ok) {
+		LOG_DEBUG("KeyFile",
+			"next offset for page at offset %" PRId64
+			" changed: old %" PRId64 ", new %" PRId64,
+			offset, onoff, nextOffset);
 	} else {
 		LOG_ERROR("KeyFile",
 			"failed to set next offset to %" PRId64
@@ -335,30 +983,65 @@ KeyFile::freePage(int64_t offset)
 	}
 }
 
+/**
+ * Copies the block at the specified index to the checkpoint
+ * file.
+ *
+ * @param [in] idx - block index.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+KeyFile::copyBlock(int64_t idx)
+{
+	std::lock_guard<std::mutex> guard(mutex);
+	return CopyBlock(copier, idx);
+}
+
 /**
  * Opens the database value file.
  *
  * @return E_ok on success, -ve error code on failure.
  */
 int
-ValueFile::open(bool sync)
+ValueFile::open(bool sync, bool direct)
 {
-	return OpenFile(this, sync);
+	return DbFile::open(sync, direct);
 }
 
 /**
- * Reads the value page at the given offset.
+ * Reads the value page at the given offset. If checksum
+ * verification is enabled, the page is verified against
+ * its checksum.
  *
  * @param [in]  offset - page offset in the value file.
  * @param [out] vp     - value page.
  *
- * @return E_ok on success, -ve error code on failure.
+ * @return E_ok on success, E_checksum_failed if the page
+ * does not match its checksum, -ve error code on failure.
  */
 int
 ValueFile::read(int64_t offset, value_page_t *vp)
 {
-	std::lock_guard<std::mutex> guard(mutex);
-	return ReadFile(this, offset, vp, int(sizeof(*vp)));
+	int retval = E_ok;
+
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		retval = ReadFile(this, offset, vp, int(sizeof(*vp)));
+	}
+
+	if ((retval == E_ok) && verify) {
+		verified.add();
+		if (!IsValuePageChecksumValid(vp)) {
+			failures.add();
+			LOG_ERROR("ValueFile",
+				"checksum mismatch for page at offset %" PRId64 " in %s",
+				offset, name());
+			retval = E_checksum_failed;
+		}
+	}
+
+	return retval;
 }
 
 /**
@@ -373,13 +1056,25 @@ ValueFile::read(int64_t offset, value_page_t *vp)
 int
 ValueFile::readFlags(int64_t offset, int *flags)
 {
-	std::lock_guard<std::mutex> guard(mutex);
-	offset += offsetof(value_page_t, vp_flags);
-	return ReadFile(this, offset, flags, int(sizeof(int)));
+	int     retval;
+	short   sflags = 0;
+
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		offset += offsetof(value_page_t, vp_flags);
+		retval = ReadFile(this, offset, &sflags, int(sizeof(sflags)));
+	}
+
+	if (retval == E_ok)
+		*flags = sflags;
+
+	return retval;
 }
 
 /**
  * Writes value page at the specified offset in the file.
+ * If checksums are enabled, the page checksum is set in
+ * the page before it is written.
  *
  * @param [in] offset - file offset where the value page
  *                      is to be written.
@@ -388,10 +1083,13 @@ ValueFile::readFlags(int64_t offset, int *flags)
  * @return E_ok on success, -ve error code on failure.
  */
 int
-ValueFile::write(int64_t offset, const value_page_t *vp)
+ValueFile::write(int64_t offset, value_page_t *vp)
 {
+	if (csumSize)
+		SetValuePageChecksum(vp);
+
 	std::lock_guard<std::mutex> guard(mutex);
-	return WriteFile(this, offset, vp, int(sizeof(*vp)));
+	return WriteFile(this, copier, offset, vp, int(sizeof(*vp)));
 }
 
 /**
@@ -404,7 +1102,7 @@ ValueFile::write(int64_t offset, const value_page_t *vp)
  * @return E_ok on success, -ve error code on failure.
  */
 int
-ValueFile::write(int64_t *offset, const value_page_t *vp)
+ValueFile::write(int64_t *offset, value_page_t *vp)
 {
 	int     retval = E_ok;
 	int64_t newOffset = fdpMgr->get();
@@ -426,9 +1124,48 @@ ValueFile::write(int64_t *offset, const value_page_t *vp)
 	return E_ok;
 }
 
+/*
+ * Gets the value page to update a field of, when checksums
+ * are enabled: the page given or, if none is given, the
+ * page read into the buffer. The page read must match its
+ * checksum, as it is written back with a fresh one.
+ *
+ * @return E_ok on success, E_checksum_failed if the page
+ * read does not match its checksum, -ve error code on
+ * failure.
+ */
+int
+ValueFile::readForUpdate(int64_t offset, value_page_t **vp, value_page_t *buf)
+{
+	int retval = E_ok;
+
+	if (*vp)
+		return E_ok;
+
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		retval = ReadFile(this, offset, buf, int(sizeof(*buf)));
+	}
+
+	if ((retval == E_ok) && !IsValuePageChecksumValid(buf)) {
+		failures.add();
+		LOG_ERROR("ValueFile",
+			"checksum mismatch for page at offset %" PRId64 " in %s",
+			offset, name());
+		retval = E_checksum_failed;
+	}
+
+	if (retval == E_ok)
+		*vp = buf;
+
+	return retval;
+}
+
 /**
- * Write flags in the value page which is located
- * at the specified index.
+ * Write flags in the value page which is located at the
+ * specified index. If checksums are enabled, the whole
+ * page is written with its checksum updated; the page is
+ * read first if it is not given.
  *
  * @param [in]  offset - page offset in the value file.
  * @param [out] vp     - value page. If vp is not NULL,
@@ -443,22 +1180,93 @@ ValueFile::writeFlags(int64_t offset, value_page_t *vp, int flags)
 {
 	int retval = E_ok;
 
-	{
-		std::lock_guard<std::mutex> guard(mutex);
-		offset += offsetof(value_page_t, vp_flags);
-		retval = WriteFile(this, offset, &flags, int(sizeof(flags)));
-	}
+	flags &= ~VPAGE_CHECKSUM;
 
-	if (retval == E_ok) {
-		if (vp)
-			vp->vp_flags = flags;
+	if (csumSize) {
+		value_page_t buf;
+		value_page_t *page = vp;
+
+		retval = readForUpdate(offset, &page, &buf);
+		if (retval == E_ok) {
+			short oflags = page->vp_flags;
+			page->vp_flags = short(flags);
+			retval = write(offset, page);
+			if (retval != E_ok)
+				page->vp_flags = oflags;
+		}
 	} else {
+		short sflags = short(flags);
+
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			offset += offsetof(value_page_t, vp_flags);
+			retval = WriteFile(this, copier, offset, &sflags, int(sizeof(sflags)));
+		}
+
+		if ((retval == E_ok) && vp)
+			vp->vp_flags = sflags;
+	}
+
+	if (retval != E_ok) {
 		LOG_ERROR("ValueFile", "failed to set flags to 0x%04x", flags);
 	}
 
 	return retval;
 }
 
+/**
+ * Writes the value in the value page, in place, which is
+ * located at the specified offset. Only the value bytes
+ * are written, unless checksums are enabled: the whole
+ * page is written then, with its checksum updated; the
+ * page is read first if it is not given. The value length
+ * must not change.
+ *
+ * @param [in]  offset - page offset in the value file.
+ * @param [out] vp     - value page. If vp is not NULL,
+ *                       the value in the value page
+ *                       record is updated as well.
+ * @param [in]  value  - new value.
+ * @param [in]  vlen   - value length.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+ValueFile::writeValue(int64_t offset, value_page_t *vp, const char *value, int vlen)
+{
+	int retval = E_ok;
+
+	if (csumSize) {
+		value_page_t buf;
+		value_page_t *page = vp;
+
+		retval = readForUpdate(offset, &page, &buf);
+		if (retval == E_ok) {
+			char ovalue[MAX_VALUE_LENGTH];
+			memcpy(ovalue, page->vp_value, vlen);
+			memcpy(page->vp_value, value, vlen);
+			retval = write(offset, page);
+			if (retval != E_ok)
+				memcpy(page->vp_value, ovalue, vlen);
+		}
+	} else {
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			retval = WriteFile(this, copier, offset + int64_t(offsetof(value_page_t, vp_value)),
+					value, vlen);
+		}
+
+		if ((retval == E_ok) && vp)
+			memcpy(vp->vp_value, value, vlen);
+	}
+
+	if (retval != E_ok) {
+		LOG_ERROR("ValueFile", "failed to write %d bytes of value in place", vlen);
+	}
+
+	return retval;
+}
+
 /**
  * Frees the value page at the specified offset.
  *
@@ -478,3 +1286,38 @@ ValueFile::freePage(int64_t offset)
 		return E_invalid_state;
 	}
 }
+
+/**
+ * Frees the value pages at the specified offsets.
+ *
+ * @param [in] offsets - file offsets.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+ValueFile::freePages(const std::vector<int64_t> &offsets)
+{
+	if (fdpMgr) {
+		return fdpMgr->free(offsets);
+	} else {
+		ERROR_STRM("ValueFile")
+			<< "free disk page manager is not set"
+			<< snf::log::record::endl;
+		return E_invalid_state;
+	}
+}
+
+/**
+ * Copies the block at the specified index to the checkpoint
+ * file.
+ *
+ * @param [in] idx - block index.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+ValueFile::copyBlock(int64_t idx)
+{
+	std::lock_guard<std::mutex> guard(mutex);
+	return CopyBlock(copier, idx);
+}
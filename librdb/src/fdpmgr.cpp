@@ -42,6 +42,49 @@ FreeDiskPageMgr::addOffsetToFile(int64_t offset)
 	return retval;
 }
 
+/*
+ * Adds the offsets to the file in a single write.
+ *
+ * This function assumes that the file pointer is
+ * already set correctly (i.e. at the end of the file).
+ *
+ * @param [in] offsets - The file offsets to persist.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+FreeDiskPageMgr::addOffsetsToFile(const std::vector<int64_t> &offsets)
+{
+	int retval = E_ok;
+
+	if (file && !offsets.empty()) {
+		int     oserr = 0;
+		int     toWrite = int(offsets.size() * sizeof(int64_t));
+		int     bWritten = 0;
+
+		retval = file->write(offsets.data(), toWrite, &bWritten, &oserr);
+		if (retval != E_ok) {
+			ERROR_STRM("FreeDiskPageMgr", oserr)
+				<< "failed to write " << offsets.size()
+				<< " free disk page offsets to file " << file->name()
+				<< snf::log::record::endl;
+		} else if (bWritten != toWrite) {
+			ERROR_STRM("FreeDiskPageMgr")
+				<< "expected to write " << toWrite
+				<< " bytes, written only " << bWritten << " bytes"
+				<< snf::log::record::endl;
+			// do not leave a partial offset behind
+			file->truncate(fsize, &oserr);
+			file->seek(fsize, &oserr);
+			retval = E_write_failed;
+		} else {
+			fsize += toWrite;
+		}
+	}
+
+	return retval;
+}
+
 /*
  * Removes the last offset from the file.
  * This function simply truncate the filesize by
@@ -204,6 +247,36 @@ FreeDiskPageMgr::free(int64_t offset)
 	return retval;
 }
 
+/**
+ * Frees a batch of disk page offsets. They are added to
+ * the stack for re-use and persisted with a single write.
+ *
+ * @param [in] offsets - The free disk page offsets that
+ *                       are available for re-use.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+FreeDiskPageMgr::free(const std::vector<int64_t> &offsets)
+{
+	for (int64_t offset : offsets) {
+		ASSERT((offset >= 0), "FreeDiskPageMgr", 0,
+			"invalid offset (%" PRId64 ") specified", offset);
+		ASSERT(((offset % pageSize) == 0), "FreeDiskPageMgr", 0,
+			"offset (%" PRId64 ") is not correctly aligned", offset);
+	}
+
+	std::lock_guard<std::mutex> guard(mutex);
+
+	int retval = addOffsetsToFile(offsets);
+	if (retval == E_ok) {
+		for (int64_t offset : offsets)
+			nextFreeOffset.push(offset);
+	}
+
+	return retval;
+}
+
 /**
  * Resets everything. Use with caution (preferably
  * at start-up only).
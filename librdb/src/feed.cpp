@@ -0,0 +1,396 @@
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <memory>
+#include "feed.h"
+#include "dir.h"
+#include "filesystem.h"
+#include "logmgr.h"
+#include "error.h"
+
+static const int RECORD_SIZE = int(sizeof(change_rec_t));
+
+/*
+ * Gets the segment file name.
+ *
+ * @param [in] first - sequence of the first record.
+ *
+ * @return the file name.
+ */
+std::string
+ChangeFeed::segmentName(uint64_t first) const
+{
+	char    fname[MAXPATHLEN + 1];
+
+	snprintf(fname, MAXPATHLEN, "%s%c%s.feed.%020" PRIu64,
+		path.c_str(), snf::pathsep(), name.c_str(), first);
+	return fname;
+}
+
+/*
+ * Opens a segment file.
+ *
+ * @param [in] file   - segment file.
+ * @param [in] create - create (and empty) the file?
+ * @param [in] rdonly - open the file read-only?
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+ChangeFeed::openSegment(snf::file *file, bool create, bool rdonly)
+{
+	int                   retval = E_ok;
+	int                   oserr = 0;
+	snf::file::open_flags oflags;
+
+	oflags.o_read = true;
+	oflags.o_write = !rdonly;
+	oflags.o_create = create;
+	oflags.o_truncate = create;
+	oflags.o_sync = sync && !rdonly;
+
+	retval = file->open(oflags, 0600, &oserr);
+	if ((retval != E_ok) && !rdonly) {
+		ERROR_STRM("ChangeFeed", oserr)
+			<< "failed to open file " << file->name()
+			<< snf::log::record::endl;
+	}
+
+	return retval;
+}
+
+/*
+ * Finds the last record in the last segment; the records not
+ * completely written (if the process died while writing them)
+ * are truncated.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+ChangeFeed::recover()
+{
+	int             retval = E_ok;
+	int             oserr = 0;
+	int             bRead = 0;
+	int64_t         fsize;
+	int64_t         count;
+	uint64_t        first = segments.back();
+	change_rec_t    cr;
+
+	std::unique_ptr<snf::file> file(DBG_NEW snf::file(segmentName(first), 0022));
+	retval = openSegment(file.get(), false, false);
+	if (retval != E_ok)
+		return retval;
+
+	fsize = file->size(&oserr);
+	if (fsize < 0) {
+		ERROR_STRM("ChangeFeed", oserr)
+			<< "failed to get size of file " << file->name()
+			<< snf::log::record::endl;
+		return int(fsize);
+	}
+
+	for (count = fsize / RECORD_SIZE; count > 0; --count) {
+		retval = file->read((count - 1) * RECORD_SIZE, &cr, RECORD_SIZE, &bRead, &oserr);
+		if (retval != E_ok) {
+			ERROR_STRM("ChangeFeed", oserr)
+				<< "failed to read file " << file->name()
+				<< snf::log::record::endl;
+			return retval;
+		}
+
+		if ((bRead == RECORD_SIZE) &&
+			(cr.cr_magic == CHANGE_MAGIC) &&
+			(cr.cr_seq == (first + uint64_t(count - 1))))
+			break;
+	}
+
+	if ((count * RECORD_SIZE) != fsize) {
+		LOG_WARNING("ChangeFeed", "truncating %s to %" PRId64 " records",
+			file->name(), count);
+
+		retval = file->truncate(count * RECORD_SIZE, &oserr);
+		if (retval != E_ok) {
+			ERROR_STRM("ChangeFeed", oserr)
+				<< "failed to truncate file " << file->name()
+				<< snf::log::record::endl;
+			return retval;
+		}
+	}
+
+	lastSeq = first + uint64_t(count) - 1;
+	tail = file.release();
+
+	return E_ok;
+}
+
+/*
+ * Starts a new segment, removing the oldest ones beyond the
+ * segments kept. Must be called with the mutex locked.
+ *
+ * @param [in] first - sequence of the first record.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+ChangeFeed::roll(uint64_t first)
+{
+	int retval = E_ok;
+
+	if (tail) {
+		delete tail;
+		tail = 0;
+	}
+
+	std::unique_ptr<snf::file> file(DBG_NEW snf::file(segmentName(first), 0022));
+	retval = openSegment(file.get(), true, false);
+	if (retval != E_ok)
+		return retval;
+
+	tail = file.release();
+
+	if (segments.empty() || (segments.back() != first))
+		segments.push_back(first);
+
+	while (int(segments.size()) > maxSegs) {
+		std::string fname = segmentName(segments.front());
+		LOG_DEBUG("ChangeFeed", "removing segment %s", fname.c_str());
+		snf::fs::remove_file(fname.c_str());
+		segments.pop_front();
+	}
+
+	broken = false;
+
+	return E_ok;
+}
+
+/**
+ * Opens the change feed. The sequence numbers continue from
+ * the last record found.
+ *
+ * @param [in] start - sequence of the last change already in
+ *                     the database; the sequence numbers
+ *                     continue from it if the feed is empty.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+ChangeFeed::open(uint64_t start)
+{
+	std::string prefix = name + ".feed.";
+
+	std::lock_guard<std::mutex> guard(mutex);
+
+	segments.clear();
+	lastSeq = start;
+	broken = false;
+
+	try {
+		for (auto &fa : snf::directory(path, R"(.*\.feed\.[0-9]{20})")) {
+			if ((fa.f_name.size() == (prefix.size() + 20)) &&
+				(fa.f_name.compare(0, prefix.size(), prefix) == 0))
+				segments.push_back(strtoull(fa.f_name.c_str() + prefix.size(), 0, 10));
+		}
+	} catch (std::system_error &ex) {
+		ERROR_STRM("ChangeFeed", ex.code().value())
+			<< ex.what()
+			<< snf::log::record::endl;
+		return E_not_found;
+	}
+
+	std::sort(segments.begin(), segments.end());
+
+	if (segments.empty())
+		return E_ok;
+
+	return recover();
+}
+
+/**
+ * Closes the change feed.
+ */
+void
+ChangeFeed::close()
+{
+	std::lock_guard<std::mutex> guard(mutex);
+
+	if (tail) {
+		delete tail;
+		tail = 0;
+	}
+}
+
+/**
+ * Gets the sequence of the oldest record in the feed.
+ */
+uint64_t
+ChangeFeed::firstSequence()
+{
+	std::lock_guard<std::mutex> guard(mutex);
+	return segments.empty() ? (lastSeq + 1) : segments.front();
+}
+
+/**
+ * Gets the sequence of the last record in the feed, the
+ * start sequence (see open()) if the feed is empty.
+ */
+uint64_t
+ChangeFeed::lastSequence()
+{
+	std::lock_guard<std::mutex> guard(mutex);
+	return lastSeq;
+}
+
+/**
+ * Appends a change to the feed with the next sequence number.
+ * A failure is logged and leaves a gap in the feed.
+ *
+ * @param [in] op     - CHANGE_SET or CHANGE_REMOVE.
+ * @param [in] key    - key.
+ * @param [in] klen   - key length.
+ * @param [in] value  - value (set).
+ * @param [in] vlen   - value length (set).
+ * @param [in] expiry - expiry time (set).
+ */
+void
+ChangeFeed::append(int op, const char *key, int klen, const char *value, int vlen, uint32_t expiry)
+{
+	int             retval = E_ok;
+	int             oserr = 0;
+	int             bWritten = 0;
+	change_rec_t    cr;
+
+	memset(&cr, 0, sizeof(cr));
+	cr.cr_magic = CHANGE_MAGIC;
+	cr.cr_op = short(op);
+	cr.cr_klen = short(klen);
+	memcpy(cr.cr_key, key, klen);
+	if (op == CHANGE_SET) {
+		cr.cr_vlen = short(vlen);
+		cr.cr_expiry = expiry;
+		memcpy(cr.cr_value, value, vlen);
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+
+		cr.cr_seq = ++lastSeq;
+
+		if ((tail == 0) || broken || ((cr.cr_seq - segments.back()) >= uint64_t(segSize)))
+			retval = roll(cr.cr_seq);
+
+		if (retval == E_ok) {
+			retval = tail->write(int64_t(cr.cr_seq - segments.back()) * RECORD_SIZE,
+					&cr, RECORD_SIZE, &bWritten, &oserr);
+			if ((retval == E_ok) && (bWritten != RECORD_SIZE))
+				retval = E_write_failed;
+		}
+
+		if (retval != E_ok) {
+			ERROR_STRM("ChangeFeed", oserr)
+				<< "failed to append change " << cr.cr_seq
+				<< " to the feed of " << name
+				<< snf::log::record::endl;
+			broken = true;
+		}
+	}
+
+	cond.notify_all();
+}
+
+/**
+ * Reads the changes starting at the given sequence number.
+ * The changes are read from one segment at a time, so fewer
+ * than asked for may be returned even if there are more.
+ *
+ * @param [in]  from    - sequence of the first change to read.
+ * @param [in]  max     - maximum number of changes to read.
+ * @param [out] changes - changes read, in sequence order;
+ *                        empty if there are no changes
+ *                        after from yet.
+ *
+ * @return E_ok on success, E_not_found if the change is no
+ * longer in the feed (or is lost), E_mismatch if the feed
+ * has not reached from - 1 yet i.e. the reader is ahead of
+ * the feed, -ve error code on failure.
+ */
+int
+ChangeFeed::read(uint64_t from, int max, std::vector<change_rec_t> &changes)
+{
+	int         retval = E_ok;
+	int         oserr = 0;
+	int         bRead = 0;
+	uint64_t    first;
+	uint64_t    last;
+
+	changes.clear();
+
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+
+		if (from > (lastSeq + 1))
+			return E_mismatch;
+
+		if (from == (lastSeq + 1))
+			return E_ok;
+
+		std::deque<uint64_t>::iterator it =
+			std::upper_bound(segments.begin(), segments.end(), from);
+		if (it == segments.begin())
+			return E_not_found;
+
+		last = std::min(lastSeq, from + uint64_t(max) - 1);
+		if (it != segments.end())
+			last = std::min(last, *it - 1);
+
+		first = *(--it);
+	}
+
+	// Records up to the last sequence are written; they are
+	// read without holding up the writers.
+	snf::file segment(segmentName(first), 0022);
+	if (openSegment(&segment, false, true) != E_ok)
+		return E_not_found;
+
+	changes.resize(size_t(last - from + 1));
+
+	retval = segment.read(int64_t(from - first) * RECORD_SIZE, changes.data(),
+			int(changes.size()) * RECORD_SIZE, &bRead, &oserr);
+	if (retval != E_ok) {
+		ERROR_STRM("ChangeFeed", oserr)
+			<< "failed to read file " << segment.name()
+			<< snf::log::record::endl;
+		changes.clear();
+		return retval;
+	}
+
+	size_t valid = 0;
+	while ((valid < size_t(bRead / RECORD_SIZE)) &&
+		(changes[valid].cr_magic == CHANGE_MAGIC) &&
+		(changes[valid].cr_seq == (from + valid)))
+		valid++;
+
+	changes.resize(valid);
+
+	return changes.empty() ? E_not_found : E_ok;
+}
+
+/**
+ * Waits for the feed to reach the given sequence number.
+ *
+ * @param [in] seq - sequence to wait for.
+ * @param [in] to  - timeout in milliseconds.
+ *
+ * @return E_ok if the feed has reached seq, E_timed_out
+ * otherwise.
+ */
+int
+ChangeFeed::wait(uint64_t seq, int to)
+{
+	std::unique_lock<std::mutex> guard(mutex);
+
+	if (cond.wait_for(guard, std::chrono::milliseconds(to), [this, seq] { return lastSeq >= seq; }))
+		return E_ok;
+
+	return E_timed_out;
+}
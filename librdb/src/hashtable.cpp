@@ -53,6 +53,24 @@ HashTable::allocate(int size)
 	}
 }
 
+/**
+ * Shares the hash table with the processes that open the
+ * database read-only. From here on, the first key page
+ * offsets are published to the shared hash table and the
+ * write locks mark the shared entries as being updated:
+ * the entry sequence number is odd while the write lock is
+ * held, and the generation is bumped on unlock.
+ *
+ * @param [in] hh - header of the shared (mapped) hash table.
+ *                  NULL stops sharing.
+ */
+void
+HashTable::share(hti_header_t *hh)
+{
+	std::lock_guard<std::mutex> guard(mutex);
+	shared = hh;
+}
+
 /**
  * Acquires read lock on hash table entry at the
  * specified index.
@@ -66,19 +84,36 @@ HashTable::rdlock(int index)
 		"out-of-bound hash table index (%d), range [%d, %d)",
 		index, 0, htsize);
 
-	hash_entry_t *hent = ht + index;
+	hash_entry_t    *hent = ht + index;
+	RWLock          *rwlock = 0;
 
-	std::lock_guard<std::mutex> guard(mutex);
+	{
+		std::lock_guard<std::mutex> guard(mutex);
 
-	if (hent->rwlock == 0) {
-		hent->rwlock = rwlockPool->get();
-	}
+		if (hent->rwlock == 0) {
+			hent->rwlock = rwlockPool->get();
+		}
+
+		ASSERT((hent->rwlock != 0), "HashTable", 0,
+			"failed to get read write lock");
 
-	ASSERT((hent->rwlock != 0), "HashTable", 0,
-		"failed to get read write lock");
+		rwlock = hent->rwlock;
+		rwlock->addUser();
+	}
 
+	// Do not block on the entry lock while holding the
+	// table mutex; the holder needs the mutex to unlock.
+	// The time spent blocked is counted.
 	int error = 0;
-	int r = hent->rwlock->rdlock(&error);
+	int r = rwlock->tryrdlock(&error);
+	if (r == E_try_again) {
+		std::chrono::steady_clock::time_point start =
+			std::chrono::steady_clock::now();
+		r = rwlock->rdlock(&error);
+		lockWaits.add();
+		lockWaitUsec.add(std::chrono::duration_cast<std::chrono::microseconds>(
+				std::chrono::steady_clock::now() - start).count());
+	}
 	ASSERT((r == E_ok), "HashTable", error,
 		"failed to get read lock on %d", index);
 }
@@ -102,7 +137,7 @@ HashTable::rdunlock(int index)
 
 	if (hent->rwlock) {
 		hent->rwlock->rdunlock();
-		if (hent->rwlock->getLockCount() == 0) {
+		if (hent->rwlock->removeUser() == 0) {
 			rwlockPool->put(hent->rwlock);
 			hent->rwlock = 0;
 		}
@@ -122,21 +157,41 @@ HashTable::wrlock(int index)
 		"out-of-bound hash table index (%d), range [%d, %d)",
 		index, 0, htsize);
 
-	hash_entry_t *hent = ht + index;
+	hash_entry_t    *hent = ht + index;
+	RWLock          *rwlock = 0;
 
-	std::lock_guard<std::mutex> guard(mutex);
+	{
+		std::lock_guard<std::mutex> guard(mutex);
 
-	if (hent->rwlock == 0) {
-		hent->rwlock = rwlockPool->get();
-	}
+		if (hent->rwlock == 0) {
+			hent->rwlock = rwlockPool->get();
+		}
+
+		ASSERT((hent->rwlock != 0), "HashTable", 0,
+			"failed to get read write lock");
 
-	ASSERT((hent->rwlock != 0), "HashTable", 0,
-		"failed to get read write lock");
+		rwlock = hent->rwlock;
+		rwlock->addUser();
+	}
 
+	// Do not block on the entry lock while holding the
+	// table mutex; the holder needs the mutex to unlock.
+	// The time spent blocked is counted.
 	int error = 0;
-	int r = hent->rwlock->wrlock(&error);
+	int r = rwlock->trywrlock(&error);
+	if (r == E_try_again) {
+		std::chrono::steady_clock::time_point start =
+			std::chrono::steady_clock::now();
+		r = rwlock->wrlock(&error);
+		lockWaits.add();
+		lockWaitUsec.add(std::chrono::duration_cast<std::chrono::microseconds>(
+				std::chrono::steady_clock::now() - start).count());
+	}
 	ASSERT((r == E_ok), "HashTable", error,
 		"failed to get write lock on %d", index);
+
+	if (shared)
+		HashTableEntries(shared)[index].he_seq.fetch_add(1);
 }
 
 /**
@@ -156,10 +211,17 @@ HashTable::wrunlock(int index)
 
 	std::lock_guard<std::mutex> guard(mutex);
 
+	if (shared) {
+		HashTableEntries(shared)[index].he_seq.fetch_add(1);
+		shared->hh_gen.fetch_add(1);
+	}
+
 	if (hent->rwlock) {
 		hent->rwlock->wrunlock();
-		rwlockPool->put(hent->rwlock);
-		hent->rwlock = 0;
+		if (hent->rwlock->removeUser() == 0) {
+			rwlockPool->put(hent->rwlock);
+			hent->rwlock = 0;
+		}
 	}
 }
 
@@ -198,6 +260,7 @@ HashTable::setOffset(int index, int64_t offset)
 	hash_entry_t *hent = ht + index;
 
 	hent->offset = offset;
+	publish(index, offset);
 }
 
 /**
@@ -223,6 +286,7 @@ HashTable::addKeyPageNode(int index, key_page_node_t *kpn)
 		hent->head = kpn;
 		hent->tail = kpn;
 		hent->offset = kpn->kpn_kpoff;
+		publish(index, hent->offset);
 	} else {
 		kpn->kpn_prev = hent->tail;
 		hent->tail->kpn_next = kpn;
@@ -259,6 +323,7 @@ HashTable::removeKeyPageNode(int index, key_page_node_t *kpn)
 		} else {
 			hent->offset = -1L;
 		}
+		publish(index, hent->offset);
 	}
 
 	if (kpn->kpn_next) {
@@ -393,7 +393,11 @@ KeyRecords::remove(short root, const key_info_t *ki, short *idx)
 					kp->kp_keys[maxInLeftSubTree].kr_klen);
 				krec->kr_klen = kp->kp_keys[maxInLeftSubTree].kr_klen;
 				krec->kr_voff = kp->kp_keys[maxInLeftSubTree].kr_voff;
-				LEFT_OF(root) = removeMax(LEFT_OF(root), idx);
+				short freed = -1;
+				LEFT_OF(root) = removeMax(LEFT_OF(root), &freed);
+				// The key is removed from this record; the
+				// record of its predecessor is freed instead.
+				*idx = root;
 			}
 		} else /* if (cmp > 0) */ {
 			RIGHT_OF(root) = remove(RIGHT_OF(root), ki, idx);
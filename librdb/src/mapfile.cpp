@@ -0,0 +1,169 @@
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#endif
+
+#include "mapfile.h"
+#include "logmgr.h"
+#include "error.h"
+
+/**
+ * Opens the file.
+ *
+ * @param [in] writable - open the file for writing? The file
+ *                        is created if it does not exist. If
+ *                        false, the file is opened read-only.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+MappedFile::open(bool writable)
+{
+	int                   retval = E_ok;
+	int                   oserr = 0;
+	snf::file::open_flags oflags;
+
+	oflags.o_read = true;
+	if (writable) {
+		oflags.o_write = true;
+		oflags.o_create = true;
+	}
+
+	retval = snf::file::open(oflags, 0600, &oserr);
+	if (retval != E_ok) {
+		ERROR_STRM("MappedFile", oserr)
+			<< "failed to open file " << name()
+			<< snf::log::record::endl;
+	} else {
+		this->writable = writable;
+	}
+
+	return retval;
+}
+
+/**
+ * Maps the file in memory. The existing mapping, if any, is
+ * removed first.
+ *
+ * @param [in] length - length to map. It must not exceed the
+ *                      file size.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+MappedFile::map(int64_t length)
+{
+	int oserr = 0;
+
+	unmap();
+
+	if (length <= 0) {
+		return E_ok;
+	}
+
+#if defined(_WIN32)
+
+	HANDLE mh = CreateFileMapping(fd, 0,
+			writable ? PAGE_READWRITE : PAGE_READONLY,
+			DWORD(length >> 32), DWORD(length & 0xFFFFFFFF), 0);
+	if (mh != 0) {
+		addr = static_cast<char *>(MapViewOfFile(mh,
+				writable ? FILE_MAP_WRITE : FILE_MAP_READ,
+				0, 0, SIZE_T(length)));
+		if (addr == 0)
+			oserr = snf::system_error();
+		CloseHandle(mh);
+	} else {
+		oserr = snf::system_error();
+	}
+
+#else
+
+	void *maddr = mmap(0, size_t(length),
+			writable ? (PROT_READ | PROT_WRITE) : PROT_READ,
+			MAP_SHARED, fd, 0);
+	if (maddr == MAP_FAILED) {
+		oserr = snf::system_error();
+	} else {
+		addr = static_cast<char *>(maddr);
+	}
+
+#endif
+
+	if (addr == 0) {
+		ERROR_STRM("MappedFile", oserr)
+			<< "failed to map " << length
+			<< " bytes of file " << name()
+			<< snf::log::record::endl;
+		return E_syscall_failed;
+	}
+
+	len = length;
+	return E_ok;
+}
+
+/**
+ * Maps the file again if it has grown since it was mapped.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+MappedFile::remap()
+{
+	int     oserr = 0;
+	int64_t fsize = size(&oserr);
+
+	if (fsize < 0) {
+		ERROR_STRM("MappedFile", oserr)
+			<< "failed to get size of file " << name()
+			<< snf::log::record::endl;
+		return int(fsize);
+	}
+
+	if (fsize <= len) {
+		return E_ok;
+	}
+
+	return map(fsize);
+}
+
+/**
+ * Flushes the mapped pages to the file.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+MappedFile::flush()
+{
+	int retval = E_ok;
+
+	if (addr && writable) {
+#if defined(_WIN32)
+		if (!FlushViewOfFile(addr, SIZE_T(len))) {
+#else
+		if (msync(addr, size_t(len), MS_SYNC) != 0) {
+#endif
+			LOG_SYSERR("MappedFile", snf::system_error(),
+				"failed to flush mapped file %s", name());
+			retval = E_sync_failed;
+		}
+	}
+
+	return retval;
+}
+
+/**
+ * Removes the mapping.
+ */
+void
+MappedFile::unmap()
+{
+	if (addr) {
+#if defined(_WIN32)
+		UnmapViewOfFile(addr);
+#else
+		munmap(addr, size_t(len));
+#endif
+		addr = 0;
+		len = 0;
+	}
+}
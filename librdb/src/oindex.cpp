@@ -0,0 +1,682 @@
+#include <memory>
+#include "oindex.h"
+#include "logmgr.h"
+#include "error.h"
+
+/*
+ * Sets the ordered index record.
+ */
+static void
+SetRecord(oix_rec_t *rec, const char *key, int klen, int64_t off)
+{
+	memset(rec, 0, sizeof(oix_rec_t));
+	if (key && (klen > 0))
+		memcpy(rec->or_key, key, klen);
+	rec->or_klen = short(klen);
+	rec->or_off = off;
+}
+
+/*
+ * Finds the first record, at or after the first index,
+ * whose key is greater than or equal to the key.
+ *
+ * @return the record index; the record count if there is
+ * no such record.
+ */
+static int
+LowerBound(const oix_page_t *op, const char *key, int klen, int first)
+{
+	int lo = first;
+	int hi = op->op_count;
+
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		const oix_rec_t *rec = op->op_recs + mid;
+		if (CompareKeys(rec->or_key, rec->or_klen, key, klen) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/*
+ * Finds the first record, at or after the first index,
+ * whose key is greater than the key.
+ *
+ * @return the record index; the record count if there is
+ * no such record.
+ */
+static int
+UpperBound(const oix_page_t *op, const char *key, int klen, int first)
+{
+	int lo = first;
+	int hi = op->op_count;
+
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		const oix_rec_t *rec = op->op_recs + mid;
+		if (CompareKeys(rec->or_key, rec->or_klen, key, klen) <= 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/*
+ * Gets the index of the branch record whose child holds
+ * the key. The key of the first record is not used.
+ */
+static int
+ChildIndex(const oix_page_t *op, const char *key, int klen)
+{
+	if (key == 0)
+		return 0;
+	return UpperBound(op, key, klen, 1) - 1;
+}
+
+/*
+ * Returns true if the record at the index holds the key.
+ */
+static bool
+IsMatch(const oix_page_t *op, int idx, const char *key, int klen)
+{
+	if (idx >= op->op_count)
+		return false;
+
+	const oix_rec_t *rec = op->op_recs + idx;
+	return (CompareKeys(rec->or_key, rec->or_klen, key, klen) == 0);
+}
+
+/**
+ * Constructs the ordered index object.
+ *
+ * @param [in] fname  - index file name.
+ * @param [in] kpSize - key page size; the index pages are
+ *                      of the same size.
+ * @param [in] cache  - key page cache.
+ */
+OrderedIndex::OrderedIndex(const char *fname, int kpSize, LRUCache *cache)
+	: file(DBG_NEW KeyFile(fname, 0022)),
+	  cache(cache),
+	  kpSize(kpSize),
+	  maxRecs(NUM_OF_RECS_IN_OPAGE(kpSize)),
+	  opened(false)
+{
+	memset(&meta, 0, sizeof(meta));
+}
+
+/**
+ * Destroys the ordered index object. The index is closed
+ * if it is open.
+ */
+OrderedIndex::~OrderedIndex()
+{
+	close();
+	delete file;
+}
+
+/*
+ * Creates an empty index i.e. the header page and an empty
+ * root leaf page.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+OrderedIndex::format()
+{
+	int                     retval = E_ok;
+	int                     oserr = 0;
+	std::unique_ptr<char[]> buf(DBG_NEW char[kpSize]);
+	oix_page_t              *op = reinterpret_cast<oix_page_t *>(buf.get());
+
+	retval = file->truncate(0L, &oserr);
+	if (retval != E_ok) {
+		LOG_SYSERR("OrderedIndex", oserr,
+			"failed to truncate %s", file->name());
+		return retval;
+	}
+
+	memset(&meta, 0, sizeof(meta));
+	meta.om_flags = OMETA_DIRTY;
+	meta.om_height = 1;
+	meta.om_kpsize = kpSize;
+	meta.om_root = kpSize;
+
+	memset(buf.get(), 0, kpSize);
+	memcpy(buf.get(), &meta, sizeof(meta));
+	retval = file->write(0L, buf.get(), kpSize);
+
+	if (retval == E_ok) {
+		memset(buf.get(), 0, kpSize);
+		op->op_flags = OPAGE_LEAF;
+		op->op_noff = -1L;
+		retval = file->write(meta.om_root, op, kpSize);
+	}
+
+	if (retval == E_ok) {
+		retval = file->freePage(2L * kpSize);
+	}
+
+	if (retval != E_ok) {
+		LOG_ERROR("OrderedIndex", "failed to create index %s", file->name());
+	}
+
+	return retval;
+}
+
+/*
+ * Writes the index header.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+OrderedIndex::writeMeta()
+{
+	int retval = file->write(0L, &meta, int(sizeof(meta)));
+	if (retval != E_ok) {
+		LOG_ERROR("OrderedIndex", "failed to write header of %s", file->name());
+	}
+	return retval;
+}
+
+/*
+ * Gets the index page at the specified offset, reading it
+ * in if it is not cached.
+ *
+ * @param [in]  offset - page offset.
+ * @param [out] op     - index page.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+OrderedIndex::getPage(int64_t offset, oix_page_t *&op)
+{
+	int             retval = E_ok;
+	key_page_node_t *kpn = 0;
+
+	std::unordered_map<int64_t, key_page_node_t *>::iterator it = nodes.find(offset);
+	if (it != nodes.end()) {
+		kpn = it->second;
+		cache->touch(kpn);
+		if (kpn->kpn_kp == 0) {
+			retval = cache->update(kpn, offset, file);
+		}
+	} else {
+		retval = cache->get(kpn, offset, file);
+		if (retval == E_ok) {
+			nodes[offset] = kpn;
+		}
+	}
+
+	if (retval == E_ok) {
+		op = reinterpret_cast<oix_page_t *>(kpn->kpn_kp);
+	} else {
+		LOG_ERROR("OrderedIndex",
+			"failed to read index page at offset %" PRId64, offset);
+	}
+
+	return retval;
+}
+
+/*
+ * Adds a new page to the index. The page is written at
+ * a free offset in the index file and is cached.
+ *
+ * @param [out] offset - page offset.
+ * @param [in]  op     - page content.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+OrderedIndex::addPage(int64_t *offset, const oix_page_t *op)
+{
+	int             retval = E_ok;
+	key_page_node_t *kpn = 0;
+
+	retval = cache->get(kpn, -1L, file);
+	if (retval != E_ok) {
+		LOG_ERROR("OrderedIndex", "failed to get a free index page");
+		return retval;
+	}
+
+	memcpy(kpn->kpn_kp, op, kpSize);
+
+	retval = file->write(offset, kpn->kpn_kp, kpSize);
+	if (retval != E_ok) {
+		LOG_ERROR("OrderedIndex", "failed to add page to %s", file->name());
+		cache->free(kpn);
+	} else {
+		kpn->kpn_kpoff = *offset;
+		nodes[*offset] = kpn;
+	}
+
+	return retval;
+}
+
+/*
+ * Writes the index page. If the write fails, the cached
+ * page is dropped so that it is read back from the file.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+OrderedIndex::writePage(int64_t offset, const oix_page_t *op)
+{
+	int retval = file->write(offset, op, kpSize);
+	if (retval != E_ok) {
+		LOG_ERROR("OrderedIndex",
+			"failed to write index page at offset %" PRId64 " to %s",
+			offset, file->name());
+		dropPage(offset);
+	}
+	return retval;
+}
+
+/*
+ * Drops the cached index page.
+ */
+void
+OrderedIndex::dropPage(int64_t offset)
+{
+	std::unordered_map<int64_t, key_page_node_t *>::iterator it = nodes.find(offset);
+	if (it != nodes.end()) {
+		key_page_node_t *kpn = it->second;
+		nodes.erase(it);
+		if (kpn->kpn_cnode)
+			cache->free(kpn);
+		else
+			::free(kpn);
+	}
+}
+
+/*
+ * Frees all the cached index pages.
+ */
+void
+OrderedIndex::freeNodes()
+{
+	std::unordered_map<int64_t, key_page_node_t *>::iterator it;
+	for (it = nodes.begin(); it != nodes.end(); ++it) {
+		key_page_node_t *kpn = it->second;
+		if (kpn->kpn_cnode)
+			cache->free(kpn);
+		else
+			::free(kpn);
+	}
+	nodes.clear();
+}
+
+/*
+ * Finds the leaf page that holds (or can hold) the key.
+ *
+ * @param [in]  key    - key; if NULL, the first leaf page
+ *                       is found.
+ * @param [in]  klen   - key length.
+ * @param [out] offset - leaf page offset.
+ * @param [out] op     - leaf page.
+ * @param [out] path   - if not NULL, the offsets of the
+ *                       branch pages visited, root first.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+OrderedIndex::findLeaf(
+	const char *key,
+	int klen,
+	int64_t *offset,
+	oix_page_t *&op,
+	std::vector<int64_t> *path)
+{
+	int     retval = E_ok;
+	int64_t off = meta.om_root;
+
+	while ((retval = getPage(off, op)) == E_ok) {
+		if (IsLeafPage(op))
+			break;
+
+		ASSERT((op->op_count > 0), "OrderedIndex", 0,
+			"empty branch page at offset %" PRId64, off);
+
+		if (path)
+			path->push_back(off);
+
+		off = op->op_recs[ChildIndex(op, key, klen)].or_off;
+	}
+
+	if (retval == E_ok)
+		*offset = off;
+
+	return retval;
+}
+
+/*
+ * Inserts the record in the page at the specified index.
+ * If the page is full, it is split in two halves, the
+ * upper half going to a new page, and the first key of
+ * the new page is inserted in the parent page. The new
+ * page is written before the page that refers to it.
+ *
+ * @param [inout] path   - offsets of the branch pages
+ *                         above the page, root first.
+ * @param [in]    offset - page offset.
+ * @param [in]    op     - page.
+ * @param [in]    idx    - record index.
+ * @param [in]    rec    - record to insert.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+OrderedIndex::insertRecord(
+	std::vector<int64_t> &path,
+	int64_t offset,
+	oix_page_t *op,
+	int idx,
+	const oix_rec_t &rec)
+{
+	int                     retval = E_ok;
+	oix_rec_t               sep = rec;
+	std::unique_ptr<char[]> buf;
+
+	for (;;) {
+		if (op->op_count < maxRecs) {
+			memmove(op->op_recs + idx + 1, op->op_recs + idx,
+				(op->op_count - idx) * sizeof(oix_rec_t));
+			op->op_recs[idx] = sep;
+			op->op_count++;
+			return writePage(offset, op);
+		}
+
+		std::vector<oix_rec_t> recs(op->op_recs, op->op_recs + op->op_count);
+		recs.insert(recs.begin() + idx, sep);
+
+		int n = int(recs.size());
+		int half = n / 2;
+		int64_t roff = -1L;
+
+		if (!buf)
+			buf.reset(DBG_NEW char[kpSize]);
+		memset(buf.get(), 0, kpSize);
+
+		oix_page_t *rp = reinterpret_cast<oix_page_t *>(buf.get());
+		rp->op_flags = op->op_flags;
+		rp->op_count = short(n - half);
+		rp->op_noff = IsLeafPage(op) ? op->op_noff : -1L;
+		memcpy(rp->op_recs, recs.data() + half, (n - half) * sizeof(oix_rec_t));
+
+		retval = addPage(&roff, rp);
+		if (retval != E_ok)
+			return retval;
+
+		memset(op->op_recs, 0, maxRecs * sizeof(oix_rec_t));
+		memcpy(op->op_recs, recs.data(), half * sizeof(oix_rec_t));
+		op->op_count = short(half);
+		if (IsLeafPage(op))
+			op->op_noff = roff;
+
+		retval = writePage(offset, op);
+		if (retval != E_ok)
+			return retval;
+
+		LOG_DEBUG("OrderedIndex",
+			"page at offset %" PRId64 " split, new page at offset %" PRId64,
+			offset, roff);
+
+		sep = recs[half];
+		sep.or_off = roff;
+
+		if (path.empty()) {
+			// The root is split; grow the tree
+			int64_t newRoot = -1L;
+
+			memset(buf.get(), 0, kpSize);
+			rp->op_flags = 0;
+			rp->op_count = 2;
+			rp->op_noff = -1L;
+			SetRecord(rp->op_recs, 0, 0, offset);
+			rp->op_recs[1] = sep;
+
+			retval = addPage(&newRoot, rp);
+			if (retval == E_ok) {
+				meta.om_root = newRoot;
+				meta.om_height++;
+				retval = writeMeta();
+			}
+
+			return retval;
+		}
+
+		offset = path.back();
+		path.pop_back();
+
+		retval = getPage(offset, op);
+		if (retval != E_ok)
+			return retval;
+
+		idx = UpperBound(op, sep.or_key, sep.or_klen, 1);
+	}
+}
+
+/**
+ * Opens the ordered index. The index is created if it does
+ * not exist. An index that was not closed cleanly, or was
+ * created with a different page size, is discarded and an
+ * empty index is created in its place.
+ *
+ * @param [in]  sync    - sync the index file on every write?
+ * @param [in]  direct  - use direct I/O for the index file?
+ * @param [out] created - set to true if an empty index is
+ *                        created; the caller must populate it.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+OrderedIndex::open(bool sync, bool direct, bool *created)
+{
+	int     retval = E_ok;
+	int64_t fsize;
+
+	std::lock_guard<std::mutex> guard(mutex);
+
+	retval = file->open(sync, direct);
+	if (retval != E_ok) {
+		return retval;
+	}
+
+	file->setFreeDiskPageMgr(DBG_NEW FreeDiskPageMgr(kpSize));
+	opened = true;
+
+	*created = false;
+
+	fsize = file->size();
+	if (fsize > 0) {
+		retval = file->read(0L, &meta, int(sizeof(meta)));
+		if (retval != E_ok) {
+			LOG_ERROR("OrderedIndex", "failed to read header of %s", file->name());
+		} else if (meta.om_kpsize != kpSize) {
+			LOG_WARNING("OrderedIndex",
+				"index page size (%d) does not match the key page size (%d); recreating %s",
+				meta.om_kpsize, kpSize, file->name());
+		} else if ((meta.om_flags & OMETA_DIRTY) == OMETA_DIRTY) {
+			LOG_WARNING("OrderedIndex",
+				"index was not closed cleanly; recreating %s", file->name());
+		} else if ((fsize % kpSize) != 0) {
+			LOG_WARNING("OrderedIndex",
+				"index size (%" PRId64 ") is not a multiple of page size; recreating %s",
+				fsize, file->name());
+		} else {
+			// Set the end of the file as the first free page
+			retval = file->freePage(fsize);
+			if (retval == E_ok) {
+				meta.om_flags |= OMETA_DIRTY;
+				retval = writeMeta();
+			}
+			return retval;
+		}
+	}
+
+	if (retval == E_ok) {
+		retval = format();
+		if (retval == E_ok)
+			*created = true;
+	}
+
+	return retval;
+}
+
+/**
+ * Closes the ordered index. The index header is marked
+ * clean.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+OrderedIndex::close()
+{
+	int retval = E_ok;
+
+	std::lock_guard<std::mutex> guard(mutex);
+
+	freeNodes();
+
+	if (opened) {
+		meta.om_flags &= ~OMETA_DIRTY;
+		retval = writeMeta();
+		file->close();
+		opened = false;
+	}
+
+	return retval;
+}
+
+/**
+ * Inserts the key in the index. If the key is already in
+ * the index, its value offset is updated.
+ *
+ * @param [in] key  - database key.
+ * @param [in] klen - database key length.
+ * @param [in] voff - value page offset.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+OrderedIndex::insert(const char *key, int klen, int64_t voff)
+{
+	int                     retval = E_ok;
+	int64_t                 offset = -1L;
+	oix_page_t              *op = 0;
+	std::vector<int64_t>    path;
+
+	std::lock_guard<std::mutex> guard(mutex);
+
+	retval = findLeaf(key, klen, &offset, op, &path);
+	if (retval == E_ok) {
+		int idx = LowerBound(op, key, klen, 0);
+		if (IsMatch(op, idx, key, klen)) {
+			if (op->op_recs[idx].or_off != voff) {
+				op->op_recs[idx].or_off = voff;
+				retval = writePage(offset, op);
+			}
+		} else {
+			oix_rec_t rec;
+			SetRecord(&rec, key, klen, voff);
+			retval = insertRecord(path, offset, op, idx, rec);
+		}
+	}
+
+	return retval;
+}
+
+/**
+ * Removes the key from the index.
+ *
+ * @param [in] key  - database key.
+ * @param [in] klen - database key length.
+ *
+ * @return E_ok on success, E_not_found if the key is not
+ * in the index, -ve error code on failure.
+ */
+int
+OrderedIndex::remove(const char *key, int klen)
+{
+	int         retval = E_ok;
+	int64_t     offset = -1L;
+	oix_page_t  *op = 0;
+
+	std::lock_guard<std::mutex> guard(mutex);
+
+	retval = findLeaf(key, klen, &offset, op, 0);
+	if (retval == E_ok) {
+		int idx = LowerBound(op, key, klen, 0);
+		if (!IsMatch(op, idx, key, klen)) {
+			retval = E_not_found;
+		} else {
+			op->op_count--;
+			memmove(op->op_recs + idx, op->op_recs + idx + 1,
+				(op->op_count - idx) * sizeof(oix_rec_t));
+			memset(op->op_recs + op->op_count, 0, sizeof(oix_rec_t));
+			retval = writePage(offset, op);
+		}
+	}
+
+	return retval;
+}
+
+/**
+ * Gets the keys in order, starting at the specified key.
+ *
+ * @param [in]  start     - start key; NULL to start with
+ *                          the first key.
+ * @param [in]  slen      - start key length.
+ * @param [in]  inclusive - include the start key if it is
+ *                          in the index?
+ * @param [in]  count     - maximum number of keys to get.
+ * @param [out] keys      - keys, appended in order. Fewer
+ *                          than count keys are added if the
+ *                          end of the index is reached.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+OrderedIndex::keys(
+	const char *start,
+	int slen,
+	bool inclusive,
+	int count,
+	std::vector<std::string> &keys)
+{
+	int         retval = E_ok;
+	int64_t     offset = -1L;
+	oix_page_t  *op = 0;
+	int         idx = 0;
+	int         added = 0;
+
+	std::lock_guard<std::mutex> guard(mutex);
+
+	retval = findLeaf(start, slen, &offset, op, 0);
+	if ((retval == E_ok) && start) {
+		idx = LowerBound(op, start, slen, 0);
+		if (!inclusive && IsMatch(op, idx, start, slen))
+			idx++;
+	}
+
+	while ((retval == E_ok) && (added < count)) {
+		if (idx < op->op_count) {
+			const oix_rec_t *rec = op->op_recs + idx;
+			keys.push_back(std::string(rec->or_key, rec->or_klen));
+			added++;
+			idx++;
+		} else if (op->op_noff == -1L) {
+			break;
+		} else {
+			offset = op->op_noff;
+			retval = getPage(offset, op);
+			idx = 0;
+		}
+	}
+
+	return retval;
+}
@@ -0,0 +1,126 @@
+#include "optrack.h"
+#include "error.h"
+
+/**
+ * Constructs the operation tracker. No operation is allowed
+ * until start() is called.
+ */
+OpTracker::OpTracker()
+{
+	for (int i = 0; i < RDB_STATS_STRIPES; ++i)
+		stripes[i].ops.store(0, std::memory_order_relaxed);
+	state.store(OPS_STOPPED, std::memory_order_relaxed);
+}
+
+/*
+ * Gets the number of operations in flight.
+ */
+int64_t
+OpTracker::inFlight() const
+{
+	int64_t n = 0;
+	for (int i = 0; i < RDB_STATS_STRIPES; ++i)
+		n += stripes[i].ops.load(std::memory_order_seq_cst);
+	return n;
+}
+
+/*
+ * Sets the state and wakes up the operations waiting for
+ * it to change.
+ */
+void
+OpTracker::setState(int s)
+{
+	std::lock_guard<std::mutex> guard(mutex);
+	state.store(s, std::memory_order_seq_cst);
+	cond.notify_all();
+}
+
+/**
+ * Marks the start of an operation. Waits if the operations
+ * are paused.
+ *
+ * @return E_ok on success, E_invalid_state if the operations
+ * are stopped.
+ */
+int
+OpTracker::enter()
+{
+	std::atomic<int64_t> &ops = stripes[StatsStripe()].ops;
+
+	for (;;) {
+		ops.fetch_add(1, std::memory_order_seq_cst);
+		if (state.load(std::memory_order_seq_cst) == OPS_RUNNING)
+			return E_ok;
+
+		// back off, and let the pause see that it is not
+		// in flight
+		ops.fetch_sub(1, std::memory_order_seq_cst);
+
+		std::unique_lock<std::mutex> guard(mutex);
+		cond.notify_all();
+		cond.wait(guard, [this] {
+			return state.load(std::memory_order_seq_cst) != OPS_PAUSED;
+		});
+
+		if (state.load(std::memory_order_seq_cst) == OPS_STOPPED)
+			return E_invalid_state;
+	}
+}
+
+/**
+ * Marks the end of an operation.
+ */
+void
+OpTracker::leave()
+{
+	stripes[StatsStripe()].ops.fetch_sub(1, std::memory_order_seq_cst);
+
+	if (state.load(std::memory_order_seq_cst) != OPS_RUNNING) {
+		std::lock_guard<std::mutex> guard(mutex);
+		cond.notify_all();
+	}
+}
+
+/**
+ * Marks the start of an operation while the operations are
+ * paused by the caller, e.g. for the pauser to keep the
+ * operations from being stopped once they are resumed.
+ */
+void
+OpTracker::hold()
+{
+	stripes[StatsStripe()].ops.fetch_add(1, std::memory_order_seq_cst);
+}
+
+/**
+ * Allows the operations, starting or resuming them.
+ */
+void
+OpTracker::start()
+{
+	setState(OPS_RUNNING);
+}
+
+/**
+ * Pauses the operations: the new operations wait until the
+ * operations are started or stopped. Waits for the operations
+ * in flight to end.
+ */
+void
+OpTracker::pause()
+{
+	std::unique_lock<std::mutex> guard(mutex);
+	state.store(OPS_PAUSED, std::memory_order_seq_cst);
+	cond.wait(guard, [this] { return inFlight() == 0; });
+}
+
+/**
+ * Stops the operations: the new operations, and the ones
+ * waiting, fail. To be called once the operations are paused.
+ */
+void
+OpTracker::stop()
+{
+	setState(OPS_STOPPED);
+}
@@ -37,7 +37,8 @@ PageMgr::PageMgr(int pageSize, int memUsage)
 			break;
 		}
 
-		pool = (char *)malloc(poolSize);
+		// aligned so that the key pages can be used for direct I/O
+		pool = (char *)AllocAligned(poolSize);
 		if (pool == 0) {
 			// reduce by 100 MB on every failure
 			poolSize -= (100 * 1024 * 1024);
@@ -1,4 +1,10 @@
+#include <algorithm>
+#include <chrono>
 #include <memory>
+#if defined(__linux__)
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
 #include "filesystem.h"
 #include "keyrec.h"
 #include "rdb.h"
@@ -131,6 +137,179 @@ Rdb::populateFreePages(const char *fname)
 	return retval;
 }
 
+/*
+ * Populates the ordered index with all the keys in the key
+ * file. Called when the ordered index is created afresh.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+Rdb::populateOrderedIndex()
+{
+	int                     retval = E_ok;
+	int64_t                 offset = 0;
+	int64_t                 nkeys = 0;
+	std::unique_ptr<char[]> buf(DBG_NEW char[kpSize]);
+	key_page_t              *kp = reinterpret_cast<key_page_t *>(buf.get());
+
+	LOG_DEBUG("Rdb", "populating ordered index");
+
+	while (retval == E_ok) {
+		retval = keyFile->read(offset, kp, kpSize);
+		if (retval != E_ok) {
+			if (retval == E_eof_detected) {
+				retval = E_ok;
+			}
+			break;
+		}
+
+		if (!IsKeyPageDeleted(kp) && (kp->kp_vcount > 0)) {
+			for (int i = 0; (retval == E_ok) && (i < NUM_OF_KEYS_IN_PAGE(kpSize)); ++i) {
+				const key_rec_t *kr = kp->kp_keys + i;
+				if (kr->kr_flags == KEY_INUSE) {
+					retval = oindex->insert(kr->kr_key, kr->kr_klen, kr->kr_voff);
+					nkeys++;
+				}
+			}
+		}
+
+		offset += kpSize;
+	}
+
+	LOG_DEBUG("Rdb", "%" PRId64 " keys added to ordered index", nkeys);
+
+	return retval;
+}
+
+/*
+ * Opens the shared hash table, <dbname>.hti, and publishes
+ * the first key page offsets of the hash table to it. The
+ * file is recreated if it is of a different database. The
+ * sequence numbers and the generation are retained so that
+ * the readers that have the file mapped are not confused.
+ *
+ * @param [in] fname - <dbname>.hti file.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+Rdb::openSharedHashTable(const char *fname)
+{
+	int             retval = E_ok;
+	int             oserr = 0;
+	int64_t         len = int64_t(sizeof(hti_header_t)) +
+				int64_t(htSize) * int64_t(sizeof(hti_entry_t));
+	hti_header_t    *hh;
+	hti_entry_t     *he;
+
+	LOG_DEBUG("Rdb", "sharing hash table in %s", fname);
+
+	std::unique_ptr<MappedFile> file(DBG_NEW MappedFile(fname, 0022));
+
+	retval = file->open(true);
+	if (retval != E_ok) {
+		return retval;
+	}
+
+	if (file->size(&oserr) != len) {
+		retval = file->truncate(0L, &oserr);
+		if (retval == E_ok) {
+			retval = file->truncate(len, &oserr);
+		}
+
+		if (retval != E_ok) {
+			LOG_SYSERR("Rdb", oserr, "failed to resize %s", fname);
+			return retval;
+		}
+	}
+
+	retval = file->map(len);
+	if (retval != E_ok) {
+		return retval;
+	}
+
+	hh = reinterpret_cast<hti_header_t *>(file->data());
+	if ((hh->hh_magic != HTI_MAGIC) ||
+		(hh->hh_htsize != htSize) ||
+		(hh->hh_kpsize != kpSize)) {
+		memset(file->data(), 0, size_t(len));
+		hh->hh_magic = HTI_MAGIC;
+		hh->hh_htsize = htSize;
+		hh->hh_kpsize = kpSize;
+	}
+
+	he = HashTableEntries(hh);
+	for (int i = 0; i < htSize; ++i) {
+		// a writer that died while updating leaves it odd
+		uint32_t seq = he[i].he_seq.load();
+		if ((seq & 1) != 0)
+			he[i].he_seq.store(seq + 1);
+		he[i].he_offset.store(hashTable->getOffset(i));
+	}
+
+	hh->hh_flags |= HTI_VALID;
+	hh->hh_gen.fetch_add(1);
+
+	hashTable->share(hh);
+	htiFile = file.release();
+
+	return retval;
+}
+
+/*
+ * Opens the database read-only: the key, value and shared
+ * hash table files are mapped by the read-only view. None
+ * of the files is created or modified.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+Rdb::openReadOnly(
+	const char *attrPath,
+	const char *idxPath,
+	const char *dbPath,
+	const char *htiPath)
+{
+	int retval = E_ok;
+
+	if (!snf::fs::exists(attrPath) ||
+		!snf::fs::exists(idxPath) ||
+		!snf::fs::exists(dbPath)) {
+		LOG_ERROR("Rdb", "database %s does not exist in %s",
+			name.c_str(), path.c_str());
+		return E_not_found;
+	}
+
+	AttrFile attrFile(attrPath, 0022);
+	retval = attrFile.open(true);
+	if (retval == E_ok) {
+		retval = attrFile.read();
+		attrFile.close();
+	}
+
+	if (retval != E_ok) {
+		return retval;
+	}
+
+	if (attrFile.getVersion() != RDB_FORMAT_VERSION) {
+		LOG_ERROR("Rdb", "database %s is of format version %d; open it for writing to upgrade",
+			name.c_str(), attrFile.getVersion());
+		return E_mismatch;
+	}
+
+	kpSize = attrFile.getKeyPageSize();
+	htSize = attrFile.getHashTableSize();
+
+	std::unique_ptr<RdbReader> pReader(DBG_NEW RdbReader(idxPath, dbPath, htiPath,
+					kpSize, htSize));
+	retval = pReader->open();
+	if (retval == E_ok) {
+		reader = pReader.release();
+	}
+
+	return retval;
+}
+
 /*
  * Main function to process the key pages and find the
  * correct key page that holds (or can hold) the key.
@@ -410,6 +589,278 @@ Rdb::removeBackupFile(const char *oldName)
 	return snf::fs::remove_file(newName);
 }
 
+/*
+ * Marks the start of a database operation. Waits if the
+ * operations are paused (for checkpoint).
+ *
+ * @return E_ok on success, E_invalid_state if the database
+ * is not open or is being closed.
+ */
+int
+Rdb::beginOp()
+{
+	int retval = ops.enter();
+	if (retval != E_ok) {
+		LOG_ERROR("Rdb", "DB is not open");
+	}
+	return retval;
+}
+
+/*
+ * Marks the end of a database operation.
+ */
+void
+Rdb::endOp()
+{
+	ops.leave();
+}
+
+/*
+ * Copies a database file that is not modified during the
+ * copy.
+ *
+ * @param [in] dstName - destination file.
+ * @param [in] srcName - source file.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+Rdb::copyFile(const char *dstName, const char *srcName)
+{
+	int         retval = E_ok;
+	int         oserr = 0;
+	int         bRead = 0;
+	int         bWritten = 0;
+	snf::file   src(srcName, 0022);
+	snf::file   dst(dstName, 0022);
+	std::unique_ptr<char []> buf(DBG_NEW char[CKPT_BLOCK_SIZE]);
+
+	snf::file::open_flags oflags;
+	oflags.o_read = true;
+
+	retval = src.open(oflags, 0600, &oserr);
+	if (retval != E_ok) {
+		LOG_SYSERR("Rdb", oserr, "failed to open file %s", srcName);
+		return retval;
+	}
+
+	retval = openCheckpointFile(&dst);
+	if (retval != E_ok) {
+		src.close();
+		return retval;
+	}
+
+	for (;;) {
+		retval = src.read(buf.get(), CKPT_BLOCK_SIZE, &bRead, &oserr);
+		if (retval != E_ok) {
+			LOG_SYSERR("Rdb", oserr, "failed to read file %s", srcName);
+			break;
+		} else if (bRead == 0) {
+			break;
+		}
+
+		retval = dst.write(buf.get(), bRead, &bWritten, &oserr);
+		if (retval != E_ok) {
+			LOG_SYSERR("Rdb", oserr, "failed to write file %s", dstName);
+			break;
+		} else if (bWritten != bRead) {
+			LOG_ERROR("Rdb", "expected to write %d bytes to %s, wrote only %d bytes",
+				bRead, dstName, bWritten);
+			retval = E_write_failed;
+			break;
+		}
+	}
+
+	if (retval == E_ok) {
+		retval = dst.sync(&oserr);
+		if (retval != E_ok) {
+			LOG_SYSERR("Rdb", oserr, "failed to sync file %s", dstName);
+		}
+	}
+
+	dst.close();
+	src.close();
+
+	return retval;
+}
+
+/*
+ * Makes the destination file share the data blocks of the
+ * source file (reflink) where the file system supports it.
+ *
+ * @param [in] dst - destination file.
+ * @param [in] src - source file.
+ *
+ * @return E_ok on success, -ve error code if the file could
+ * not be cloned.
+ */
+int
+Rdb::cloneFile(snf::file *dst, snf::file *src)
+{
+#if defined(__linux__) && defined(FICLONE)
+	if (ioctl(fhandle_t(*dst), FICLONE, fhandle_t(*src)) == 0) {
+		LOG_DEBUG("Rdb", "file %s cloned to %s", src->name(), dst->name());
+		return E_ok;
+	}
+
+	LOG_DEBUG("Rdb", "unable to clone file %s to %s, errno = %d",
+		src->name(), dst->name(), errno);
+#endif
+	return E_syscall_failed;
+}
+
+/*
+ * Opens (creates/truncates) the checkpoint file.
+ *
+ * @param [in] file - checkpoint file.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+Rdb::openCheckpointFile(snf::file *file)
+{
+	int retval = E_ok;
+	int oserr = 0;
+
+	snf::file::open_flags oflags;
+	oflags.o_read = true;
+	oflags.o_write = true;
+	oflags.o_create = true;
+	oflags.o_truncate = true;
+
+	retval = file->open(oflags, 0600, &oserr);
+	if (retval != E_ok) {
+		LOG_SYSERR("Rdb", oserr, "failed to open checkpoint file %s", file->name());
+	}
+
+	return retval;
+}
+
+/*
+ * Upgrades the database to the current format version. For
+ * version 1, the value pages are converted into a new file
+ * (<dbname>.db.upgrade), the version is updated, and the new
+ * file replaces the value file. An upgrade interrupted before
+ * the version is updated starts over; one interrupted after
+ * is completed by replacing the value file.
+ *
+ * @param [in] attrFile - attributes file, open for writing.
+ * @param [in] dbPath   - value file path.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+Rdb::upgradeFormat(AttrFile *attrFile, const char *dbPath)
+{
+	int         retval = E_ok;
+	int         oserr = 0;
+	std::string upgPath(dbPath);
+
+	upgPath.append(".upgrade");
+
+	if ((attrFile->getVersion() < 1) || (attrFile->getVersion() > RDB_FORMAT_VERSION)) {
+		LOG_ERROR("Rdb", "database %s is of unknown format version %d",
+			name.c_str(), attrFile->getVersion());
+		return E_mismatch;
+	}
+
+	if (attrFile->getVersion() == 1) {
+		int64_t     offset = 0;
+		int         bRead = 0;
+		int         bWritten = 0;
+		snf::file   src(dbPath, 0022);
+		snf::file   dst(upgPath, 0022);
+		std::unique_ptr<char []> buf(DBG_NEW char[CKPT_BLOCK_SIZE]);
+
+		LOG_INFO("Rdb", "upgrading database %s to format version %d",
+			name.c_str(), RDB_FORMAT_VERSION);
+
+		snf::file::open_flags oflags;
+		oflags.o_read = true;
+		oflags.o_create = true;
+
+		retval = src.open(oflags, 0600, &oserr);
+		if (retval != E_ok) {
+			LOG_SYSERR("Rdb", oserr, "failed to open file %s", dbPath);
+			return retval;
+		}
+
+		oflags.o_write = true;
+		oflags.o_truncate = true;
+
+		retval = dst.open(oflags, 0600, &oserr);
+		if (retval != E_ok) {
+			LOG_SYSERR("Rdb", oserr, "failed to open file %s", upgPath.c_str());
+			src.close();
+			return retval;
+		}
+
+		for (;;) {
+			retval = src.read(offset, buf.get(), CKPT_BLOCK_SIZE, &bRead, &oserr);
+			if (retval != E_ok) {
+				LOG_SYSERR("Rdb", oserr, "failed to read file %s", dbPath);
+				break;
+			} else if (bRead == 0) {
+				break;
+			}
+
+			// a partial page at the end is copied as it is
+			for (int i = 0; (i + int(sizeof(value_page_t))) <= bRead; i += int(sizeof(value_page_t))) {
+				value_page_v1_t ovp;
+				memcpy(&ovp, buf.get() + i, sizeof(ovp));
+				UpgradeValuePage(&ovp, reinterpret_cast<value_page_t *>(buf.get() + i));
+			}
+
+			retval = dst.write(offset, buf.get(), bRead, &bWritten, &oserr);
+			if (retval != E_ok) {
+				LOG_SYSERR("Rdb", oserr, "failed to write file %s", upgPath.c_str());
+				break;
+			} else if (bWritten != bRead) {
+				LOG_ERROR("Rdb", "expected to write %d bytes to %s, wrote only %d bytes",
+					bRead, upgPath.c_str(), bWritten);
+				retval = E_write_failed;
+				break;
+			}
+
+			offset += bRead;
+		}
+
+		if (retval == E_ok) {
+			retval = dst.sync(&oserr);
+			if (retval != E_ok) {
+				LOG_SYSERR("Rdb", oserr, "failed to sync file %s", upgPath.c_str());
+			}
+		}
+
+		dst.close();
+		src.close();
+
+		if (retval == E_ok) {
+			attrFile->setVersion(RDB_FORMAT_VERSION);
+			retval = attrFile->write();
+			if (retval == E_ok) {
+				retval = attrFile->sync(&oserr);
+				if (retval != E_ok) {
+					LOG_SYSERR("Rdb", oserr, "failed to sync file %s", attrFile->name());
+				}
+			}
+		}
+
+		if (retval != E_ok) {
+			return retval;
+		}
+	}
+
+	if (snf::fs::exists(upgPath.c_str())) {
+		retval = snf::fs::rename(dbPath, upgPath.c_str(), &oserr);
+		if (retval != E_ok) {
+			LOG_SYSERR("Rdb", oserr, "failed to rename %s to %s", upgPath.c_str(), dbPath);
+		}
+	}
+
+	return retval;
+}
+
 /**
  * Sets the key page size. Must be called before opening
  * the database for the first time (time of database
@@ -458,13 +909,13 @@ Rdb::setHashTableSize(int htsize)
 {
 	if (htsize <= 0) {
 		LOG_ERROR("Rdb",
-			"invalid hash table size (%d)", htSize);
+			"invalid hash table size (%d)", htsize);
 		return E_invalid_arg;
 	}
 
 	std::lock_guard<std::mutex> guard(openMutex);
 	if (!opened) {
-		this->htSize = NextPrime(htSize);
+		this->htSize = NextPrime(htsize);
 		return E_ok;
 	} else {
 		LOG_ERROR("Rdb", "DB is open; cannot set hash table size");
@@ -489,6 +940,11 @@ Rdb::open()
 	char    dbPath[MAXPATHLEN + 1];
 	char    attrPath[MAXPATHLEN + 1];
 	char    fdpPath[MAXPATHLEN + 1];
+	char    oixPath[MAXPATHLEN + 1];
+	char    htiPath[MAXPATHLEN + 1];
+	char    txnPath[MAXPATHLEN + 1];
+	char    seqPath[MAXPATHLEN + 1];
+	char    warmPath[MAXPATHLEN + 1];
 
 	std::lock_guard<std::mutex> guard(openMutex);
 	if (opened) {
@@ -499,11 +955,30 @@ Rdb::open()
 	strncpy(dbPath, idxPath, MAXPATHLEN);
 	strncpy(attrPath, idxPath, MAXPATHLEN);
 	strncpy(fdpPath, idxPath, MAXPATHLEN);
+	strncpy(oixPath, idxPath, MAXPATHLEN);
+	strncpy(htiPath, idxPath, MAXPATHLEN);
+	strncpy(txnPath, idxPath, MAXPATHLEN);
+	strncpy(seqPath, idxPath, MAXPATHLEN);
+	strncpy(warmPath, idxPath, MAXPATHLEN);
 
 	strncat(idxPath, ".idx", MAXPATHLEN);
 	strncat(dbPath, ".db", MAXPATHLEN);
 	strncat(attrPath, ".attr", MAXPATHLEN);
 	strncat(fdpPath, ".fdp", MAXPATHLEN);
+	strncat(oixPath, ".oix", MAXPATHLEN);
+	strncat(htiPath, ".hti", MAXPATHLEN);
+	strncat(txnPath, ".txn", MAXPATHLEN);
+	strncat(seqPath, ".seq", MAXPATHLEN);
+	strncat(warmPath, ".warm", MAXPATHLEN);
+
+	if (options.readOnly()) {
+		retval = openReadOnly(attrPath, idxPath, dbPath, htiPath);
+		if (retval == E_ok) {
+			opened = true;
+			ops.start();
+		}
+		return retval;
+	}
 
 	std::unique_ptr<AttrFile> attrFile(DBG_NEW AttrFile(attrPath, 0022));
 	retval = attrFile->open();
@@ -512,12 +987,13 @@ Rdb::open()
 	}
 
 	retval = attrFile->read();
-	if (retval != E_ok) {
-		if (retval == E_eof_detected) {
-			attrFile->setKeyPageSize(kpSize);
-			attrFile->setHashTableSize(htSize);
-			retval = attrFile->write();
-		}
+	if (retval == E_ok) {
+		retval = upgradeFormat(attrFile.get(), dbPath);
+	} else if (retval == E_eof_detected) {
+		attrFile->setKeyPageSize(kpSize);
+		attrFile->setHashTableSize(htSize);
+		attrFile->setVersion(RDB_FORMAT_VERSION);
+		retval = attrFile->write();
 	}
 
 	attrFile->close();
@@ -530,16 +1006,18 @@ Rdb::open()
 	htSize = attrFile->getHashTableSize();
 
 	std::unique_ptr<KeyFile> pKeyFile(DBG_NEW KeyFile(idxPath, 0022));
-	retval = pKeyFile->open(options.syncIndexFile());
+	retval = pKeyFile->open(options.syncIndexFile(), options.directIO());
 	if (retval != E_ok) {
 		return retval;
 	}
+	pKeyFile->setChecksums(kpSize, options.verifyChecksums());
 
 	std::unique_ptr<ValueFile> pValueFile(DBG_NEW ValueFile(dbPath, 0022));
-	retval = pValueFile->open(options.syncDataFile());
+	retval = pValueFile->open(options.syncDataFile(), options.directIO());
 	if (retval != E_ok) {
 		return retval;
 	}
+	pValueFile->setChecksums(int(sizeof(value_page_t)), options.verifyChecksums());
 
 	hashTable = DBG_NEW HashTable();
 	retval = hashTable->allocate(htSize);
@@ -557,16 +1035,177 @@ Rdb::open()
 		retval = populateFreePages(fdpPath);
 	}
 
-	if (retval != E_ok) {
-		delete valueFile;
-		delete keyFile;
-		delete hashTable;
-	} else {
-		opened = true;
+	if (retval == E_ok) {
+		if (options.shareHashTable()) {
+			retval = openSharedHashTable(htiPath);
+		} else if (snf::fs::exists(htiPath)) {
+			// The readers would not see the updates
+			LOG_DEBUG("Rdb", "removing shared hash table %s", htiPath);
+			snf::fs::remove_file(htiPath);
+		}
 	}
 
-	return retval;
-}
+	if (retval == E_ok) {
+		if (options.orderedIndex()) {
+			bool created = false;
+
+			oindex = DBG_NEW OrderedIndex(oixPath, kpSize, cache);
+			retval = oindex->open(options.syncIndexFile(), options.directIO(), &created);
+			if ((retval == E_ok) && created) {
+				retval = populateOrderedIndex();
+			}
+		} else if (snf::fs::exists(oixPath)) {
+			// The index would go stale; it is rebuilt when enabled again
+			LOG_DEBUG("Rdb", "removing ordered index %s", oixPath);
+			snf::fs::remove_file(oixPath);
+		}
+	}
+
+	if ((retval == E_ok) && snf::fs::exists(seqPath)) {
+		retval = openSeqFile(seqPath);
+	}
+
+	if ((retval == E_ok) && options.changeFeed()) {
+		// A replica promoted to primary continues the
+		// sequence numbers of the feed it replicated.
+		feed = DBG_NEW ChangeFeed(path, name, options.getFeedSegmentSize(),
+				options.getFeedSegments(), options.syncDataFile());
+		retval = feed->open(appliedSeq);
+	}
+
+	if (retval == E_ok) {
+		txnLog = DBG_NEW TxnLog(txnPath, 0022);
+		retval = txnLog->open();
+		if (retval == E_ok) {
+			retval = txnLog->replay([this] (const txn_writes_t &writes) {
+				return replayWrites(writes);
+			});
+		}
+	}
+
+	if (retval != E_ok) {
+		if (txnLog) {
+			delete txnLog;
+			txnLog = 0;
+		}
+		if (feed) {
+			delete feed;
+			feed = 0;
+		}
+		if (seqFile) {
+			delete seqFile;
+			seqFile = 0;
+		}
+		if (oindex) {
+			delete oindex;
+			oindex = 0;
+		}
+		delete valueFile;
+		delete keyFile;
+		delete hashTable;
+		if (htiFile) {
+			delete htiFile;
+			htiFile = 0;
+		}
+	} else {
+		opened = true;
+		ops.start();
+		startSweeper();
+		startWarmer(warmPath);
+	}
+
+	return retval;
+}
+
+/*
+ * Visits the key pages of the hash table entry in order,
+ * reading them in if they are not in memory. Must be
+ * called with the hash table entry locked.
+ *
+ * @param [in] hindex  - hash table index.
+ * @param [in] visitor - called for every key page; a
+ *                       non-E_ok return stops the walk.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+Rdb::visitKeyPages(int hindex, const std::function<int(key_page_t *)> &visitor)
+{
+	int             retval = E_ok;
+	int64_t         nextOffset = hashTable->getOffset(hindex);
+	key_page_node_t *kpn = hashTable->getKeyPageNodeList(hindex);
+
+	while ((retval == E_ok) && (nextOffset != -1L)) {
+		if (kpn) {
+			cache->touch(kpn);
+			if (kpn->kpn_kp == 0) {
+				retval = cache->update(kpn, nextOffset);
+			}
+		} else {
+			retval = cache->get(kpn, nextOffset);
+			if (retval == E_ok) {
+				hashTable->addKeyPageNode(hindex, kpn);
+			}
+		}
+
+		if (retval != E_ok) {
+			LOG_ERROR("Rdb",
+				"failed to read key page at offset %" PRId64,
+				nextOffset);
+		} else {
+			retval = visitor(kpn->kpn_kp);
+			nextOffset = kpn->kpn_kp->kp_noff;
+			kpn = kpn->kpn_next;
+		}
+	}
+
+	return retval;
+}
+
+/*
+ * Finds the key and reads its value page. Must be called
+ * with the hash table entry locked. The value page may
+ * be expired; it is up to the caller to check it.
+ *
+ * @param [inout] ki - key information.
+ * @param [out]   vp - value page.
+ *
+ * @return E_ok on success, E_not_found if the key is not
+ * found, -ve error code on failure.
+ */
+int
+Rdb::findValue(key_info_t *ki, value_page_t *vp)
+{
+	int retval = processKeyPages(ki, GET);
+	if (retval == E_ok) {
+		ASSERT((ki->ki_kpn != 0), "Rdb", 0,
+			"found the key but key page node is not set");
+		ASSERT((ki->ki_kpn->kpn_kp != 0), "Rdb", 0,
+			"found the key but key page is not set");
+		ASSERT((ki->ki_kpn->kpn_kpoff != -1), "Rdb", 0,
+			"found the key but key page offset is not set");
+		ASSERT((ki->ki_kidx != -1), "Rdb", 0,
+			"found the key but key index in page is not set");
+		ASSERT((ki->ki_voff != -1), "Rdb", 0,
+			"found the key but value page offset is not set");
+
+		retval = valueFile->read(ki->ki_voff, vp);
+		if (retval != E_ok) {
+			LOG_ERROR("Rdb", "failed to read value page at offset %" PRId64 " from %s",
+				ki->ki_voff, valueFile->name());
+		} else {
+			ASSERT(!IsValuePageDeleted(vp), "Rdb", 0,
+				"value is already deleted");
+			ASSERT((ki->ki_klen == vp->vp_klen), "Rdb", 0,
+				"key length mismatch (expected %d, found %d)",
+				ki->ki_klen, vp->vp_klen);
+			ASSERT((memcmp(ki->ki_key, vp->vp_key, ki->ki_klen) == 0), "Rdb", 0,
+				"key mismatch");
+		}
+	}
+
+	return retval;
+}
 
 /**
  * Gets the value for the key from the database.
@@ -578,7 +1217,7 @@ Rdb::open()
  *                         actual value size on output.
  *
  * @return E_ok on success, E_not_found if the value is not
- * found, -ve error code on failure.
+ * found (or is expired), -ve error code on failure.
  */
 int
 Rdb::get(
@@ -612,45 +1251,31 @@ Rdb::get(
 		return E_invalid_arg;
 	}
 
-	{
-		std::lock_guard<std::mutex> guard(opMutex);
-		opCount++;
+	LatencyTimer timer(getLatency);
+
+	if (reader) {
+		return reader->get(key, klen, value, vlen);
+	}
+
+	if ((retval = beginOp()) != E_ok) {
+		return retval;
 	}
 
 	hindex = hash(key, klen, htSize);
 	ASSERT(((hindex >= 0) && (hindex < htSize)), "Rdb", 0,
 		"invalid hash value (%d)", hindex);
 
-	HTLockGuard guard(hashTable, hindex, false);
-
-	SetKeyInfo(&ki, key, klen, hindex);
-
-	retval = processKeyPages(&ki, GET);
-	if (retval == E_ok) {
-		ASSERT((ki.ki_kpn != 0), "Rdb", 0,
-			"found the key but key page node is not set");
-		ASSERT((ki.ki_kpn->kpn_kp != 0), "Rdb", 0,
-			"found the key but key page is not set");
-		ASSERT((ki.ki_kpn->kpn_kpoff != -1), "Rdb", 0,
-			"found the key but key page offset is not set");
-		ASSERT((ki.ki_kidx != -1), "Rdb", 0,
-			"found the key but key index in page is not set");
-		ASSERT((ki.ki_voff != -1), "Rdb", 0,
-			"found the key but value page offset is not set");
+	{
+		HTLockGuard guard(hashTable, hindex, false);
 
-		retval = valueFile->read(ki.ki_voff, &vp);
-		if (retval != E_ok) {
-			LOG_ERROR("Rdb", "failed to read value page at offset %" PRId64 " from %s",
-				ki.ki_voff, valueFile->name());
-		} else {
-			ASSERT(!IsValuePageDeleted(&vp), "Rdb", 0,
-				"value is already deleted");
-			ASSERT((klen == vp.vp_klen), "Rdb", 0,
-				"key length mismatch (expected %d, found %d)", klen, vp.vp_klen);
-			ASSERT((memcmp(key, vp.vp_key, klen) == 0), "Rdb", 0,
-				"key mismatch");
+		SetKeyInfo(&ki, key, klen, hindex);
 
-			if (vp.vp_vlen > *vlen) {
+		retval = findValue(&ki, &vp);
+		if (retval == E_ok) {
+			if (IsValuePageExpired(&vp, time(0))) {
+				LOG_DEBUG("Rdb", "key expired");
+				retval = E_not_found;
+			} else if (vp.vp_vlen > *vlen) {
 				retval = E_insufficient_buffer;
 			} else {
 				if (vp.vp_vlen < *vlen) {
@@ -661,127 +1286,70 @@ Rdb::get(
 		}
 	}
 
-	{
-		std::lock_guard<std::mutex> guard(opMutex);
-		opCount--;
-	}
+	endOp();
 
 	return retval;
 }
 
-/**
- * Set the key/value pair in the database. It is also used to
- * update the value in the database.
+/*
+ * Sets the key/value pair in the database. Must be called
+ * with the hash table entry locked exclusively.
  *
- * @param [in]  key     - database key.
- * @param [in]  klen    - database key length.
- * @param [in]  value   - value for the corresponding key.
- * @param [in]  vlen    - value length.
- * @param [in]  updater - the updater object.
+ * @param [inout] ki      - key information.
+ * @param [in]    value   - value for the key.
+ * @param [in]    vlen    - value length.
+ * @param [in]    expiry  - expiry time in seconds since epoch.
+ *                          0 if the value never expires, -1
+ *                          to retain the expiry time of the
+ *                          value being updated by the updater.
+ * @param [in]    updater - the updater object.
  *
- * - updater == 0
- *   If the key does not exist, a new key/value pair is
- *   added to the database.
- *   If the key already exists, its value is set to the new
- *   value specified.
- * - updater != 0
- *   If the key does not exist, a new key/value pair is
- *   added to the database.
- *   If the key already exists, its existing value is passed
- *   to the update() function of updater. Then the value
- *   returned by getUpdatedValue() is persisted in the
- *   database.
+ * An expired key is treated as if it does not exist.
  *
  * @return E_ok on success, -ve error code on failure.
  */
 int
-Rdb::set(
-	const char *key,
-	int klen,
+Rdb::store(
+	key_info_t *ki,
 	const char *value,
 	int vlen,
+	int64_t expiry,
 	Updater *updater)
 {
 	int             retval;
-	int             hindex = -1;
 	value_page_t    vp;
-	key_info_t      ki;
+	value_page_t    ovp;
+	bool            indexed = false;
 	UnwindStack     ustk;
 
-	if ((key == 0) || (*key == '\0')) {
-		LOG_ERROR("Rdb", "invalid key specified");
-		return E_invalid_arg;
-	}
-
-	if (klen <= 0) {
-		LOG_ERROR("Rdb", "invalid key length specified");
-		return E_invalid_arg;
-	}
-
-	if ((value == 0) || (*value == '\0')) {
-		LOG_ERROR("Rdb", "invalid value specified");
-		return E_invalid_arg;
-	}
-
-	if (vlen <= 0) {
-		LOG_ERROR("Rdb", "invalid value length specified");
-		return E_invalid_arg;
-	}
-
-	{
-		std::lock_guard<std::mutex> guard(opMutex);
-		opCount++;
-	}
-
-	hindex = hash(key, klen, htSize);
-	ASSERT(((hindex >= 0) && (hindex < htSize)), "Rdb", 0,
-		"invalid hash value (%d)", hindex);
-
-	HTLockGuard guard(hashTable, hindex, true);
-
-	SetKeyInfo(&ki, key, klen, hindex);
+	InitValuePage(&vp, ki->ki_key, ki->ki_klen, value, vlen);
 
-	InitValuePage(&vp, key, klen, value, vlen);
-
-	retval = processKeyPages(&ki, GET);
+	retval = findValue(ki, &ovp);
 	if (retval == E_ok) {
-		ASSERT((ki.ki_kpn != 0), "Rdb", 0,
-			"found the key but key page node is not set");
-		ASSERT((ki.ki_kpn->kpn_kp != 0), "Rdb", 0,
-			"found the key but key page is not set");
-		ASSERT((ki.ki_kpn->kpn_kpoff != -1), "Rdb", 0,
-			"found the key but key page offset is not set");
-		ASSERT((ki.ki_kidx != -1), "Rdb", 0,
-			"found the key but key index in page is not set");
-		ASSERT((ki.ki_voff != -1), "Rdb", 0,
-			"found the key but value page offset is not set");
-
 		LOG_DEBUG("Rdb", "key exists");
 
-		if (updater) {
+		if (IsValuePageExpired(&ovp, time(0))) {
+			LOG_DEBUG("Rdb", "key expired; replacing the value");
+		} else if (updater) {
 			LOG_DEBUG("Rdb", "updating the value");
 
-			retval = valueFile->read(ki.ki_voff, &vp);
-			if (retval != E_ok) {
-				LOG_ERROR("Rdb", "failed to read value page at offset %" PRId64 " from %s",
-					ki.ki_voff, valueFile->name());
-			} else {
-				ASSERT(!IsValuePageDeleted(&vp), "Rdb", 0,
-					"value is already deleted");
-				ASSERT((klen == vp.vp_klen), "Rdb", 0,
-					"key length mismatch (expected %d, found %d)", klen, vp.vp_klen);
-				ASSERT((memcmp(key, vp.vp_key, klen) == 0), "Rdb", 0,
-					"key mismatch");
-
-				retval = updater->update(vp.vp_value, vp.vp_vlen);
-				if (retval == E_ok) {
-					retval = updater->getUpdatedValue(vp.vp_value, &(vp.vp_vlen));
-				}
+			memcpy(&vp, &ovp, sizeof(vp));
+
+			retval = updater->update(vp.vp_value, vp.vp_vlen);
+			if (retval == E_ok) {
+				int nlen = vp.vp_vlen;
+				retval = updater->getUpdatedValue(vp.vp_value, &nlen);
+				vp.vp_vlen = short(nlen);
+			}
+
+			if (expiry < 0) {
+				expiry = ovp.vp_expiry;
 			}
 		}
 
 		if (retval == E_ok) {
-			retval = valueFile->write(ki.ki_voff, &vp);
+			vp.vp_expiry = (expiry > 0) ? uint32_t(expiry) : 0;
+			retval = valueFile->write(ki->ki_voff, &vp);
 			if (retval != E_ok) {
 				LOG_ERROR("Rdb", "failed to write value to %s",
 					valueFile->name());
@@ -791,49 +1359,67 @@ Rdb::set(
 
 		LOG_DEBUG("Rdb", "writing a new value");
 
-		retval = valueFile->write(&(ki.ki_voff), &vp);
+		vp.vp_expiry = (expiry > 0) ? uint32_t(expiry) : 0;
+
+		retval = valueFile->write(&(ki->ki_voff), &vp);
 		if (retval != E_ok) {
 			LOG_ERROR("Rdb", "failed to write value to %s",
 				valueFile->name());
 		} else {
-			ustk.freePage(valueFile, ki.ki_voff);
-			ustk.writeFlags(valueFile, &vp, ki.ki_voff, VPAGE_DELETED);
+			ustk.freePage(valueFile, ki->ki_voff);
+			ustk.writeFlags(valueFile, &vp, ki->ki_voff, VPAGE_DELETED);
+
+			if (oindex) {
+				retval = oindex->insert(ki->ki_key, ki->ki_klen, ki->ki_voff);
+				indexed = (retval == E_ok);
+			}
 
-			retval = processKeyPages(&ki, SET);
-			if (retval == E_not_found) {
-				retval = addNewPage(&ki);
+			if (retval == E_ok) {
+				retval = processKeyPages(ki, SET);
+				if (retval == E_not_found) {
+					retval = addNewPage(ki);
+				}
 			}
 		}
 	}
 
+	if ((retval != E_ok) && indexed) {
+		oindex->remove(ki->ki_key, ki->ki_klen);
+	}
+
 	ustk.unwind(retval);
 
-	{
-		std::lock_guard<std::mutex> guard(opMutex);
-		opCount--;
+	if (retval == E_ok) {
+		logChange(CHANGE_SET, ki->ki_key, ki->ki_klen,
+			vp.vp_value, vp.vp_vlen, vp.vp_expiry);
 	}
 
 	return retval;
 }
 
-/**
- * Removes the key/value pair from the database.
+/*
+ * Validates the arguments, locks the hash table entry, and
+ * sets the key/value pair in the database.
  *
- * @param [in]  key     - database key.
- * @param [in]  klen    - database key length.
- * 
  * @return E_ok on success, -ve error code on failure.
  */
 int
-Rdb::remove(
+Rdb::setValue(
 	const char *key,
-	int klen)
+	int klen,
+	const char *value,
+	int vlen,
+	int64_t expiry,
+	Updater *updater)
 {
-	int         retval;
-	int         hindex = -1;
-	key_info_t  ki;
-	key_info_t  dki;
-	UnwindStack ustk;
+	int             retval;
+	int             hindex = -1;
+	key_info_t      ki;
+
+	if (options.readOnly()) {
+		LOG_ERROR("Rdb", "database is opened read-only");
+		return E_invalid_state;
+	}
 
 	if ((key == 0) || (*key == '\0')) {
 		LOG_ERROR("Rdb", "invalid key specified");
@@ -845,281 +1431,2545 @@ Rdb::remove(
 		return E_invalid_arg;
 	}
 
-	{
-		std::lock_guard<std::mutex> guard(opMutex);
-		opCount++;
+	if ((value == 0) || (*value == '\0')) {
+		LOG_ERROR("Rdb", "invalid value specified");
+		return E_invalid_arg;
 	}
 
-	hindex = hash(key, klen, htSize);
-	ASSERT(((hindex >= 0) && (hindex < htSize)), "Rdb", 0,
-		"invalid hash value (%d)", hindex);
-
-	HTLockGuard guard(hashTable, hindex, true);
-
-	SetKeyInfo(&ki, key, klen, hindex);
-
-	retval = processKeyPages(&ki, GET);
-	if (retval == E_ok) {
-		ASSERT((ki.ki_kpn != 0), "Rdb", 0,
-			"found the key but key page node is not set");
-		ASSERT((ki.ki_kpn->kpn_kp != 0), "Rdb", 0,
-			"found the key but key page is not set");
-		ASSERT((ki.ki_kpn->kpn_kpoff != -1), "Rdb", 0,
-			"found the key but key page offset is not set");
-		ASSERT((ki.ki_kidx != -1), "Rdb", 0,
-			"found the key but key index in page is not set");
-		ASSERT((ki.ki_voff != -1), "Rdb", 0,
-			"found the key but value page offset is not set");
+	if (vlen <= 0) {
+		LOG_ERROR("Rdb", "invalid value length specified");
+		return E_invalid_arg;
+	}
 
-		// Mark the value page as deleted
-		retval = valueFile->writeFlags(ki.ki_voff, 0, VPAGE_DELETED);
-		if (retval != E_ok) {
-			LOG_ERROR("Rdb", "failed to mark value page as deleted");
-		} else {
-			ustk.writeFlags(valueFile, 0, ki.ki_voff, 0);
+	LatencyTimer timer(setLatency);
 
-			SetKeyInfo(&dki, key, klen, hindex);
+	if ((retval = beginOp()) != E_ok) {
+		return retval;
+	}
 
-			retval = processKeyPages(&dki, DEL);
-			ASSERT((retval == E_ok), "Rdb", 0,
-				"unable to delete the key that was recently located");
+	hindex = hash(key, klen, htSize);
+	ASSERT(((hindex >= 0) && (hindex < htSize)), "Rdb", 0,
+		"invalid hash value (%d)", hindex);
 
-			ASSERT((ki.ki_kpn == dki.ki_kpn), "Rdb", 0,
-				"found and deleted key page node mismatch");
-			ASSERT((ki.ki_kpn->kpn_kp == dki.ki_kpn->kpn_kp), "Rdb", 0,
-				"found and deleted key page mismatch");
-			ASSERT((ki.ki_kpn->kpn_kpoff == dki.ki_kpn->kpn_kpoff), "Rdb", 0,
-				"found and deleted key page offset mismatch");
-			ASSERT((ki.ki_kidx == dki.ki_kidx), "Rdb", 0,
-				"found and deleted key index mismatch");
+	{
+		HTLockGuard guard(hashTable, hindex, true);
 
-			// The key is deleted now
+		SetKeyInfo(&ki, key, klen, hindex);
 
-			if (ki.ki_kpn->kpn_kp->kp_vcount <= 0) {
-				// It was the last key in the page
+		retval = store(&ki, value, vlen, expiry, updater);
+	}
 
-				key_page_t *prev_kp = 0, *next_kp = 0;
-				key_page_node_t *prev_kpn, *next_kpn;
-				int64_t prev_kpoff, next_kpoff;
+	endOp();
 
-				prev_kpoff = dki.ki_kpn->kpn_kp->kp_poff;
-				prev_kpn = dki.ki_kpn->kpn_prev;
-				next_kpoff = dki.ki_kpn->kpn_kp->kp_noff;
-				next_kpn = dki.ki_kpn->kpn_next;
+	return retval;
+}
 
-				LOG_DEBUG("Rdb",
-					"previous page offset = %" PRId64
+/**
+ * Set the key/value pair in the database. It is also used to
+ * update the value in the database.
+ *
+ * @param [in]  key     - database key.
+ * @param [in]  klen    - database key length.
+ * @param [in]  value   - value for the corresponding key.
+ * @param [in]  vlen    - value length.
+ * @param [in]  updater - the updater object.
+ *
+ * - updater == 0
+ *   If the key does not exist, a new key/value pair is
+ *   added to the database.
+ *   If the key already exists, its value is set to the new
+ *   value specified. The key no longer expires.
+ * - updater != 0
+ *   If the key does not exist, a new key/value pair is
+ *   added to the database.
+ *   If the key already exists, its existing value is passed
+ *   to the update() function of updater. Then the value
+ *   returned by getUpdatedValue() is persisted in the
+ *   database. The expiry time of the key is retained.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+Rdb::set(
+	const char *key,
+	int klen,
+	const char *value,
+	int vlen,
+	Updater *updater)
+{
+	return setValue(key, klen, value, vlen, -1L, updater);
+}
+
+/**
+ * Set the key/value pair in the database along with the
+ * time to live for the key. Once the time to live elapses,
+ * the key is not visible any more; it is reclaimed by the
+ * background sweep (see RdbOptions::setSweepInterval())
+ * or by sweepExpired().
+ *
+ * @param [in]  key     - database key.
+ * @param [in]  klen    - database key length.
+ * @param [in]  value   - value for the corresponding key.
+ * @param [in]  vlen    - value length.
+ * @param [in]  ttl     - time to live in seconds.
+ * @param [in]  updater - the updater object. See set().
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+Rdb::setWithTTL(
+	const char *key,
+	int klen,
+	const char *value,
+	int vlen,
+	int ttl,
+	Updater *updater)
+{
+	if (ttl <= 0) {
+		LOG_ERROR("Rdb", "invalid time to live (%d) specified", ttl);
+		return E_invalid_arg;
+	}
+
+	return setValue(key, klen, value, vlen, int64_t(time(0)) + ttl, updater);
+}
+
+/**
+ * Sets the time to live for an existing key.
+ *
+ * @param [in]  key     - database key.
+ * @param [in]  klen    - database key length.
+ * @param [in]  ttl     - time to live in seconds. 0 removes
+ *                        the expiry time i.e. the key never
+ *                        expires.
+ *
+ * @return E_ok on success, E_not_found if the key is not
+ * found (or is expired), -ve error code on failure.
+ */
+int
+Rdb::expire(
+	const char *key,
+	int klen,
+	int ttl)
+{
+	int             retval;
+	int             hindex = -1;
+	time_t          now = time(0);
+	value_page_t    vp;
+	key_info_t      ki;
+
+	if (options.readOnly()) {
+		LOG_ERROR("Rdb", "database is opened read-only");
+		return E_invalid_state;
+	}
+
+	if ((key == 0) || (*key == '\0')) {
+		LOG_ERROR("Rdb", "invalid key specified");
+		return E_invalid_arg;
+	}
+
+	if (klen <= 0) {
+		LOG_ERROR("Rdb", "invalid key length specified");
+		return E_invalid_arg;
+	}
+
+	if (ttl < 0) {
+		LOG_ERROR("Rdb", "invalid time to live (%d) specified", ttl);
+		return E_invalid_arg;
+	}
+
+	if ((retval = beginOp()) != E_ok) {
+		return retval;
+	}
+
+	hindex = hash(key, klen, htSize);
+	ASSERT(((hindex >= 0) && (hindex < htSize)), "Rdb", 0,
+		"invalid hash value (%d)", hindex);
+
+	{
+		HTLockGuard guard(hashTable, hindex, true);
+
+		SetKeyInfo(&ki, key, klen, hindex);
+
+		retval = findValue(&ki, &vp);
+		if (retval == E_ok) {
+			if (IsValuePageExpired(&vp, now)) {
+				LOG_DEBUG("Rdb", "key expired");
+				retval = E_not_found;
+			} else {
+				vp.vp_expiry = ttl ? uint32_t(now + ttl) : 0;
+				retval = valueFile->write(ki.ki_voff, &vp);
+				if (retval != E_ok) {
+					LOG_ERROR("Rdb", "failed to write value to %s",
+						valueFile->name());
+				} else {
+					logChange(CHANGE_SET, key, klen,
+						vp.vp_value, vp.vp_vlen, vp.vp_expiry);
+				}
+			}
+		}
+	}
+
+	endOp();
+
+	return retval;
+}
+
+/*
+ * Applies a batch of increments to the counter with a single
+ * 8-byte write. Each increment gets the counter value as if
+ * the increments were applied one at a time in order.
+ *
+ * @param [in]    key   - database key.
+ * @param [in]    klen  - database key length.
+ * @param [inout] batch - pending increments.
+ */
+void
+Rdb::applyIncrements(const char *key, int klen, std::vector<counter_op_t *> &batch)
+{
+	int             retval;
+	int             hindex = -1;
+	int64_t         counter = 0;
+	value_page_t    vp;
+	key_info_t      ki;
+
+	hindex = hash(key, klen, htSize);
+	ASSERT(((hindex >= 0) && (hindex < htSize)), "Rdb", 0,
+		"invalid hash value (%d)", hindex);
+
+	if ((retval = beginOp()) != E_ok) {
+		for (counter_op_t *op : batch) {
+			op->status = retval;
+			op->done = true;
+		}
+		return;
+	}
+
+	{
+		HTLockGuard guard(hashTable, hindex, true);
+
+		SetKeyInfo(&ki, key, klen, hindex);
+
+		retval = findValue(&ki, &vp);
+		if ((retval == E_ok) && IsValuePageExpired(&vp, time(0))) {
+			LOG_DEBUG("Rdb", "key expired; starting a new counter");
+			retval = E_not_found;
+		}
+
+		if (retval == E_ok) {
+			if (vp.vp_vlen != int(sizeof(int64_t))) {
+				LOG_ERROR("Rdb", "value of length %d is not a counter", vp.vp_vlen);
+				retval = E_invalid_state;
+			} else {
+				memcpy(&counter, vp.vp_value, sizeof(int64_t));
+			}
+		}
+
+		if ((retval == E_ok) || (retval == E_not_found)) {
+			for (counter_op_t *op : batch) {
+				counter += op->delta;
+				op->result = counter;
+			}
+
+			if (retval == E_ok) {
+				retval = valueFile->writeValue(ki.ki_voff, &vp,
+						reinterpret_cast<const char *>(&counter),
+						int(sizeof(counter)));
+				if (retval == E_ok) {
+					logChange(CHANGE_SET, key, klen,
+						reinterpret_cast<const char *>(&counter),
+						int(sizeof(counter)), vp.vp_expiry);
+				}
+			} else {
+				SetKeyInfo(&ki, key, klen, hindex);
+				retval = store(&ki, reinterpret_cast<const char *>(&counter),
+						int(sizeof(counter)), 0L, 0);
+			}
+		}
+	}
+
+	endOp();
+
+	LOG_DEBUG("Rdb", "%d increments applied, status = %d", int(batch.size()), retval);
+
+	for (counter_op_t *op : batch) {
+		op->status = retval;
+		op->done = true;
+	}
+}
+
+/**
+ * Increments the counter. The counter is a key whose value
+ * is a 64-bit integer (in native byte order) i.e. the value
+ * length is 8 bytes. If the key does not exist (or is
+ * expired), the counter is created with value 0 and then
+ * incremented. The increment is done in place with a single
+ * 8-byte write to the value page.
+ *
+ * Concurrent increments to the same key are combined: one
+ * of the threads applies all the pending increments with a
+ * single read and a single write.
+ *
+ * @param [in]  key    - database key.
+ * @param [in]  klen   - database key length.
+ * @param [in]  delta  - increment (may be negative).
+ * @param [out] newval - counter value after the increment.
+ *
+ * @return E_ok on success, E_invalid_state if the value is
+ * not a counter, -ve error code on failure.
+ */
+int
+Rdb::increment(
+	const char *key,
+	int klen,
+	int64_t delta,
+	int64_t *newval)
+{
+	counter_op_t    op = { delta, 0, E_ok, false };
+	counter_slot_t  *slot = 0;
+
+	if (options.readOnly()) {
+		LOG_ERROR("Rdb", "database is opened read-only");
+		return E_invalid_state;
+	}
+
+	if ((key == 0) || (*key == '\0')) {
+		LOG_ERROR("Rdb", "invalid key specified");
+		return E_invalid_arg;
+	}
+
+	if ((klen <= 0) || (klen > MAX_KEY_LENGTH)) {
+		LOG_ERROR("Rdb", "invalid key length specified");
+		return E_invalid_arg;
+	}
+
+	std::string ckey(key, klen);
+
+	std::unique_lock<std::mutex> guard(counterMutex);
+
+	slot = counters[ckey];
+	if (slot == 0) {
+		slot = DBG_NEW counter_slot_t;
+		slot->busy = false;
+		slot->refs = 0;
+		counters[ckey] = slot;
+	}
+
+	slot->refs++;
+	slot->pending.push_back(&op);
+
+	while (!op.done) {
+		if (slot->busy) {
+			slot->cond.wait(guard);
+		} else {
+			std::vector<counter_op_t *> batch;
+			batch.swap(slot->pending);
+			slot->busy = true;
+
+			guard.unlock();
+			applyIncrements(key, klen, batch);
+			guard.lock();
+
+			slot->busy = false;
+			slot->cond.notify_all();
+		}
+	}
+
+	if (--slot->refs == 0) {
+		counters.erase(ckey);
+		delete slot;
+	}
+
+	if ((op.status == E_ok) && newval)
+		*newval = op.result;
+
+	return op.status;
+}
+
+/**
+ * Sets the value for the key only if its current value is
+ * the expected value. If the new value has the same length
+ * as the current value, only the value bytes are written
+ * in place. The expiry time of the key is retained.
+ *
+ * @param [in]  key      - database key.
+ * @param [in]  klen     - database key length.
+ * @param [in]  expected - expected value. If NULL, the key
+ *                         must not exist.
+ * @param [in]  elen     - expected value length.
+ * @param [in]  desired  - new value.
+ * @param [in]  dlen     - new value length.
+ *
+ * @return E_ok on success, E_mismatch if the current value
+ * is not the expected value (or the key exists when it is
+ * expected not to), E_not_found if the key does not exist,
+ * -ve error code on failure.
+ */
+int
+Rdb::compareAndSet(
+	const char *key,
+	int klen,
+	const char *expected,
+	int elen,
+	const char *desired,
+	int dlen)
+{
+	int             retval;
+	int             hindex = -1;
+	value_page_t    vp;
+	key_info_t      ki;
+
+	if (options.readOnly()) {
+		LOG_ERROR("Rdb", "database is opened read-only");
+		return E_invalid_state;
+	}
+
+	if ((key == 0) || (*key == '\0')) {
+		LOG_ERROR("Rdb", "invalid key specified");
+		return E_invalid_arg;
+	}
+
+	if ((klen <= 0) || (klen > MAX_KEY_LENGTH)) {
+		LOG_ERROR("Rdb", "invalid key length specified");
+		return E_invalid_arg;
+	}
+
+	if (expected && ((elen <= 0) || (elen > MAX_VALUE_LENGTH))) {
+		LOG_ERROR("Rdb", "invalid expected value length specified");
+		return E_invalid_arg;
+	}
+
+	if ((desired == 0) || (dlen <= 0) || (dlen > MAX_VALUE_LENGTH)) {
+		LOG_ERROR("Rdb", "invalid value specified");
+		return E_invalid_arg;
+	}
+
+	if ((retval = beginOp()) != E_ok) {
+		return retval;
+	}
+
+	hindex = hash(key, klen, htSize);
+	ASSERT(((hindex >= 0) && (hindex < htSize)), "Rdb", 0,
+		"invalid hash value (%d)", hindex);
+
+	{
+		HTLockGuard guard(hashTable, hindex, true);
+
+		SetKeyInfo(&ki, key, klen, hindex);
+
+		retval = findValue(&ki, &vp);
+		if ((retval == E_ok) && IsValuePageExpired(&vp, time(0))) {
+			LOG_DEBUG("Rdb", "key expired");
+			retval = E_not_found;
+		}
+
+		if (expected == 0) {
+			if (retval == E_ok) {
+				retval = E_mismatch;
+			} else if (retval == E_not_found) {
+				SetKeyInfo(&ki, key, klen, hindex);
+				retval = store(&ki, desired, dlen, 0L, 0);
+			}
+		} else if (retval == E_ok) {
+			if ((vp.vp_vlen != elen) || (memcmp(vp.vp_value, expected, elen) != 0)) {
+				retval = E_mismatch;
+			} else if (dlen == vp.vp_vlen) {
+				retval = valueFile->writeValue(ki.ki_voff, &vp, desired, dlen);
+			} else {
+				memcpy(vp.vp_value, desired, dlen);
+				vp.vp_vlen = dlen;
+				retval = valueFile->write(ki.ki_voff, &vp);
+				if (retval != E_ok) {
+					LOG_ERROR("Rdb", "failed to write value to %s",
+						valueFile->name());
+				}
+			}
+
+			if (retval == E_ok) {
+				logChange(CHANGE_SET, key, klen, desired, dlen, vp.vp_expiry);
+			}
+		}
+	}
+
+	endOp();
+
+	return retval;
+}
+
+/*
+ * Removes the key/value pair from the database. Must be
+ * called with the hash table entry locked exclusively.
+ *
+ * @param [inout] ki    - key information.
+ * @param [out]   freed - if not NULL, the value page offset
+ *                        is added to it instead of being
+ *                        freed. The caller frees the pages
+ *                        in a batch.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+Rdb::removeKey(key_info_t *ki, std::vector<int64_t> *freed)
+{
+	int         retval;
+	int         hindex = ki->ki_hash;
+	bool        unindexed = false;
+	key_info_t  dki;
+	UnwindStack ustk;
+
+	retval = processKeyPages(ki, GET);
+	if (retval == E_ok) {
+		ASSERT((ki->ki_kpn != 0), "Rdb", 0,
+			"found the key but key page node is not set");
+		ASSERT((ki->ki_kpn->kpn_kp != 0), "Rdb", 0,
+			"found the key but key page is not set");
+		ASSERT((ki->ki_kpn->kpn_kpoff != -1), "Rdb", 0,
+			"found the key but key page offset is not set");
+		ASSERT((ki->ki_kidx != -1), "Rdb", 0,
+			"found the key but key index in page is not set");
+		ASSERT((ki->ki_voff != -1), "Rdb", 0,
+			"found the key but value page offset is not set");
+
+		if (oindex) {
+			retval = oindex->remove(ki->ki_key, ki->ki_klen);
+			if (retval == E_ok) {
+				unindexed = true;
+			} else if (retval == E_not_found) {
+				LOG_WARNING("Rdb", "key is missing from the ordered index");
+				retval = E_ok;
+			}
+		}
+	}
+
+	if (retval == E_ok) {
+		// Mark the value page as deleted
+		retval = valueFile->writeFlags(ki->ki_voff, 0, VPAGE_DELETED);
+		if (retval != E_ok) {
+			LOG_ERROR("Rdb", "failed to mark value page as deleted");
+		} else {
+			ustk.writeFlags(valueFile, 0, ki->ki_voff, 0);
+
+			SetKeyInfo(&dki, ki->ki_key, ki->ki_klen, hindex);
+
+			retval = processKeyPages(&dki, DEL);
+			ASSERT((retval == E_ok), "Rdb", 0,
+				"unable to delete the key that was recently located");
+
+			ASSERT((ki->ki_kpn == dki.ki_kpn), "Rdb", 0,
+				"found and deleted key page node mismatch");
+			ASSERT((ki->ki_kpn->kpn_kp == dki.ki_kpn->kpn_kp), "Rdb", 0,
+				"found and deleted key page mismatch");
+			ASSERT((ki->ki_kpn->kpn_kpoff == dki.ki_kpn->kpn_kpoff), "Rdb", 0,
+				"found and deleted key page offset mismatch");
+			ASSERT((ki->ki_kidx == dki.ki_kidx), "Rdb", 0,
+				"found and deleted key index mismatch");
+
+			// The key is deleted now
+
+			if (ki->ki_kpn->kpn_kp->kp_vcount <= 0) {
+				// It was the last key in the page
+
+				key_page_t *prev_kp = 0, *next_kp = 0;
+				key_page_node_t *prev_kpn, *next_kpn;
+				int64_t prev_kpoff, next_kpoff;
+
+				prev_kpoff = dki.ki_kpn->kpn_kp->kp_poff;
+				prev_kpn = dki.ki_kpn->kpn_prev;
+				next_kpoff = dki.ki_kpn->kpn_kp->kp_noff;
+				next_kpn = dki.ki_kpn->kpn_next;
+
+				LOG_DEBUG("Rdb",
+					"previous page offset = %" PRId64
 					", next page offset = %" PRId64,
 					prev_kpoff, next_kpoff);
 
-				// The previous page is already loaded. If there
-				// is a next page, load it as we need to update
-				// its previous page offset.
+				// The previous page is already loaded. If there
+				// is a next page, load it as we need to update
+				// its previous page offset.
+
+				if ((next_kpoff != -1L) && (next_kpn == 0)) {
+					retval = cache->get(next_kpn, next_kpoff);
+					if (retval == E_ok) {
+						hashTable->addKeyPageNode(dki.ki_hash, next_kpn);
+					} else {
+						LOG_ERROR("Rdb",
+							"failed to read key page at offset %" PRId64,
+							next_kpoff);
+					}
+				}
+
+				if (retval == E_ok) {
+					if ((prev_kpoff != -1L) && (prev_kpn != 0)) {
+						prev_kp = prev_kpn->kpn_kp;
+					}
+
+					if ((next_kpoff != -1L) && (next_kpn != 0)) {
+						next_kp = next_kpn->kpn_kp;
+					}
+
+					// Mark the key page as deleted
+					retval = keyFile->writeFlags(dki.ki_kpn->kpn_kpoff,
+								dki.ki_kpn->kpn_kp, KPAGE_DELETED);
+					if (retval != E_ok) {
+						LOG_ERROR("Rdb",
+							"failed to mark key page at offset %" PRId64 " as deleted",
+							dki.ki_kpn->kpn_kpoff);
+					} else {
+						ustk.writeFlags(keyFile, dki.ki_kpn->kpn_kp,
+							dki.ki_kpn->kpn_kpoff, 0);
+
+						int64_t offset = -1L;
+
+						// Update next offset of the previous page
+						if (prev_kp) {
+							offset = prev_kp->kp_noff;
+							retval = keyFile->writeNextOffset(prev_kpoff, prev_kp, next_kpoff);
+							if (retval != E_ok) {
+								LOG_ERROR("Rdb", "failed to update key page at offset %" PRId64
+									" to %s", prev_kpoff, keyFile->name());
+							} else {
+								ustk.writeNextOffset(keyFile, prev_kp, prev_kpoff, offset);
+							}
+						}
+
+						// Update previous offset of the next page
+						if ((retval == E_ok) && next_kp) {
+							offset = next_kp->kp_poff;
+							retval = keyFile->writePrevOffset(next_kpoff, next_kp, prev_kpoff);
+							if (retval != E_ok) {
+								LOG_ERROR("Rdb", "failed to update key page at offset %" PRId64
+									" to %s", next_kpoff, keyFile->name());
+							} else {
+								ustk.writePrevOffset(keyFile, next_kp, next_kpoff, offset);
+							}
+						}
+
+						if (retval == E_ok) {
+							// Update other data structures
+							offset = dki.ki_kpn->kpn_kpoff;
+							hashTable->removeKeyPageNode(hindex, dki.ki_kpn);
+							cache->free(dki.ki_kpn);
+							retval = keyFile->freePage(offset);
+						}
+					}
+				}
+			}
+
+			if (retval == E_ok) {
+				if (freed) {
+					freed->push_back(ki->ki_voff);
+				} else {
+					retval = valueFile->freePage(ki->ki_voff);
+				}
+			}
+		}
+	}
+
+	if ((retval != E_ok) && unindexed) {
+		oindex->insert(ki->ki_key, ki->ki_klen, ki->ki_voff);
+	}
+
+	ustk.unwind(retval);
+
+	if (retval == E_ok) {
+		logChange(CHANGE_REMOVE, ki->ki_key, ki->ki_klen, 0, 0, 0);
+	}
+
+	return retval;
+}
+
+/**
+ * Removes the key/value pair from the database.
+ *
+ * @param [in]  key     - database key.
+ * @param [in]  klen    - database key length.
+ * 
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+Rdb::remove(
+	const char *key,
+	int klen)
+{
+	int         retval;
+	int         hindex = -1;
+	key_info_t  ki;
+
+	if (options.readOnly()) {
+		LOG_ERROR("Rdb", "database is opened read-only");
+		return E_invalid_state;
+	}
+
+	if ((key == 0) || (*key == '\0')) {
+		LOG_ERROR("Rdb", "invalid key specified");
+		return E_invalid_arg;
+	}
+
+	if (klen <= 0) {
+		LOG_ERROR("Rdb", "invalid key length specified");
+		return E_invalid_arg;
+	}
+
+	LatencyTimer timer(removeLatency);
+
+	if ((retval = beginOp()) != E_ok) {
+		return retval;
+	}
+
+	hindex = hash(key, klen, htSize);
+	ASSERT(((hindex >= 0) && (hindex < htSize)), "Rdb", 0,
+		"invalid hash value (%d)", hindex);
+
+	{
+		HTLockGuard guard(hashTable, hindex, true);
+
+		SetKeyInfo(&ki, key, klen, hindex);
+
+		retval = removeKey(&ki, 0);
+	}
+
+	endOp();
+
+	return retval;
+}
+
+/*
+ * Looks up the key for a transaction. Must be called with
+ * the hash table entry locked. An expired key is treated
+ * as if it does not exist.
+ *
+ * @param [inout] ki - key information.
+ * @param [out]   rd - what is found.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+Rdb::lookupKey(key_info_t *ki, txn_read_t *rd)
+{
+	value_page_t vp;
+
+	rd->status = E_not_found;
+	rd->value.clear();
+	rd->expiry = 0;
+
+	int retval = findValue(ki, &vp);
+	if (retval == E_ok) {
+		if (!IsValuePageExpired(&vp, time(0))) {
+			rd->status = E_ok;
+			rd->value.assign(vp.vp_value, vp.vp_vlen);
+			rd->expiry = vp.vp_expiry;
+		}
+	} else if (retval == E_not_found) {
+		retval = E_ok;
+	}
+
+	return retval;
+}
+
+/*
+ * Reads the key for a transaction.
+ *
+ * @param [in]  key - database key.
+ * @param [out] rd  - what is found.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+Rdb::readKey(const std::string &key, txn_read_t *rd)
+{
+	int         retval;
+	int         hindex = -1;
+	key_info_t  ki;
+
+	if ((retval = beginOp()) != E_ok) {
+		return retval;
+	}
+
+	hindex = hash(key.data(), int(key.size()), htSize);
+	ASSERT(((hindex >= 0) && (hindex < htSize)), "Rdb", 0,
+		"invalid hash value (%d)", hindex);
+
+	{
+		HTLockGuard guard(hashTable, hindex, false);
+
+		SetKeyInfo(&ki, key.data(), int(key.size()), hindex);
+
+		retval = lookupKey(&ki, rd);
+	}
+
+	endOp();
+
+	return retval;
+}
+
+/*
+ * Applies the writes of a transaction. Must be called with
+ * the hash table entries of all the keys locked exclusively.
+ *
+ * @param [in] writes - transaction writes.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+Rdb::applyWrites(const txn_writes_t &writes)
+{
+	int         retval = E_ok;
+	key_info_t  ki;
+
+	for (const txn_writes_t::value_type &w : writes) {
+		SetKeyInfo(&ki, w.first.data(), int(w.first.size()),
+			hash(w.first.data(), int(w.first.size()), htSize));
+
+		if (w.second.remove) {
+			retval = removeKey(&ki, 0);
+			if (retval == E_not_found)
+				retval = E_ok;
+		} else {
+			retval = store(&ki, w.second.value.data(),
+					int(w.second.value.size()), 0L, 0);
+		}
+
+		if (retval != E_ok)
+			break;
+	}
+
+	return retval;
+}
+
+/*
+ * Applies the writes of a transaction found pending in the
+ * transaction log on open.
+ *
+ * @param [in] writes - transaction writes.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+Rdb::replayWrites(const txn_writes_t &writes)
+{
+	std::map<int, bool> indices;
+
+	for (const txn_writes_t::value_type &w : writes)
+		indices[hash(w.first.data(), int(w.first.size()), htSize)] = true;
+
+	HTMultiLockGuard guard(hashTable, indices);
+
+	return applyWrites(writes);
+}
+
+/*
+ * Commits a transaction. The hash table entries of the keys
+ * read are locked shared and the ones of the keys written
+ * are locked exclusively, all in index order. The keys read
+ * are checked to be unchanged, and the writes are logged
+ * and applied.
+ *
+ * @param [in] reads  - keys read.
+ * @param [in] writes - transaction writes.
+ *
+ * @return E_ok on success, E_try_again if a key read has
+ * changed, -ve error code on failure.
+ */
+int
+Rdb::commitTransaction(const txn_reads_t &reads, const txn_writes_t &writes)
+{
+	int                 retval = E_ok;
+	int                 slot = -1;
+	key_info_t          ki;
+	txn_read_t          cur;
+	std::map<int, bool> indices;
+
+	for (const txn_reads_t::value_type &r : reads)
+		indices.insert(std::make_pair(
+			hash(r.first.data(), int(r.first.size()), htSize), false));
+
+	for (const txn_writes_t::value_type &w : writes)
+		indices[hash(w.first.data(), int(w.first.size()), htSize)] = true;
+
+	if ((retval = beginOp()) != E_ok) {
+		return retval;
+	}
+
+	{
+		HTMultiLockGuard guard(hashTable, indices);
+
+		for (const txn_reads_t::value_type &r : reads) {
+			SetKeyInfo(&ki, r.first.data(), int(r.first.size()),
+				hash(r.first.data(), int(r.first.size()), htSize));
+
+			retval = lookupKey(&ki, &cur);
+			if (retval != E_ok)
+				break;
+
+			if ((cur.status != r.second.status) ||
+				(cur.expiry != r.second.expiry) ||
+				(cur.value != r.second.value)) {
+				LOG_DEBUG("Rdb", "transaction conflict on key %.*s",
+					int(r.first.size()), r.first.data());
+				retval = E_try_again;
+				break;
+			}
+		}
+
+		if ((retval == E_ok) && !writes.empty()) {
+			retval = txnLog->write(writes, &slot);
+			if (retval == E_ok) {
+				retval = applyWrites(writes);
+				if (retval == E_ok) {
+					// The writes are applied; a failure
+					// is logged and the slot is not reused
+					txnLog->done(slot);
+				} else {
+					LOG_ERROR("Rdb",
+						"transaction partially applied; "
+						"it is applied again when %s is opened",
+						name.c_str());
+				}
+			}
+		}
+	}
+
+	endOp();
+
+	return retval;
+}
+
+/*
+ * Validates the key of a transaction read/write.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+Rdb::Transaction::validate(const char *key, int klen) const
+{
+	if ((rdb == 0) || (rdb->txnLog == 0)) {
+		LOG_ERROR("Rdb", "database is not opened for transactions");
+		return E_invalid_state;
+	}
+
+	if ((key == 0) || (*key == '\0')) {
+		LOG_ERROR("Rdb", "invalid key specified");
+		return E_invalid_arg;
+	}
+
+	if ((klen <= 0) || (klen > MAX_KEY_LENGTH)) {
+		LOG_ERROR("Rdb", "invalid key length specified");
+		return E_invalid_arg;
+	}
+
+	return E_ok;
+}
+
+/**
+ * Gets the value for the key. The value written by the
+ * transaction, if any, is returned; otherwise the value is
+ * read from the database and remembered, so that it is
+ * checked at commit and read the same way again.
+ *
+ * @param [in]    key    - database key.
+ * @param [in]    klen   - database key length.
+ * @param [out]   value  - value for the corresponding key.
+ * @param [inout] vlen   - maximum value size on input,
+ *                         actual value size on output.
+ *
+ * @return E_ok on success, E_not_found if the value is not
+ * found (or is expired, or is removed by the transaction),
+ * -ve error code on failure.
+ */
+int
+Rdb::Transaction::get(
+	const char *key,
+	int klen,
+	char *value,
+	int *vlen)
+{
+	int                 retval;
+	const std::string   *found = 0;
+
+	retval = validate(key, klen);
+	if (retval != E_ok) {
+		return retval;
+	}
+
+	if (value == 0) {
+		LOG_ERROR("Rdb", "invalid value specified");
+		return E_invalid_arg;
+	}
+
+	if ((vlen == 0) || (*vlen <= 0)) {
+		LOG_ERROR("Rdb", "invalid value length specified");
+		return E_invalid_arg;
+	}
+
+	std::string k(key, klen);
+
+	txn_writes_t::const_iterator W = writes.find(k);
+	if (W != writes.end()) {
+		if (W->second.remove)
+			return E_not_found;
+		found = &(W->second.value);
+	} else {
+		txn_reads_t::iterator R = reads.find(k);
+		if (R == reads.end()) {
+			txn_read_t rd;
+			retval = rdb->readKey(k, &rd);
+			if (retval != E_ok) {
+				return retval;
+			}
+			R = reads.insert(std::make_pair(k, rd)).first;
+		}
+
+		if (R->second.status != E_ok)
+			return R->second.status;
+		found = &(R->second.value);
+	}
+
+	if (int(found->size()) > *vlen) {
+		return E_insufficient_buffer;
+	}
+
+	*vlen = int(found->size());
+	memcpy(value, found->data(), *vlen);
+
+	return E_ok;
+}
+
+/**
+ * Sets the key/value pair. The write is buffered until
+ * the transaction is committed.
+ *
+ * @param [in] key   - database key.
+ * @param [in] klen  - database key length.
+ * @param [in] value - value for the key.
+ * @param [in] vlen  - value length.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+Rdb::Transaction::set(
+	const char *key,
+	int klen,
+	const char *value,
+	int vlen)
+{
+	int retval = validate(key, klen);
+	if (retval != E_ok) {
+		return retval;
+	}
+
+	if ((value == 0) || (*value == '\0')) {
+		LOG_ERROR("Rdb", "invalid value specified");
+		return E_invalid_arg;
+	}
+
+	if ((vlen <= 0) || (vlen > MAX_VALUE_LENGTH)) {
+		LOG_ERROR("Rdb", "invalid value length specified");
+		return E_invalid_arg;
+	}
+
+	std::string k(key, klen);
+
+	if ((writes.size() >= RDB_TXN_MAX_WRITES) && (writes.find(k) == writes.end())) {
+		LOG_ERROR("Rdb", "too many writes in the transaction; at most %d allowed",
+			RDB_TXN_MAX_WRITES);
+		return E_invalid_arg;
+	}
+
+	txn_op_t &op = writes[k];
+	op.remove = false;
+	op.value.assign(value, vlen);
+
+	return E_ok;
+}
+
+/**
+ * Removes the key. The removal is buffered until the
+ * transaction is committed.
+ *
+ * @param [in] key   - database key.
+ * @param [in] klen  - database key length.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+Rdb::Transaction::remove(
+	const char *key,
+	int klen)
+{
+	int retval = validate(key, klen);
+	if (retval != E_ok) {
+		return retval;
+	}
+
+	std::string k(key, klen);
+
+	if ((writes.size() >= RDB_TXN_MAX_WRITES) && (writes.find(k) == writes.end())) {
+		LOG_ERROR("Rdb", "too many writes in the transaction; at most %d allowed",
+			RDB_TXN_MAX_WRITES);
+		return E_invalid_arg;
+	}
+
+	txn_op_t &op = writes[k];
+	op.remove = true;
+	op.value.clear();
+
+	return E_ok;
+}
+
+/**
+ * Commits the transaction. Either all the writes are
+ * applied or none. The transaction is empty afterwards,
+ * whether the commit succeeds or fails, and can be used
+ * again.
+ *
+ * @return E_ok on success, E_try_again if a key read by
+ * the transaction was changed since (run the transaction
+ * again), -ve error code on failure.
+ */
+int
+Rdb::Transaction::commit()
+{
+	int retval = E_ok;
+
+	if ((rdb == 0) || (rdb->txnLog == 0)) {
+		LOG_ERROR("Rdb", "database is not opened for transactions");
+		retval = E_invalid_state;
+	} else if (!reads.empty() || !writes.empty()) {
+		// The reads of a read-only transaction are
+		// validated too; they were made at different times
+		retval = rdb->commitTransaction(reads, writes);
+	}
+
+	rollback();
+
+	return retval;
+}
+
+/**
+ * Discards the reads and the buffered writes of the
+ * transaction.
+ */
+void
+Rdb::Transaction::rollback()
+{
+	reads.clear();
+	writes.clear();
+}
+
+/*
+ * Gets the next batch of keys from the ordered index.
+ *
+ * @param [in]  from      - key to start from; empty to start
+ *                          from the first key.
+ * @param [in]  inclusive - include the start key?
+ * @param [out] keys      - keys in order.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+Rdb::orderedKeys(const std::string &from, bool inclusive, std::vector<std::string> &keys)
+{
+	int retval = E_ok;
+
+	if ((retval = beginOp()) != E_ok) {
+		return retval;
+	}
+
+	if (oindex == 0) {
+		LOG_ERROR("Rdb", "ordered index is not open");
+		retval = E_invalid_state;
+	} else {
+		retval = oindex->keys(from.empty() ? 0 : from.data(), int(from.size()),
+				inclusive, OINDEX_SCAN_COUNT, keys);
+	}
+
+	endOp();
+
+	return retval;
+}
+
+/**
+ * Starts a scan of the keys with the specified prefix, in
+ * key order. Requires the ordered index.
+ *
+ * @param [in]  prefix - key prefix.
+ * @param [in]  plen   - key prefix length.
+ * @param [out] iter   - iterator; use RdbIterator::next()
+ *                       to get the keys and values.
+ *
+ * @return E_ok on success, E_invalid_state if the ordered
+ * index is not enabled, -ve error code on failure.
+ */
+int
+Rdb::scanPrefix(const char *prefix, int plen, RdbIterator &iter)
+{
+	if ((prefix == 0) || (*prefix == '\0')) {
+		LOG_ERROR("Rdb", "invalid key prefix specified");
+		return E_invalid_arg;
+	}
+
+	if ((plen <= 0) || (plen > MAX_KEY_LENGTH)) {
+		LOG_ERROR("Rdb", "invalid key prefix length specified");
+		return E_invalid_arg;
+	}
+
+	if (!options.orderedIndex()) {
+		LOG_ERROR("Rdb", "ordered index is not enabled");
+		return E_invalid_state;
+	}
+
+	iter.reset(this);
+	iter.from.assign(prefix, plen);
+	iter.prefix.assign(prefix, plen);
+
+	return E_ok;
+}
+
+/**
+ * Starts a scan of the keys in the range [from, to), in
+ * key order. Requires the ordered index.
+ *
+ * @param [in]  from - first key; NULL to start with the
+ *                     first key in the database.
+ * @param [in]  flen - first key length.
+ * @param [in]  to   - end key (excluded); NULL to scan
+ *                     up to the last key in the database.
+ * @param [in]  tlen - end key length.
+ * @param [out] iter - iterator; use RdbIterator::next()
+ *                     to get the keys and values.
+ *
+ * @return E_ok on success, E_invalid_state if the ordered
+ * index is not enabled, -ve error code on failure.
+ */
+int
+Rdb::scanRange(const char *from, int flen, const char *to, int tlen, RdbIterator &iter)
+{
+	if (from && ((flen <= 0) || (flen > MAX_KEY_LENGTH))) {
+		LOG_ERROR("Rdb", "invalid first key length specified");
+		return E_invalid_arg;
+	}
+
+	if (to && ((tlen <= 0) || (tlen > MAX_KEY_LENGTH))) {
+		LOG_ERROR("Rdb", "invalid end key length specified");
+		return E_invalid_arg;
+	}
+
+	if (!options.orderedIndex()) {
+		LOG_ERROR("Rdb", "ordered index is not enabled");
+		return E_invalid_state;
+	}
+
+	iter.reset(this);
+	if (from)
+		iter.from.assign(from, flen);
+	if (to) {
+		iter.to.assign(to, tlen);
+		iter.bounded = true;
+	}
+
+	return E_ok;
+}
+
+/*
+ * Resets the iterator to start a new scan.
+ */
+void
+RdbIterator::reset(Rdb *rdb)
+{
+	this->rdb = rdb;
+	from.clear();
+	inclusive = true;
+	prefix.clear();
+	to.clear();
+	bounded = false;
+	batch.clear();
+	pos = 0;
+	exhausted = false;
+}
+
+/*
+ * Is the key within the scan range?
+ */
+bool
+RdbIterator::inRange(const std::string &key) const
+{
+	if (!prefix.empty())
+		return (key.compare(0, prefix.size(), prefix) == 0);
+
+	if (bounded)
+		return (CompareKeys(key.data(), int(key.size()), to.data(), int(to.size())) < 0);
+
+	return true;
+}
+
+/**
+ * Gets the next key/value pair of the scan.
+ *
+ * @param [out]   key   - key.
+ * @param [inout] klen  - maximum key size on input, actual
+ *                        key size on output.
+ * @param [out]   value - value for the key.
+ * @param [inout] vlen  - maximum value size on input,
+ *                        actual value size on output.
+ *
+ * @return E_ok on success, E_eof_detected at the end of the
+ * scan, -ve error code on failure. On E_insufficient_buffer,
+ * the call can be retried with larger buffers.
+ */
+int
+RdbIterator::next(char *key, int *klen, char *value, int *vlen)
+{
+	int retval = E_ok;
+
+	if ((key == 0) || (klen == 0) || (*klen <= 0)) {
+		LOG_ERROR("RdbIterator", "invalid key buffer specified");
+		return E_invalid_arg;
+	}
+
+	if ((value == 0) || (vlen == 0) || (*vlen <= 0)) {
+		LOG_ERROR("RdbIterator", "invalid value buffer specified");
+		return E_invalid_arg;
+	}
+
+	if (rdb == 0) {
+		LOG_ERROR("RdbIterator", "scan is not started");
+		return E_invalid_state;
+	}
+
+	for (;;) {
+		if (pos >= batch.size()) {
+			if (exhausted)
+				return E_eof_detected;
+
+			batch.clear();
+			pos = 0;
+
+			retval = rdb->orderedKeys(from, inclusive, batch);
+			if (retval != E_ok)
+				return retval;
+
+			if (batch.size() < OINDEX_SCAN_COUNT)
+				exhausted = true;
+
+			if (!batch.empty()) {
+				from = batch.back();
+				inclusive = false;
+			}
+
+			continue;
+		}
+
+		const std::string &k = batch[pos];
+
+		if (!inRange(k)) {
+			batch.clear();
+			pos = 0;
+			exhausted = true;
+			return E_eof_detected;
+		}
+
+		if (int(k.size()) > *klen)
+			return E_insufficient_buffer;
+
+		int len = *vlen;
+		retval = rdb->get(k.data(), int(k.size()), value, &len);
+		if (retval == E_not_found) {
+			// removed or expired since the keys were read
+			pos++;
+			continue;
+		} else if (retval != E_ok) {
+			return retval;
+		}
+
+		memcpy(key, k.data(), k.size());
+		*klen = int(k.size());
+		*vlen = len;
+		pos++;
+
+		return E_ok;
+	}
+}
+
+/*
+ * Removes the expired keys of the hash table entry. Must
+ * be called with the hash table entry locked exclusively.
+ *
+ * @param [in]  hindex - hash table index.
+ * @param [in]  now    - current time.
+ * @param [out] freed  - offsets of the value pages freed.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+Rdb::sweepBucket(int hindex, time_t now, std::vector<int64_t> *freed)
+{
+	int                     retval = E_ok;
+	value_page_t            vp;
+	key_info_t              ki;
+	std::vector<key_info_t> keys;
+
+	// Collect the keys first; removing a key may free
+	// the key page being visited.
+	retval = visitKeyPages(hindex, [this, hindex, &keys] (key_page_t *kp) {
+		key_info_t ki;
+		for (int i = 0; i < NUM_OF_KEYS_IN_PAGE(kpSize); ++i) {
+			const key_rec_t *kr = &(kp->kp_keys[i]);
+			if (kr->kr_flags == KEY_INUSE) {
+				SetKeyInfo(&ki, kr->kr_key, kr->kr_klen, hindex);
+				ki.ki_voff = kr->kr_voff;
+				keys.push_back(ki);
+			}
+		}
+		return E_ok;
+	});
+
+	for (size_t i = 0; (retval == E_ok) && (i < keys.size()); ++i) {
+		retval = valueFile->read(keys[i].ki_voff, &vp);
+		if (retval != E_ok) {
+			LOG_ERROR("Rdb", "failed to read value page at offset %" PRId64 " from %s",
+				keys[i].ki_voff, valueFile->name());
+		} else if (!IsValuePageDeleted(&vp) && IsValuePageExpired(&vp, now)) {
+			LOG_DEBUG("Rdb", "removing expired key at offset %" PRId64,
+				keys[i].ki_voff);
+
+			SetKeyInfo(&ki, keys[i].ki_key, keys[i].ki_klen, hindex);
+			retval = removeKey(&ki, freed);
+		}
+	}
+
+	return retval;
+}
+
+/**
+ * Reclaims the expired keys. Visits the next \em count
+ * entries of the hash table, in order, wrapping around at
+ * the end of the table. The value pages freed are returned
+ * to the free disk page stack in a single batch.
+ *
+ * This is what the background sweep does periodically
+ * (see RdbOptions::setSweepInterval()). It can also be
+ * called directly if the background sweep is disabled.
+ *
+ * @param [in] count - number of hash table entries to visit.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+Rdb::sweepExpired(int count)
+{
+	int                     retval = E_ok;
+	time_t                  now = time(0);
+	std::vector<int64_t>    freed;
+
+	if (options.readOnly()) {
+		LOG_ERROR("Rdb", "database is opened read-only");
+		return E_invalid_state;
+	}
+
+	if (count <= 0) {
+		LOG_ERROR("Rdb", "invalid sweep count (%d) specified", count);
+		return E_invalid_arg;
+	}
+
+	std::lock_guard<std::mutex> sweepGuard(sweepMutex);
+
+	if ((retval = beginOp()) != E_ok) {
+		return retval;
+	}
+
+	if (count > htSize)
+		count = htSize;
+
+	for (int i = 0; (retval == E_ok) && (i < count); ++i) {
+		int hindex = sweepIndex;
+		sweepIndex = (sweepIndex + 1) % htSize;
+
+		HTLockGuard guard(hashTable, hindex, true);
+		retval = sweepBucket(hindex, now, &freed);
+	}
+
+	if (!freed.empty()) {
+		LOG_DEBUG("Rdb", "freeing %d expired value pages", int(freed.size()));
+
+		int r = valueFile->freePages(freed);
+		if (retval == E_ok)
+			retval = r;
+	}
+
+	endOp();
+
+	return retval;
+}
+
+/*
+ * The background sweep of expired keys.
+ */
+void
+Rdb::sweep()
+{
+	std::chrono::milliseconds interval(options.getSweepInterval());
+
+	std::unique_lock<std::mutex> guard(sweepMutex);
+	while (!sweepCond.wait_for(guard, interval, [this] { return sweepStop; })) {
+		guard.unlock();
+
+		int retval = sweepExpired(options.getSweepCount());
+		if (retval != E_ok) {
+			LOG_ERROR("Rdb", "failed to sweep expired keys, error = %d", retval);
+		}
+
+		guard.lock();
+	}
+}
+
+/*
+ * Starts the background sweep of expired keys, if enabled.
+ */
+void
+Rdb::startSweeper()
+{
+	if (!options.readOnly() && (options.getSweepInterval() > 0)) {
+		sweepStop = false;
+		sweeper = std::thread(&Rdb::sweep, this);
+	}
+}
+
+/*
+ * Stops the background sweep of expired keys.
+ */
+void
+Rdb::stopSweeper()
+{
+	if (sweeper.joinable()) {
+		{
+			std::lock_guard<std::mutex> guard(sweepMutex);
+			sweepStop = true;
+		}
+		sweepCond.notify_all();
+		sweeper.join();
+	}
+}
+
+/*
+ * Reads the key page into the cache, along with the key pages
+ * preceding it in its hash table entry that are not in the
+ * cache (the pages of an entry are in the cache in order).
+ *
+ * @param [in] offset  - key page offset.
+ * @param [in] pages   - key pages already read, by offset.
+ * @param [in] useRead - can the pages already read be used?
+ *                       They are stale if a page could have
+ *                       been updated and evicted since.
+ *
+ * @return the number of key pages read into the cache.
+ */
+int
+Rdb::warmKeyPage(int64_t offset, const std::unordered_map<int64_t, key_page_t *> &pages, bool useRead)
+{
+	int             retval = E_ok;
+	int             count = 0;
+	key_page_t      *kp = pages.at(offset);
+
+	if (IsKeyPageDeleted(kp) || (kp->kp_vcount <= 0) ||
+		(kp->kp_hash < 0) || (kp->kp_hash >= htSize))
+		return 0;
+
+	int hindex = kp->kp_hash;
+
+	if (beginOp() != E_ok)
+		return 0;
+
+	{
+		HTLockGuard guard(hashTable, hindex, true);
+
+		int64_t         nextOffset = hashTable->getOffset(hindex);
+		key_page_node_t *kpn = hashTable->getKeyPageNodeList(hindex);
+
+		while ((retval == E_ok) && (nextOffset != -1L)) {
+			const void *data = 0;
+			if (useRead) {
+				std::unordered_map<int64_t, key_page_t *>::const_iterator it =
+					pages.find(nextOffset);
+				if (it != pages.end())
+					data = it->second;
+			}
+
+			if (kpn == 0) {
+				retval = cache->get(kpn, nextOffset, 0, data);
+				if (retval == E_ok) {
+					hashTable->addKeyPageNode(hindex, kpn);
+					count++;
+				}
+			} else if (kpn->kpn_kp == 0) {
+				retval = cache->update(kpn, nextOffset, 0, data);
+				if (retval == E_ok)
+					count++;
+			}
+
+			if ((retval != E_ok) || (nextOffset == offset))
+				break;
+
+			nextOffset = kpn->kpn_kp->kp_noff;
+			kpn = kpn->kpn_next;
+		}
+	}
+
+	endOp();
+
+	return count;
+}
+
+/*
+ * Warms up the key page cache in the background. The pages
+ * are read in batches, the most recently used batch first;
+ * a batch is read in offset order, with the adjacent pages
+ * read together. Warming up stops once the cache is full, so
+ * that the pages read in by the operations are not evicted.
+ *
+ * A key page on disk changes only while it is in the cache,
+ * so a page read here is current as long as it is not in the
+ * cache and no page has been evicted since it was read.
+ *
+ * @param [in] offsets - key page offsets, the most recently
+ *                       used first.
+ */
+void
+Rdb::warmUp(std::vector<int64_t> offsets)
+{
+	static const int WARM_BATCH = 64;
+
+	int         count = 0;
+	int64_t     evictions = cache->getEvictions();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	char *buf = static_cast<char *>(AllocAligned(size_t(WARM_BATCH) * kpSize));
+	if (buf == 0) {
+		LOG_ERROR("Rdb", "failed to allocate memory to warm up the cache");
+		return;
+	}
+
+	for (size_t first = 0; (first < offsets.size()) && !warmStop; first += WARM_BATCH) {
+		std::unordered_map<int64_t, key_page_t *> pages;
+
+		std::vector<int64_t> batch(offsets.begin() + first,
+			offsets.begin() + std::min(offsets.size(), first + WARM_BATCH));
+		std::sort(batch.begin(), batch.end());
+		batch.erase(std::unique(batch.begin(), batch.end()), batch.end());
+
+		char *p = buf;
+		for (size_t i = 0, j; i < batch.size(); i = j) {
+			for (j = i + 1; (j < batch.size()) && (batch[j] == (batch[j - 1] + kpSize)); ++j)
+				;
+
+			if (keyFile->read(batch[i], p, int(j - i) * kpSize) == E_ok) {
+				for (size_t k = i; k < j; ++k)
+					pages[batch[k]] = reinterpret_cast<key_page_t *>(p + (k - i) * kpSize);
+			}
+
+			p += (j - i) * kpSize;
+		}
+
+		for (int64_t offset : batch) {
+			if (warmStop || cache->isFull())
+				break;
+
+			if (pages.find(offset) != pages.end())
+				count += warmKeyPage(offset, pages, cache->getEvictions() == evictions);
+		}
+
+		if (cache->isFull())
+			break;
+	}
+
+	FreeAligned(buf);
+
+	LOG_INFO("Rdb", "warmed up the cache of %s with %d key pages in %d ms",
+		name.c_str(), count,
+		int(std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - start).count()));
+}
+
+/*
+ * Starts warming up the key page cache, if enabled, with the
+ * pages in the manifest.
+ *
+ * @param [in] fname - warm-up manifest.
+ */
+void
+Rdb::startWarmer(const char *fname)
+{
+	std::vector<int64_t> offsets;
+
+	if (!options.warmCache() || !snf::fs::exists(fname))
+		return;
+
+	{
+		WarmFile warmFile(fname, 0022);
+		if (warmFile.open(true) != E_ok)
+			return;
+		if (warmFile.read(kpSize, offsets) != E_ok)
+			offsets.clear();
+		warmFile.close();
+	}
+
+	if (int(offsets.size()) > cache->getNumberOfPages())
+		offsets.resize(cache->getNumberOfPages());
+
+	if (!offsets.empty()) {
+		warmStop = false;
+		warmer = std::thread(&Rdb::warmUp, this, std::move(offsets));
+	}
+}
+
+/*
+ * Stops warming up the key page cache.
+ */
+void
+Rdb::stopWarmer()
+{
+	if (warmer.joinable()) {
+		warmStop = true;
+		warmer.join();
+	}
+}
+
+/*
+ * Records the key pages in the cache, the most recently used
+ * first, in the warm-up manifest (<dbname>.warm).
+ */
+void
+Rdb::saveHotPages()
+{
+	char                    fname[MAXPATHLEN + 1];
+	std::vector<int64_t>    offsets;
+
+	if ((cache == 0) || options.readOnly())
+		return;
+
+	snprintf(fname, MAXPATHLEN, "%s%c%s.warm", path.c_str(), snf::pathsep(), name.c_str());
+
+	cache->getHotPages(offsets, cache->getNumberOfPages());
+	if (offsets.empty()) {
+		snf::fs::remove_file(fname);
+		return;
+	}
+
+	WarmFile warmFile(fname, 0022);
+	if (warmFile.open() == E_ok) {
+		if (warmFile.write(kpSize, offsets) != E_ok)
+			LOG_WARNING("Rdb", "failed to write %s", fname);
+		warmFile.close();
+	}
+}
+
+/**
+ * Rebuilds the database. It does the following:
+ * 1. Backs up the database.
+ * 2. Create a new database.
+ * 3. Reads the key/value from the backed up database files
+ *    and adds them to the new database created.
+ * 4. Cleans up the backed up files.
+ *
+ * Rebuilding database serves two purposes:
+ * 1. Defragment the database.
+ * 2. Provides for a way to change the key page and
+ *    hash table size.
+ *
+ * The expired keys are dropped; the others retain their
+ * expiry time.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+Rdb::rebuild()
+{
+	int             retval = E_ok;
+	char            idxPath[MAXPATHLEN + 1];
+	char            dbPath[MAXPATHLEN + 1];
+	char            dbPathBkup[MAXPATHLEN + 1];
+	char            attrPath[MAXPATHLEN + 1];
+	char            fdpPath[MAXPATHLEN + 1];
+	char            oixPath[MAXPATHLEN + 1];
+	char            warmPath[MAXPATHLEN + 1];
+	int64_t         offset = 0;
+	time_t          now;
+	value_page_t    vp;
+
+	if (options.readOnly()) {
+		LOG_ERROR("Rdb", "database is opened read-only");
+		return E_invalid_state;
+	}
+
+	{
+		std::lock_guard<std::mutex> guard1(openMutex);
+		if (opened) {
+			LOG_ERROR("Rdb", "DB is open; close it before rebuilding");
+			return E_invalid_state;
+		}
+
+		snprintf(idxPath, MAXPATHLEN, "%s%c%s", path.c_str(), snf::pathsep(), name.c_str());
+		strncpy(dbPath, idxPath, MAXPATHLEN);
+		strncpy(attrPath, idxPath, MAXPATHLEN);
+		strncpy(fdpPath, idxPath, MAXPATHLEN);
+		strncpy(oixPath, idxPath, MAXPATHLEN);
+		strncpy(warmPath, idxPath, MAXPATHLEN);
+
+		strncat(idxPath, ".idx", MAXPATHLEN);
+		strncat(dbPath, ".db", MAXPATHLEN);
+		strncat(attrPath, ".attr", MAXPATHLEN);
+		strncat(fdpPath, ".fdp", MAXPATHLEN);
+		strncat(oixPath, ".oix", MAXPATHLEN);
+		strncat(warmPath, ".warm", MAXPATHLEN);
+
+		if ((retval = backupFile(idxPath)) != E_ok)
+			return retval;
+
+		if ((retval = backupFile(dbPath)) != E_ok) {
+			restoreFile(idxPath);
+			return retval;
+		}
+
+		if ((retval = backupFile(attrPath)) != E_ok) {
+			restoreFile(dbPath);
+			restoreFile(idxPath);
+			return retval;
+		}
+
+		if ((retval = backupFile(fdpPath)) != E_ok) {
+			restoreFile(attrPath);
+			restoreFile(dbPath);
+			restoreFile(idxPath);
+			return retval;
+		}
+
+		// The ordered index is derived from the key file; it is
+		// rebuilt by the sets below or on the next open.
+		if (snf::fs::exists(oixPath)) {
+			snf::fs::remove_file(oixPath);
+		}
+
+		// The key pages move; the manifest of the rebuilt
+		// database is written when it is closed below.
+		if (snf::fs::exists(warmPath)) {
+			snf::fs::remove_file(warmPath);
+		}
+	}
+
+	if ((retval = open()) != E_ok) {
+		restoreFile(fdpPath);
+		restoreFile(attrPath);
+		restoreFile(dbPath);
+		restoreFile(idxPath);
+		return retval;
+	}
+
+	strncpy(dbPathBkup, dbPath, MAXPATHLEN);
+	strncat(dbPathBkup, ".bkup", MAXPATHLEN);
+	ValueFile vf(dbPathBkup, 0022);
+	retval = vf.open(false);
+	if (retval != E_ok) {
+		restoreFile(fdpPath);
+		restoreFile(attrPath);
+		restoreFile(dbPath);
+		restoreFile(idxPath);
+		return retval;
+	}
+
+	// The rebuilt database has the same keys; there is no
+	// change to feed.
+	ChangeFeed *rebuildFeed = feed;
+	feed = 0;
+
+	now = time(0);
+
+	// the value pages not matching their checksums are dropped
+	vf.setChecksums(int(sizeof(value_page_t)), options.verifyChecksums());
+
+	while (((retval = vf.read(offset, &vp)) == E_ok) || (retval == E_checksum_failed)) {
+		// a zero-filled page may be left at the end of the file
+		// if a direct I/O write extending the file was interrupted
+		if (retval == E_checksum_failed) {
+			LOG_WARNING("Rdb",
+				"dropping damaged value page at offset %" PRId64, offset);
+			retval = E_ok;
+		} else if ((vp.vp_klen > 0) &&
+			((vp.vp_flags & VPAGE_DELETED) != VPAGE_DELETED) &&
+			!IsValuePageExpired(&vp, now)) {
+			retval = setValue(vp.vp_key, vp.vp_klen, vp.vp_value, vp.vp_vlen,
+					vp.vp_expiry, 0);
+			if (retval != E_ok) 
+				break;
+		}
+		offset += (int64_t) sizeof(vp);
+	}
+
+	if (retval == E_eof_detected) {
+		retval = E_ok;
+	}
+
+	vf.close();
+
+	feed = rebuildFeed;
+
+	close();
+
+	if (retval != E_ok) {
+		restoreFile(fdpPath);
+		restoreFile(attrPath);
+		restoreFile(dbPath);
+		restoreFile(idxPath);
+	} else {
+		removeBackupFile(fdpPath);
+		removeBackupFile(attrPath);
+		removeBackupFile(dbPath);
+		removeBackupFile(idxPath);
+	}
+
+	return retval;
+}
+
+/**
+ * Checkpoints the database i.e. creates a consistent copy of
+ * the database in the specified directory while the database
+ * is in use. It does the following:
+ * 1. Pauses new operations and waits for the in-flight
+ *    operations to finish.
+ * 2. Copies the attributes and free disk page files.
+ * 3. Clones (reflinks) the key and value files if the file
+ *    system supports it. Otherwise, installs a page copier
+ *    on the file; the copier preserves the pages modified
+ *    from here on before they are overwritten.
+ * 4. Resumes the operations.
+ * 5. Copies the remaining pages of the key and value files
+ *    in the background of the live operations.
+ *
+ * The writers are paused only for step 2 and 3 (no data is
+ * copied in step 3 in the absence of reflink support).
+ *
+ * The checkpoint is a database with the same name; it can be
+ * opened by pointing an Rdb object to the directory. It has
+ * the changes up to lastSequence() at the time of the pause,
+ * recorded in <dbname>.seq; a replica opened from it follows
+ * the change feed from there.
+ *
+ * @param [in] dir - checkpoint directory. It is created if it
+ *                   does not exist. It must not be the database
+ *                   directory.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+Rdb::checkpoint(const std::string &dir)
+{
+	int     retval = E_ok;
+	int     oserr = 0;
+	char    attrPath[MAXPATHLEN + 1];
+	char    fdpPath[MAXPATHLEN + 1];
+	char    ckptIdxPath[MAXPATHLEN + 1];
+	char    ckptDbPath[MAXPATHLEN + 1];
+	char    ckptAttrPath[MAXPATHLEN + 1];
+	char    ckptFdpPath[MAXPATHLEN + 1];
+	char    ckptSeqPath[MAXPATHLEN + 1];
+	uint64_t seq = 0;
+
+	if (options.readOnly()) {
+		LOG_ERROR("Rdb", "database is opened read-only");
+		return E_invalid_state;
+	}
+
+	std::unique_ptr<PageCopier> idxCopier;
+	std::unique_ptr<PageCopier> dbCopier;
+
+	if (dir.empty()) {
+		LOG_ERROR("Rdb", "invalid checkpoint directory specified");
+		return E_invalid_arg;
+	}
+
+	if (dir == path) {
+		LOG_ERROR("Rdb", "checkpoint directory %s is the database directory",
+			dir.c_str());
+		return E_invalid_arg;
+	}
+
+	std::lock_guard<std::mutex> ckptGuard(ckptMutex);
+
+	retval = snf::fs::mkdir(dir.c_str(), 0700, &oserr);
+	if (retval != E_ok) {
+		LOG_SYSERR("Rdb", oserr, "failed to create directory %s", dir.c_str());
+		return retval;
+	}
+
+	snprintf(attrPath, MAXPATHLEN, "%s%c%s", path.c_str(), snf::pathsep(), name.c_str());
+	strncpy(fdpPath, attrPath, MAXPATHLEN);
+	strncat(attrPath, ".attr", MAXPATHLEN);
+	strncat(fdpPath, ".fdp", MAXPATHLEN);
+
+	snprintf(ckptIdxPath, MAXPATHLEN, "%s%c%s", dir.c_str(), snf::pathsep(), name.c_str());
+	strncpy(ckptDbPath, ckptIdxPath, MAXPATHLEN);
+	strncpy(ckptAttrPath, ckptIdxPath, MAXPATHLEN);
+	strncpy(ckptFdpPath, ckptIdxPath, MAXPATHLEN);
+	strncpy(ckptSeqPath, ckptIdxPath, MAXPATHLEN);
+
+	strncat(ckptIdxPath, ".idx", MAXPATHLEN);
+	strncat(ckptDbPath, ".db", MAXPATHLEN);
+	strncat(ckptAttrPath, ".attr", MAXPATHLEN);
+	strncat(ckptFdpPath, ".fdp", MAXPATHLEN);
+	strncat(ckptSeqPath, ".seq", MAXPATHLEN);
+
+	snf::file idxCkpt(ckptIdxPath, 0022);
+	if ((retval = openCheckpointFile(&idxCkpt)) != E_ok)
+		return retval;
+
+	snf::file dbCkpt(ckptDbPath, 0022);
+	if ((retval = openCheckpointFile(&dbCkpt)) != E_ok) {
+		idxCkpt.close();
+		return retval;
+	}
+
+	{
+		std::lock_guard<std::mutex> openGuard(openMutex);
+		if (!opened) {
+			LOG_ERROR("Rdb", "DB is not open; cannot checkpoint");
+			dbCkpt.close();
+			idxCkpt.close();
+			return E_invalid_state;
+		}
+
+		ops.pause();
+
+		LOG_DEBUG("Rdb", "operations paused for checkpoint");
+
+		// No change is in flight; the checkpoint has all the
+		// changes up to this one.
+		seq = lastSequence();
+
+		retval = copyFile(ckptAttrPath, attrPath);
+		if (retval == E_ok)
+			retval = copyFile(ckptFdpPath, fdpPath);
+
+		if ((retval == E_ok) && (cloneFile(&idxCkpt, keyFile) != E_ok)) {
+			idxCopier.reset(DBG_NEW PageCopier(keyFile, &idxCkpt,
+						kpSize, keyFile->size()));
+			keyFile->setPageCopier(idxCopier.get());
+		}
+
+		if ((retval == E_ok) && (cloneFile(&dbCkpt, valueFile) != E_ok)) {
+			dbCopier.reset(DBG_NEW PageCopier(valueFile, &dbCkpt,
+						int(sizeof(value_page_t)), valueFile->size()));
+			valueFile->setPageCopier(dbCopier.get());
+		}
+
+		// The checkpoint counts as an operation so that
+		// close waits for it.
+		if (retval == E_ok)
+			ops.hold();
+
+		ops.start();
+
+		LOG_DEBUG("Rdb", "operations resumed after checkpoint pause");
+	}
+
+	if (retval == E_ok) {
+		if (idxCopier) {
+			for (int64_t i = 0; (retval == E_ok) && (i < idxCopier->numberOfBlocks()); ++i)
+				retval = keyFile->copyBlock(i);
+			keyFile->setPageCopier(0);
+			if (retval == E_ok)
+				retval = idxCopier->status();
+		}
+
+		if (dbCopier) {
+			for (int64_t i = 0; (retval == E_ok) && (i < dbCopier->numberOfBlocks()); ++i)
+				retval = valueFile->copyBlock(i);
+			valueFile->setPageCopier(0);
+			if (retval == E_ok)
+				retval = dbCopier->status();
+		}
+
+		endOp();
+	}
+
+	if (retval == E_ok) {
+		if ((retval = idxCkpt.sync(&oserr)) == E_ok)
+			retval = dbCkpt.sync(&oserr);
+		if (retval != E_ok) {
+			LOG_SYSERR("Rdb", oserr, "failed to sync checkpoint files in %s",
+				dir.c_str());
+		}
+	}
+
+	if (retval == E_ok) {
+		SeqFile seqCkpt(ckptSeqPath, 0022);
+		if ((retval = seqCkpt.open()) == E_ok) {
+			seqCkpt.setSequence(seq);
+			if ((retval = seqCkpt.write()) == E_ok)
+				retval = seqCkpt.sync(&oserr);
+			seqCkpt.close();
+		}
+	}
+
+	if (retval != E_ok) {
+		LOG_ERROR("Rdb", "failed to checkpoint database %s to %s",
+			name.c_str(), dir.c_str());
+	}
+
+	dbCkpt.close();
+	idxCkpt.close();
+
+	return retval;
+}
+
+/**
+ * Gets the database generation. It is bumped on every update
+ * made to the database by the process that opened it with
+ * the hash table shared; a reader can compare it with a value
+ * read earlier to detect the updates cheaply.
+ *
+ * @return the generation, 0 if the hash table is not shared.
+ */
+uint64_t
+Rdb::generation()
+{
+	if (reader)
+		return reader->generation();
+
+	if (htiFile && htiFile->data())
+		return reinterpret_cast<hti_header_t *>(htiFile->data())->hh_gen.load();
+
+	return 0;
+}
+
+/*
+ * Appends the change to the change feed, if enabled. Must be
+ * called, once the change is applied, with the hash table
+ * entry of the key still locked so that the changes to a
+ * key are fed in the order they are applied.
+ *
+ * @param [in] op     - CHANGE_SET or CHANGE_REMOVE.
+ * @param [in] key    - database key.
+ * @param [in] klen   - database key length.
+ * @param [in] value  - value (set).
+ * @param [in] vlen   - value length (set).
+ * @param [in] expiry - expiry time (set).
+ */
+void
+Rdb::logChange(int op, const char *key, int klen, const char *value, int vlen, uint32_t expiry)
+{
+	if (feed)
+		feed->append(op, key, klen, value, vlen, expiry);
+}
+
+/*
+ * Opens the sequence file, creating it if it does not exist,
+ * and reads the sequence of the last change applied.
+ *
+ * @param [in] fname - sequence file name.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+Rdb::openSeqFile(const char *fname)
+{
+	int retval;
+
+	std::unique_ptr<SeqFile> pSeqFile(DBG_NEW SeqFile(fname, 0022));
+	retval = pSeqFile->open();
+	if (retval != E_ok)
+		return retval;
+
+	retval = pSeqFile->read();
+	if (retval == E_eof_detected) {
+		pSeqFile->setSequence(0);
+		retval = E_ok;
+	}
+
+	if (retval == E_ok) {
+		appliedSeq = pSeqFile->getSequence();
+		seqFile = pSeqFile.release();
+	}
+
+	return retval;
+}
+
+/*
+ * Applies a change read from the change feed of another
+ * database. Applying a change again is harmless.
+ *
+ * @param [in] cr - change record.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+Rdb::applyChange(const change_rec_t *cr)
+{
+	int         retval;
+	int         hindex = -1;
+	key_info_t  ki;
+
+	if ((retval = beginOp()) != E_ok) {
+		return retval;
+	}
 
-				if ((next_kpoff != -1L) && (next_kpn == 0)) {
-					retval = cache->get(next_kpn, next_kpoff);
-					if (retval == E_ok) {
-						hashTable->addKeyPageNode(dki.ki_hash, next_kpn);
-					} else {
-						LOG_ERROR("Rdb",
-							"failed to read key page at offset %" PRId64,
-							next_kpoff);
-					}
-				}
+	hindex = hash(cr->cr_key, cr->cr_klen, htSize);
+	ASSERT(((hindex >= 0) && (hindex < htSize)), "Rdb", 0,
+		"invalid hash value (%d)", hindex);
 
-				if (retval == E_ok) {
-					if ((prev_kpoff != -1L) && (prev_kpn != 0)) {
-						prev_kp = prev_kpn->kpn_kp;
-					}
+	{
+		HTLockGuard guard(hashTable, hindex, true);
 
-					if ((next_kpoff != -1L) && (next_kpn != 0)) {
-						next_kp = next_kpn->kpn_kp;
-					}
+		SetKeyInfo(&ki, cr->cr_key, cr->cr_klen, hindex);
 
-					// Mark the key page as deleted
-					retval = keyFile->writeFlags(dki.ki_kpn->kpn_kpoff,
-								dki.ki_kpn->kpn_kp, KPAGE_DELETED);
-					if (retval != E_ok) {
-						LOG_ERROR("Rdb",
-							"failed to mark key page at offset %" PRId64 " as deleted",
-							dki.ki_kpn->kpn_kpoff);
-					} else {
-						ustk.writeFlags(keyFile, dki.ki_kpn->kpn_kp,
-							dki.ki_kpn->kpn_kpoff, 0);
+		if (cr->cr_op == CHANGE_SET) {
+			retval = store(&ki, cr->cr_value, cr->cr_vlen, int64_t(cr->cr_expiry), 0);
+		} else {
+			retval = removeKey(&ki, 0);
+			if (retval == E_not_found)
+				retval = E_ok;
+		}
+	}
 
-						int64_t offset = -1L;
+	endOp();
 
-						// Update next offset of the previous page
-						if (prev_kp) {
-							offset = prev_kp->kp_noff;
-							retval = keyFile->writeNextOffset(prev_kpoff, prev_kp, next_kpoff);
-							if (retval != E_ok) {
-								LOG_ERROR("Rdb", "failed to update key page at offset %" PRId64
-									" to %s", prev_kpoff, keyFile->name());
-							} else {
-								ustk.writeNextOffset(keyFile, prev_kp, prev_kpoff, offset);
-							}
-						}
+	return retval;
+}
 
-						// Update previous offset of the next page
-						if ((retval == E_ok) && next_kp) {
-							offset = next_kp->kp_poff;
-							retval = keyFile->writePrevOffset(next_kpoff, next_kp, prev_kpoff);
-							if (retval != E_ok) {
-								LOG_ERROR("Rdb", "failed to update key page at offset %" PRId64
-									" to %s", next_kpoff, keyFile->name());
-							} else {
-								ustk.writePrevOffset(keyFile, next_kp, next_kpoff, offset);
-							}
-						}
+/**
+ * Gets the sequence number of the last change in the
+ * database: the last one fed if the change feed is enabled,
+ * the last one applied (see applyChanges()) otherwise.
+ *
+ * @return the sequence number, 0 if there is none.
+ */
+uint64_t
+Rdb::lastSequence()
+{
+	if (feed)
+		return feed->lastSequence();
 
-						if (retval == E_ok) {
-							// Update other data structures
-							offset = dki.ki_kpn->kpn_kpoff;
-							hashTable->removeKeyPageNode(hindex, dki.ki_kpn);
-							cache->free(dki.ki_kpn);
-							retval = keyFile->freePage(offset);
-						}
-					}
-				}
-			}
+	// Not locked: checkpoint() calls it with the appliers
+	// paused. The changes of a batch being applied may be
+	// in the database already; applying them again is fine.
+	return appliedSeq;
+}
 
-			if (retval == E_ok) {
-				retval = valueFile->freePage(ki.ki_voff);
-			}
-		}
+/**
+ * Reads the changes from the change feed (see
+ * RdbOptions::changeFeed()). Every change committed to the
+ * database, a set (including the updates made by expire(),
+ * increment(), compareAndSet() and the transactions) or a
+ * remove (including the expired keys swept), is in the feed
+ * with a sequence number that grows by one with every change.
+ * Applying the changes in order to a copy of the database
+ * (see checkpoint() and applyChanges()) makes it a replica.
+ *
+ * @param [in]  from    - sequence of the first change to read.
+ * @param [in]  max     - maximum number of changes to read.
+ * @param [out] changes - changes read, in sequence order; it
+ *                        is empty if there is no change after
+ *                        from yet, and may have fewer changes
+ *                        than there are.
+ *
+ * @return E_ok on success, E_not_found if the change is no
+ * longer in the feed (the reader has to start over from a
+ * checkpoint), E_mismatch if the reader is ahead of the
+ * feed, E_invalid_state if the feed is not enabled, -ve
+ * error code on failure.
+ */
+int
+Rdb::readChanges(uint64_t from, int max, std::vector<change_rec_t> &changes)
+{
+	int retval;
+
+	if (feed == 0) {
+		LOG_ERROR("Rdb", "change feed is not enabled");
+		return E_invalid_state;
 	}
 
-	ustk.unwind(retval);
+	if ((from == 0) || (max <= 0)) {
+		LOG_ERROR("Rdb", "invalid sequence (%" PRIu64 ") or count (%d) specified",
+			from, max);
+		return E_invalid_arg;
+	}
 
-	{
-		std::lock_guard<std::mutex> guard(opMutex);
-		opCount--;
+	if ((retval = beginOp()) == E_ok) {
+		retval = feed->read(from, max, changes);
+		endOp();
 	}
 
 	return retval;
 }
 
 /**
- * Rebuilds the database. It does the following:
- * 1. Backs up the database.
- * 2. Create a new database.
- * 3. Reads the key/value from the backed up database files
- *    and adds them to the new database created.
- * 4. Cleans up the backed up files.
+ * Waits for the change feed to reach the given sequence
+ * number. It is not an operation that holds up checkpoint()
+ * but, like the others, must not be called while the
+ * database is being closed.
  *
- * Rebuilding database serves two purposes:
- * 1. Defragment the database.
- * 2. Provides for a way to change the key page and
- *    hash table size.
+ * @param [in] seq - sequence to wait for.
+ * @param [in] to  - timeout in milliseconds.
  *
- * @return E_ok on success, -ve error code on failure.
+ * @return E_ok if the feed has reached seq, E_timed_out if
+ * not, E_invalid_state if the feed is not enabled, -ve error
+ * code on failure.
  */
 int
-Rdb::rebuild()
+Rdb::waitForChanges(uint64_t seq, int to)
 {
-	int             retval = E_ok;
-	char            idxPath[MAXPATHLEN + 1];
-	char            dbPath[MAXPATHLEN + 1];
-	char            dbPathBkup[MAXPATHLEN + 1];
-	char            attrPath[MAXPATHLEN + 1];
-	char            fdpPath[MAXPATHLEN + 1];
-	int64_t         offset = 0;
-	value_page_t    vp;
+	if (feed == 0) {
+		LOG_ERROR("Rdb", "change feed is not enabled");
+		return E_invalid_state;
+	}
 
-	{
-		std::lock_guard<std::mutex> guard1(openMutex);
-		if (opened) {
-			LOG_ERROR("Rdb", "DB is open; close it before rebuilding");
-			return E_invalid_state;
-		}
+	if (to < 0) {
+		LOG_ERROR("Rdb", "invalid timeout (%d) specified", to);
+		return E_invalid_arg;
+	}
 
-		snprintf(idxPath, MAXPATHLEN, "%s%c%s", path.c_str(), snf::pathsep(), name.c_str());
-		strncpy(dbPath, idxPath, MAXPATHLEN);
-		strncpy(attrPath, idxPath, MAXPATHLEN);
-		strncpy(fdpPath, idxPath, MAXPATHLEN);
+	return feed->wait(seq, to);
+}
 
-		strncat(idxPath, ".idx", MAXPATHLEN);
-		strncat(dbPath, ".db", MAXPATHLEN);
-		strncat(attrPath, ".attr", MAXPATHLEN);
-		strncat(fdpPath, ".fdp", MAXPATHLEN);
+/**
+ * Applies, in order, the changes read from the change feed
+ * of another database, making this database its replica.
+ * The changes already applied are skipped; the sequence of
+ * the last change applied is saved in <dbname>.seq once the
+ * batch is applied (see lastSequence()). The replica is
+ * usually opened from a checkpoint of the other database,
+ * which has the sequence of the last change in it.
+ *
+ * A database with the change feed enabled cannot apply the
+ * changes of another one.
+ *
+ * @param [in] changes - changes, in sequence order.
+ *
+ * @return E_ok on success, E_mismatch if a change is missing
+ * i.e. the first change is not the one after lastSequence(),
+ * -ve error code on failure.
+ */
+int
+Rdb::applyChanges(const std::vector<change_rec_t> &changes)
+{
+	int         retval = E_ok;
+	int         oserr = 0;
+	uint64_t    seq;
+	char        seqPath[MAXPATHLEN + 1];
 
-		if ((retval = backupFile(idxPath)) != E_ok)
-			return retval;
+	if (options.readOnly() || feed) {
+		LOG_ERROR("Rdb", "database is opened read-only or has the change feed");
+		return E_invalid_state;
+	}
 
-		if ((retval = backupFile(dbPath)) != E_ok) {
-			restoreFile(idxPath);
-			return retval;
+	std::lock_guard<std::mutex> guard(applyMutex);
+
+	seq = appliedSeq;
+
+	for (const change_rec_t &cr : changes) {
+		if (cr.cr_seq <= seq)
+			continue;
+
+		if (cr.cr_seq != (seq + 1)) {
+			LOG_ERROR("Rdb", "change %" PRIu64 " is missing", seq + 1);
+			retval = E_mismatch;
+			break;
 		}
 
-		if ((retval = backupFile(attrPath)) != E_ok) {
-			restoreFile(dbPath);
-			restoreFile(idxPath);
-			return retval;
+		if ((cr.cr_magic != CHANGE_MAGIC) ||
+			((cr.cr_op != CHANGE_SET) && (cr.cr_op != CHANGE_REMOVE)) ||
+			(cr.cr_klen <= 0) || (cr.cr_klen > MAX_KEY_LENGTH) ||
+			((cr.cr_op == CHANGE_SET) &&
+				((cr.cr_vlen <= 0) || (cr.cr_vlen > MAX_VALUE_LENGTH)))) {
+			LOG_ERROR("Rdb", "invalid change %" PRIu64, cr.cr_seq);
+			retval = E_invalid_arg;
+			break;
 		}
 
-		if ((retval = backupFile(fdpPath)) != E_ok) {
-			restoreFile(attrPath);
-			restoreFile(dbPath);
-			restoreFile(idxPath);
-			return retval;
+		retval = applyChange(&cr);
+		if (retval != E_ok) {
+			LOG_ERROR("Rdb", "failed to apply change %" PRIu64 ", error = %d",
+				cr.cr_seq, retval);
+			break;
 		}
+
+		seq = cr.cr_seq;
 	}
 
-	if ((retval = open()) != E_ok) {
-		restoreFile(fdpPath);
-		restoreFile(attrPath);
-		restoreFile(dbPath);
-		restoreFile(idxPath);
+	if (seq == appliedSeq)
 		return retval;
+
+	int r = E_ok;
+
+	if (seqFile == 0) {
+		snprintf(seqPath, MAXPATHLEN, "%s%c%s.seq", path.c_str(), snf::pathsep(), name.c_str());
+		r = openSeqFile(seqPath);
 	}
 
-	strncpy(dbPathBkup, dbPath, MAXPATHLEN);
-	strncat(dbPathBkup, ".bkup", MAXPATHLEN);
-	ValueFile vf(dbPathBkup, 0022);
-	retval = vf.open(false);
-	if (retval != E_ok) {
-		restoreFile(fdpPath);
-		restoreFile(attrPath);
-		restoreFile(dbPath);
-		restoreFile(idxPath);
-		return retval;
+	if (r == E_ok) {
+		seqFile->setSequence(seq);
+		r = seqFile->write();
+		if ((r == E_ok) && options.syncDataFile())
+			r = seqFile->sync(&oserr);
 	}
 
-	while ((retval = vf.read(offset, &vp)) == E_ok) {
-		if ((vp.vp_flags & VPAGE_DELETED) != VPAGE_DELETED) {
-			retval = set(vp.vp_key, vp.vp_klen, vp.vp_value, vp.vp_vlen);
-			if (retval != E_ok) 
-				break;
+	if (r != E_ok) {
+		LOG_ERROR("Rdb", "failed to save the sequence of the last change applied");
+	}
+
+	// The changes are in the database even if the sequence is
+	// not saved; they are applied again after a restart.
+	appliedSeq = seq;
+
+	return (retval == E_ok) ? r : retval;
+}
+
+/*
+ * Scans the key pages in the key file to find the number of
+ * keys and the distribution of the key page chain lengths.
+ * The key pages are read directly from the key file, in
+ * batches, so the cache is not disturbed. The pages updated
+ * while the scan is in progress may be counted as they were
+ * before or after the update.
+ *
+ * @param [inout] stats - database statistics.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+Rdb::scanKeyPages(RdbStats &stats)
+{
+	const int           batch = 64;
+	int                 retval = E_ok;
+	int                 oserr = 0;
+	int64_t             fsize;
+	int64_t             offset;
+	std::vector<int>    chains(size_t(htSize), 0);
+
+	fsize = keyFile->size(&oserr);
+	if (fsize < 0) {
+		LOG_SYSERR("Rdb", oserr,
+			"failed to get size of file %s", keyFile->name());
+		return int(fsize);
+	}
+
+	std::unique_ptr<char[]> buf(DBG_NEW char[batch * kpSize]);
+
+	for (offset = 0; (offset + kpSize) <= fsize; ) {
+		int n = int(std::min(int64_t(batch), (fsize - offset) / kpSize));
+
+		retval = keyFile->read(offset, buf.get(), n * kpSize);
+		if (retval != E_ok) {
+			LOG_ERROR("Rdb",
+				"failed to read key pages at offset %" PRId64,
+				offset);
+			return retval;
 		}
-		offset += (int64_t) sizeof(vp);
+
+		for (int i = 0; i < n; ++i) {
+			const key_page_t *kp =
+				reinterpret_cast<const key_page_t *>(buf.get() + i * kpSize);
+
+			if (IsKeyPageDeleted(kp) || (kp->kp_vcount <= 0) ||
+				(kp->kp_hash < 0) || (kp->kp_hash >= htSize))
+				continue;
+
+			chains[kp->kp_hash]++;
+			stats.keyPages++;
+			stats.keys += kp->kp_vcount;
+		}
+
+		offset += int64_t(n) * kpSize;
 	}
 
-	if (retval == E_eof_detected) {
-		retval = E_ok;
+	for (int i = 0; i < htSize; ++i) {
+		if (chains[i] > stats.maxChainLength)
+			stats.maxChainLength = chains[i];
 	}
 
-	vf.close();
+	stats.chainLengths.assign(
+		size_t(std::min(stats.maxChainLength, RDB_CHAIN_LENGTHS - 1) + 1), 0);
 
-	close();
+	for (int i = 0; i < htSize; ++i) {
+		int len = std::min(chains[i], RDB_CHAIN_LENGTHS - 1);
+		stats.chainLengths[len]++;
+	}
 
-	if (retval != E_ok) {
-		restoreFile(fdpPath);
-		restoreFile(attrPath);
-		restoreFile(dbPath);
-		restoreFile(idxPath);
-	} else {
-		removeBackupFile(fdpPath);
-		removeBackupFile(attrPath);
-		removeBackupFile(dbPath);
-		removeBackupFile(idxPath);
+	return retval;
+}
+
+/**
+ * Gets the database statistics. The counters are updated
+ * without locks, so they are not consistent with each other
+ * while the database is in use; they are meant to monitor
+ * the database and to size the hash table and the cache.
+ *
+ * If the database is opened read-only, only the operation
+ * latencies are available.
+ *
+ * @param [out] stats - database statistics.
+ * @param [in]  scan  - scan the key pages to find the key
+ *                      page chain lengths? It reads the
+ *                      whole key file.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+Rdb::getStats(RdbStats &stats, bool scan)
+{
+	int retval = E_ok;
+
+	stats.clear();
+
+	getLatency.get(stats.gets);
+	setLatency.get(stats.sets);
+	removeLatency.get(stats.removes);
+	stats.htSize = htSize;
+
+	std::lock_guard<std::mutex> guard(openMutex);
+	if (!opened || reader) {
+		return E_ok;
+	}
+
+	stats.cacheHits = cache->getHits();
+	stats.cacheMisses = cache->getMisses();
+	stats.cacheEvictions = cache->getEvictions();
+	stats.cachePages = cache->getNumberOfPages();
+	stats.cacheFreePages = cache->getNumberOfFreePages();
+
+	stats.keyPageReads = keyFile->getReads();
+	stats.keyPageWrites = keyFile->getWrites();
+	stats.keyPageSyncs = keyFile->getSyncs();
+	stats.valuePageReads = valueFile->getReads();
+	stats.valuePageWrites = valueFile->getWrites();
+	stats.valuePageSyncs = valueFile->getSyncs();
+	stats.checksumsVerified = keyFile->getChecksumsVerified() +
+		valueFile->getChecksumsVerified();
+	stats.checksumFailures = keyFile->getChecksumFailures() +
+		valueFile->getChecksumFailures();
+
+	// The end of the file is always on the free page
+	// stack; it is not a free page.
+	FreeDiskPageMgr *fdpMgr = keyFile->getFreeDiskPageMgr();
+	if (fdpMgr && (fdpMgr->size() > 0))
+		stats.freeKeyPages = int64_t(fdpMgr->size()) - 1;
+
+	fdpMgr = valueFile->getFreeDiskPageMgr();
+	if (fdpMgr && (fdpMgr->size() > 0))
+		stats.freeValuePages = int64_t(fdpMgr->size()) - 1;
+
+	stats.lockWaits = hashTable->getLockWaits();
+	stats.lockWaitUsec = hashTable->getLockWaitTime();
+
+	if (scan) {
+		retval = scanKeyPages(stats);
 	}
 
 	return retval;
 }
 
 /**
- * Closes the database.
+ * Closes the database. The new operations are held off and
+ * the operations in flight (including a checkpoint being
+ * copied) are waited for; once the database is closed, the
+ * operations held off, and the ones started later, fail with
+ * E_invalid_state.
  *
  * @return E_ok on success, -ve error code on failure.
  */
@@ -1131,10 +3981,14 @@ Rdb::close()
 		return E_ok;
 	}
 
-	std::lock_guard<std::mutex> guard2(opMutex);
-	if (opCount > 0) {
-		return E_try_again;
-	}
+	stopWarmer();
+	stopSweeper();
+
+	ops.pause();
+
+	LOG_DEBUG("Rdb", "operations drained for close");
+
+	saveHotPages();
 
 	if (valueFile) {
 		delete valueFile;
@@ -1146,6 +4000,26 @@ Rdb::close()
 		keyFile = 0;
 	}
 
+	if (oindex) {
+		delete oindex;
+		oindex = 0;
+	}
+
+	if (txnLog) {
+		delete txnLog;
+		txnLog = 0;
+	}
+
+	if (feed) {
+		delete feed;
+		feed = 0;
+	}
+
+	if (seqFile) {
+		delete seqFile;
+		seqFile = 0;
+	}
+
 	if (cache) {
 		delete cache;
 		cache = 0;
@@ -1156,7 +4030,19 @@ Rdb::close()
 		hashTable = 0;
 	}
 
+	if (htiFile) {
+		htiFile->flush();
+		delete htiFile;
+		htiFile = 0;
+	}
+
+	if (reader) {
+		delete reader;
+		reader = 0;
+	}
+
 	opened = false;
+	ops.stop();
 
 	return E_ok;
 }
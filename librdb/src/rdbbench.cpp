@@ -0,0 +1,649 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "rdb.h"
+#include "json.h"
+#include "logmgr.h"
+#include "logger.h"
+#include "flogger.h"
+
+static bool   Verbosity;
+
+/*
+ * Benchmark configuration.
+ */
+typedef struct bench_config
+{
+	int64_t     num;        // keys in the database
+	int64_t     reads;      // operations of the read/update/delete benchmarks
+	int         threads;    // client threads
+	int         kmin;       // min key size
+	int         kmax;       // max key size
+	int         vmin;       // min value size
+	int         vmax;       // max value size
+	double      zipf;       // Zipfian skew (0: uniform)
+	uint64_t    seed;       // random seed
+} bench_config_t;
+
+/*
+ * Result of a benchmark thread.
+ */
+typedef struct bench_result
+{
+	int64_t                 ops;        // operations done
+	int64_t                 found;      // keys found (reads)
+	int64_t                 errors;     // operations failed
+	int64_t                 bytes;      // key + value bytes moved
+	std::vector<int64_t>    latencies;  // operation latencies in nanoseconds
+} bench_result_t;
+
+/*
+ * Picks the key indices in [0, n): uniformly, or with a
+ * Zipfian distribution of the given skew (theta). The Zipfian
+ * ranks are scrambled so that the popular keys are spread
+ * over the key space (as YCSB does).
+ */
+class KeyChooser
+{
+private:
+	int64_t     n;
+	double      theta;
+	double      alpha;
+	double      zetan;
+	double      eta;
+
+	static double zeta(int64_t n, double theta)
+	{
+		double sum = 0;
+		for (int64_t i = 1; i <= n; ++i)
+			sum += 1.0 / std::pow(double(i), theta);
+		return sum;
+	}
+
+	static uint64_t fnv(uint64_t v)
+	{
+		uint64_t h = 0xCBF29CE484222325ULL;
+		for (int i = 0; i < 8; ++i) {
+			h ^= (v & 0xFF);
+			h *= 0x100000001B3ULL;
+			v >>= 8;
+		}
+		return h;
+	}
+
+public:
+	KeyChooser(int64_t n, double theta)
+		: n(n),
+		  theta(theta),
+		  alpha(0),
+		  zetan(0),
+		  eta(0)
+	{
+		if (theta > 0) {
+			double zeta2 = zeta(2, theta);
+			zetan = zeta(n, theta);
+			alpha = 1.0 / (1.0 - theta);
+			eta = (1.0 - std::pow(2.0 / double(n), 1.0 - theta)) /
+				(1.0 - zeta2 / zetan);
+		}
+	}
+
+	int64_t next(std::mt19937_64 &rng) const
+	{
+		if (theta <= 0)
+			return int64_t(rng() % uint64_t(n));
+
+		double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+		double uz = u * zetan;
+		int64_t rank;
+
+		if (uz < 1.0)
+			rank = 0;
+		else if (uz < (1.0 + std::pow(0.5, theta)))
+			rank = 1;
+		else
+			rank = int64_t(double(n) * std::pow(eta * u - eta + 1.0, alpha));
+
+		if (rank >= n)
+			rank = n - 1;
+
+		return int64_t(fnv(uint64_t(rank)) % uint64_t(n));
+	}
+};
+
+/*
+ * Generates the keys and the values. The key of an index is
+ * the index, zero-padded to the key size; the key size of an
+ * index is fixed, so the same index always gives the same
+ * key. The values are slices of a random printable buffer.
+ */
+class Generator
+{
+private:
+	const bench_config_t    &config;
+	std::string             data;
+
+	static uint64_t mix(uint64_t v)
+	{
+		v ^= v >> 33;
+		v *= 0xFF51AFD7ED558CCDULL;
+		v ^= v >> 33;
+		return v;
+	}
+
+public:
+	Generator(const bench_config_t &cfg)
+		: config(cfg)
+	{
+		std::mt19937_64 rng(cfg.seed);
+		data.resize(size_t(cfg.vmax) * 4);
+		for (size_t i = 0; i < data.size(); ++i)
+			data[i] = char('a' + (rng() % 26));
+	}
+
+	int key(int64_t index, char *buf) const
+	{
+		int klen = config.kmin;
+		if (config.kmax > config.kmin)
+			klen += int(mix(uint64_t(index)) % uint64_t(config.kmax - config.kmin + 1));
+		snprintf(buf, MAX_KEY_LENGTH + 1, "%0*" PRId64, klen, index);
+		return klen;
+	}
+
+	const char *value(std::mt19937_64 &rng, int *vlen) const
+	{
+		*vlen = config.vmin;
+		if (config.vmax > config.vmin)
+			*vlen += int(rng() % uint64_t(config.vmax - config.vmin + 1));
+		return data.data() + (rng() % uint64_t(data.size() - *vlen + 1));
+	}
+};
+
+/*
+ * A benchmark: runs the operation in the given number of
+ * threads; every thread does ops operations.
+ */
+typedef std::function<void(int, int64_t, std::mt19937_64 &, bench_result_t &)> bench_op_t;
+
+static int64_t
+Elapsed(const std::chrono::steady_clock::time_point &start)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start).count();
+}
+
+static double
+Percentile(const std::vector<int64_t> &sorted, double pct)
+{
+	if (sorted.empty())
+		return 0;
+
+	size_t i = size_t(std::ceil(double(sorted.size()) * pct / 100.0));
+	if (i > 0)
+		i--;
+	if (i >= sorted.size())
+		i = sorted.size() - 1;
+
+	return double(sorted[i]) / 1000.0;
+}
+
+static snf::json::value
+Run(
+	const char *name,
+	const bench_config_t &config,
+	int threads,
+	int64_t ops,
+	const bench_op_t &op,
+	const std::function<void(std::atomic<bool> &, bench_result_t &)> &background = nullptr)
+{
+	std::vector<bench_result_t> results(threads);
+	std::vector<std::thread>    workers;
+	std::atomic<int>            ready(0);
+	std::atomic<bool>           go(false);
+	std::atomic<bool>           done(false);
+	bench_result_t              bgResult = bench_result_t();
+	std::thread                 bgThread;
+
+	if (background)
+		bgThread = std::thread([&] {
+			while (!go.load())
+				std::this_thread::yield();
+			background(done, bgResult);
+		});
+
+	for (int t = 0; t < threads; ++t) {
+		int64_t n = ops / threads + ((t < (ops % threads)) ? 1 : 0);
+		results[t] = bench_result_t();
+		results[t].latencies.reserve(size_t(n));
+		workers.push_back(std::thread([&, t, n] {
+			std::mt19937_64 rng(config.seed + uint64_t(t) + 1);
+			ready++;
+			while (!go.load())
+				std::this_thread::yield();
+			op(t, n, rng, results[t]);
+		}));
+	}
+
+	while (ready.load() < threads)
+		std::this_thread::yield();
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	go = true;
+
+	for (std::thread &w : workers)
+		w.join();
+
+	int64_t elapsed = Elapsed(start);
+
+	done = true;
+	if (bgThread.joinable())
+		bgThread.join();
+
+	bench_result_t total = bench_result_t();
+	for (bench_result_t &r : results) {
+		total.ops += r.ops;
+		total.found += r.found;
+		total.errors += r.errors;
+		total.bytes += r.bytes;
+		total.latencies.insert(total.latencies.end(), r.latencies.begin(), r.latencies.end());
+		r.latencies.clear();
+		r.latencies.shrink_to_fit();
+	}
+
+	std::sort(total.latencies.begin(), total.latencies.end());
+
+	double seconds = double(elapsed) / 1e9;
+	double avg = 0;
+	if (!total.latencies.empty()) {
+		for (int64_t l : total.latencies)
+			avg += double(l);
+		avg /= double(total.latencies.size()) * 1000.0;
+	}
+
+	snf::json::object result {
+		KVPAIR("benchmark", name),
+		KVPAIR("threads", threads),
+		KVPAIR("ops", total.ops),
+		KVPAIR("errors", total.errors),
+		KVPAIR("seconds", seconds),
+		KVPAIR("ops_per_sec", (seconds > 0) ? (double(total.ops) / seconds) : 0.0),
+		KVPAIR("mb_per_sec", (seconds > 0) ? (double(total.bytes) / 1048576.0 / seconds) : 0.0),
+		KVPAIR("latency_us", OBJECT {
+			KVPAIR("avg", avg),
+			KVPAIR("p50", Percentile(total.latencies, 50)),
+			KVPAIR("p99", Percentile(total.latencies, 99)),
+			KVPAIR("p999", Percentile(total.latencies, 99.9)),
+			KVPAIR("max", Percentile(total.latencies, 100))
+		})
+	};
+
+	if (strncmp(name, "read", 4) == 0)
+		result.add("found", total.found);
+
+	if (background)
+		result.add("background_writes", bgResult.ops);
+
+	if (Verbosity) {
+		std::cerr
+			<< name << ": " << total.ops << " ops in "
+			<< seconds << " s" << std::endl;
+	}
+
+	return result;
+}
+
+static int
+usage(const char *prog)
+{
+	std::cerr
+		<< prog
+		<< " -path <db_path> -name <db_name>" << std::endl
+		<< "        [-benchmarks <name,...>] [-num <keys>] [-reads <ops>]" << std::endl
+		<< "        [-threads <n>] [-ksize <min>[:<max>]] [-vsize <min>[:<max>]]" << std::endl
+		<< "        [-zipf <skew>] [-seed <n>] [-htsize <hash_table_size>]" << std::endl
+		<< "        [-pgsize <page_size>] [-memusage <%_of_memory>]" << std::endl
+		<< "        [-syncdf <0|1>] [-syncif <0|1>] [-pretty]" << std::endl
+		<< "        [-logpath <log_path>] [-v]" << std::endl
+		<< "benchmarks: fillseq, fillrandom, readrandom, readmissing," << std::endl
+		<< "            readwhilewriting, updaterandom, deleterandom" << std::endl;
+	return 1;
+}
+
+/*
+ * Parses <min>[:<max>].
+ */
+static bool
+ParseRange(const char *arg, int *min, int *max)
+{
+	char *end = 0;
+
+	*min = int(strtol(arg, &end, 10));
+	if (*end == ':')
+		*max = int(strtol(end + 1, &end, 10));
+	else
+		*max = *min;
+
+	return (*end == '\0') && (*min > 0) && (*max >= *min);
+}
+
+int
+main(int argc, const char **argv)
+{
+	int retval = E_ok;
+	std::string path;
+	std::string name;
+	std::string logPath;
+	std::string benchmarks = "fillseq,fillrandom,readrandom,readmissing,"
+				"readwhilewriting,updaterandom,deleterandom";
+	int htSize = -1;
+	int pgSize = -1;
+	bool pretty = false;
+	RdbOptions dbOpt;
+	bench_config_t config;
+	char prog[MAXPATHLEN + 1];
+
+	config.num = 100000;
+	config.reads = -1;
+	config.threads = 1;
+	config.kmin = config.kmax = 16;
+	config.vmin = config.vmax = 100;
+	config.zipf = 0;
+	config.seed = 301;
+
+	snf::basename(prog, MAXPATHLEN + 1, argv[0], true);
+
+	for (int i = 1; i < argc; ++i) {
+		const char *opt = argv[i];
+
+		if (strcmp("-pretty", opt) == 0) {
+			pretty = true;
+			continue;
+		} else if (strcmp("-v", opt) == 0) {
+			Verbosity = true;
+			continue;
+		}
+
+		++i;
+		if (argv[i] == 0) {
+			std::cerr << "missing argument to " << opt << std::endl;
+			return usage(prog);
+		}
+
+		if (strcmp("-path", opt) == 0) {
+			path = argv[i];
+		} else if (strcmp("-name", opt) == 0) {
+			name = argv[i];
+		} else if (strcmp("-benchmarks", opt) == 0) {
+			benchmarks = argv[i];
+		} else if (strcmp("-num", opt) == 0) {
+			config.num = atoll(argv[i]);
+		} else if (strcmp("-reads", opt) == 0) {
+			config.reads = atoll(argv[i]);
+		} else if (strcmp("-threads", opt) == 0) {
+			config.threads = atoi(argv[i]);
+		} else if (strcmp("-ksize", opt) == 0) {
+			if (!ParseRange(argv[i], &config.kmin, &config.kmax) ||
+				(config.kmax > MAX_KEY_LENGTH)) {
+				std::cerr << "invalid key size (" << argv[i] << ")" << std::endl;
+				return 1;
+			}
+		} else if (strcmp("-vsize", opt) == 0) {
+			if (!ParseRange(argv[i], &config.vmin, &config.vmax) ||
+				(config.vmax > MAX_VALUE_LENGTH)) {
+				std::cerr << "invalid value size (" << argv[i] << ")" << std::endl;
+				return 1;
+			}
+		} else if (strcmp("-zipf", opt) == 0) {
+			config.zipf = atof(argv[i]);
+		} else if (strcmp("-seed", opt) == 0) {
+			config.seed = strtoull(argv[i], 0, 10);
+		} else if (strcmp("-htsize", opt) == 0) {
+			htSize = atoi(argv[i]);
+		} else if (strcmp("-pgsize", opt) == 0) {
+			pgSize = atoi(argv[i]);
+		} else if (strcmp("-memusage", opt) == 0) {
+			if (dbOpt.setMemoryUsage(atoi(argv[i])) != E_ok) {
+				std::cerr << "invalid memory usage (" << argv[i] << ")" << std::endl;
+				return 1;
+			}
+		} else if (strcmp("-syncdf", opt) == 0) {
+			dbOpt.syncDataFile(atoi(argv[i]) != 0);
+		} else if (strcmp("-syncif", opt) == 0) {
+			dbOpt.syncIndexFile(atoi(argv[i]) != 0);
+		} else if (strcmp("-logpath", opt) == 0) {
+			logPath = argv[i];
+		} else {
+			return usage(prog);
+		}
+	}
+
+	if (path.empty() || name.empty()) {
+		std::cerr << "database path and name must be specified" << std::endl;
+		return usage(prog);
+	}
+
+	if ((config.num <= 0) || (config.threads <= 0)) {
+		std::cerr << "invalid number of keys or threads" << std::endl;
+		return 1;
+	}
+
+	if ((config.zipf < 0) || (config.zipf >= 1)) {
+		std::cerr << "invalid Zipfian skew (" << config.zipf
+			<< "); should be in the range [0, 1)" << std::endl;
+		return 1;
+	}
+
+	if (config.reads < 0)
+		config.reads = config.num;
+
+	// the keys of the readmissing benchmark are [num, 2 * num)
+	if (config.kmin < int(std::to_string(2 * config.num).size())) {
+		std::cerr << "key size " << config.kmin << " is too small for "
+			<< config.num << " keys" << std::endl;
+		return 1;
+	}
+
+	if (!logPath.empty()) {
+		snf::log::file_logger *flog = DBG_NEW snf::log::file_logger {
+						logPath,
+						Verbosity ? snf::log::severity::trace : snf::log::severity::info };
+		flog->make_path(true);
+		snf::log::manager::instance().add_logger(flog);
+	} else {
+		// keep stdout for the report
+		snf::log::manager::instance().add_logger(
+			DBG_NEW snf::log::console_logger(snf::log::severity::warning));
+	}
+
+	Rdb rdb(path, name, dbOpt);
+
+	if (pgSize != -1)
+		rdb.setKeyPageSize(pgSize);
+
+	if (htSize != -1)
+		rdb.setHashTableSize(htSize);
+
+	retval = rdb.open();
+	if (retval != E_ok) {
+		std::cerr << "failed to open database with status " << retval << std::endl;
+		return 1;
+	}
+
+	Generator gen(config);
+	KeyChooser chooser(config.num, config.zipf);
+
+	bench_op_t setOp = [&](int, int64_t ops, std::mt19937_64 &rng, bench_result_t &r) {
+		char key[MAX_KEY_LENGTH + 1];
+		for (int64_t i = 0; i < ops; ++i) {
+			int klen = gen.key(chooser.next(rng), key);
+			int vlen;
+			const char *val = gen.value(rng, &vlen);
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			if (rdb.set(key, klen, val, vlen) != E_ok)
+				r.errors++;
+			r.latencies.push_back(Elapsed(start));
+			r.bytes += klen + vlen;
+			r.ops++;
+		}
+	};
+
+	bench_op_t fillSeqOp = [&](int t, int64_t ops, std::mt19937_64 &rng, bench_result_t &r) {
+		char key[MAX_KEY_LENGTH + 1];
+		int64_t first = (config.num / config.threads) * t +
+				std::min(int64_t(t), config.num % config.threads);
+		for (int64_t i = 0; i < ops; ++i) {
+			int klen = gen.key(first + i, key);
+			int vlen;
+			const char *val = gen.value(rng, &vlen);
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			if (rdb.set(key, klen, val, vlen) != E_ok)
+				r.errors++;
+			r.latencies.push_back(Elapsed(start));
+			r.bytes += klen + vlen;
+			r.ops++;
+		}
+	};
+
+	auto getOp = [&](int64_t offset) {
+		return [&, offset](int, int64_t ops, std::mt19937_64 &rng, bench_result_t &r) {
+			char key[MAX_KEY_LENGTH + 1];
+			char val[MAX_VALUE_LENGTH];
+			for (int64_t i = 0; i < ops; ++i) {
+				int klen = gen.key(offset + chooser.next(rng), key);
+				int vlen = MAX_VALUE_LENGTH;
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				int status = rdb.get(key, klen, val, &vlen);
+				r.latencies.push_back(Elapsed(start));
+				if (status == E_ok) {
+					r.found++;
+					r.bytes += klen + vlen;
+				} else if (status != E_not_found) {
+					r.errors++;
+				}
+				r.ops++;
+			}
+		};
+	};
+
+	bench_op_t updateOp = [&](int, int64_t ops, std::mt19937_64 &rng, bench_result_t &r) {
+		char key[MAX_KEY_LENGTH + 1];
+		char val[MAX_VALUE_LENGTH];
+		for (int64_t i = 0; i < ops; ++i) {
+			int klen = gen.key(chooser.next(rng), key);
+			int vlen = MAX_VALUE_LENGTH;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			int status = rdb.get(key, klen, val, &vlen);
+			if ((status == E_ok) || (status == E_not_found)) {
+				const char *nval = gen.value(rng, &vlen);
+				status = rdb.set(key, klen, nval, vlen);
+			}
+			r.latencies.push_back(Elapsed(start));
+			if (status != E_ok)
+				r.errors++;
+			r.bytes += klen + vlen;
+			r.ops++;
+		}
+	};
+
+	bench_op_t deleteOp = [&](int, int64_t ops, std::mt19937_64 &rng, bench_result_t &r) {
+		char key[MAX_KEY_LENGTH + 1];
+		for (int64_t i = 0; i < ops; ++i) {
+			int klen = gen.key(chooser.next(rng), key);
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			int status = rdb.remove(key, klen);
+			r.latencies.push_back(Elapsed(start));
+			if ((status != E_ok) && (status != E_not_found))
+				r.errors++;
+			r.bytes += klen;
+			r.ops++;
+		}
+	};
+
+	auto writer = [&](std::atomic<bool> &done, bench_result_t &r) {
+		std::mt19937_64 rng(config.seed);
+		char key[MAX_KEY_LENGTH + 1];
+		while (!done.load()) {
+			int klen = gen.key(chooser.next(rng), key);
+			int vlen;
+			const char *val = gen.value(rng, &vlen);
+			if (rdb.set(key, klen, val, vlen) != E_ok)
+				r.errors++;
+			r.ops++;
+		}
+	};
+
+	snf::json::array results;
+	std::istringstream names(benchmarks);
+	std::string bench;
+
+	while ((retval == E_ok) && std::getline(names, bench, ',')) {
+		if (bench == "fillseq") {
+			results.add(Run("fillseq", config, config.threads, config.num, fillSeqOp));
+		} else if (bench == "fillrandom") {
+			results.add(Run("fillrandom", config, config.threads, config.num, setOp));
+		} else if (bench == "readrandom") {
+			results.add(Run("readrandom", config, config.threads, config.reads, getOp(0)));
+		} else if (bench == "readmissing") {
+			results.add(Run("readmissing", config, config.threads, config.reads, getOp(config.num)));
+		} else if (bench == "readwhilewriting") {
+			results.add(Run("readwhilewriting", config, config.threads, config.reads, getOp(0), writer));
+		} else if (bench == "updaterandom") {
+			results.add(Run("updaterandom", config, config.threads, config.reads, updateOp));
+		} else if (bench == "deleterandom") {
+			results.add(Run("deleterandom", config, config.threads, config.reads, deleteOp));
+		} else {
+			std::cerr << "unknown benchmark " << bench << std::endl;
+			retval = E_invalid_arg;
+		}
+	}
+
+	RdbStats stats;
+	rdb.getStats(stats);
+	rdb.close();
+
+	if (retval != E_ok)
+		return 1;
+
+	snf::json::value report = OBJECT {
+		KVPAIR("database", OBJECT {
+			KVPAIR("path", path),
+			KVPAIR("name", name),
+			KVPAIR("kpsize", rdb.getKeyPageSize()),
+			KVPAIR("htsize", rdb.getHashTableSize()),
+			KVPAIR("memusage", dbOpt.getMemoryUsage()),
+			KVPAIR("syncdf", dbOpt.syncDataFile()),
+			KVPAIR("syncif", dbOpt.syncIndexFile())
+		}),
+		KVPAIR("config", OBJECT {
+			KVPAIR("num", config.num),
+			KVPAIR("reads", config.reads),
+			KVPAIR("threads", config.threads),
+			KVPAIR("ksize", ARRAY { config.kmin, config.kmax }),
+			KVPAIR("vsize", ARRAY { config.vmin, config.vmax }),
+			KVPAIR("zipf", config.zipf),
+			KVPAIR("seed", int64_t(config.seed))
+		}),
+		KVPAIR("results", results),
+		KVPAIR("stats", OBJECT {
+			KVPAIR("cache_hits", stats.cacheHits),
+			KVPAIR("cache_misses", stats.cacheMisses),
+			KVPAIR("cache_evictions", stats.cacheEvictions),
+			KVPAIR("key_page_reads", stats.keyPageReads),
+			KVPAIR("key_page_writes", stats.keyPageWrites),
+			KVPAIR("value_page_reads", stats.valuePageReads),
+			KVPAIR("value_page_writes", stats.valuePageWrites),
+			KVPAIR("checksum_failures", stats.checksumFailures),
+			KVPAIR("lock_waits", stats.lockWaits),
+			KVPAIR("lock_wait_us", stats.lockWaitUsec)
+		})
+	};
+
+	std::cout << report.str(pretty) << std::endl;
+
+	return 0;
+}
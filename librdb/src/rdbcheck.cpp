@@ -0,0 +1,139 @@
+#include "checker.h"
+#include "rdb.h"
+#include "logmgr.h"
+#include "logger.h"
+#include "flogger.h"
+
+static int
+usage(const char *prog)
+{
+	std::cerr
+		<< prog
+		<< " -path <db_path> -name <db_name> [-repair]" << std::endl
+		<< "        [-threads <n>] [-logpath <log_path>] [-v]" << std::endl;
+	return 1;
+}
+
+static void
+printReport(const RdbCheckReport &report)
+{
+	std::cout
+		<< "key pages: " << report.keyPages
+		<< " (" << report.freeKeyPages << " free)" << std::endl
+		<< "keys: " << report.keys << std::endl
+		<< "value pages: " << report.valuePages
+		<< " (" << report.freeValuePages << " free)" << std::endl;
+
+	if (report.clean()) {
+		std::cout << "no problem found" << std::endl;
+		return;
+	}
+
+	std::cout
+		<< "problems: " << report.problemCount() << std::endl
+		<< "  bad key pages: " << report.badKeyPages << std::endl
+		<< "  bad key page links: " << report.badLinks << std::endl
+		<< "  bad keys: " << report.badKeys << std::endl
+		<< "  bad free value pages: " << report.badFreePages << std::endl
+		<< "  lost free value pages: " << report.lostFreePages << std::endl
+		<< "  unreferenced value pages: " << report.unreferencedValues << std::endl
+		<< "  pages not matching their checksums: " << report.badChecksums << std::endl
+		<< "  damaged hash table entries: " << report.damagedBuckets.size() << std::endl;
+
+	for (const std::string &p : report.problems)
+		std::cout << "  " << p << std::endl;
+
+	if (int64_t(report.problems.size()) < report.problemCount())
+		std::cout << "  ..." << std::endl;
+}
+
+int
+main(int argc, const char **argv)
+{
+	int retval = E_ok;
+	std::string path;
+	std::string name;
+	std::string logPath;
+	int threads = 0;
+	bool repair = false;
+	bool verbose = false;
+	RdbCheckReport report;
+	char prog[MAXPATHLEN + 1];
+
+	snf::basename(prog, MAXPATHLEN + 1, argv[0], true);
+
+	for (int i = 1; i < argc; ++i) {
+		const char *opt = argv[i];
+
+		if (strcmp("-repair", opt) == 0) {
+			repair = true;
+			continue;
+		} else if (strcmp("-v", opt) == 0) {
+			verbose = true;
+			continue;
+		}
+
+		++i;
+		if (argv[i] == 0) {
+			std::cerr << "missing argument to " << opt << std::endl;
+			return usage(prog);
+		}
+
+		if (strcmp("-path", opt) == 0) {
+			path = argv[i];
+		} else if (strcmp("-name", opt) == 0) {
+			name = argv[i];
+		} else if (strcmp("-threads", opt) == 0) {
+			threads = atoi(argv[i]);
+		} else if (strcmp("-logpath", opt) == 0) {
+			logPath = argv[i];
+		} else {
+			return usage(prog);
+		}
+	}
+
+	if (path.empty() || name.empty()) {
+		std::cerr << "database path and name must be specified" << std::endl;
+		return usage(prog);
+	}
+
+	if (!logPath.empty()) {
+		snf::log::file_logger *flog = DBG_NEW snf::log::file_logger {
+						logPath,
+						verbose ? snf::log::severity::trace : snf::log::severity::info };
+		flog->make_path(true);
+		snf::log::manager::instance().add_logger(flog);
+	} else {
+		snf::log::manager::instance().add_logger(
+			DBG_NEW snf::log::console_logger(
+				verbose ? snf::log::severity::info : snf::log::severity::warning));
+	}
+
+	RdbChecker checker(path, name, threads);
+
+	retval = checker.check(report, repair);
+	if (retval != E_ok) {
+		std::cerr << "failed to check database with status " << retval << std::endl;
+		return 1;
+	}
+
+	printReport(report);
+
+	if (!repair || report.clean())
+		return report.clean() ? 0 : 1;
+
+	std::cout
+		<< "repaired: " << report.repairedBuckets << " hash table entries rebuilt with "
+		<< report.recoveredKeys << " keys, " << report.freedValuePages
+		<< " value pages freed" << std::endl;
+
+	retval = checker.check(report);
+	if (retval != E_ok) {
+		std::cerr << "failed to check database with status " << retval << std::endl;
+		return 1;
+	}
+
+	printReport(report);
+
+	return report.clean() ? 0 : 1;
+}
@@ -9,14 +9,81 @@ usage(const char *prog)
 {
 	std::cerr
 		<< prog
-		<< " [-get|-set|-del|-rebuild] -path <db_path> -name <db_name>" << std::endl
-		<< "        -key <key> [-value <value>]" << std::endl
+		<< " [-get|-set|-del|-rebuild] [-stats] -path <db_path> -name <db_name>" << std::endl
+		<< "        [-key <key>] [-value <value>] [-ttl <seconds>]" << std::endl
 		<< "        [-htsize <hash_table_size>] [-pgsize <page_size>]" << std::endl
 		<< "        [-memusage <%_of_memory>] [-syncdf <0|1>]" << std::endl
 		<< "        [-syncif <0|1>] [-logpath <log_path>]" << std::endl;
 	return 1;
 }
 
+static void
+printLatency(const char *op, const RdbLatency &lat)
+{
+	std::cout
+		<< "  " << op << ": " << lat.count
+		<< " (avg " << lat.average() << "us"
+		<< ", p50 < " << lat.percentile(50) << "us"
+		<< ", p99 < " << lat.percentile(99) << "us"
+		<< ", p99.9 < " << lat.percentile(99.9) << "us)" << std::endl;
+}
+
+static void
+printStats(const RdbStats &stats)
+{
+	std::cout << "operations:" << std::endl;
+	printLatency("get", stats.gets);
+	printLatency("set", stats.sets);
+	printLatency("remove", stats.removes);
+
+	std::cout
+		<< "cache:" << std::endl
+		<< "  pages: " << stats.cachePages
+		<< " (" << stats.cacheFreePages << " free)" << std::endl
+		<< "  hits: " << stats.cacheHits << std::endl
+		<< "  misses: " << stats.cacheMisses << std::endl
+		<< "  evictions: " << stats.cacheEvictions << std::endl;
+
+	std::cout
+		<< "key file:" << std::endl
+		<< "  reads: " << stats.keyPageReads << std::endl
+		<< "  writes: " << stats.keyPageWrites
+		<< " (" << stats.keyPageSyncs << " synced)" << std::endl
+		<< "  free pages: " << stats.freeKeyPages << std::endl
+		<< "value file:" << std::endl
+		<< "  reads: " << stats.valuePageReads << std::endl
+		<< "  writes: " << stats.valuePageWrites
+		<< " (" << stats.valuePageSyncs << " synced)" << std::endl
+		<< "  free pages: " << stats.freeValuePages << std::endl;
+
+	std::cout
+		<< "checksums:" << std::endl
+		<< "  verified: " << stats.checksumsVerified << std::endl
+		<< "  failures: " << stats.checksumFailures << std::endl;
+
+	std::cout
+		<< "hash table:" << std::endl
+		<< "  size: " << stats.htSize << std::endl
+		<< "  lock waits: " << stats.lockWaits
+		<< " (" << stats.lockWaitUsec << "us)" << std::endl
+		<< "  keys: " << stats.keys << std::endl
+		<< "  key pages: " << stats.keyPages << std::endl
+		<< "  longest chain: " << stats.maxChainLength << std::endl;
+
+	for (size_t i = 0; i < stats.chainLengths.size(); ++i) {
+		if (stats.chainLengths[i] == 0)
+			continue;
+
+		// the last element counts the longer chains too
+		bool longer = ((i + 1) == stats.chainLengths.size()) &&
+				(int(i) < stats.maxChainLength);
+
+		std::cout
+			<< "  chains of " << i << (longer ? "+" : "")
+			<< " pages: " << stats.chainLengths[i] << std::endl;
+	}
+}
+
 int
 main(int argc, const char **argv)
 {
@@ -29,11 +96,13 @@ main(int argc, const char **argv)
 	std::string logPath;
 	int htSize = -1;
 	int pgSize = -1;
+	int ttl = 0;
 	RdbOptions dbOpt;
 	int vlen;
 	char val[MAX_VALUE_LENGTH + 1];
 	char prog[MAXPATHLEN + 1];
 	bool rebuild = false;
+	bool stats = false;
 
 	snf::basename(prog, MAXPATHLEN + 1, argv[0], true);
 
@@ -46,6 +115,8 @@ main(int argc, const char **argv)
 			cmd = DEL;
 		} else if (strcmp("-rebuild", argv[i]) == 0) {
 			rebuild = true;
+		} else if (strcmp("-stats", argv[i]) == 0) {
+			stats = true;
 		} else if (strcmp("-path", argv[i]) == 0) {
 			++i;
 			if (argv[i]) {
@@ -139,6 +210,20 @@ main(int argc, const char **argv)
 				std::cerr << "missing argument to -value" << std::endl;
 				return usage(prog);
 			}
+		} else if (strcmp("-ttl", argv[i]) == 0) {
+			++i;
+			if (argv[i]) {
+				ttl = atoi(argv[i]);
+				if (ttl <= 0) {
+					std::cerr
+						<< "invalid time to live ("
+						<< argv[i] << ")" << std::endl;
+					return 1;
+				}
+			} else {
+				std::cerr << "missing argument to -ttl" << std::endl;
+				return usage(prog);
+			}
 		} else if (strcmp("-logpath", argv[i]) == 0) {
 			++i;
 			if (argv[i]) {
@@ -166,8 +251,8 @@ main(int argc, const char **argv)
 		snf::log::manager::instance().add_logger(flog);
 	}
 
-	if ((cmd == NIL) && !rebuild) {
-		std::cerr << "one of [-get|-set|-del|-rebuild] must be specified" << std::endl;
+	if ((cmd == NIL) && !rebuild && !stats) {
+		std::cerr << "one of [-get|-set|-del|-rebuild|-stats] must be specified" << std::endl;
 		return usage(prog);
 	}
 
@@ -199,7 +284,7 @@ main(int argc, const char **argv)
 		return 0;
 	}
 
-	if (key.empty()) {
+	if ((cmd != NIL) && key.empty()) {
 		std::cerr << "key not specified" << std::endl;
 		return usage(prog);
 	}
@@ -220,6 +305,9 @@ main(int argc, const char **argv)
 	retval = rdb.open();
 	if (retval == E_ok) {
 		switch (cmd) {
+			case NIL:
+				break;
+
 			case GET:
 				vlen = MAX_VALUE_LENGTH;
 				retval = rdb.get(
@@ -237,11 +325,20 @@ main(int argc, const char **argv)
 				break;
 
 			case SET:
-				retval = rdb.set(
-						key.c_str(),
-						(int)key.size(),
-						value.c_str(),
-						(int)value.size());
+				if (ttl > 0) {
+					retval = rdb.setWithTTL(
+							key.c_str(),
+							(int)key.size(),
+							value.c_str(),
+							(int)value.size(),
+							ttl);
+				} else {
+					retval = rdb.set(
+							key.c_str(),
+							(int)key.size(),
+							value.c_str(),
+							(int)value.size());
+				}
 				if (retval == E_ok) {
 					std::cout << key << " is set to " << value << std::endl;
 				}
@@ -256,6 +353,14 @@ main(int argc, const char **argv)
 				break;
 		}
 
+		if ((retval == E_ok) && stats) {
+			RdbStats dbStats;
+			retval = rdb.getStats(dbStats, true);
+			if (retval == E_ok) {
+				printStats(dbStats);
+			}
+		}
+
 		rdb.close();
 	}
 
@@ -0,0 +1,317 @@
+#include <thread>
+#include "filesystem.h"
+#include "hashtable.h"
+#include "reader.h"
+#include "logmgr.h"
+#include "error.h"
+
+/**
+ * Constructs the read-only view of the database.
+ *
+ * @param [in] idxPath - key file path.
+ * @param [in] dbPath  - value file path.
+ * @param [in] htiPath - shared hash table file path.
+ * @param [in] kpSize  - key page size.
+ * @param [in] htSize  - hash table size.
+ */
+RdbReader::RdbReader(
+	const char *idxPath,
+	const char *dbPath,
+	const char *htiPath,
+	int kpSize,
+	int htSize)
+	: kpSize(kpSize),
+	  htSize(htSize),
+	  idxFile(idxPath, 0022),
+	  dbFile(dbPath, 0022),
+	  htiFile(htiPath, 0022),
+	  hti(0)
+{
+}
+
+/**
+ * Destroys the read-only view of the database.
+ */
+RdbReader::~RdbReader()
+{
+	hti = 0;
+}
+
+/*
+ * Builds the private hash table from the key file i.e. sets
+ * the offset of the first key page of every hash table entry.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+RdbReader::buildHashTable()
+{
+	const char  *idx = idxFile.data();
+	int64_t     offset;
+
+	LOG_DEBUG("RdbReader", "building hash table from %s", idxFile.name());
+
+	offsets.assign(size_t(htSize), -1L);
+
+	for (offset = 0; (offset + kpSize) <= idxFile.length(); offset += kpSize) {
+		const key_page_t *kp = reinterpret_cast<const key_page_t *>(idx + offset);
+
+		if (IsKeyPageDeleted(kp) || (kp->kp_vcount <= 0) || (kp->kp_poff != -1L))
+			continue;
+
+		if ((kp->kp_hash >= 0) && (kp->kp_hash < htSize) &&
+			(offsets[kp->kp_hash] == -1L)) {
+			offsets[kp->kp_hash] = offset;
+		}
+	}
+
+	return E_ok;
+}
+
+/*
+ * Looks up the key in the mapped key pages and copies its
+ * value page. A concurrent writer may be updating the pages,
+ * so nothing read is trusted: the offsets and the key record
+ * indices are checked, and the walk is bounded.
+ *
+ * @param [in]  ki     - key information.
+ * @param [in]  offset - offset of the first key page.
+ * @param [out] vp     - value page.
+ *
+ * @return E_ok if the key is found, E_not_found if it is not
+ * found, E_eof_detected if an offset is beyond the mapping,
+ * or E_try_again if the pages are inconsistent.
+ */
+int
+RdbReader::lookup(const key_info_t *ki, int64_t offset, value_page_t *vp)
+{
+	const char  *idx = idxFile.data();
+	int         numOfKeys = NUM_OF_KEYS_IN_PAGE(kpSize);
+	int64_t     maxPages = idxFile.length() / kpSize;
+
+	for (int64_t n = 0; offset != -1L; ++n) {
+		if ((offset < 0) || ((offset % kpSize) != 0) || (n > maxPages))
+			return E_try_again;
+
+		if ((offset + kpSize) > idxFile.length())
+			return E_eof_detected;
+
+		const key_page_t *kp = reinterpret_cast<const key_page_t *>(idx + offset);
+		if (IsKeyPageDeleted(kp) || (kp->kp_hash != ki->ki_hash))
+			return E_try_again;
+
+		short root = kp->kp_root;
+
+		for (int steps = 0; root != -1; ++steps) {
+			if ((root < 0) || (root >= numOfKeys) || (steps >= numOfKeys))
+				return E_try_again;
+
+			const key_rec_t *kr = kp->kp_keys + root;
+
+			int cmp = ki->ki_klen - kr->kr_klen;
+			if (cmp == 0)
+				cmp = memcmp(ki->ki_key, kr->kr_key, ki->ki_klen);
+
+			if (cmp == 0) {
+				int64_t voff = kr->kr_voff;
+
+				if ((voff < 0) || ((voff % int64_t(sizeof(value_page_t))) != 0))
+					return E_try_again;
+
+				if ((voff + int64_t(sizeof(value_page_t))) > dbFile.length())
+					return E_eof_detected;
+
+				memcpy(vp, dbFile.data() + voff, sizeof(value_page_t));
+				return E_ok;
+			}
+
+			root = (cmp < 0) ? kr->kr_left : kr->kr_right;
+		}
+
+		offset = kp->kp_noff;
+	}
+
+	return E_not_found;
+}
+
+/*
+ * Maps the key and value files again to see the pages added
+ * since they were mapped.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+RdbReader::remap()
+{
+	int retval;
+
+	mapLock.wrlock();
+
+	retval = idxFile.remap();
+	if (retval == E_ok)
+		retval = dbFile.remap();
+
+	mapLock.wrunlock();
+
+	return retval;
+}
+
+/**
+ * Opens the read-only view: maps the key file, the value
+ * file and the shared hash table. The files are not read.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+RdbReader::open()
+{
+	int     retval = E_ok;
+	int64_t htiSize = int64_t(sizeof(hti_header_t)) +
+				int64_t(htSize) * int64_t(sizeof(hti_entry_t));
+
+	retval = idxFile.open(false);
+	if (retval == E_ok)
+		retval = idxFile.map(idxFile.size());
+	if (retval != E_ok)
+		return retval;
+
+	retval = dbFile.open(false);
+	if (retval == E_ok)
+		retval = dbFile.map(dbFile.size());
+	if (retval != E_ok)
+		return retval;
+
+	if (snf::fs::exists(htiFile.name()) &&
+		(htiFile.open(false) == E_ok) &&
+		(htiFile.size() == htiSize) &&
+		(htiFile.map(htiSize) == E_ok)) {
+		hti_header_t *hh = reinterpret_cast<hti_header_t *>(htiFile.data());
+		if ((hh->hh_magic == HTI_MAGIC) &&
+			(hh->hh_htsize == htSize) &&
+			(hh->hh_kpsize == kpSize) &&
+			((hh->hh_flags & HTI_VALID) == HTI_VALID)) {
+			hti = hh;
+		}
+	}
+
+	if (hti == 0) {
+		LOG_WARNING("RdbReader",
+			"shared hash table %s is not usable; updates made by "
+			"the writer may not be seen consistently",
+			htiFile.name());
+		htiFile.unmap();
+		htiFile.close();
+		retval = buildHashTable();
+	}
+
+	return retval;
+}
+
+/**
+ * Gets the value for the key. No lock is held while the key
+ * is looked up; the lookup is retried if a writer updated the
+ * hash table entry in the meantime.
+ *
+ * @param [in]    key    - database key.
+ * @param [in]    klen   - database key length.
+ * @param [out]   value  - value for the corresponding key.
+ * @param [inout] vlen   - maximum value size on input,
+ *                         actual value size on output.
+ *
+ * @return E_ok on success, E_not_found if the value is not
+ * found (or is expired), E_try_again if the key is updated
+ * too often to be read, -ve error code on failure.
+ */
+int
+RdbReader::get(const char *key, int klen, char *value, int *vlen)
+{
+	int             retval = E_try_again;
+	int             hindex;
+	hti_entry_t     *hent = 0;
+	key_info_t      ki;
+	value_page_t    vp;
+
+	if (klen > MAX_KEY_LENGTH) {
+		return E_not_found;
+	}
+
+	hindex = hash(key, klen, htSize);
+	if (hti)
+		hent = HashTableEntries(hti) + hindex;
+
+	SetKeyInfo(&ki, key, klen, hindex);
+
+	for (int i = 0; (retval == E_try_again) && (i < RDB_READ_RETRIES); ++i) {
+		uint32_t    seq = 0;
+		int64_t     offset;
+
+		if (hent) {
+			seq = hent->he_seq.load(std::memory_order_acquire);
+			if ((seq & 1) != 0) {
+				std::this_thread::yield();
+				continue;
+			}
+			offset = hent->he_offset.load(std::memory_order_acquire);
+		} else {
+			offset = offsets[hindex];
+		}
+
+		mapLock.rdlock();
+		retval = lookup(&ki, offset, &vp);
+		mapLock.rdunlock();
+
+		if (hent) {
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (hent->he_seq.load(std::memory_order_relaxed) != seq) {
+				retval = E_try_again;
+				continue;
+			}
+		}
+
+		if (retval == E_eof_detected) {
+			retval = remap();
+			if (retval == E_ok)
+				retval = E_try_again;
+		} else if (retval == E_ok) {
+			if (IsValuePageDeleted(&vp) ||
+				(vp.vp_klen != klen) ||
+				(memcmp(vp.vp_key, key, klen) != 0)) {
+				retval = E_try_again;
+			}
+		}
+	}
+
+	if (retval == E_try_again) {
+		LOG_WARNING("RdbReader", "key is being updated; try again");
+	} else if (retval == E_ok) {
+		if (IsValuePageExpired(&vp, time(0))) {
+			LOG_DEBUG("RdbReader", "key expired");
+			retval = E_not_found;
+		} else if ((vp.vp_vlen < 0) || (vp.vp_vlen > MAX_VALUE_LENGTH)) {
+			retval = E_invalid_state;
+		} else if (vp.vp_vlen > *vlen) {
+			retval = E_insufficient_buffer;
+		} else {
+			if (vp.vp_vlen < *vlen) {
+				*vlen = vp.vp_vlen;
+			}
+			memcpy(value, vp.vp_value, *vlen);
+		}
+	}
+
+	return retval;
+}
+
+/**
+ * Gets the database generation. It changes whenever the
+ * writer updates the database; comparing it with a value
+ * read earlier is a cheap way to detect the updates.
+ *
+ * @return the generation, 0 if the shared hash table is
+ * not in use.
+ */
+uint64_t
+RdbReader::generation() const
+{
+	return hti ? hti->hh_gen.load() : 0;
+}
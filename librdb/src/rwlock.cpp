@@ -8,6 +8,7 @@
 RWLock::RWLock()
 {
 	cnt = 0;
+	users = 0;
 
 #if defined(_WIN32)
 	InitializeSRWLock(&lock);
@@ -0,0 +1,201 @@
+#include <cmath>
+#include "stats.h"
+
+static std::atomic<int> nextStripe(0);
+
+/**
+ * Gets the counter stripe of the calling thread. The threads
+ * are assigned the stripes round-robin on their first call.
+ *
+ * @return the stripe index.
+ */
+int
+StatsStripe()
+{
+	thread_local int stripe = -1;
+
+	if (stripe < 0)
+		stripe = nextStripe.fetch_add(1, std::memory_order_relaxed) % RDB_STATS_STRIPES;
+
+	return stripe;
+}
+
+/**
+ * Gets the latency below which the given percentage of
+ * the operations completed. The latency is known only to
+ * the histogram bucket, so the upper bound of the bucket
+ * is returned.
+ *
+ * @param [in] pct - percentage, in the range (0, 100].
+ *
+ * @return the latency in microseconds.
+ */
+int64_t
+RdbLatency::percentile(double pct) const
+{
+	if (count <= 0)
+		return 0;
+
+	int64_t wanted = int64_t(std::ceil(double(count) * pct / 100.0));
+	int64_t seen = 0;
+
+	for (int i = 0; i < RDB_LATENCY_BUCKETS; ++i) {
+		seen += buckets[i];
+		if (seen >= wanted)
+			return int64_t(1) << i;
+	}
+
+	return int64_t(1) << (RDB_LATENCY_BUCKETS - 1);
+}
+
+/**
+ * Adds the latencies of another snapshot, of the same
+ * operation on another database, to this one.
+ *
+ * @param [in] lat - latency snapshot to add.
+ */
+void
+RdbLatency::add(const RdbLatency &lat)
+{
+	count += lat.count;
+	usec += lat.usec;
+	for (int i = 0; i < RDB_LATENCY_BUCKETS; ++i)
+		buckets[i] += lat.buckets[i];
+}
+
+/**
+ * Constructs the latency histogram.
+ */
+LatencyHistogram::LatencyHistogram()
+{
+	for (int i = 0; i < RDB_STATS_STRIPES; ++i) {
+		stripes[i].count.store(0, std::memory_order_relaxed);
+		stripes[i].usec.store(0, std::memory_order_relaxed);
+		for (int j = 0; j < RDB_LATENCY_BUCKETS; ++j)
+			stripes[i].buckets[j].store(0, std::memory_order_relaxed);
+	}
+}
+
+/**
+ * Adds an operation to the histogram.
+ *
+ * @param [in] usec - time taken by the operation in
+ *                    microseconds.
+ */
+void
+LatencyHistogram::add(int64_t usec)
+{
+	stripe_t    &s = stripes[StatsStripe()];
+	int         b = 0;
+
+	if (usec < 0)
+		usec = 0;
+
+	for (int64_t u = usec; (u > 0) && (b < (RDB_LATENCY_BUCKETS - 1)); u >>= 1)
+		b++;
+
+	s.count.fetch_add(1, std::memory_order_relaxed);
+	s.usec.fetch_add(usec, std::memory_order_relaxed);
+	s.buckets[b].fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * Gets the snapshot of the histogram. The operations in
+ * progress may be partially counted.
+ *
+ * @param [out] lat - latency snapshot.
+ */
+void
+LatencyHistogram::get(RdbLatency &lat) const
+{
+	lat = RdbLatency();
+
+	for (int i = 0; i < RDB_STATS_STRIPES; ++i) {
+		lat.count += stripes[i].count.load(std::memory_order_relaxed);
+		lat.usec += stripes[i].usec.load(std::memory_order_relaxed);
+		for (int j = 0; j < RDB_LATENCY_BUCKETS; ++j)
+			lat.buckets[j] += stripes[i].buckets[j].load(std::memory_order_relaxed);
+	}
+}
+
+/**
+ * Constructs the statistics object.
+ */
+RdbStats::RdbStats()
+{
+	clear();
+}
+
+/**
+ * Clears the statistics.
+ */
+void
+RdbStats::clear()
+{
+	gets = RdbLatency();
+	sets = RdbLatency();
+	removes = RdbLatency();
+	cacheHits = 0;
+	cacheMisses = 0;
+	cacheEvictions = 0;
+	cachePages = 0;
+	cacheFreePages = 0;
+	keyPageReads = 0;
+	keyPageWrites = 0;
+	keyPageSyncs = 0;
+	valuePageReads = 0;
+	valuePageWrites = 0;
+	valuePageSyncs = 0;
+	freeKeyPages = 0;
+	freeValuePages = 0;
+	checksumsVerified = 0;
+	checksumFailures = 0;
+	lockWaits = 0;
+	lockWaitUsec = 0;
+	htSize = 0;
+	keyPages = 0;
+	keys = 0;
+	maxChainLength = 0;
+	chainLengths.clear();
+}
+
+/**
+ * Adds the statistics of another database to these ones,
+ * e.g. to get the totals of the shards of a cluster. The
+ * longest chain is the longest of the two.
+ *
+ * @param [in] stats - statistics to add.
+ */
+void
+RdbStats::add(const RdbStats &stats)
+{
+	gets.add(stats.gets);
+	sets.add(stats.sets);
+	removes.add(stats.removes);
+	cacheHits += stats.cacheHits;
+	cacheMisses += stats.cacheMisses;
+	cacheEvictions += stats.cacheEvictions;
+	cachePages += stats.cachePages;
+	cacheFreePages += stats.cacheFreePages;
+	keyPageReads += stats.keyPageReads;
+	keyPageWrites += stats.keyPageWrites;
+	keyPageSyncs += stats.keyPageSyncs;
+	valuePageReads += stats.valuePageReads;
+	valuePageWrites += stats.valuePageWrites;
+	valuePageSyncs += stats.valuePageSyncs;
+	freeKeyPages += stats.freeKeyPages;
+	freeValuePages += stats.freeValuePages;
+	checksumsVerified += stats.checksumsVerified;
+	checksumFailures += stats.checksumFailures;
+	lockWaits += stats.lockWaits;
+	lockWaitUsec += stats.lockWaitUsec;
+	htSize += stats.htSize;
+	keyPages += stats.keyPages;
+	keys += stats.keys;
+	if (stats.maxChainLength > maxChainLength)
+		maxChainLength = stats.maxChainLength;
+	if (stats.chainLengths.size() > chainLengths.size())
+		chainLengths.resize(stats.chainLengths.size(), 0);
+	for (size_t i = 0; i < stats.chainLengths.size(); ++i)
+		chainLengths[i] += stats.chainLengths[i];
+}
@@ -0,0 +1,269 @@
+#include <cstddef>
+#include "txnlog.h"
+#include "logmgr.h"
+#include "error.h"
+
+/*
+ * Checksum (FNV-1a) of the transaction log record writes.
+ */
+static uint32_t
+Checksum(const char *buf, int len)
+{
+	uint32_t h = 2166136261U;
+
+	for (int i = 0; i < len; ++i) {
+		h ^= uint8_t(buf[i]);
+		h *= 16777619U;
+	}
+
+	return h;
+}
+
+/*
+ * Gets a free slot, adding one at the end of the file if
+ * none is free.
+ *
+ * @return the slot index.
+ */
+int
+TxnLog::getSlot()
+{
+	std::lock_guard<std::mutex> guard(mutex);
+
+	if (freeSlots.empty())
+		return numSlots++;
+
+	int slot = freeSlots.back();
+	freeSlots.pop_back();
+	return slot;
+}
+
+/*
+ * Puts the slot back to the free slots.
+ *
+ * @param [in] slot - slot index.
+ */
+void
+TxnLog::putSlot(int slot)
+{
+	std::lock_guard<std::mutex> guard(mutex);
+	freeSlots.push_back(slot);
+}
+
+/**
+ * Opens the transaction log. It is created if it does not
+ * exist. The writes are synchronous.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+TxnLog::open()
+{
+	int                   retval = E_ok;
+	int                   oserr = 0;
+	snf::file::open_flags oflags;
+
+	oflags.o_read = true;
+	oflags.o_write = true;
+	oflags.o_create = true;
+	oflags.o_sync = true;
+
+	retval = snf::file::open(oflags, 0600, &oserr);
+	if (retval != E_ok) {
+		ERROR_STRM("TxnLog", oserr)
+			<< "failed to open file " << name()
+			<< snf::log::record::endl;
+	}
+
+	return retval;
+}
+
+/**
+ * Applies the records that are not done, in slot order, and
+ * empties the log. The records that were not completely
+ * written are skipped: their writes were never applied.
+ *
+ * @param [in] apply - applies the writes of a record.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+TxnLog::replay(const std::function<int(const txn_writes_t &)> &apply)
+{
+	int                 retval = E_ok;
+	int                 oserr = 0;
+	int                 bRead = 0;
+	int                 replayed = 0;
+	int64_t             fsize;
+	std::vector<char>   buf(slotSize);
+
+	fsize = size(&oserr);
+	if (fsize < 0) {
+		ERROR_STRM("TxnLog", oserr)
+			<< "failed to get size of file " << name()
+			<< snf::log::record::endl;
+		return int(fsize);
+	}
+
+	for (int64_t offset = 0; (retval == E_ok) && (offset < fsize); offset += slotSize) {
+		retval = read(offset, buf.data(), slotSize, &bRead, &oserr);
+		if (retval != E_ok) {
+			ERROR_STRM("TxnLog", oserr)
+				<< "failed to read file " << name()
+				<< " at offset " << offset
+				<< snf::log::record::endl;
+			break;
+		}
+
+		const txn_header_t *th = reinterpret_cast<const txn_header_t *>(buf.data());
+		if ((bRead < int(sizeof(txn_header_t))) ||
+			(th->th_magic != TXN_MAGIC) ||
+			((th->th_flags & TXN_DONE) == TXN_DONE) ||
+			(th->th_length < 0) ||
+			(th->th_length > (bRead - int(sizeof(txn_header_t)))) ||
+			(th->th_checksum != Checksum(buf.data() + sizeof(txn_header_t), th->th_length)))
+			continue;
+
+		txn_writes_t    writes;
+		const char      *p = buf.data() + sizeof(txn_header_t);
+		const char      *end = p + th->th_length;
+
+		for (int i = 0; i < th->th_count; ++i) {
+			const txn_write_t *tw = reinterpret_cast<const txn_write_t *>(p);
+			p += sizeof(txn_write_t);
+
+			if ((p > end) || (tw->tw_klen <= 0) || (tw->tw_vlen < 0) ||
+				((p + tw->tw_klen + tw->tw_vlen) > end)) {
+				retval = E_invalid_state;
+				break;
+			}
+
+			txn_op_t &op = writes[std::string(p, tw->tw_klen)];
+			op.remove = ((tw->tw_flags & TXN_REMOVE) == TXN_REMOVE);
+			op.value.assign(p + tw->tw_klen, tw->tw_vlen);
+			p += tw->tw_klen + tw->tw_vlen;
+		}
+
+		if (retval == E_ok) {
+			retval = apply(writes);
+			replayed++;
+		} else {
+			ERROR_STRM("TxnLog")
+				<< "invalid record at offset " << offset
+				<< " in " << name()
+				<< snf::log::record::endl;
+		}
+	}
+
+	if (replayed > 0) {
+		LOG_WARNING("TxnLog", "%d pending transactions applied from %s",
+			replayed, name());
+	}
+
+	if (retval == E_ok) {
+		retval = truncate(0, &oserr);
+		if (retval != E_ok) {
+			ERROR_STRM("TxnLog", oserr)
+				<< "failed to truncate file " << name()
+				<< snf::log::record::endl;
+		}
+	}
+
+	return retval;
+}
+
+/**
+ * Writes the transaction record to a free slot.
+ *
+ * @param [in]  writes - transaction writes.
+ * @param [out] slot   - slot used; pass it to done() once
+ *                       the writes are applied.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+TxnLog::write(const txn_writes_t &writes, int *slot)
+{
+	int                 retval = E_ok;
+	int                 oserr = 0;
+	int                 bWritten = 0;
+	std::vector<char>   buf(sizeof(txn_header_t), 0);
+
+	if (writes.size() > RDB_TXN_MAX_WRITES) {
+		LOG_ERROR("TxnLog", "too many writes (%d) in a transaction",
+			int(writes.size()));
+		return E_invalid_arg;
+	}
+
+	for (const txn_writes_t::value_type &w : writes) {
+		txn_write_t tw;
+		tw.tw_flags = w.second.remove ? TXN_REMOVE : 0;
+		tw.tw_klen = int(w.first.size());
+		tw.tw_vlen = w.second.remove ? 0 : int(w.second.value.size());
+
+		const char *p = reinterpret_cast<const char *>(&tw);
+		buf.insert(buf.end(), p, p + sizeof(tw));
+		buf.insert(buf.end(), w.first.begin(), w.first.end());
+		if (!w.second.remove)
+			buf.insert(buf.end(), w.second.value.begin(), w.second.value.end());
+	}
+
+	txn_header_t *th = reinterpret_cast<txn_header_t *>(buf.data());
+	th->th_magic = TXN_MAGIC;
+	th->th_flags = 0;
+	th->th_count = int(writes.size());
+	th->th_length = int(buf.size() - sizeof(txn_header_t));
+	th->th_checksum = Checksum(buf.data() + sizeof(txn_header_t), th->th_length);
+
+	*slot = getSlot();
+
+	retval = snf::file::write(int64_t(*slot) * slotSize, buf.data(), int(buf.size()), &bWritten, &oserr);
+	if ((retval == E_ok) && (bWritten != int(buf.size()))) {
+		retval = E_write_failed;
+	}
+
+	if (retval != E_ok) {
+		ERROR_STRM("TxnLog", oserr)
+			<< "failed to write transaction to " << name()
+			<< snf::log::record::endl;
+		putSlot(*slot);
+		*slot = -1;
+	}
+
+	return retval;
+}
+
+/**
+ * Marks the record in the slot done i.e. its writes are
+ * applied, and frees the slot.
+ *
+ * @param [in] slot - slot returned by write().
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+TxnLog::done(int slot)
+{
+	int retval = E_ok;
+	int oserr = 0;
+	int bWritten = 0;
+	int flags = TXN_DONE;
+
+	retval = snf::file::write(int64_t(slot) * slotSize + offsetof(txn_header_t, th_flags),
+			&flags, int(sizeof(flags)), &bWritten, &oserr);
+	if ((retval == E_ok) && (bWritten != int(sizeof(flags)))) {
+		retval = E_write_failed;
+	}
+
+	if (retval != E_ok) {
+		// The writes would be applied again on open,
+		// overwriting the later updates; keep the slot
+		ERROR_STRM("TxnLog", oserr)
+			<< "failed to mark transaction done in " << name()
+			<< snf::log::record::endl;
+	} else {
+		putSlot(slot);
+	}
+
+	return retval;
+}
@@ -0,0 +1,197 @@
+#include <vector>
+#include "error.h"
+#include "checker.h"
+#include "rdb.h"
+#include "dbtest.h"
+
+class CheckDB : public snf::tf::test
+{
+private:
+	static const int NKEYS = 400;
+	static const int KPSIZE = 1024;
+	static const int HTSIZE = 13;
+
+	/* keys removed */
+	static bool removed(int i)
+	{
+		return (i % 7) == 0;
+	}
+
+	/* keys updated */
+	static bool updated(int i)
+	{
+		return (i % 5) == 0;
+	}
+
+	bool verify(Rdb &rdb)
+	{
+		char    key[32];
+		char    val[32];
+		char    buf[32];
+		int     buflen;
+
+		for (int i = 0; i < NKEYS; ++i) {
+			TestKey(key, "check", i);
+			TestValue(val, i, updated(i) ? 2 : 1);
+			buflen = int(sizeof(buf));
+			int retval = rdb.get(key, int(strlen(key)), buf, &buflen);
+			m_strm << "rdb get: key = " << key;
+			if (removed(i)) {
+				ASSERT_EQ(int, retval, E_not_found, m_strm.str());
+			} else {
+				ASSERT_EQ(int, retval, E_ok, m_strm.str());
+				ASSERT_EQ(std::string, std::string(buf, buflen), std::string(val), m_strm.str());
+			}
+			m_strm.str("");
+		}
+
+		return true;
+	}
+
+public:
+	CheckDB() : snf::tf::test() {}
+	~CheckDB() {}
+
+	virtual const char *name() const
+	{
+		return "CheckDB";
+	}
+
+	virtual const char *description() const
+	{
+		return "Checks and repairs the database";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		ASSERT_NE(const snf::config *, conf, nullptr, "check config");
+		const char *dbPath = conf->get("DBPATH");
+		ASSERT_NE(const char *, dbPath, nullptr, "get DBPATH from config");
+
+		char            key[32];
+		char            val[32];
+		int             retval;
+		int             expected = 0;
+		RdbCheckReport  report;
+
+		RdbOptions options;
+		options.syncDataFile(false);
+		Rdb rdb(dbPath, "checkdb", KPSIZE, HTSIZE, options);
+
+		retval = rdb.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb open");
+
+		for (int i = 0; i < NKEYS; ++i) {
+			TestKey(key, "check", i);
+			TestValue(val, i, 1);
+			retval = rdb.set(key, int(strlen(key)), val, int(strlen(val)));
+			ASSERT_EQ(int, retval, E_ok, "rdb set");
+		}
+
+		for (int i = 0; i < NKEYS; ++i) {
+			TestKey(key, "check", i);
+			if (removed(i)) {
+				retval = rdb.remove(key, int(strlen(key)));
+				ASSERT_EQ(int, retval, E_ok, "rdb remove");
+			} else {
+				expected++;
+				if (updated(i)) {
+					TestValue(val, i, 2);
+					retval = rdb.set(key, int(strlen(key)), val, int(strlen(val)));
+					ASSERT_EQ(int, retval, E_ok, "rdb update");
+				}
+			}
+		}
+
+		retval = rdb.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb close");
+
+		RdbChecker checker(dbPath, "checkdb", 4);
+
+		retval = checker.check(report);
+		ASSERT_EQ(int, retval, E_ok, "check");
+		for (const std::string &p : report.problems)
+			TEST_LOG(p);
+		ASSERT_EQ(bool, report.clean(), true, "database is clean");
+		ASSERT_EQ(int64_t, report.keys, expected, "keys");
+		ASSERT_EQ(size_t, report.damagedBuckets.size(), 0, "no damaged entries");
+
+		// break a chain link, a key page tree and the free list
+		{
+			snf::file idx(DbFileName(dbPath, "checkdb", ".idx"), 0022);
+			ASSERT_EQ(bool, OpenDbFile(idx), true, "open key file");
+
+			std::vector<char> buf(KPSIZE);
+			key_page_t *kp = reinterpret_cast<key_page_t *>(buf.data());
+			int linkHash = -1;
+			int treeHash = -1;
+
+			for (int64_t off = 0; (linkHash == -1) || (treeHash == -1); off += KPSIZE) {
+				ASSERT_EQ(bool, ReadPage(idx, off, buf.data(), KPSIZE), true, "read key page");
+				if (IsKeyPageDeleted(kp) || (kp->kp_vcount <= 0))
+					continue;
+
+				if ((linkHash == -1) && (kp->kp_poff == -1L) && (kp->kp_noff != -1L)) {
+					linkHash = kp->kp_hash;
+					kp->kp_noff = idx.size() + 7 * KPSIZE;
+				} else if ((treeHash == -1) && (kp->kp_hash != linkHash)) {
+					treeHash = kp->kp_hash;
+					kp->kp_vcount++;
+				} else {
+					continue;
+				}
+
+				// broken, but not torn: the checksum matches
+				SetKeyPageChecksum(kp, KPSIZE);
+				ASSERT_EQ(bool, WritePage(idx, off, buf.data(), KPSIZE), true, "write key page");
+			}
+
+			snf::file fdp(DbFileName(dbPath, "checkdb", ".fdp"), 0022);
+			ASSERT_EQ(bool, OpenDbFile(fdp), true, "open free page file");
+			int64_t inuse = 0;
+			ASSERT_EQ(bool, WritePage(fdp, fdp.size(), &inuse, int(sizeof(inuse))), true,
+				"add page in use to the free list");
+		}
+
+		retval = checker.check(report);
+		ASSERT_EQ(int, retval, E_ok, "check");
+		ASSERT_EQ(bool, report.clean(), false, "database is damaged");
+		ASSERT_NE(int64_t, report.badLinks, 0, "bad links found");
+		ASSERT_NE(int64_t, report.badKeyPages, 0, "bad key pages found");
+		ASSERT_EQ(int64_t, report.badFreePages, 1, "bad free page found");
+		ASSERT_EQ(size_t, report.damagedBuckets.size(), 2, "damaged entries");
+
+		retval = checker.check(report, true);
+		ASSERT_EQ(int, retval, E_ok, "repair");
+		ASSERT_EQ(int64_t, report.repairedBuckets, 2, "entries rebuilt");
+		ASSERT_NE(int64_t, report.recoveredKeys, 0, "keys recovered");
+
+		retval = checker.check(report);
+		ASSERT_EQ(int, retval, E_ok, "check");
+		for (const std::string &p : report.problems)
+			TEST_LOG(p);
+		ASSERT_EQ(bool, report.clean(), true, "database is clean after the repair");
+		ASSERT_EQ(int64_t, report.keys, expected, "keys after the repair");
+
+		retval = rdb.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb open");
+
+		if (!verify(rdb))
+			return false;
+
+		for (int i = 0; i < NKEYS; ++i) {
+			TestKey(key, "check", i);
+			rdb.remove(key, int(strlen(key)));
+		}
+
+		retval = rdb.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb close");
+
+		retval = checker.check(report);
+		ASSERT_EQ(int, retval, E_ok, "check");
+		ASSERT_EQ(bool, report.clean(), true, "database is clean after removing the keys");
+		ASSERT_EQ(int64_t, report.keys, 0, "no keys");
+
+		return true;
+	}
+};
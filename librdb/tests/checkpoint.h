@@ -0,0 +1,148 @@
+#include <atomic>
+#include <string>
+#include <thread>
+#include "error.h"
+#include "rdb.h"
+#include "dbtest.h"
+
+class CheckpointDB : public snf::tf::test
+{
+private:
+	static const int NKEYS = 2000;
+
+	/*
+	 * Updates the keys in order; so any consistent copy of
+	 * the database has the keys updated up to a point and
+	 * the rest not updated.
+	 */
+	static void writer(Rdb *rdb, std::atomic<int> *done, int *failures)
+	{
+		char key[32];
+		char val[32];
+
+		for (int i = 0; i < NKEYS; ++i) {
+			TestKey(key, "ckpt", i);
+			TestValue(val, i, 2);
+			if (rdb->set(key, (int)strlen(key), val, (int)strlen(val)) != E_ok)
+				(*failures)++;
+			(*done)++;
+		}
+	}
+
+public:
+	CheckpointDB() : snf::tf::test() {}
+	~CheckpointDB() {}
+
+	virtual const char *name() const
+	{
+		return "CheckpointDB";
+	}
+
+	virtual const char *description() const
+	{
+		return "Checkpoint database while it is being updated";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		ASSERT_NE(const snf::config *, conf, nullptr, "check config");
+		const char *dbPath = conf->get("DBPATH");
+		ASSERT_NE(const char *, dbPath, nullptr, "get DBPATH from config");
+		const char *dbName = conf->get("DBNAME");
+		ASSERT_NE(const char *, dbName, nullptr, "get DBNAME from config");
+
+		char key[32];
+		char val[32];
+		char buf[32];
+		int  buflen;
+
+		std::string ckptPath(dbPath);
+		ckptPath.push_back(snf::pathsep());
+		ckptPath.append("ckpt");
+
+		RdbOptions options;
+		options.syncDataFile(false);
+		Rdb rdb(dbPath, dbName, 1024, 101, options);
+
+		int retval = rdb.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb open");
+
+		for (int i = 0; i < NKEYS; ++i) {
+			TestKey(key, "ckpt", i);
+			TestValue(val, i, 1);
+			retval = rdb.set(key, (int)strlen(key), val, (int)strlen(val));
+			m_strm << "rdb set: key = " << key;
+			ASSERT_EQ(int, retval, E_ok, m_strm.str());
+			m_strm.str("");
+		}
+
+		retval = rdb.checkpoint(dbPath);
+		ASSERT_EQ(int, retval, E_invalid_arg, "checkpoint to database directory");
+
+		int failures = 0;
+		std::atomic<int> done(0);
+		std::thread thrd(writer, &rdb, &done, &failures);
+
+		// let the writer get going
+		while (done < (NKEYS / 10))
+			std::this_thread::yield();
+
+		retval = rdb.checkpoint(ckptPath);
+
+		thrd.join();
+
+		ASSERT_EQ(int, retval, E_ok, "rdb checkpoint");
+		ASSERT_EQ(int, failures, 0, "updates during checkpoint");
+
+		for (int i = 0; i < NKEYS; ++i) {
+			TestKey(key, "ckpt", i);
+			retval = rdb.remove(key, (int)strlen(key));
+			m_strm << "rdb remove: key = " << key;
+			ASSERT_EQ(int, retval, E_ok, m_strm.str());
+			m_strm.str("");
+		}
+
+		retval = rdb.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb close");
+
+		Rdb ckpt(ckptPath, dbName, 1024, 101, options);
+
+		retval = ckpt.open();
+		ASSERT_EQ(int, retval, E_ok, "checkpoint open");
+
+		int lastGen = 2;
+		for (int i = 0; i < NKEYS; ++i) {
+			TestKey(key, "ckpt", i);
+			buflen = (int)(sizeof(buf) - 1);
+			retval = ckpt.get(key, (int)strlen(key), buf, &buflen);
+			m_strm << "checkpoint get: key = " << key;
+			ASSERT_EQ(int, retval, E_ok, m_strm.str());
+			m_strm.str("");
+			buf[buflen] = '\0';
+
+			int gen = 0;
+			for (gen = 1; gen <= 2; ++gen) {
+				TestValue(val, i, gen);
+				if (strcmp(buf, val) == 0)
+					break;
+			}
+
+			m_strm << "checkpoint value for key " << key << " = " << buf;
+			ASSERT_NE(int, gen, 3, m_strm.str());
+			ASSERT_EQ(bool, (gen <= lastGen), true, m_strm.str());
+			m_strm.str("");
+
+			lastGen = gen;
+
+			retval = ckpt.remove(key, (int)strlen(key));
+			m_strm << "checkpoint remove: key = " << key;
+			ASSERT_EQ(int, retval, E_ok, m_strm.str());
+			m_strm.str("");
+		}
+
+		retval = ckpt.close();
+		ASSERT_EQ(int, retval, E_ok, "checkpoint close");
+
+		return true;
+	}
+};
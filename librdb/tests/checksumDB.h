@@ -0,0 +1,351 @@
+#include <vector>
+#include "error.h"
+#include "checker.h"
+#include "crc32c.h"
+#include "rdb.h"
+#include "dbtest.h"
+
+class ChecksumDB : public snf::tf::test
+{
+private:
+	static const int NKEYS = 200;
+	static const int KPSIZE = 1024;
+	static const int HTSIZE = 31;
+
+	/*
+	 * Gets the number of the key, -1 if it is not one of the
+	 * keys set.
+	 */
+	static int keyIndex(const char *k, int klen)
+	{
+		char    key[32];
+
+		for (int i = 0; i < NKEYS; ++i) {
+			TestKey(key, "csum", i);
+			if ((klen == int(strlen(key))) && (memcmp(k, key, klen) == 0))
+				return i;
+		}
+
+		return -1;
+	}
+
+	/*
+	 * Gets the keys, expecting E_checksum_failed for the keys
+	 * in the damaged pages and E_ok for the rest.
+	 */
+	bool getAll(Rdb &rdb, const std::vector<int> &damaged)
+	{
+		char    key[32];
+		char    buf[32];
+		int     buflen;
+
+		for (int i = 0; i < NKEYS; ++i) {
+			TestKey(key, "csum", i);
+			buflen = int(sizeof(buf));
+			int retval = rdb.get(key, int(strlen(key)), buf, &buflen);
+			m_strm << "rdb get: key = " << key;
+			if (damaged[i]) {
+				ASSERT_EQ(int, retval, E_checksum_failed, m_strm.str());
+			} else {
+				ASSERT_EQ(int, retval, E_ok, m_strm.str());
+				ASSERT_EQ(std::string, std::string(buf, buflen), std::string(key), m_strm.str());
+			}
+			m_strm.str("");
+		}
+
+		return true;
+	}
+
+	/*
+	 * Turns a database into one of format version 1, with one
+	 * value page damaged, and checks that it is upgraded on
+	 * open with the damage still detected.
+	 */
+	bool upgrade(const char *dbPath)
+	{
+		char        key[32];
+		char        buf[32];
+		int         buflen;
+		int         retval;
+		int         damagedKey = -1;
+
+		RdbOptions options;
+		options.syncDataFile(false);
+		options.warmCache(false);
+
+		{
+			Rdb rdb(dbPath, "csumv1", KPSIZE, HTSIZE, options);
+
+			retval = rdb.open();
+			ASSERT_EQ(int, retval, E_ok, "rdb open");
+
+			for (int i = 0; i < NKEYS; ++i) {
+				TestKey(key, "csum", i);
+				retval = rdb.set(key, int(strlen(key)), key, int(strlen(key)));
+				ASSERT_EQ(int, retval, E_ok, "rdb set");
+			}
+
+			retval = rdb.close();
+			ASSERT_EQ(int, retval, E_ok, "rdb close");
+		}
+
+		{
+			snf::file attr(DbFileName(dbPath, "csumv1", ".attr"), 0022);
+			ASSERT_EQ(bool, OpenDbFile(attr), true, "open attributes file");
+			retval = attr.truncate(int64_t(offsetof(dbattr_t, a_version)));
+			ASSERT_EQ(int, retval, E_ok, "drop the format version");
+
+			snf::file db(DbFileName(dbPath, "csumv1", ".db"), 0022);
+			ASSERT_EQ(bool, OpenDbFile(db), true, "open value file");
+
+			value_page_t vp;
+			for (int64_t off = 0; ReadPage(db, off, &vp, int(sizeof(vp))); off += int64_t(sizeof(vp))) {
+				value_page_v1_t ovp;
+				memset(&ovp, 0, sizeof(ovp));
+				ovp.vp_flags = vp.vp_flags;
+				ovp.vp_expiry = vp.vp_expiry;
+				ovp.vp_klen = vp.vp_klen;
+				ovp.vp_vlen = vp.vp_vlen;
+				memcpy(ovp.vp_key, vp.vp_key, MAX_KEY_LENGTH);
+				memcpy(ovp.vp_value, vp.vp_value, MAX_VALUE_LENGTH);
+				ovp.vp_checksum = ValuePageChecksumV1(&ovp);
+				if (damagedKey == -1) {
+					damagedKey = keyIndex(ovp.vp_key, ovp.vp_klen);
+					ovp.vp_value[MAX_VALUE_LENGTH - 1] ^= 1;
+				}
+				ASSERT_EQ(bool, WritePage(db, off, &ovp, int(sizeof(ovp))), true, "write value page");
+			}
+		}
+
+		options.readOnly(true);
+		{
+			Rdb reader(dbPath, "csumv1", KPSIZE, HTSIZE, options);
+			retval = reader.open();
+			ASSERT_EQ(int, retval, E_mismatch, "read-only open of format version 1");
+		}
+		options.readOnly(false);
+
+		Rdb rdb(dbPath, "csumv1", KPSIZE, HTSIZE, options);
+
+		retval = rdb.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb open (upgrade)");
+
+		for (int i = 0; i < NKEYS; ++i) {
+			TestKey(key, "csum", i);
+			buflen = int(sizeof(buf));
+			retval = rdb.get(key, int(strlen(key)), buf, &buflen);
+			m_strm << "rdb get after the upgrade: key = " << key;
+			if (i == damagedKey) {
+				ASSERT_EQ(int, retval, E_checksum_failed, m_strm.str());
+			} else {
+				ASSERT_EQ(int, retval, E_ok, m_strm.str());
+				ASSERT_EQ(std::string, std::string(buf, buflen), std::string(key), m_strm.str());
+			}
+			m_strm.str("");
+		}
+
+		retval = rdb.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb close");
+
+		std::string upgPath = DbFileName(dbPath, "csumv1", ".db.upgrade");
+		ASSERT_EQ(bool, snf::fs::exists(upgPath.c_str()), false, "upgrade file replaced the value file");
+		ASSERT_EQ(int64_t, snf::fs::size(DbFileName(dbPath, "csumv1", ".attr").c_str()),
+			int64_t(sizeof(dbattr_t)), "format version written");
+
+		return true;
+	}
+
+public:
+	ChecksumDB() : snf::tf::test() {}
+	~ChecksumDB() {}
+
+	virtual const char *name() const
+	{
+		return "ChecksumDB";
+	}
+
+	virtual const char *description() const
+	{
+		return "Detects damaged pages using the page checksums";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		ASSERT_NE(const snf::config *, conf, nullptr, "check config");
+		const char *dbPath = conf->get("DBPATH");
+		ASSERT_NE(const char *, dbPath, nullptr, "get DBPATH from config");
+
+		char            key[32];
+		int             retval;
+		int             valueKey = -1;
+		std::vector<int> damaged(NKEYS, 0);
+		RdbStats        stats;
+		RdbCheckReport  report;
+
+		const char *check = "123456789";
+		ASSERT_EQ(uint32_t, Crc32c(check, strlen(check)), 0xE3069283U, "CRC32C check value");
+		ASSERT_EQ(uint32_t, Crc32c(check + 4, strlen(check) - 4, Crc32c(check, 4)),
+			0xE3069283U, "CRC32C continued");
+		TEST_LOG((Crc32cAccelerated() ? "CRC32C instructions used" : "CRC32C table used"));
+
+		RdbOptions options;
+		options.syncDataFile(false);
+		options.warmCache(false);
+		Rdb rdb(dbPath, "csumdb", KPSIZE, HTSIZE, options);
+
+		retval = rdb.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb open");
+
+		for (int i = 0; i < NKEYS; ++i) {
+			TestKey(key, "csum", i);
+			retval = rdb.set(key, int(strlen(key)), key, int(strlen(key)));
+			ASSERT_EQ(int, retval, E_ok, "rdb set");
+		}
+
+		retval = rdb.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb close");
+
+		// damage, where it does no harm otherwise, the first
+		// key page and the first value page of another key
+		{
+			snf::file idx(DbFileName(dbPath, "csumdb", ".idx"), 0022);
+			ASSERT_EQ(bool, OpenDbFile(idx), true, "open key file");
+
+			std::vector<char> buf(KPSIZE);
+			key_page_t *kp = reinterpret_cast<key_page_t *>(buf.data());
+
+			ASSERT_EQ(bool, ReadPage(idx, 0L, buf.data(), KPSIZE), true, "read key page");
+			ASSERT_EQ(int, kp->kp_flags & KPAGE_CHECKSUM, KPAGE_CHECKSUM, "key page checksum set");
+			ASSERT_EQ(bool, IsKeyPageChecksumValid(kp, KPSIZE), true, "key page checksum valid");
+
+			for (int i = 0; i < NUM_OF_KEYS_IN_PAGE(KPSIZE); ++i) {
+				const key_rec_t *kr = kp->kp_keys + i;
+				if (kr->kr_flags == KEY_INUSE)
+					damaged[keyIndex(kr->kr_key, kr->kr_klen)] = 1;
+			}
+
+			kp->kp_unused3 ^= 1;
+			ASSERT_EQ(bool, WritePage(idx, 0L, buf.data(), KPSIZE), true, "write key page");
+
+			snf::file db(DbFileName(dbPath, "csumdb", ".db"), 0022);
+			ASSERT_EQ(bool, OpenDbFile(db), true, "open value file");
+
+			value_page_t vp;
+			for (int64_t off = 0; valueKey == -1; off += int64_t(sizeof(vp))) {
+				ASSERT_EQ(bool, ReadPage(db, off, &vp, int(sizeof(vp))), true, "read value page");
+				int i = keyIndex(vp.vp_key, vp.vp_klen);
+				if (damaged[i])
+					continue;
+
+				ASSERT_EQ(int, vp.vp_flags & VPAGE_CHECKSUM, VPAGE_CHECKSUM, "value page checksum set");
+				ASSERT_EQ(bool, IsValuePageChecksumValid(&vp), true, "value page checksum valid");
+
+				vp.vp_value[MAX_VALUE_LENGTH - 1] ^= 1;
+				ASSERT_EQ(bool, WritePage(db, off, &vp, int(sizeof(vp))), true, "write value page");
+				valueKey = i;
+				damaged[i] = 1;
+			}
+		}
+
+		retval = rdb.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb open");
+
+		if (!getAll(rdb, damaged))
+			return false;
+
+		retval = rdb.getStats(stats);
+		ASSERT_EQ(int, retval, E_ok, "rdb get stats");
+		ASSERT_NE(int64_t, stats.checksumsVerified, 0, "checksums verified");
+		ASSERT_GE(int64_t, stats.checksumFailures, 2, "checksum failures");
+
+		retval = rdb.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb close");
+
+		// the damage goes unnoticed without the verification
+		options.verifyChecksums(false);
+		Rdb unverified(dbPath, "csumdb", KPSIZE, HTSIZE, options);
+
+		retval = unverified.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb open without verification");
+
+		if (!getAll(unverified, std::vector<int>(NKEYS, 0)))
+			return false;
+
+		retval = unverified.getStats(stats);
+		ASSERT_EQ(int, retval, E_ok, "rdb get stats");
+		ASSERT_EQ(int64_t, stats.checksumsVerified, 0, "no checksum verified");
+
+		retval = unverified.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb close");
+
+		// the repair rebuilds the damaged key page and drops
+		// the damaged value
+		RdbChecker checker(dbPath, "csumdb", 2);
+
+		retval = checker.check(report);
+		ASSERT_EQ(int, retval, E_ok, "check");
+		ASSERT_EQ(int64_t, report.badChecksums, 2, "damaged pages found");
+		ASSERT_EQ(size_t, report.damagedBuckets.size(), 2, "damaged entries");
+
+		retval = checker.check(report, true);
+		ASSERT_EQ(int, retval, E_ok, "repair");
+
+		retval = checker.check(report);
+		ASSERT_EQ(int, retval, E_ok, "check");
+		for (const std::string &p : report.problems)
+			TEST_LOG(p);
+		ASSERT_EQ(bool, report.clean(), true, "database is clean after the repair");
+		ASSERT_EQ(int64_t, report.keys, NKEYS - 1, "keys after the repair");
+
+		retval = rdb.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb open");
+
+		for (int i = 0; i < NKEYS; ++i) {
+			char buf[32];
+			int buflen = int(sizeof(buf));
+			TestKey(key, "csum", i);
+			retval = rdb.get(key, int(strlen(key)), buf, &buflen);
+			m_strm << "rdb get after the repair: key = " << key;
+			ASSERT_EQ(int, retval, (i == valueKey) ? E_not_found : E_ok, m_strm.str());
+			m_strm.str("");
+			rdb.remove(key, int(strlen(key)));
+		}
+
+		retval = rdb.getStats(stats);
+		ASSERT_EQ(int, retval, E_ok, "rdb get stats");
+		ASSERT_EQ(int64_t, stats.checksumFailures, 0, "no checksum failure after the repair");
+
+		retval = rdb.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb close");
+
+		// the pages updated in place by the removes keep
+		// their checksums
+		{
+			snf::file idx(DbFileName(dbPath, "csumdb", ".idx"), 0022);
+			ASSERT_EQ(bool, OpenDbFile(idx), true, "open key file");
+
+			std::vector<char> buf(KPSIZE);
+			key_page_t *kp = reinterpret_cast<key_page_t *>(buf.data());
+
+			for (int64_t off = 0; ReadPage(idx, off, buf.data(), KPSIZE); off += KPSIZE) {
+				m_strm << "key page at offset " << off;
+				ASSERT_EQ(int, kp->kp_flags & KPAGE_CHECKSUM, KPAGE_CHECKSUM, m_strm.str());
+				ASSERT_EQ(bool, IsKeyPageChecksumValid(kp, KPSIZE), true, m_strm.str());
+				m_strm.str("");
+			}
+
+			snf::file db(DbFileName(dbPath, "csumdb", ".db"), 0022);
+			ASSERT_EQ(bool, OpenDbFile(db), true, "open value file");
+
+			value_page_t vp;
+			for (int64_t off = 0; ReadPage(db, off, &vp, int(sizeof(vp))); off += int64_t(sizeof(vp))) {
+				m_strm << "value page at offset " << off;
+				ASSERT_EQ(int, vp.vp_flags & VPAGE_CHECKSUM, VPAGE_CHECKSUM, m_strm.str());
+				ASSERT_EQ(bool, IsValuePageChecksumValid(&vp), true, m_strm.str());
+				m_strm.str("");
+			}
+		}
+
+		return upgrade(dbPath);
+	}
+};
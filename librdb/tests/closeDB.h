@@ -0,0 +1,131 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "error.h"
+#include "rdb.h"
+#include "dbtest.h"
+
+class CloseDB : public snf::tf::test
+{
+private:
+	static const int NTHREADS = 4;
+	static const int NKEYS = 2000;     // per thread
+	static const int MIN_SETS = 200;   // per thread, before closing
+
+	struct writer_t
+	{
+		std::atomic<int>    sets;       // sets done
+		int                 status;     // status of the set that failed
+	};
+
+	static void write(Rdb *rdb, int t, writer_t *w)
+	{
+		char key[32];
+		char val[32];
+
+		for (int i = 0; ; ++i) {
+			TestKey(key, "close", t * NKEYS + i % NKEYS);
+			TestValue(val, i % NKEYS, i / NKEYS);
+			int retval = rdb->set(key, (int)strlen(key), val, (int)strlen(val));
+			if (retval != E_ok) {
+				w->status = retval;
+				break;
+			}
+			w->sets++;
+		}
+	}
+
+public:
+	CloseDB() : snf::tf::test() {}
+	~CloseDB() {}
+
+	virtual const char *name() const
+	{
+		return "CloseDB";
+	}
+
+	virtual const char *description() const
+	{
+		return "Closes the database with the operations in flight";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		ASSERT_NE(const snf::config *, conf, nullptr, "check config");
+		const char *dbPath = conf->get("DBPATH");
+		ASSERT_NE(const char *, dbPath, nullptr, "get DBPATH from config");
+
+		char        key[32];
+		char        val[32];
+		char        buf[32];
+		int         buflen;
+		int         retval;
+
+		RdbOptions options;
+		options.syncDataFile(false);
+		options.warmCache(false);
+		Rdb rdb(dbPath, "closedb", 1024, 101, options);
+
+		retval = rdb.set("k", 1, "v", 1);
+		ASSERT_EQ(int, retval, E_invalid_state, "rdb set: db not open");
+
+		retval = rdb.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb open");
+
+		writer_t                    writers[NTHREADS];
+		std::vector<std::thread>    threads;
+
+		for (int t = 0; t < NTHREADS; ++t) {
+			writers[t].sets = 0;
+			writers[t].status = E_ok;
+			threads.emplace_back(write, &rdb, t, &writers[t]);
+		}
+
+		for (int t = 0; t < NTHREADS; ++t) {
+			while (writers[t].sets < MIN_SETS)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		// the writers are still going; close waits for the
+		// sets in flight and fails the others
+		retval = rdb.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb close");
+
+		for (int t = 0; t < NTHREADS; ++t)
+			threads[t].join();
+
+		for (int t = 0; t < NTHREADS; ++t) {
+			m_strm << "writer " << t << ": " << writers[t].sets << " sets";
+			TEST_LOG(m_strm.str());
+			ASSERT_EQ(int, writers[t].status, E_invalid_state, m_strm.str());
+			m_strm.str("");
+		}
+
+		buflen = (int)sizeof(buf);
+		retval = rdb.get("k", 1, buf, &buflen);
+		ASSERT_EQ(int, retval, E_invalid_state, "rdb get: db closed");
+
+		// every set that succeeded made it to the database
+		retval = rdb.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb reopen");
+
+		for (int t = 0; t < NTHREADS; ++t) {
+			int last = writers[t].sets - 1;
+
+			TestKey(key, "close", t * NKEYS + last % NKEYS);
+			TestValue(val, last % NKEYS, last / NKEYS);
+			buflen = (int)sizeof(buf);
+			retval = rdb.get(key, (int)strlen(key), buf, &buflen);
+			m_strm << "rdb get: key = " << key;
+			ASSERT_EQ(int, retval, E_ok, m_strm.str());
+			ASSERT_EQ(std::string, std::string(buf, buflen), std::string(val), m_strm.str());
+			m_strm.str("");
+		}
+
+		retval = rdb.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb close");
+
+		return true;
+	}
+};
@@ -0,0 +1,161 @@
+#include <atomic>
+#include <mutex>
+#include <set>
+#include "error.h"
+#include "cluster.h"
+#include "dbtest.h"
+
+class ClusterDB : public snf::tf::test
+{
+private:
+	static const int NSHARDS = 4;
+	static const int NKEYS = 200;
+
+public:
+	ClusterDB() : snf::tf::test() {}
+	~ClusterDB() {}
+
+	virtual const char *name() const
+	{
+		return "ClusterDB";
+	}
+
+	virtual const char *description() const
+	{
+		return "Spreads the keys over the shards of a cluster";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		ASSERT_NE(const snf::config *, conf, nullptr, "check config");
+		const char *dbPath = conf->get("DBPATH");
+		ASSERT_NE(const char *, dbPath, nullptr, "get DBPATH from config");
+		const char *dbName = conf->get("DBNAME");
+		ASSERT_NE(const char *, dbName, nullptr, "get DBNAME from config");
+
+		char                        key[32];
+		char                        buf[32];
+		int                         buflen;
+		int                         retval;
+		int                         perShard[NSHARDS] = { 0 };
+		RdbStats                    before;
+		RdbStats                    after;
+		std::vector<RdbStats>       shardStats;
+		std::vector<std::string>    paths;
+
+		for (int i = 0; i < NSHARDS; ++i) {
+			std::ostringstream oss;
+			oss << dbPath << snf::pathsep() << "cluster" << snf::pathsep() << "shard" << i;
+			paths.push_back(oss.str());
+		}
+
+		RdbOptions options;
+		options.syncDataFile(false);
+		options.orderedIndex(true);
+		RdbCluster cluster(paths, dbName, 1024, 11, options);
+
+		ASSERT_EQ(int, cluster.getShardCount(), NSHARDS, "shard count");
+
+		retval = cluster.open();
+		ASSERT_EQ(int, retval, E_ok, "cluster open");
+
+		retval = cluster.getStats(before, 0, true);
+		ASSERT_EQ(int, retval, E_ok, "cluster get stats");
+
+		for (int i = 0; i < NKEYS; ++i) {
+			TestKey(key, "shard", i);
+			retval = cluster.set(key, (int)strlen(key), key, (int)strlen(key));
+			m_strm << "cluster set: key = " << key;
+			ASSERT_EQ(int, retval, E_ok, m_strm.str());
+			m_strm.str("");
+			perShard[cluster.getShardIndex(key, (int)strlen(key))]++;
+		}
+
+		for (int i = 0; i < NSHARDS; ++i) {
+			m_strm << "keys in shard " << i;
+			ASSERT_EQ(bool, (perShard[i] > 0), true, m_strm.str());
+			m_strm.str("");
+		}
+
+		for (int i = 0; i < NKEYS; ++i) {
+			TestKey(key, "shard", i);
+			buflen = (int)(sizeof(buf) - 1);
+			retval = cluster.get(key, (int)strlen(key), buf, &buflen);
+			m_strm << "cluster get: key = " << key;
+			ASSERT_EQ(int, retval, E_ok, m_strm.str());
+			buf[buflen] = '\0';
+			ASSERT_EQ(int, strcmp(buf, key), 0, m_strm.str());
+			m_strm.str("");
+		}
+
+		// The key is only in the shard it is routed to
+		TestKey(key, "shard", 0);
+		int shard = cluster.getShardIndex(key, (int)strlen(key));
+		buflen = (int)sizeof(buf);
+		retval = cluster.getShard((shard + 1) % NSHARDS)->get(key, (int)strlen(key), buf, &buflen);
+		ASSERT_EQ(int, retval, E_not_found, "shard get: other shard");
+
+		std::mutex              scanMutex;
+		std::set<std::string>   scanned;
+		std::atomic<int>        misrouted(0);
+
+		retval = cluster.scanPrefix("shard", 5,
+			[&] (int shard, const char *k, int klen, const char *, int) {
+				if (cluster.getShardIndex(k, klen) != shard)
+					misrouted++;
+				std::lock_guard<std::mutex> guard(scanMutex);
+				scanned.insert(std::string(k, klen));
+				return E_ok;
+			});
+		ASSERT_EQ(int, retval, E_ok, "cluster scan prefix");
+		ASSERT_EQ(int, int(scanned.size()), NKEYS, "keys scanned");
+		ASSERT_EQ(int, misrouted, 0, "keys scanned from their shard");
+
+		std::atomic<int> visited(0);
+		retval = cluster.scanRange(0, 0, 0, 0,
+			[&visited] (int, const char *, int, const char *, int) {
+				return (++visited < 10) ? E_ok : E_eof_detected;
+			});
+		ASSERT_EQ(int, retval, E_eof_detected, "cluster scan range: stopped by visitor");
+
+		retval = cluster.getStats(after, &shardStats, true);
+		ASSERT_EQ(int, retval, E_ok, "cluster get stats");
+		ASSERT_EQ(int, int(shardStats.size()), NSHARDS, "shard stats");
+		ASSERT_EQ(int64_t, after.keys - before.keys, NKEYS, "keys added");
+		ASSERT_EQ(int64_t, after.sets.count - before.sets.count, NKEYS, "set count");
+		ASSERT_EQ(int, after.htSize, NSHARDS * shardStats[0].htSize, "hash table size");
+
+		retval = cluster.close();
+		ASSERT_EQ(int, retval, E_ok, "cluster close");
+
+		std::vector<std::string> fewer(paths.begin(), paths.end() - 1);
+		RdbCluster smaller(fewer, dbName, 1024, 11, options);
+		retval = smaller.open();
+		ASSERT_EQ(int, retval, E_mismatch, "cluster open: fewer shards");
+
+		retval = cluster.rebuild();
+		ASSERT_EQ(int, retval, E_ok, "cluster rebuild");
+
+		retval = cluster.open();
+		ASSERT_EQ(int, retval, E_ok, "cluster open: after rebuild");
+
+		for (int i = 0; i < NKEYS; ++i) {
+			TestKey(key, "shard", i);
+			buflen = (int)sizeof(buf);
+			retval = cluster.get(key, (int)strlen(key), buf, &buflen);
+			m_strm << "cluster get after rebuild: key = " << key;
+			ASSERT_EQ(int, retval, E_ok, m_strm.str());
+			m_strm.str("");
+
+			retval = cluster.remove(key, (int)strlen(key));
+			m_strm << "cluster remove: key = " << key;
+			ASSERT_EQ(int, retval, E_ok, m_strm.str());
+			m_strm.str("");
+		}
+
+		retval = cluster.close();
+		ASSERT_EQ(int, retval, E_ok, "cluster close");
+
+		return true;
+	}
+};
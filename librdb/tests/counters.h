@@ -0,0 +1,130 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "error.h"
+#include "rdb.h"
+
+class CountersDB : public snf::tf::test
+{
+private:
+	static const int NTHREADS = 8;
+	static const int NINCRS = 1000;
+
+	static void incrementer(Rdb *rdb, std::atomic<int> *failures)
+	{
+		for (int i = 0; i < NINCRS; ++i) {
+			if (rdb->increment("hits", 4, 1) != E_ok)
+				(*failures)++;
+		}
+	}
+
+public:
+	CountersDB() : snf::tf::test() {}
+	~CountersDB() {}
+
+	virtual const char *name() const
+	{
+		return "CountersDB";
+	}
+
+	virtual const char *description() const
+	{
+		return "Increments counters and compares and sets values";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		ASSERT_NE(const snf::config *, conf, nullptr, "check config");
+		const char *dbPath = conf->get("DBPATH");
+		ASSERT_NE(const char *, dbPath, nullptr, "get DBPATH from config");
+		const char *dbName = conf->get("DBNAME");
+		ASSERT_NE(const char *, dbName, nullptr, "get DBNAME from config");
+
+		char    buf[32];
+		int     buflen;
+		int64_t counter = 0;
+
+		RdbOptions options;
+		options.syncDataFile(false);
+		Rdb rdb(dbPath, dbName, 1024, 11, options);
+
+		int retval = rdb.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb open");
+
+		retval = rdb.increment("visits", 6, 5, &counter);
+		ASSERT_EQ(int, retval, E_ok, "rdb increment: new counter");
+		ASSERT_EQ(int64_t, counter, 5, "counter value");
+
+		retval = rdb.increment("visits", 6, -7, &counter);
+		ASSERT_EQ(int, retval, E_ok, "rdb increment: existing counter");
+		ASSERT_EQ(int64_t, counter, -2, "counter value");
+
+		buflen = (int)sizeof(buf);
+		retval = rdb.get("visits", 6, buf, &buflen);
+		ASSERT_EQ(int, retval, E_ok, "rdb get: key = visits");
+		ASSERT_EQ(int, buflen, (int)sizeof(int64_t), "counter length");
+		memcpy(&counter, buf, sizeof(int64_t));
+		ASSERT_EQ(int64_t, counter, -2, "stored counter value");
+
+		retval = rdb.set("name", 4, "rdb", 3);
+		ASSERT_EQ(int, retval, E_ok, "rdb set: key = name");
+
+		retval = rdb.increment("name", 4, 1, &counter);
+		ASSERT_EQ(int, retval, E_invalid_state, "rdb increment: not a counter");
+
+		std::atomic<int> failures(0);
+		std::vector<std::thread> threads;
+		for (int i = 0; i < NTHREADS; ++i)
+			threads.push_back(std::thread(incrementer, &rdb, &failures));
+		for (std::thread &t : threads)
+			t.join();
+
+		ASSERT_EQ(int, failures, 0, "concurrent increments");
+
+		retval = rdb.increment("hits", 4, 0, &counter);
+		ASSERT_EQ(int, retval, E_ok, "rdb increment: key = hits");
+		ASSERT_EQ(int64_t, counter, (int64_t)(NTHREADS * NINCRS), "concurrent counter value");
+
+		retval = rdb.compareAndSet("name", 4, "abc", 3, "xyz", 3);
+		ASSERT_EQ(int, retval, E_mismatch, "rdb compare and set: wrong value");
+
+		retval = rdb.compareAndSet("name", 4, "rdb", 3, "xyz", 3);
+		ASSERT_EQ(int, retval, E_ok, "rdb compare and set: same length");
+
+		retval = rdb.compareAndSet("name", 4, "xyz", 3, "librdb", 6);
+		ASSERT_EQ(int, retval, E_ok, "rdb compare and set: different length");
+
+		buflen = (int)(sizeof(buf) - 1);
+		retval = rdb.get("name", 4, buf, &buflen);
+		ASSERT_EQ(int, retval, E_ok, "rdb get: key = name");
+		buf[buflen] = '\0';
+		ASSERT_EQ(int, strcmp(buf, "librdb"), 0, "value: key = name");
+
+		retval = rdb.compareAndSet("name", 4, 0, 0, "new", 3);
+		ASSERT_EQ(int, retval, E_mismatch, "rdb compare and set: key exists");
+
+		retval = rdb.compareAndSet("absent", 6, "x", 1, "y", 1);
+		ASSERT_EQ(int, retval, E_not_found, "rdb compare and set: key = absent");
+
+		retval = rdb.compareAndSet("absent", 6, 0, 0, "y", 1);
+		ASSERT_EQ(int, retval, E_ok, "rdb compare and set: create key = absent");
+
+		char longkey[MAX_KEY_LENGTH + 1];
+		memset(longkey, 'k', sizeof(longkey));
+		retval = rdb.compareAndSet(longkey, int(sizeof(longkey)), 0, 0, "y", 1);
+		ASSERT_EQ(int, retval, E_invalid_arg, "rdb compare and set: key too long");
+
+		const char *keys[] = { "visits", "hits", "name", "absent" };
+		for (const char *k : keys) {
+			retval = rdb.remove(k, (int)strlen(k));
+			m_strm << "rdb remove: key = " << k;
+			ASSERT_EQ(int, retval, E_ok, m_strm.str());
+			m_strm.str("");
+		}
+
+		retval = rdb.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb close");
+
+		return true;
+	}
+};
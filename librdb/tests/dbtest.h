@@ -0,0 +1,59 @@
+#ifndef _SNF_RDB_TESTS_DBTEST_H_
+#define _SNF_RDB_TESTS_DBTEST_H_
+
+#include <string>
+#include "error.h"
+#include "rdb.h"
+
+/*
+ * Helpers shared by the tests. The keys and the values are
+ * made with GenKeyValue() (rdbts.cpp) and numbered, so that a
+ * test can read back or update the keys it has set; the key
+ * prefix keeps the keys of the tests sharing a database apart.
+ */
+
+extern void GenKeyValue(char *, char *, int);
+extern void TestKey(char *, const char *, int);
+extern void TestValue(char *, int, int);
+
+/*
+ * Gets the path of the database file with the given extension.
+ */
+inline std::string
+DbFileName(const char *dbPath, const char *dbName, const char *ext)
+{
+	std::string fname(dbPath);
+	fname.push_back(snf::pathsep());
+	fname.append(dbName);
+	fname.append(ext);
+	return fname;
+}
+
+/*
+ * Opens the database file for reading and writing, to damage
+ * or inspect its pages behind the database's back.
+ */
+inline bool
+OpenDbFile(snf::file &file)
+{
+	snf::file::open_flags oflags;
+	oflags.o_read = true;
+	oflags.o_write = true;
+	return file.open(oflags) == E_ok;
+}
+
+inline bool
+ReadPage(snf::file &file, int64_t offset, void *buf, int len)
+{
+	int bRead = 0;
+	return (file.read(offset, buf, len, &bRead) == E_ok) && (bRead == len);
+}
+
+inline bool
+WritePage(snf::file &file, int64_t offset, const void *buf, int len)
+{
+	int bWritten = 0;
+	return (file.write(offset, buf, len, &bWritten) == E_ok) && (bWritten == len);
+}
+
+#endif // _SNF_RDB_TESTS_DBTEST_H_
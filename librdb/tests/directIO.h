@@ -0,0 +1,126 @@
+#include "error.h"
+#include "filesystem.h"
+#include "rdb.h"
+#include "dbtest.h"
+
+class DirectIODB : public snf::tf::test
+{
+private:
+	static const int NKEYS = 2000;
+
+public:
+	DirectIODB() : snf::tf::test() {}
+	~DirectIODB() {}
+
+	virtual const char *name() const
+	{
+		return "DirectIODB";
+	}
+
+	virtual const char *description() const
+	{
+		return "Sets, updates and removes keys using direct I/O";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		ASSERT_NE(const snf::config *, conf, nullptr, "check config");
+		const char *dbPath = conf->get("DBPATH");
+		ASSERT_NE(const char *, dbPath, nullptr, "get DBPATH from config");
+		const char *dbName = conf->get("DBNAME");
+		ASSERT_NE(const char *, dbName, nullptr, "get DBNAME from config");
+
+		char key[32];
+		char val[64];
+		char buf[64];
+		int  buflen;
+		int  retval;
+
+		char dbpath[MAXPATHLEN + 1];
+		snprintf(dbpath, MAXPATHLEN, "%s%c%s.db", dbPath, snf::pathsep(), dbName);
+
+		RdbOptions options;
+		options.directIO(true);
+
+		{
+			Rdb rdb(dbPath, dbName, 1024, 11, options);
+
+			retval = rdb.open();
+			ASSERT_EQ(int, retval, E_ok, "rdb open with direct I/O");
+
+			for (int i = 0; i < NKEYS; ++i) {
+				TestKey(key, "dio", i);
+				TestValue(val, i, 0);
+				retval = rdb.set(key, (int)strlen(key), val, (int)strlen(val));
+				m_strm << "rdb set: key = " << key;
+				ASSERT_EQ(int, retval, E_ok, m_strm.str());
+				m_strm.str("");
+			}
+
+			for (int i = 0; i < NKEYS; i += 2) {
+				TestKey(key, "dio", i);
+				TestValue(val, i, 1);
+				retval = rdb.set(key, (int)strlen(key), val, (int)strlen(val));
+				m_strm << "rdb update: key = " << key;
+				ASSERT_EQ(int, retval, E_ok, m_strm.str());
+				m_strm.str("");
+			}
+
+			for (int i = 0; i < NKEYS; i += 4) {
+				TestKey(key, "dio", i + 1);
+				retval = rdb.remove(key, (int)strlen(key));
+				m_strm << "rdb remove: key = " << key;
+				ASSERT_EQ(int, retval, E_ok, m_strm.str());
+				m_strm.str("");
+			}
+
+			retval = rdb.close();
+			ASSERT_EQ(int, retval, E_ok, "rdb close");
+		}
+
+		// the partial page writes must not leave padding behind
+		ASSERT_EQ(int64_t, snf::fs::size(dbpath) % (int64_t)sizeof(value_page_t), 0,
+			"value file size is a multiple of the value page size");
+
+		options.directIO(false);
+
+		{
+			Rdb rdb(dbPath, dbName, 1024, 11, options);
+
+			retval = rdb.open();
+			ASSERT_EQ(int, retval, E_ok, "rdb open with buffered I/O");
+
+			for (int i = 0; i < NKEYS; ++i) {
+				TestKey(key, "dio", i);
+				buflen = (int)(sizeof(buf) - 1);
+				retval = rdb.get(key, (int)strlen(key), buf, &buflen);
+				if ((i % 4) == 1) {
+					m_strm << "rdb get removed: key = " << key;
+					ASSERT_EQ(int, retval, E_not_found, m_strm.str());
+					m_strm.str("");
+					continue;
+				}
+
+				m_strm << "rdb get: key = " << key;
+				ASSERT_EQ(int, retval, E_ok, m_strm.str());
+				m_strm.str("");
+
+				buf[buflen] = '\0';
+				TestValue(val, i, ((i % 2) == 0) ? 1 : 0);
+				m_strm << "value: key = " << key;
+				ASSERT_EQ(int, strcmp(buf, val), 0, m_strm.str());
+				m_strm.str("");
+
+				retval = rdb.remove(key, (int)strlen(key));
+				m_strm << "rdb remove: key = " << key;
+				ASSERT_EQ(int, retval, E_ok, m_strm.str());
+				m_strm.str("");
+			}
+
+			retval = rdb.close();
+			ASSERT_EQ(int, retval, E_ok, "rdb close");
+		}
+
+		return true;
+	}
+};
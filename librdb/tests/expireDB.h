@@ -0,0 +1,165 @@
+#include <chrono>
+#include <thread>
+#include "error.h"
+#include "filesystem.h"
+#include "rdb.h"
+#include "dbtest.h"
+
+class ExpireDB : public snf::tf::test
+{
+private:
+	static const int NKEYS = 20;
+
+public:
+	ExpireDB() : snf::tf::test() {}
+	~ExpireDB() {}
+
+	virtual const char *name() const
+	{
+		return "ExpireDB";
+	}
+
+	virtual const char *description() const
+	{
+		return "Expires keys and reclaims them";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		ASSERT_NE(const snf::config *, conf, nullptr, "check config");
+		const char *dbPath = conf->get("DBPATH");
+		ASSERT_NE(const char *, dbPath, nullptr, "get DBPATH from config");
+		const char *dbName = conf->get("DBNAME");
+		ASSERT_NE(const char *, dbName, nullptr, "get DBNAME from config");
+
+		char key[32];
+		char buf[32];
+		int  buflen;
+
+		char fdppath[MAXPATHLEN + 1];
+		snprintf(fdppath, MAXPATHLEN, "%s%c%s.fdp", dbPath, snf::pathsep(), dbName);
+
+		RdbOptions options;
+		options.syncDataFile(false);
+
+		{
+			Rdb rdb(dbPath, dbName, 1024, 11, options);
+
+			int retval = rdb.open();
+			ASSERT_EQ(int, retval, E_ok, "rdb open");
+
+			retval = rdb.setWithTTL("k1", 2, "v1", 2, 0);
+			ASSERT_EQ(int, retval, E_invalid_arg, "rdb set with zero ttl");
+
+			for (int i = 0; i < NKEYS; ++i) {
+				TestKey(key, "ttl", i);
+				retval = rdb.setWithTTL(key, (int)strlen(key), "expiring", 8, 1);
+				m_strm << "rdb set with ttl: key = " << key;
+				ASSERT_EQ(int, retval, E_ok, m_strm.str());
+				m_strm.str("");
+			}
+
+			retval = rdb.set("persist", 7, "P", 1);
+			ASSERT_EQ(int, retval, E_ok, "rdb set: key = persist");
+
+			retval = rdb.setWithTTL("renew", 5, "R", 1, 1);
+			ASSERT_EQ(int, retval, E_ok, "rdb set with ttl: key = renew");
+
+			retval = rdb.expire("renew", 5, 0);
+			ASSERT_EQ(int, retval, E_ok, "rdb expire: key = renew, ttl = 0");
+
+			retval = rdb.expire("persist", 7, 1);
+			ASSERT_EQ(int, retval, E_ok, "rdb expire: key = persist, ttl = 1");
+
+			retval = rdb.expire("missing", 7, 1);
+			ASSERT_EQ(int, retval, E_not_found, "rdb expire: key = missing");
+
+			TestKey(key, "ttl", 0);
+			buflen = (int)(sizeof(buf) - 1);
+			retval = rdb.get(key, (int)strlen(key), buf, &buflen);
+			ASSERT_EQ(int, retval, E_ok, "rdb get before expiry");
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(2100));
+
+			buflen = (int)(sizeof(buf) - 1);
+			retval = rdb.get(key, (int)strlen(key), buf, &buflen);
+			ASSERT_EQ(int, retval, E_not_found, "rdb get after expiry");
+
+			buflen = (int)(sizeof(buf) - 1);
+			retval = rdb.get("persist", 7, buf, &buflen);
+			ASSERT_EQ(int, retval, E_not_found, "rdb get: key = persist");
+
+			buflen = (int)(sizeof(buf) - 1);
+			retval = rdb.get("renew", 5, buf, &buflen);
+			ASSERT_EQ(int, retval, E_ok, "rdb get: key = renew");
+
+			// an expired key is treated as absent
+			retval = rdb.set("persist", 7, "Q", 1);
+			ASSERT_EQ(int, retval, E_ok, "rdb set: expired key = persist");
+
+			buflen = (int)(sizeof(buf) - 1);
+			retval = rdb.get("persist", 7, buf, &buflen);
+			ASSERT_EQ(int, retval, E_ok, "rdb get: key = persist");
+			ASSERT_EQ(int, buflen, 1, "value length: key = persist");
+			ASSERT_EQ(char, buf[0], 'Q', "value: key = persist");
+
+			int64_t fdpsize = snf::fs::size(fdppath);
+
+			retval = rdb.sweepExpired(rdb.getHashTableSize());
+			ASSERT_EQ(int, retval, E_ok, "rdb sweep expired");
+
+			ASSERT_EQ(int64_t, snf::fs::size(fdppath),
+				fdpsize + (int64_t)(NKEYS * sizeof(int64_t)),
+				"expired value pages freed");
+
+			for (int i = 0; i < NKEYS; ++i) {
+				TestKey(key, "ttl", i);
+				retval = rdb.remove(key, (int)strlen(key));
+				m_strm << "rdb remove swept key: key = " << key;
+				ASSERT_EQ(int, retval, E_not_found, m_strm.str());
+				m_strm.str("");
+			}
+
+			retval = rdb.remove("persist", 7);
+			ASSERT_EQ(int, retval, E_ok, "rdb remove: key = persist");
+
+			retval = rdb.remove("renew", 5);
+			ASSERT_EQ(int, retval, E_ok, "rdb remove: key = renew");
+
+			retval = rdb.close();
+			ASSERT_EQ(int, retval, E_ok, "rdb close");
+		}
+
+		options.setSweepInterval(100);
+
+		{
+			Rdb rdb(dbPath, dbName, 1024, 11, options);
+
+			int retval = rdb.open();
+			ASSERT_EQ(int, retval, E_ok, "rdb open with background sweep");
+
+			for (int i = 0; i < NKEYS; ++i) {
+				TestKey(key, "ttl", i);
+				retval = rdb.setWithTTL(key, (int)strlen(key), "expiring", 8, 1);
+				m_strm << "rdb set with ttl: key = " << key;
+				ASSERT_EQ(int, retval, E_ok, m_strm.str());
+				m_strm.str("");
+			}
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(2500));
+
+			for (int i = 0; i < NKEYS; ++i) {
+				TestKey(key, "ttl", i);
+				retval = rdb.remove(key, (int)strlen(key));
+				m_strm << "rdb remove swept key: key = " << key;
+				ASSERT_EQ(int, retval, E_not_found, m_strm.str());
+				m_strm.str("");
+			}
+
+			retval = rdb.close();
+			ASSERT_EQ(int, retval, E_ok, "rdb close");
+		}
+
+		return true;
+	}
+};
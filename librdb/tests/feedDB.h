@@ -0,0 +1,311 @@
+#include <string>
+#include <thread>
+#include <vector>
+#include "error.h"
+#include "rdb.h"
+#include "dbtest.h"
+
+class FeedDB : public snf::tf::test
+{
+private:
+	static const int NKEYS = 20;
+	static const int SEGSIZE = 64;
+	static const int SEGMENTS = 4;
+
+	static std::string feedKey(int i)
+	{
+		char key[32];
+		TestKey(key, "feed", i);
+		return key;
+	}
+
+	static std::string feedValue(int i, int gen)
+	{
+		char val[32];
+		TestValue(val, i, gen);
+		return val;
+	}
+
+	/*
+	 * Applies the changes of the primary to the replica until
+	 * the replica has all of them.
+	 */
+	bool catchUp(Rdb &primary, Rdb &replica)
+	{
+		std::vector<change_rec_t> changes;
+
+		while (replica.lastSequence() < primary.lastSequence()) {
+			int retval = primary.readChanges(replica.lastSequence() + 1, 16, changes);
+			ASSERT_EQ(int, retval, E_ok, "read changes");
+			ASSERT_EQ(bool, changes.empty(), false, "changes read");
+
+			retval = replica.applyChanges(changes);
+			ASSERT_EQ(int, retval, E_ok, "apply changes");
+		}
+
+		return true;
+	}
+
+	/*
+	 * Checks that the key has the same value, or is missing,
+	 * in both the databases.
+	 */
+	bool sameValue(Rdb &primary, Rdb &replica, const std::string &key)
+	{
+		char    pval[MAX_VALUE_LENGTH];
+		char    rval[MAX_VALUE_LENGTH];
+		int     plen = int(sizeof(pval));
+		int     rlen = int(sizeof(rval));
+
+		int pstatus = primary.get(key.data(), int(key.size()), pval, &plen);
+		int rstatus = replica.get(key.data(), int(key.size()), rval, &rlen);
+
+		m_strm << "replica get: key = " << key;
+		ASSERT_EQ(int, rstatus, pstatus, m_strm.str());
+		if (pstatus == E_ok)
+			ASSERT_EQ(std::string, std::string(rval, rlen), std::string(pval, plen), m_strm.str());
+		m_strm.str("");
+
+		return true;
+	}
+
+public:
+	FeedDB() : snf::tf::test() {}
+	~FeedDB() {}
+
+	virtual const char *name() const
+	{
+		return "FeedDB";
+	}
+
+	virtual const char *description() const
+	{
+		return "Replicates database using the change feed";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		ASSERT_NE(const snf::config *, conf, nullptr, "check config");
+		const char *dbPath = conf->get("DBPATH");
+		ASSERT_NE(const char *, dbPath, nullptr, "get DBPATH from config");
+
+		std::vector<change_rec_t> changes;
+		std::string key;
+		std::string val;
+
+		std::string replicaPath(dbPath);
+		replicaPath.push_back(snf::pathsep());
+		replicaPath.append("replica");
+
+		RdbOptions options;
+		options.syncDataFile(false);
+		options.changeFeed(true);
+		options.setFeedSegmentSize(SEGSIZE);
+		options.setFeedSegments(SEGMENTS);
+
+		Rdb primary(dbPath, "feeddb", 1024, 101, options);
+
+		int retval = primary.open();
+		ASSERT_EQ(int, retval, E_ok, "primary open");
+
+		// the feed is kept across the runs
+		uint64_t base = primary.lastSequence();
+
+		for (int i = 0; i < NKEYS; ++i) {
+			key = feedKey(i);
+			val = feedValue(i, 1);
+			retval = primary.set(key.data(), int(key.size()), val.data(), int(val.size()));
+			m_strm << "primary set: key = " << key;
+			ASSERT_EQ(int, retval, E_ok, m_strm.str());
+			m_strm.str("");
+		}
+
+		ASSERT_EQ(uint64_t, primary.lastSequence(), base + NKEYS, "sequence after sets");
+
+		retval = primary.readChanges(base + 1, NKEYS, changes);
+		ASSERT_EQ(int, retval, E_ok, "read changes");
+		ASSERT_EQ(bool, changes.empty(), false, "changes read");
+		for (size_t i = 0; i < changes.size(); ++i) {
+			m_strm << "change " << changes[i].cr_seq;
+			ASSERT_EQ(uint64_t, changes[i].cr_seq, base + 1 + i, m_strm.str());
+			ASSERT_EQ(int, changes[i].cr_op, CHANGE_SET, m_strm.str());
+			m_strm.str("");
+		}
+
+		retval = primary.checkpoint(replicaPath);
+		ASSERT_EQ(int, retval, E_ok, "primary checkpoint");
+
+		// changes after the checkpoint
+		for (int i = 0; i < NKEYS / 2; ++i) {
+			key = feedKey(i);
+			val = feedValue(i, 2);
+			retval = primary.set(key.data(), int(key.size()), val.data(), int(val.size()));
+			ASSERT_EQ(int, retval, E_ok, "primary update");
+		}
+
+		for (int i = NKEYS / 2; i < (NKEYS * 3) / 4; ++i) {
+			key = feedKey(i);
+			retval = primary.remove(key.data(), int(key.size()));
+			ASSERT_EQ(int, retval, E_ok, "primary remove");
+		}
+
+		key = feedKey(NKEYS - 5);
+		val = feedValue(NKEYS - 5, 2);
+		retval = primary.setWithTTL(key.data(), int(key.size()), val.data(), int(val.size()), 3600);
+		ASSERT_EQ(int, retval, E_ok, "primary set with ttl");
+
+		key = feedKey(NKEYS - 4);
+		retval = primary.expire(key.data(), int(key.size()), 7200);
+		ASSERT_EQ(int, retval, E_ok, "primary expire");
+
+		key = feedKey(NKEYS - 3);
+		val = feedValue(NKEYS - 3, 1);
+		std::string desired = feedValue(NKEYS - 3, 3);
+		retval = primary.compareAndSet(key.data(), int(key.size()),
+				val.data(), int(val.size()), desired.data(), int(desired.size()));
+		ASSERT_EQ(int, retval, E_ok, "primary compare and set");
+
+		std::string counter("feedcounter");
+		retval = primary.increment(counter.data(), int(counter.size()), 256);
+		ASSERT_EQ(int, retval, E_ok, "primary increment");
+		retval = primary.increment(counter.data(), int(counter.size()), 1);
+		ASSERT_EQ(int, retval, E_ok, "primary increment");
+
+		{
+			Rdb::Transaction txn(&primary);
+			key = feedKey(NKEYS - 2);
+			val = feedValue(NKEYS - 2, 2);
+			retval = txn.set(key.data(), int(key.size()), val.data(), int(val.size()));
+			ASSERT_EQ(int, retval, E_ok, "transaction set");
+			key = feedKey(NKEYS - 1);
+			retval = txn.remove(key.data(), int(key.size()));
+			ASSERT_EQ(int, retval, E_ok, "transaction remove");
+			retval = txn.commit();
+			ASSERT_EQ(int, retval, E_ok, "transaction commit");
+		}
+
+		RdbOptions replicaOptions;
+		replicaOptions.syncDataFile(false);
+
+		Rdb replica(replicaPath, "feeddb", 1024, 101, replicaOptions);
+
+		retval = replica.open();
+		ASSERT_EQ(int, retval, E_ok, "replica open");
+		ASSERT_EQ(uint64_t, replica.lastSequence(), base + NKEYS, "replica sequence");
+
+		if (!catchUp(primary, replica))
+			return false;
+
+		for (int i = 0; i < NKEYS; ++i) {
+			if (!sameValue(primary, replica, feedKey(i)))
+				return false;
+		}
+
+		if (!sameValue(primary, replica, counter))
+			return false;
+
+		// the changes already applied are skipped
+		retval = primary.readChanges(base + NKEYS + 1, 4, changes);
+		ASSERT_EQ(int, retval, E_ok, "read changes");
+		retval = replica.applyChanges(changes);
+		ASSERT_EQ(int, retval, E_ok, "apply changes again");
+
+		retval = primary.applyChanges(changes);
+		ASSERT_EQ(int, retval, E_invalid_state, "apply changes to the primary");
+
+		uint64_t last = primary.lastSequence();
+
+		retval = primary.readChanges(last + 1, 4, changes);
+		ASSERT_EQ(int, retval, E_ok, "read changes at the end");
+		ASSERT_EQ(bool, changes.empty(), true, "no change at the end");
+
+		retval = primary.readChanges(last + 2, 4, changes);
+		ASSERT_EQ(int, retval, E_mismatch, "read changes ahead of the feed");
+
+		retval = primary.waitForChanges(last + 1, 10);
+		ASSERT_EQ(int, retval, E_timed_out, "wait for changes");
+
+		std::thread writer([&primary, &counter] {
+			primary.increment(counter.data(), int(counter.size()), 1);
+		});
+
+		retval = primary.waitForChanges(last + 1, 5000);
+		writer.join();
+		ASSERT_EQ(int, retval, E_ok, "wait for changes with a writer");
+
+		if (!catchUp(primary, replica) || !sameValue(primary, replica, counter))
+			return false;
+
+		// a change is missing
+		retval = primary.increment(counter.data(), int(counter.size()), 1);
+		ASSERT_EQ(int, retval, E_ok, "primary increment");
+		retval = primary.increment(counter.data(), int(counter.size()), 1);
+		ASSERT_EQ(int, retval, E_ok, "primary increment");
+		retval = primary.readChanges(primary.lastSequence(), 4, changes);
+		ASSERT_EQ(int, retval, E_ok, "read last change");
+		retval = replica.applyChanges(changes);
+		ASSERT_EQ(int, retval, E_mismatch, "apply changes with a gap");
+
+		if (!catchUp(primary, replica) || !sameValue(primary, replica, counter))
+			return false;
+
+		// the oldest segments are removed; a replica that far
+		// behind starts over from a checkpoint
+		uint64_t behind = replica.lastSequence();
+
+		for (int i = 0; i < (SEGSIZE * SEGMENTS); ++i) {
+			retval = primary.increment(counter.data(), int(counter.size()), 1);
+			ASSERT_EQ(int, retval, E_ok, "primary increment");
+		}
+
+		retval = primary.readChanges(behind + 1, 4, changes);
+		ASSERT_EQ(int, retval, E_not_found, "read removed changes");
+
+		retval = replica.close();
+		ASSERT_EQ(int, retval, E_ok, "replica close");
+		retval = primary.checkpoint(replicaPath);
+		ASSERT_EQ(int, retval, E_ok, "primary checkpoint");
+		retval = replica.open();
+		ASSERT_EQ(int, retval, E_ok, "replica open");
+		ASSERT_EQ(uint64_t, replica.lastSequence(), primary.lastSequence(),
+			"replica sequence after checkpoint");
+
+		if (!sameValue(primary, replica, counter))
+			return false;
+
+		last = primary.lastSequence();
+
+		retval = primary.close();
+		ASSERT_EQ(int, retval, E_ok, "primary close");
+		retval = primary.open();
+		ASSERT_EQ(int, retval, E_ok, "primary reopen");
+		ASSERT_EQ(uint64_t, primary.lastSequence(), last, "sequence after reopen");
+
+		retval = replica.close();
+		ASSERT_EQ(int, retval, E_ok, "replica close");
+		retval = replica.open();
+		ASSERT_EQ(int, retval, E_ok, "replica reopen");
+		ASSERT_EQ(uint64_t, replica.lastSequence(), last, "replica sequence after reopen");
+
+		for (int i = 0; i < NKEYS; ++i) {
+			key = feedKey(i);
+			primary.remove(key.data(), int(key.size()));
+		}
+		primary.remove(counter.data(), int(counter.size()));
+
+		if (!catchUp(primary, replica))
+			return false;
+
+		for (int i = 0; i < NKEYS; ++i) {
+			if (!sameValue(primary, replica, feedKey(i)))
+				return false;
+		}
+
+		retval = replica.close();
+		ASSERT_EQ(int, retval, E_ok, "replica close");
+		retval = primary.close();
+		ASSERT_EQ(int, retval, E_ok, "primary close");
+
+		return true;
+	}
+};
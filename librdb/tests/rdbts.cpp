@@ -1,11 +1,28 @@
+#include <unordered_set>
+#include <vector>
 #include "test.h"
 #include "testmain.h"
+#include "dbtest.h"
 #include "simpleSGR.h"
 #include "updateDB.h"
 #include "multipleKPN.h"
 #include "normalFD.h"
 #include "bigload.h"
 #include "rebuildDB.h"
+#include "checkpoint.h"
+#include "expireDB.h"
+#include "counters.h"
+#include "scanDB.h"
+#include "directIO.h"
+#include "readOnly.h"
+#include "statsDB.h"
+#include "txnDB.h"
+#include "clusterDB.h"
+#include "feedDB.h"
+#include "warmDB.h"
+#include "checkDB.h"
+#include "checksumDB.h"
+#include "closeDB.h"
 
 static int
 RandomInRange(unsigned int seed, int lo, int hi)
@@ -47,6 +64,57 @@ GenKeyValue(char *key, char *val, int len)
 	return;
 }
 
+/*
+ * Keys and values made with GenKeyValue(), numbered for the
+ * tests to set and read back: TEST_KEYS distinct keys of
+ * TEST_KEYLEN characters, made on first use.
+ */
+static const int TEST_KEYS = 8192;
+static const int TEST_KEYLEN = 16;
+
+static const std::vector<std::string> &
+TestKeyValues()
+{
+	static const std::vector<std::string> kvs = [] {
+		std::vector<std::string> v;
+		std::unordered_set<std::string> seen;
+		char key[TEST_KEYLEN + 1];
+		char val[TEST_KEYLEN + 1];
+
+		while (int(v.size()) < 2 * TEST_KEYS) {
+			GenKeyValue(key, val, TEST_KEYLEN);
+			if (seen.insert(key).second) {
+				v.push_back(key);
+				v.push_back(val);
+			}
+		}
+
+		return v;
+	}();
+
+	return kvs;
+}
+
+/*
+ * Makes key number i, with the given prefix. The key buffer
+ * must hold the prefix and TEST_KEYLEN + 1 characters.
+ */
+void
+TestKey(char *key, const char *prefix, int i)
+{
+	sprintf(key, "%s%s", prefix, TestKeyValues()[2 * (i % TEST_KEYS)].c_str());
+}
+
+/*
+ * Makes generation gen of the value of key number i. The value
+ * buffer must hold at least 32 characters.
+ */
+void
+TestValue(char *val, int i, int gen)
+{
+	snprintf(val, 32, "%s-%d", TestKeyValues()[2 * (i % TEST_KEYS) + 1].c_str(), gen);
+}
+
 namespace snf {
 namespace tf {
 
@@ -56,6 +124,20 @@ test *test_list[] = {
 	DBG_NEW MultipleKeyPageNodes(),
 	DBG_NEW NormalFairDistribution(),
 	DBG_NEW RebuildDB(),
+	DBG_NEW CheckpointDB(),
+	DBG_NEW ExpireDB(),
+	DBG_NEW CountersDB(),
+	DBG_NEW ScanDB(),
+	DBG_NEW DirectIODB(),
+	DBG_NEW ReadOnlyDB(),
+	DBG_NEW StatsDB(),
+	DBG_NEW TransactionDB(),
+	DBG_NEW ClusterDB(),
+	DBG_NEW FeedDB(),
+	DBG_NEW WarmDB(),
+	DBG_NEW CheckDB(),
+	DBG_NEW ChecksumDB(),
+	DBG_NEW CloseDB(),
 	// DBG_NEW BigLoad(),
 	0
 };
@@ -0,0 +1,208 @@
+#include <atomic>
+#include <thread>
+#include "error.h"
+#include "filesystem.h"
+#include "rdb.h"
+#include "dbtest.h"
+
+class ReadOnlyDB : public snf::tf::test
+{
+private:
+	static const int NKEYS = 200;
+	static const int NUPDATES = 2000;
+
+	static void updater(Rdb *rdb, std::atomic<int> *failures)
+	{
+		char    key[32];
+
+		TestKey(key, "ro", 0);
+		for (int i = 0; i < NUPDATES; ++i) {
+			const char *val = ((i % 2) == 0) ? "AAAAAAAAAAAAAAAA" : "BBBBBBBB";
+			if (rdb->set(key, (int)strlen(key), val, (int)strlen(val)) != E_ok)
+				(*failures)++;
+		}
+	}
+
+	static void reader(Rdb *rdb, std::atomic<int> *failures)
+	{
+		char    key[32];
+		char    buf[32];
+		int     buflen;
+
+		TestKey(key, "ro", 0);
+		for (int i = 0; i < NUPDATES; ++i) {
+			buflen = (int)(sizeof(buf) - 1);
+			if (rdb->get(key, (int)strlen(key), buf, &buflen) != E_ok) {
+				(*failures)++;
+				continue;
+			}
+
+			buf[buflen] = '\0';
+			if ((strcmp(buf, "AAAAAAAAAAAAAAAA") != 0) && (strcmp(buf, "BBBBBBBB") != 0))
+				(*failures)++;
+		}
+	}
+
+public:
+	ReadOnlyDB() : snf::tf::test() {}
+	~ReadOnlyDB() {}
+
+	virtual const char *name() const
+	{
+		return "ReadOnlyDB";
+	}
+
+	virtual const char *description() const
+	{
+		return "Reads the database opened read-only while it is updated";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		ASSERT_NE(const snf::config *, conf, nullptr, "check config");
+		const char *dbPath = conf->get("DBPATH");
+		ASSERT_NE(const char *, dbPath, nullptr, "get DBPATH from config");
+		const char *dbName = conf->get("DBNAME");
+		ASSERT_NE(const char *, dbName, nullptr, "get DBNAME from config");
+
+		char key[32];
+		char val[32];
+		char buf[32];
+		int  buflen;
+		int  retval;
+
+		char htipath[MAXPATHLEN + 1];
+		snprintf(htipath, MAXPATHLEN, "%s%c%s.hti", dbPath, snf::pathsep(), dbName);
+
+		RdbOptions wopt;
+		wopt.syncDataFile(false);
+		wopt.shareHashTable(true);
+		Rdb writer(dbPath, dbName, 1024, 11, wopt);
+
+		RdbOptions ropt;
+		ropt.readOnly(true);
+		Rdb rdonly(dbPath, dbName, 1024, 11, ropt);
+
+		retval = writer.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb open for writing");
+		ASSERT_EQ(bool, snf::fs::exists(htipath), true, "shared hash table exists");
+
+		for (int i = 0; i < NKEYS; ++i) {
+			TestKey(key, "ro", i);
+			TestValue(val, i, 0);
+			retval = writer.set(key, (int)strlen(key), val, (int)strlen(val));
+			m_strm << "rdb set: key = " << key;
+			ASSERT_EQ(int, retval, E_ok, m_strm.str());
+			m_strm.str("");
+		}
+
+		retval = rdonly.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb open read-only");
+
+		for (int i = 0; i < NKEYS; ++i) {
+			TestKey(key, "ro", i);
+			TestValue(val, i, 0);
+			buflen = (int)(sizeof(buf) - 1);
+			retval = rdonly.get(key, (int)strlen(key), buf, &buflen);
+			m_strm << "rdb get read-only: key = " << key;
+			ASSERT_EQ(int, retval, E_ok, m_strm.str());
+			m_strm.str("");
+			buf[buflen] = '\0';
+			ASSERT_EQ(int, strcmp(buf, val), 0, "read-only value");
+		}
+
+		TestKey(key, "ro", 0);
+		retval = rdonly.set(key, (int)strlen(key), "x", 1);
+		ASSERT_EQ(int, retval, E_invalid_state, "rdb set read-only");
+
+		retval = rdonly.remove(key, (int)strlen(key));
+		ASSERT_EQ(int, retval, E_invalid_state, "rdb remove read-only");
+
+		uint64_t gen = rdonly.generation();
+
+		// grow the files beyond the reader's mapping
+		for (int i = NKEYS; i < 4 * NKEYS; ++i) {
+			TestKey(key, "ro", i);
+			TestValue(val, i, 1);
+			retval = writer.set(key, (int)strlen(key), val, (int)strlen(val));
+			m_strm << "rdb set: key = " << key;
+			ASSERT_EQ(int, retval, E_ok, m_strm.str());
+			m_strm.str("");
+		}
+
+		TestKey(key, "ro", 1);
+		retval = writer.remove(key, (int)strlen(key));
+		ASSERT_EQ(int, retval, E_ok, "rdb remove: key 1");
+
+		ASSERT_EQ(bool, (rdonly.generation() > gen), true, "generation bumped by the writer");
+		ASSERT_EQ(bool, (rdonly.generation() == writer.generation()), true, "generation shared");
+
+		for (int i = NKEYS; i < 4 * NKEYS; ++i) {
+			TestKey(key, "ro", i);
+			TestValue(val, i, 1);
+			buflen = (int)(sizeof(buf) - 1);
+			retval = rdonly.get(key, (int)strlen(key), buf, &buflen);
+			m_strm << "rdb get read-only: new key = " << key;
+			ASSERT_EQ(int, retval, E_ok, m_strm.str());
+			m_strm.str("");
+			buf[buflen] = '\0';
+			ASSERT_EQ(int, strcmp(buf, val), 0, "read-only value of new key");
+		}
+
+		TestKey(key, "ro", 1);
+		buflen = (int)(sizeof(buf) - 1);
+		retval = rdonly.get(key, (int)strlen(key), buf, &buflen);
+		ASSERT_EQ(int, retval, E_not_found, "rdb get read-only: removed key");
+
+		std::atomic<int> wfailures(0);
+		std::atomic<int> rfailures(0);
+		std::thread wthrd(updater, &writer, &wfailures);
+		std::thread rthrd(reader, &rdonly, &rfailures);
+		wthrd.join();
+		rthrd.join();
+		ASSERT_EQ(int, wfailures, 0, "concurrent updates");
+		ASSERT_EQ(int, rfailures, 0, "consistent reads during updates");
+
+		retval = rdonly.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb close read-only");
+
+		retval = writer.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb close");
+
+		// without the shared hash table, the reader builds its own
+		wopt.shareHashTable(false);
+		Rdb writer2(dbPath, dbName, 1024, 11, wopt);
+		retval = writer2.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb open for writing");
+		ASSERT_EQ(bool, snf::fs::exists(htipath), false, "shared hash table removed");
+
+		retval = rdonly.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb open read-only without shared hash table");
+
+		TestKey(key, "ro", NKEYS + 1);
+		TestValue(val, NKEYS + 1, 1);
+		buflen = (int)(sizeof(buf) - 1);
+		retval = rdonly.get(key, (int)strlen(key), buf, &buflen);
+		ASSERT_EQ(int, retval, E_ok, "rdb get read-only without shared hash table");
+		buf[buflen] = '\0';
+		ASSERT_EQ(int, strcmp(buf, val), 0, "read-only value");
+
+		retval = rdonly.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb close read-only");
+
+		for (int i = 0; i < 4 * NKEYS; ++i) {
+			if (i == 1)
+				continue;
+			TestKey(key, "ro", i);
+			retval = writer2.remove(key, (int)strlen(key));
+			m_strm << "rdb remove: key = " << key;
+			ASSERT_EQ(int, retval, E_ok, m_strm.str());
+			m_strm.str("");
+		}
+
+		retval = writer2.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb close");
+
+		return true;
+	}
+};
@@ -0,0 +1,206 @@
+#include <string>
+#include "error.h"
+#include "rdb.h"
+#include "dbtest.h"
+
+class ScanDB : public snf::tf::test
+{
+private:
+	static const int NUSERS = 30;
+	static const int NITEMS = 100;
+	static const int NKEYS = NUSERS * NITEMS;
+
+	static void makeKey(char *key, int i)
+	{
+		snprintf(key, 32, "user%03d:item%04d", i / NITEMS, i % NITEMS);
+	}
+
+	/*
+	 * Counts the keys of the scan, checking that they are in
+	 * order and have the right values.
+	 */
+	int count(RdbIterator &iter, int step = 1)
+	{
+		char        key[MAX_KEY_LENGTH + 1];
+		char        val[MAX_VALUE_LENGTH + 1];
+		char        expected[32];
+		int         klen, vlen;
+		int         retval;
+		int         n = 0;
+		std::string last;
+
+		for (;;) {
+			klen = MAX_KEY_LENGTH;
+			vlen = MAX_VALUE_LENGTH;
+			retval = iter.next(key, &klen, val, &vlen);
+			if (retval != E_ok)
+				break;
+
+			std::string k(key, klen);
+			if (!last.empty() && (k <= last))
+				return -1;
+			last = k;
+
+			int user = 0, item = 0;
+			if (sscanf(k.c_str(), "user%d:item%d", &user, &item) == 2) {
+				TestValue(expected, user * NITEMS + item, 0);
+				if ((vlen != (int)strlen(expected)) || (memcmp(val, expected, vlen) != 0))
+					return -1;
+			}
+
+			n++;
+		}
+
+		return (retval == E_eof_detected) ? n : retval;
+	}
+
+public:
+	ScanDB() : snf::tf::test() {}
+	~ScanDB() {}
+
+	virtual const char *name() const
+	{
+		return "ScanDB";
+	}
+
+	virtual const char *description() const
+	{
+		return "Scans keys by prefix and range using the ordered index";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		ASSERT_NE(const snf::config *, conf, nullptr, "check config");
+		const char *dbPath = conf->get("DBPATH");
+		ASSERT_NE(const char *, dbPath, nullptr, "get DBPATH from config");
+		const char *dbName = conf->get("DBNAME");
+		ASSERT_NE(const char *, dbName, nullptr, "get DBNAME from config");
+
+		char        key[32];
+		char        val[32];
+		RdbIterator iter;
+
+		RdbOptions options;
+		options.syncDataFile(false);
+		options.orderedIndex(true);
+
+		{
+			Rdb rdb(dbPath, dbName, 1024, 101, options);
+
+			int retval = rdb.open();
+			ASSERT_EQ(int, retval, E_ok, "rdb open");
+
+			// insert out of order
+			for (int j = 0; j < NKEYS; ++j) {
+				int i = (int)(((int64_t)j * 7919) % NKEYS);
+				makeKey(key, i);
+				TestValue(val, i, 0);
+				retval = rdb.set(key, (int)strlen(key), val, (int)strlen(val));
+				m_strm << "rdb set: key = " << key;
+				ASSERT_EQ(int, retval, E_ok, m_strm.str());
+				m_strm.str("");
+			}
+
+			retval = rdb.scanPrefix("user007:", 8, iter);
+			ASSERT_EQ(int, retval, E_ok, "rdb scan prefix");
+			ASSERT_EQ(int, count(iter), NITEMS, "keys with prefix user007:");
+
+			retval = rdb.scanRange("user010:", 8, "user012:", 8, iter);
+			ASSERT_EQ(int, retval, E_ok, "rdb scan range");
+			ASSERT_EQ(int, count(iter), 2 * NITEMS, "keys in range [user010:, user012:)");
+
+			retval = rdb.scanRange("user029:item0050", 16, 0, 0, iter);
+			ASSERT_EQ(int, retval, E_ok, "rdb scan range to the end");
+			ASSERT_EQ(int, count(iter), NITEMS / 2, "keys from user029:item0050");
+
+			retval = rdb.scanPrefix("nouser", 6, iter);
+			ASSERT_EQ(int, retval, E_ok, "rdb scan prefix: nouser");
+			ASSERT_EQ(int, count(iter), 0, "keys with prefix nouser");
+
+			retval = rdb.scanRange(0, 0, 0, 0, iter);
+			ASSERT_EQ(int, retval, E_ok, "rdb scan all");
+			ASSERT_EQ(bool, (count(iter) >= NKEYS), true, "all keys in order");
+
+			for (int i = 7 * NITEMS; i < 8 * NITEMS; i += 2) {
+				makeKey(key, i);
+				retval = rdb.remove(key, (int)strlen(key));
+				m_strm << "rdb remove: key = " << key;
+				ASSERT_EQ(int, retval, E_ok, m_strm.str());
+				m_strm.str("");
+			}
+
+			retval = rdb.scanPrefix("user007:", 8, iter);
+			ASSERT_EQ(int, retval, E_ok, "rdb scan prefix after remove");
+			ASSERT_EQ(int, count(iter), NITEMS / 2, "keys with prefix user007: after remove");
+
+			retval = rdb.close();
+			ASSERT_EQ(int, retval, E_ok, "rdb close");
+		}
+
+		{
+			// the index persists across opens
+			Rdb rdb(dbPath, dbName, 1024, 101, options);
+
+			int retval = rdb.open();
+			ASSERT_EQ(int, retval, E_ok, "rdb reopen");
+
+			retval = rdb.scanPrefix("user007:", 8, iter);
+			ASSERT_EQ(int, retval, E_ok, "rdb scan prefix after reopen");
+			ASSERT_EQ(int, count(iter), NITEMS / 2, "keys with prefix user007: after reopen");
+
+			retval = rdb.close();
+			ASSERT_EQ(int, retval, E_ok, "rdb close");
+		}
+
+		{
+			// updates without the index make it go away
+			RdbOptions noindex(options);
+			noindex.orderedIndex(false);
+			Rdb rdb(dbPath, dbName, 1024, 101, noindex);
+
+			int retval = rdb.open();
+			ASSERT_EQ(int, retval, E_ok, "rdb open without ordered index");
+
+			retval = rdb.scanPrefix("user007:", 8, iter);
+			ASSERT_EQ(int, retval, E_invalid_state, "rdb scan prefix without ordered index");
+
+			makeKey(key, 7 * NITEMS + 1);
+			retval = rdb.remove(key, (int)strlen(key));
+			ASSERT_EQ(int, retval, E_ok, "rdb remove without ordered index");
+
+			retval = rdb.close();
+			ASSERT_EQ(int, retval, E_ok, "rdb close");
+		}
+
+		{
+			// the index is rebuilt from the key file
+			Rdb rdb(dbPath, dbName, 1024, 101, options);
+
+			int retval = rdb.open();
+			ASSERT_EQ(int, retval, E_ok, "rdb open to rebuild ordered index");
+
+			retval = rdb.scanPrefix("user007:", 8, iter);
+			ASSERT_EQ(int, retval, E_ok, "rdb scan prefix after rebuild");
+			ASSERT_EQ(int, count(iter), NITEMS / 2 - 1, "keys with prefix user007: after rebuild");
+
+			for (int i = 0; i < NKEYS; ++i) {
+				if ((i >= 7 * NITEMS) && (i < 8 * NITEMS) && (((i % 2) == 0) || (i == 7 * NITEMS + 1)))
+					continue;
+				makeKey(key, i);
+				retval = rdb.remove(key, (int)strlen(key));
+				m_strm << "rdb remove: key = " << key;
+				ASSERT_EQ(int, retval, E_ok, m_strm.str());
+				m_strm.str("");
+			}
+
+			retval = rdb.scanPrefix("user", 4, iter);
+			ASSERT_EQ(int, retval, E_ok, "rdb scan prefix after removing all");
+			ASSERT_EQ(int, count(iter), 0, "keys with prefix user after removing all");
+
+			retval = rdb.close();
+			ASSERT_EQ(int, retval, E_ok, "rdb close");
+		}
+
+		return true;
+	}
+};
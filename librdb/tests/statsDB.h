@@ -0,0 +1,123 @@
+#include <numeric>
+#include "error.h"
+#include "rdb.h"
+#include "dbtest.h"
+
+class StatsDB : public snf::tf::test
+{
+private:
+	static const int NKEYS = 100;
+
+public:
+	StatsDB() : snf::tf::test() {}
+	~StatsDB() {}
+
+	virtual const char *name() const
+	{
+		return "StatsDB";
+	}
+
+	virtual const char *description() const
+	{
+		return "Gets the database statistics";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		ASSERT_NE(const snf::config *, conf, nullptr, "check config");
+		const char *dbPath = conf->get("DBPATH");
+		ASSERT_NE(const char *, dbPath, nullptr, "get DBPATH from config");
+		const char *dbName = conf->get("DBNAME");
+		ASSERT_NE(const char *, dbName, nullptr, "get DBNAME from config");
+
+		char        key[32];
+		char        buf[32];
+		int         buflen;
+		int         retval;
+		RdbStats    before;
+		RdbStats    after;
+
+		RdbOptions options;
+		options.syncDataFile(false);
+		Rdb rdb(dbPath, dbName, 1024, 11, options);
+
+		retval = rdb.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb open");
+
+		retval = rdb.getStats(before, true);
+		ASSERT_EQ(int, retval, E_ok, "rdb get stats");
+		ASSERT_EQ(int64_t, before.sets.count, 0, "no sets yet");
+
+		for (int i = 0; i < NKEYS; ++i) {
+			TestKey(key, "stat", i);
+			retval = rdb.set(key, (int)strlen(key), key, (int)strlen(key));
+			m_strm << "rdb set: key = " << key;
+			ASSERT_EQ(int, retval, E_ok, m_strm.str());
+			m_strm.str("");
+		}
+
+		for (int i = 0; i < NKEYS; ++i) {
+			TestKey(key, "stat", i);
+			buflen = (int)sizeof(buf);
+			retval = rdb.get(key, (int)strlen(key), buf, &buflen);
+			m_strm << "rdb get: key = " << key;
+			ASSERT_EQ(int, retval, E_ok, m_strm.str());
+			m_strm.str("");
+		}
+
+		retval = rdb.getStats(after, true);
+		ASSERT_EQ(int, retval, E_ok, "rdb get stats");
+
+		ASSERT_EQ(int64_t, after.sets.count, NKEYS, "set count");
+		ASSERT_EQ(int64_t, after.gets.count, NKEYS, "get count");
+		ASSERT_EQ(int64_t, after.removes.count, 0, "remove count");
+		ASSERT_EQ(int64_t,
+			std::accumulate(after.gets.buckets, after.gets.buckets + RDB_LATENCY_BUCKETS, int64_t(0)),
+			NKEYS, "get latency histogram");
+		ASSERT_EQ(bool, (after.gets.percentile(50) <= after.gets.percentile(100)), true,
+			"get latency percentiles");
+
+		ASSERT_EQ(int64_t, after.keys - before.keys, NKEYS, "keys added");
+		ASSERT_EQ(bool, (after.keyPages > 0), true, "key pages in use");
+		ASSERT_EQ(int64_t,
+			std::accumulate(after.chainLengths.begin(), after.chainLengths.end(), int64_t(0)),
+			after.htSize, "chain length distribution covers the hash table");
+		ASSERT_EQ(bool, (after.maxChainLength > 0), true, "longest chain");
+
+		ASSERT_EQ(bool, (after.cacheHits > before.cacheHits), true, "cache hits");
+		ASSERT_EQ(bool, (after.cachePages > 0), true, "cache pages");
+		ASSERT_EQ(bool, (after.keyPageWrites > before.keyPageWrites), true, "key page writes");
+		ASSERT_EQ(bool, (after.valuePageWrites - before.valuePageWrites >= NKEYS), true,
+			"value page writes");
+		ASSERT_EQ(bool, (after.valuePageReads - before.valuePageReads >= NKEYS), true,
+			"value page reads");
+		ASSERT_EQ(int64_t, after.valuePageSyncs, 0, "value file is not synced");
+
+		int64_t freeValuePages = after.freeValuePages;
+
+		for (int i = 0; i < NKEYS; ++i) {
+			TestKey(key, "stat", i);
+			retval = rdb.remove(key, (int)strlen(key));
+			m_strm << "rdb remove: key = " << key;
+			ASSERT_EQ(int, retval, E_ok, m_strm.str());
+			m_strm.str("");
+		}
+
+		retval = rdb.getStats(after);
+		ASSERT_EQ(int, retval, E_ok, "rdb get stats");
+		ASSERT_EQ(int64_t, after.removes.count, NKEYS, "remove count");
+		ASSERT_EQ(bool, (after.freeValuePages - freeValuePages >= NKEYS), true,
+			"value pages freed");
+		ASSERT_EQ(int64_t, after.keyPages, 0, "key pages not scanned");
+
+		retval = rdb.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb close");
+
+		retval = rdb.getStats(after);
+		ASSERT_EQ(int, retval, E_ok, "rdb get stats after close");
+		ASSERT_EQ(int64_t, after.gets.count, NKEYS, "get count after close");
+		ASSERT_EQ(int64_t, after.cacheHits, 0, "no cache after close");
+
+		return true;
+	}
+};
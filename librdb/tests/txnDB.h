@@ -0,0 +1,236 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "error.h"
+#include "rdb.h"
+#include "dbtest.h"
+
+class TransactionDB : public snf::tf::test
+{
+private:
+	static const int NACCOUNTS = 8;
+	static const int BALANCE = 100;
+	static const int NTHREADS = 4;
+	static const int NXFERS = 200;
+
+	static int getBalance(Rdb::Transaction &txn, int i, int *balance)
+	{
+		char    key[32];
+		char    buf[32];
+		int     buflen = (int)(sizeof(buf) - 1);
+
+		TestKey(key, "acct", i);
+		int retval = txn.get(key, (int)strlen(key), buf, &buflen);
+		if (retval == E_ok) {
+			buf[buflen] = '\0';
+			*balance = atoi(buf);
+		}
+		return retval;
+	}
+
+	static int setBalance(Rdb::Transaction &txn, int i, int balance)
+	{
+		char    key[32];
+		char    buf[32];
+
+		TestKey(key, "acct", i);
+		snprintf(buf, sizeof(buf), "%d", balance);
+		return txn.set(key, (int)strlen(key), buf, (int)strlen(buf));
+	}
+
+	static void transferer(Rdb *rdb, int seed, std::atomic<int> *failures)
+	{
+		Rdb::Transaction txn(rdb);
+
+		for (int i = 0; i < NXFERS; ++i) {
+			int from = (seed + i) % NACCOUNTS;
+			int to = (seed + i * 3 + 1) % NACCOUNTS;
+			if (from == to)
+				to = (to + 1) % NACCOUNTS;
+
+			int retval;
+			do {
+				int fbal = 0;
+				int tbal = 0;
+
+				retval = getBalance(txn, from, &fbal);
+				if (retval == E_ok)
+					retval = getBalance(txn, to, &tbal);
+				if (retval == E_ok)
+					retval = setBalance(txn, from, fbal - 1);
+				if (retval == E_ok)
+					retval = setBalance(txn, to, tbal + 1);
+				if (retval == E_ok)
+					retval = txn.commit();
+				else
+					txn.rollback();
+			} while (retval == E_try_again);
+
+			if (retval != E_ok)
+				(*failures)++;
+		}
+	}
+
+public:
+	TransactionDB() : snf::tf::test() {}
+	~TransactionDB() {}
+
+	virtual const char *name() const
+	{
+		return "TransactionDB";
+	}
+
+	virtual const char *description() const
+	{
+		return "Commits multi-key transactions";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		ASSERT_NE(const snf::config *, conf, nullptr, "check config");
+		const char *dbPath = conf->get("DBPATH");
+		ASSERT_NE(const char *, dbPath, nullptr, "get DBPATH from config");
+		const char *dbName = conf->get("DBNAME");
+		ASSERT_NE(const char *, dbName, nullptr, "get DBNAME from config");
+
+		char    key[32];
+		char    buf[32];
+		int     buflen;
+		int     balance;
+		int     retval;
+
+		RdbOptions options;
+		options.syncDataFile(false);
+		Rdb rdb(dbPath, dbName, 1024, 11, options);
+
+		retval = rdb.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb open");
+
+		Rdb::Transaction txn(&rdb);
+
+		for (int i = 0; i < NACCOUNTS; ++i) {
+			retval = setBalance(txn, i, BALANCE);
+			ASSERT_EQ(int, retval, E_ok, "txn set");
+		}
+
+		retval = getBalance(txn, 0, &balance);
+		ASSERT_EQ(int, retval, E_ok, "txn get: own write");
+		ASSERT_EQ(int, balance, BALANCE, "txn get: own write value");
+
+		TestKey(key, "acct", 0);
+		buflen = (int)sizeof(buf);
+		retval = rdb.get(key, (int)strlen(key), buf, &buflen);
+		ASSERT_EQ(int, retval, E_not_found, "rdb get: not committed yet");
+
+		retval = txn.commit();
+		ASSERT_EQ(int, retval, E_ok, "txn commit");
+
+		buflen = (int)(sizeof(buf) - 1);
+		retval = rdb.get(key, (int)strlen(key), buf, &buflen);
+		ASSERT_EQ(int, retval, E_ok, "rdb get: committed");
+		buf[buflen] = '\0';
+		ASSERT_EQ(int, atoi(buf), BALANCE, "rdb get: committed value");
+
+		// A key read by the transaction is changed by
+		// someone else before the commit
+		retval = getBalance(txn, 0, &balance);
+		ASSERT_EQ(int, retval, E_ok, "txn get");
+		retval = setBalance(txn, 1, balance + 1);
+		ASSERT_EQ(int, retval, E_ok, "txn set");
+
+		retval = rdb.set(key, (int)strlen(key), "42", 2);
+		ASSERT_EQ(int, retval, E_ok, "rdb set: conflicting write");
+
+		retval = txn.commit();
+		ASSERT_EQ(int, retval, E_try_again, "txn commit: conflict");
+
+		retval = rdb.set(key, (int)strlen(key), "100", 3);
+		ASSERT_EQ(int, retval, E_ok, "rdb set: restore balance");
+
+		TestKey(key, "acct", 1);
+		buflen = (int)(sizeof(buf) - 1);
+		retval = rdb.get(key, (int)strlen(key), buf, &buflen);
+		ASSERT_EQ(int, retval, E_ok, "rdb get: after conflict");
+		buf[buflen] = '\0';
+		ASSERT_EQ(int, atoi(buf), BALANCE, "rdb get: conflicting txn not applied");
+
+		retval = txn.remove("txnabsent", 9);
+		ASSERT_EQ(int, retval, E_ok, "txn remove");
+		buflen = (int)sizeof(buf);
+		retval = txn.get("txnabsent", 9, buf, &buflen);
+		ASSERT_EQ(int, retval, E_not_found, "txn get: removed");
+		txn.rollback();
+
+		std::atomic<int> failures(0);
+		std::vector<std::thread> threads;
+		for (int i = 0; i < NTHREADS; ++i)
+			threads.push_back(std::thread(transferer, &rdb, i, &failures));
+		for (std::thread &t : threads)
+			t.join();
+
+		ASSERT_EQ(int, failures, 0, "concurrent transfers");
+
+		int total = 0;
+		for (int i = 0; i < NACCOUNTS; ++i) {
+			retval = getBalance(txn, i, &balance);
+			ASSERT_EQ(int, retval, E_ok, "txn get: balance");
+			total += balance;
+		}
+		ASSERT_EQ(int, txn.commit(), E_ok, "txn commit: reads only");
+		ASSERT_EQ(int, total, NACCOUNTS * BALANCE, "total balance");
+
+		retval = rdb.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb close");
+
+		// A transaction logged but not applied before
+		// a crash is applied on open
+		std::string txnPath(dbPath);
+		txnPath += snf::pathsep();
+		txnPath += dbName;
+		txnPath += ".txn";
+
+		TxnLog txnLog(txnPath.c_str(), 0022);
+		retval = txnLog.open();
+		ASSERT_EQ(int, retval, E_ok, "txn log open");
+
+		txn_writes_t writes;
+		writes["txnpending"].remove = false;
+		writes["txnpending"].value = "logged";
+		TestKey(key, "acct", 0);
+		writes[key].remove = true;
+
+		int slot = -1;
+		retval = txnLog.write(writes, &slot);
+		ASSERT_EQ(int, retval, E_ok, "txn log write");
+		txnLog.close();
+
+		retval = rdb.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb open: replay");
+
+		buflen = (int)(sizeof(buf) - 1);
+		retval = rdb.get("txnpending", 10, buf, &buflen);
+		ASSERT_EQ(int, retval, E_ok, "rdb get: replayed set");
+		buf[buflen] = '\0';
+		ASSERT_EQ(int, strcmp(buf, "logged"), 0, "rdb get: replayed value");
+
+		buflen = (int)sizeof(buf);
+		retval = rdb.get(key, (int)strlen(key), buf, &buflen);
+		ASSERT_EQ(int, retval, E_not_found, "rdb get: replayed remove");
+
+		retval = rdb.remove("txnpending", 10);
+		ASSERT_EQ(int, retval, E_ok, "rdb remove: key = txnpending");
+
+		for (int i = 1; i < NACCOUNTS; ++i) {
+			TestKey(key, "acct", i);
+			retval = rdb.remove(key, (int)strlen(key));
+			m_strm << "rdb remove: key = " << key;
+			ASSERT_EQ(int, retval, E_ok, m_strm.str());
+			m_strm.str("");
+		}
+
+		retval = rdb.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb close");
+
+		return true;
+	}
+};
@@ -0,0 +1,141 @@
+#include <chrono>
+#include <thread>
+#include "error.h"
+#include "filesystem.h"
+#include "rdb.h"
+#include "dbtest.h"
+
+class WarmDB : public snf::tf::test
+{
+private:
+	static const int NKEYS = 200;
+
+	/*
+	 * Waits for the warm-up to read the pages into the cache.
+	 */
+	static int64_t waitForWarmUp(Rdb &rdb, int64_t pages)
+	{
+		RdbStats stats;
+
+		for (int i = 0; i < 500; ++i) {
+			if ((rdb.getStats(stats) == E_ok) && (stats.cacheMisses >= pages))
+				break;
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+
+		return stats.cacheMisses;
+	}
+
+	bool getAll(Rdb &rdb)
+	{
+		char    key[32];
+		char    buf[32];
+		int     buflen;
+
+		for (int i = 0; i < NKEYS; ++i) {
+			TestKey(key, "warm", i);
+			buflen = (int)sizeof(buf);
+			int retval = rdb.get(key, (int)strlen(key), buf, &buflen);
+			m_strm << "rdb get: key = " << key;
+			ASSERT_EQ(int, retval, E_ok, m_strm.str());
+			ASSERT_EQ(std::string, std::string(buf, buflen), std::string(key), m_strm.str());
+			m_strm.str("");
+		}
+
+		return true;
+	}
+
+public:
+	WarmDB() : snf::tf::test() {}
+	~WarmDB() {}
+
+	virtual const char *name() const
+	{
+		return "WarmDB";
+	}
+
+	virtual const char *description() const
+	{
+		return "Warms up the key page cache on open";
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		ASSERT_NE(const snf::config *, conf, nullptr, "check config");
+		const char *dbPath = conf->get("DBPATH");
+		ASSERT_NE(const char *, dbPath, nullptr, "get DBPATH from config");
+
+		char        key[32];
+		char        warmPath[MAXPATHLEN + 1];
+		int         retval;
+		RdbStats    stats;
+
+		snprintf(warmPath, MAXPATHLEN, "%s%cwarmdb.warm", dbPath, snf::pathsep());
+
+		RdbOptions options;
+		options.syncDataFile(false);
+		Rdb rdb(dbPath, "warmdb", 1024, 101, options);
+
+		retval = rdb.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb open");
+
+		for (int i = 0; i < NKEYS; ++i) {
+			TestKey(key, "warm", i);
+			retval = rdb.set(key, (int)strlen(key), key, (int)strlen(key));
+			m_strm << "rdb set: key = " << key;
+			ASSERT_EQ(int, retval, E_ok, m_strm.str());
+			m_strm.str("");
+		}
+
+		retval = rdb.getStats(stats);
+		ASSERT_EQ(int, retval, E_ok, "rdb get stats");
+		ASSERT_EQ(int64_t, stats.cacheEvictions, 0, "no evictions");
+
+		int64_t pages = stats.cachePages - stats.cacheFreePages;
+		ASSERT_NE(int64_t, pages, 0, "pages in the cache");
+
+		retval = rdb.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb close");
+		ASSERT_EQ(bool, snf::fs::exists(warmPath), true, "warm-up manifest written");
+
+		retval = rdb.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb reopen");
+
+		ASSERT_EQ(int64_t, waitForWarmUp(rdb, pages), pages, "pages warmed up");
+
+		if (!getAll(rdb))
+			return false;
+
+		retval = rdb.getStats(stats);
+		ASSERT_EQ(int, retval, E_ok, "rdb get stats");
+		ASSERT_EQ(int64_t, stats.cacheMisses, pages, "no misses after the warm-up");
+
+		retval = rdb.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb close");
+
+		// warm-up disabled
+		options.warmCache(false);
+		Rdb cold(dbPath, "warmdb", 1024, 101, options);
+
+		retval = cold.open();
+		ASSERT_EQ(int, retval, E_ok, "rdb open without warm-up");
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		retval = cold.getStats(stats);
+		ASSERT_EQ(int, retval, E_ok, "rdb get stats");
+		ASSERT_EQ(int64_t, stats.cacheMisses, 0, "nothing warmed up");
+
+		if (!getAll(cold))
+			return false;
+
+		for (int i = 0; i < NKEYS; ++i) {
+			TestKey(key, "warm", i);
+			cold.remove(key, (int)strlen(key));
+		}
+
+		retval = cold.close();
+		ASSERT_EQ(int, retval, E_ok, "rdb close");
+
+		return true;
+	}
+};
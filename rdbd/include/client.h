@@ -0,0 +1,110 @@
+#ifndef _SNF_RDBD_CLIENT_H_
+#define _SNF_RDBD_CLIENT_H_
+
+#include "sock.h"
+#include "error.h"
+#include "proto.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace snf {
+namespace rdbd {
+
+/*
+ * Result of an operation: the status (E_ok or -ve error code)
+ * and the value, for get and multi_get.
+ */
+struct result
+{
+	int         status = E_ok;
+	std::string value;
+};
+
+/*
+ * Request of a pipeline.
+ */
+struct request
+{
+	opcode                      op = opcode::get;
+	std::string                 key;
+	std::string                 value;      // set
+	uint32_t                    ttl = 0;    // set, in seconds
+	std::vector<std::string>    keys;       // multi_get
+
+	static request get(const std::string &k)
+	{
+		request r;
+		r.op = opcode::get;
+		r.key = k;
+		return r;
+	}
+
+	static request set(const std::string &k, const std::string &v, uint32_t ttl = 0)
+	{
+		request r;
+		r.op = opcode::set;
+		r.key = k;
+		r.value = v;
+		r.ttl = ttl;
+		return r;
+	}
+
+	static request remove(const std::string &k)
+	{
+		request r;
+		r.op = opcode::remove;
+		r.key = k;
+		return r;
+	}
+
+	static request multi_get(const std::vector<std::string> &ks)
+	{
+		request r;
+		r.op = opcode::multi_get;
+		r.keys = ks;
+		return r;
+	}
+};
+
+/*
+ * rdbd client. A client is a single connection and is not
+ * thread safe; use a client per thread.
+ */
+class client
+{
+private:
+	std::unique_ptr<snf::net::socket>   m_sock;
+	uint32_t                            m_id = 0;
+	std::string                         m_out;
+	std::vector<char>                   m_in;
+
+	int encode(const request &);
+	int send();
+	int receive(uint32_t, opcode, std::vector<result> &);
+
+public:
+	client() {}
+	client(const client &) = delete;
+	client(client &&) = delete;
+
+	const client &operator=(const client &) = delete;
+	client &operator=(client &&) = delete;
+
+	~client() { close(); }
+
+	int connect(const std::string &, in_port_t, int to = 0);
+	void close();
+	bool is_connected() const { return m_sock != nullptr; }
+
+	int get(const char *, int, char *, int *);
+	int set(const char *, int, const char *, int, uint32_t ttl = 0);
+	int remove(const char *, int);
+	int multi_get(const std::vector<std::string> &, std::vector<result> &);
+	int pipeline(const std::vector<request> &, std::vector<std::vector<result>> &);
+};
+
+} // namespace rdbd
+} // namespace snf
+
+#endif // _SNF_RDBD_CLIENT_H_
@@ -0,0 +1,69 @@
+#ifndef _SNF_RDBD_FOLLOWER_H_
+#define _SNF_RDBD_FOLLOWER_H_
+
+#include "sock.h"
+#include "rdb.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace snf {
+namespace rdbd {
+
+/*
+ * Follower of an rdbd primary, i.e. an rdbd server whose
+ * database has the change feed enabled (see librdb).
+ *
+ * A follower starts from a snapshot of the primary database,
+ * a checkpoint sent over the connection (see snapshot()). The
+ * follower then asks the primary for the changes following
+ * the last one in the snapshot, and applies them to its own
+ * database as they arrive. The primary sends a heartbeat when
+ * there is no change, so a primary gone silent is noticed;
+ * the follower connects again and continues from the last
+ * change applied.
+ *
+ * A follower that falls behind by more than the change feed
+ * of the primary holds, stops with E_not_found (see status());
+ * it has to start over from a new snapshot.
+ */
+class follower
+{
+private:
+	Rdb                                 *m_rdb = nullptr;
+	std::string                         m_host;
+	in_port_t                           m_port = 0;
+	std::thread                         m_thread;
+	std::mutex                          m_lock;
+	std::condition_variable             m_cond;
+	bool                                m_stop = false;
+	int                                 m_status = E_ok;
+
+	static snf::net::socket *connect(const std::string &, in_port_t);
+	int follow();
+	void run();
+
+public:
+	follower() {}
+	follower(const follower &) = delete;
+	follower(follower &&) = delete;
+
+	const follower &operator=(const follower &) = delete;
+	follower &operator=(follower &&) = delete;
+
+	~follower() { stop(); }
+
+	static int snapshot(const std::string &, in_port_t, const std::string &, const std::string &);
+
+	int start(Rdb *, const std::string &, in_port_t);
+	int stop();
+	int status();
+	int wait_for(uint64_t, int);
+};
+
+} // namespace rdbd
+} // namespace snf
+
+#endif // _SNF_RDBD_FOLLOWER_H_
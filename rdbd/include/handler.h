@@ -0,0 +1,63 @@
+#ifndef _SNF_RDBD_HANDLER_H_
+#define _SNF_RDBD_HANDLER_H_
+
+#include "sock.h"
+#include "reactor.h"
+
+namespace snf {
+namespace rdbd {
+
+class server;
+
+void ship_changes(server *, snf::net::socket *, uint32_t, uint64_t);
+
+class accept_handler : public snf::net::handler
+{
+protected:
+	server                              &m_server;
+	std::unique_ptr<snf::net::socket>   m_sock;
+
+public:
+	accept_handler(server &srvr, snf::net::socket *s)
+		: m_server(srvr)
+		, m_sock(s)
+	{
+	}
+
+	virtual ~accept_handler() {}
+
+	virtual const char *name() const
+	{
+		return "rdbd-accept-handler";
+	}
+
+	virtual bool operator()(sock_t, snf::net::event) override;
+};
+
+class read_handler : public snf::net::handler
+{
+protected:
+	server                              &m_server;
+	std::unique_ptr<snf::net::socket>   m_sock;
+
+public:
+	read_handler(server &srvr, snf::net::socket *s)
+		: m_server(srvr)
+		, m_sock(s)
+	{
+	}
+
+	virtual ~read_handler() {}
+
+	virtual const char *name() const
+	{
+		return "rdbd-read-handler";
+	}
+
+	virtual bool operator()(sock_t, snf::net::event) override;
+};
+
+} // namespace rdbd
+} // namespace snf
+
+#endif // _SNF_RDBD_HANDLER_H_
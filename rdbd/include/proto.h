@@ -0,0 +1,154 @@
+#ifndef _SNF_RDBD_PROTO_H_
+#define _SNF_RDBD_PROTO_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "dbstruct.h"
+
+namespace snf {
+namespace rdbd {
+
+/*
+ * rdbd protocol. Every request and response is a frame made
+ * of a 12-byte header followed by the payload; the integers
+ * are in network byte order.
+ *
+ * header:
+ *   u32 length  - payload length
+ *   u32 id      - request ID, returned in the response
+ *   u8  op      - operation
+ *   u8  flags   - unused, 0
+ *   u16 count   - keys in the request, results in the response
+ *
+ * request payload:
+ *   get         - key
+ *   set         - key, value, u32 ttl (seconds, 0 for none)
+ *   remove      - key
+ *   multi_get   - count keys
+ *
+ * response payload: count results, each one being
+ *   i16 status  - E_ok or -ve error code
+ *   value       - get and multi_get only, if status is E_ok
+ *
+ * where key and value are u16 length followed by the bytes.
+ *
+ * A client can send any number of requests without waiting
+ * for the responses (pipelining); the responses come back in
+ * the order of the requests.
+ *
+ * Replication (see follower.h):
+ *   snapshot    - request: no payload
+ *                 response: i16 status and, for each of the
+ *                 count files of a checkpoint of the database,
+ *                 the file suffix and the u64 file size; the
+ *                 file contents follow the frame, in order
+ *   follow      - request: u64 sequence of the first change
+ *                 response: a stream of frames, with the ID of
+ *                 the request, of i16 status and count changes,
+ *                 each being
+ *                   u64 seq, u16 op, key, value, u32 expiry
+ *                 A frame with no change is a heartbeat. The
+ *                 stream ends with a frame with an error
+ *                 status, e.g. E_not_found if the changes
+ *                 asked for are no longer in the change feed.
+ */
+
+constexpr int HEADER_SIZE = 12;
+constexpr int MAX_PAYLOAD = 1 << 20;
+constexpr int MAX_MULTI_GET = 1024;
+constexpr int MAX_CHANGES = 1024;
+
+/*
+ * Suffixes of the database files sent in response to snapshot.
+ */
+constexpr const char *SNAPSHOT_FILES[] = { ".attr", ".fdp", ".idx", ".db", ".seq" };
+
+enum class opcode : uint8_t
+{
+	get = 1,
+	set = 2,
+	remove = 3,
+	multi_get = 4,
+	snapshot = 5,
+	follow = 6
+};
+
+inline bool
+valid_opcode(uint8_t op)
+{
+	return (op >= static_cast<uint8_t>(opcode::get)) &&
+		(op <= static_cast<uint8_t>(opcode::follow));
+}
+
+struct header
+{
+	uint32_t    length = 0;
+	uint32_t    id = 0;
+	opcode      op = opcode::get;
+	uint8_t     flags = 0;
+	uint16_t    count = 0;
+};
+
+/*
+ * Appends the protocol fields to a buffer.
+ */
+class frame_writer
+{
+private:
+	std::string &m_buf;
+	size_t      m_start;
+
+public:
+	/*
+	 * Starts a frame at the end of the buffer.
+	 */
+	frame_writer(std::string &buf, uint32_t id, opcode op, uint16_t count);
+
+	void put_u16(uint16_t);
+	void put_u32(uint32_t);
+	void put_u64(uint64_t);
+	void put_bytes(const char *, int);
+	void put_change(const change_rec_t &);
+
+	void put_bytes(const std::string &s)
+	{
+		put_bytes(s.data(), static_cast<int>(s.size()));
+	}
+
+	void finish();
+};
+
+/*
+ * Reads the protocol fields from a payload. A read past the
+ * end of the payload fails (returns false).
+ */
+class frame_reader
+{
+private:
+	const char  *m_cur;
+	const char  *m_end;
+
+public:
+	frame_reader(const char *buf, int len)
+		: m_cur(buf)
+		, m_end(buf + len)
+	{
+	}
+
+	bool get_u16(uint16_t *);
+	bool get_u32(uint32_t *);
+	bool get_u64(uint64_t *);
+	bool get_bytes(const char **, int *);
+	bool get_change(change_rec_t *);
+
+	bool at_end() const { return m_cur == m_end; }
+};
+
+void encode_header(char *, const header &);
+bool decode_header(const char *, header &);
+
+} // namespace rdbd
+} // namespace snf
+
+#endif // _SNF_RDBD_PROTO_H_
@@ -0,0 +1,85 @@
+#ifndef _SNF_RDBD_SERVER_H_
+#define _SNF_RDBD_SERVER_H_
+
+#include "sock.h"
+#include "reactor.h"
+#include "thrdpool.h"
+#include "rdb.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+namespace snf {
+namespace rdbd {
+
+/*
+ * rdbd server. Serves an open Rdb over the rdbd protocol
+ * (see proto.h). The reactor waits for the connections to
+ * become readable; a readable connection is then handed over
+ * to the thread pool, which executes all the requests already
+ * received on the connection, sends the responses back in one
+ * write and registers the connection with the reactor again.
+ *
+ * A connection that asks to follow the changes (see
+ * follower.h) is handed over to a thread of its own, which
+ * ships the change feed of the database for as long as the
+ * follower is connected.
+ */
+class server
+{
+private:
+	Rdb                                 *m_rdb = nullptr;
+	snf::net::reactor                   m_reactor;
+	std::unique_ptr<snf::thread_pool>   m_thrdpool;
+	in_port_t                           m_port = 0;
+	bool                                m_started = false;
+	bool                                m_stopped = false;
+	bool                                m_read_only = false;
+	std::atomic<bool>                   m_stopping { false };
+	std::atomic<unsigned>               m_snapshots { 0 };
+	int                                 m_shippers = 0;
+	std::mutex                          m_lock;
+	std::condition_variable             m_cond;
+
+	snf::net::socket *setup_socket(in_port_t);
+
+public:
+	server() {}
+	server(const server &) = delete;
+	server(server &&) = delete;
+
+	const server &operator=(const server &) = delete;
+	server &operator=(server &&) = delete;
+
+	~server() { stop(); }
+
+	int start(Rdb *, in_port_t, int nthreads = 4);
+	int stop();
+	int add_follower(snf::net::socket *, uint32_t, uint64_t);
+
+	/*
+	 * Serves reads only, as a follower does; must be set
+	 * before the server is started.
+	 */
+	void read_only(bool ro) { m_read_only = ro; }
+	bool read_only() const { return m_read_only; }
+
+	bool stopping() const { return m_stopping; }
+	unsigned next_snapshot() { return ++m_snapshots; }
+
+	/*
+	 * Gets the port the server is listening on; useful when
+	 * the server is started on an ephemeral port (0).
+	 */
+	in_port_t port() const { return m_port; }
+
+	Rdb *db() { return m_rdb; }
+	snf::net::reactor &reactor() { return m_reactor; }
+	snf::thread_pool *thread_pool() { return m_thrdpool.get(); }
+};
+
+} // namespace rdbd
+} // namespace snf
+
+#endif // _SNF_RDBD_SERVER_H_
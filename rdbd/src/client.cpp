@@ -0,0 +1,348 @@
+#include "client.h"
+#include "logmgr.h"
+#include <climits>
+
+namespace snf {
+namespace rdbd {
+
+/**
+ * Connects to the rdbd server.
+ *
+ * @param [in] host - server host.
+ * @param [in] port - server port.
+ * @param [in] to   - send/receive timeout in milliseconds,
+ *                    0 to wait for ever.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+client::connect(const std::string &host, in_port_t port, int to)
+{
+	close();
+
+	try {
+		std::unique_ptr<snf::net::socket> s(
+			DBG_NEW snf::net::socket(AF_INET, snf::net::socket_type::tcp));
+		s->tcpnodelay(true);
+		s->connect(AF_INET, host, port);
+		if (to > 0) {
+			s->rcvtimeout(to);
+			s->sndtimeout(to);
+		}
+		m_sock = std::move(s);
+		return E_ok;
+	} catch (std::system_error &ex) {
+		ERROR_STRM("client", ex.code().value())
+			<< ex.what()
+			<< snf::log::record::endl;
+		return E_connect_failed;
+	}
+}
+
+/*
+ * Closes the connection. Any pending response is lost.
+ */
+void
+client::close()
+{
+	if (m_sock) {
+		m_sock->close();
+		m_sock.reset();
+	}
+	m_out.clear();
+}
+
+/*
+ * Appends the request frame to the output buffer.
+ */
+int
+client::encode(const request &req)
+{
+	uint32_t id = ++m_id;
+
+	switch (req.op) {
+		case opcode::get:
+		case opcode::remove: {
+			if (req.key.size() > UINT16_MAX)
+				return E_invalid_arg;
+
+			frame_writer writer(m_out, id, req.op, 1);
+			writer.put_bytes(req.key);
+			writer.finish();
+			break;
+		}
+
+		case opcode::set: {
+			if ((req.key.size() > UINT16_MAX) || (req.value.size() > UINT16_MAX))
+				return E_invalid_arg;
+
+			frame_writer writer(m_out, id, req.op, 1);
+			writer.put_bytes(req.key);
+			writer.put_bytes(req.value);
+			writer.put_u32(req.ttl);
+			writer.finish();
+			break;
+		}
+
+		case opcode::multi_get: {
+			if (req.keys.empty() || (req.keys.size() > MAX_MULTI_GET))
+				return E_invalid_arg;
+
+			frame_writer writer(m_out, id, req.op, static_cast<uint16_t>(req.keys.size()));
+			for (auto &k : req.keys) {
+				if (k.size() > UINT16_MAX)
+					return E_invalid_arg;
+				writer.put_bytes(k);
+			}
+			writer.finish();
+			break;
+		}
+
+		default:
+			return E_invalid_arg;
+	}
+
+	return E_ok;
+}
+
+/*
+ * Sends the buffered requests in one write.
+ */
+int
+client::send()
+{
+	int bwritten = 0;
+	int oserr = 0;
+
+	int retval = m_sock->writen(m_out.data(), static_cast<int>(m_out.size()), &bwritten,
+			snf::net::POLL_WAIT_FOREVER, &oserr);
+	m_out.clear();
+	return retval;
+}
+
+/*
+ * Receives the response to the request.
+ *
+ * @param [in]  id      - request ID.
+ * @param [in]  op      - request operation.
+ * @param [out] results - results in the response.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+client::receive(uint32_t id, opcode op, std::vector<result> &results)
+{
+	char    hbuf[HEADER_SIZE];
+	header  hdr;
+	int     bread = 0;
+	int     oserr = 0;
+	int     retval;
+
+	retval = m_sock->readn(hbuf, HEADER_SIZE, &bread, snf::net::POLL_WAIT_FOREVER, &oserr);
+	if (retval != E_ok)
+		return retval;
+	if (bread != HEADER_SIZE)
+		return E_connection_reset;
+
+	if (!decode_header(hbuf, hdr) || (hdr.id != id) || (hdr.op != op))
+		return E_mismatch;
+
+	m_in.resize(hdr.length);
+	if (hdr.length > 0) {
+		bread = 0;
+		retval = m_sock->readn(m_in.data(), static_cast<int>(hdr.length), &bread,
+				snf::net::POLL_WAIT_FOREVER, &oserr);
+		if (retval != E_ok)
+			return retval;
+		if (bread != static_cast<int>(hdr.length))
+			return E_connection_reset;
+	}
+
+	frame_reader reader(m_in.data(), static_cast<int>(hdr.length));
+	bool has_value = (op == opcode::get) || (op == opcode::multi_get);
+
+	results.resize(hdr.count);
+	for (auto &r : results) {
+		uint16_t status;
+		if (!reader.get_u16(&status))
+			return E_mismatch;
+
+		r.status = static_cast<int16_t>(status);
+		r.value.clear();
+		if (has_value && (r.status == E_ok)) {
+			const char *value;
+			int vlen;
+			if (!reader.get_bytes(&value, &vlen))
+				return E_mismatch;
+			r.value.assign(value, vlen);
+		}
+	}
+
+	return reader.at_end() ? E_ok : E_mismatch;
+}
+
+/**
+ * Sends the requests in one write and then reads the responses,
+ * without waiting for the response to a request before sending
+ * the next one. The connection is closed on a transport or
+ * protocol failure as the responses can no longer be matched
+ * with the requests.
+ *
+ * @param [in]  requests - requests to send.
+ * @param [out] results  - results of every request, in the
+ *                         order of the requests.
+ *
+ * @return E_ok on success, -ve error code on failure. The
+ * status of the individual operations is in the results.
+ */
+int
+client::pipeline(const std::vector<request> &requests, std::vector<std::vector<result>> &results)
+{
+	int retval;
+
+	if (!m_sock)
+		return E_invalid_state;
+
+	if (requests.empty())
+		return E_invalid_arg;
+
+	uint32_t first = m_id + 1;
+	for (auto &req : requests) {
+		retval = encode(req);
+		if (retval != E_ok) {
+			m_out.clear();
+			return retval;
+		}
+	}
+
+	retval = send();
+	if (retval == E_ok) {
+		results.resize(requests.size());
+		for (size_t i = 0; i < requests.size(); ++i) {
+			retval = receive(first + static_cast<uint32_t>(i), requests[i].op, results[i]);
+			if (retval != E_ok)
+				break;
+		}
+	}
+
+	if (retval != E_ok) {
+		ERROR_STRM("client")
+			<< "pipeline of " << requests.size()
+			<< " requests failed with status " << retval
+			<< snf::log::record::endl;
+		close();
+	}
+
+	return retval;
+}
+
+/**
+ * Gets the value of the key.
+ *
+ * @param [in]    key   - key.
+ * @param [in]    klen  - key length.
+ * @param [out]   value - buffer to copy the value to.
+ * @param [inout] vlen  - value buffer size on input, value
+ *                        length on output.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+client::get(const char *key, int klen, char *value, int *vlen)
+{
+	std::vector<std::vector<result>> results;
+
+	if ((key == nullptr) || (klen < 0) || (value == nullptr) || (vlen == nullptr))
+		return E_invalid_arg;
+
+	int retval = pipeline({ request::get(std::string(key, klen)) }, results);
+	if (retval != E_ok)
+		return retval;
+
+	const result &r = results[0][0];
+	if (r.status != E_ok)
+		return r.status;
+
+	if (static_cast<int>(r.value.size()) > *vlen)
+		return E_insufficient_buffer;
+
+	*vlen = static_cast<int>(r.value.size());
+	memcpy(value, r.value.data(), r.value.size());
+	return E_ok;
+}
+
+/**
+ * Sets the value of the key.
+ *
+ * @param [in] key   - key.
+ * @param [in] klen  - key length.
+ * @param [in] value - value.
+ * @param [in] vlen  - value length.
+ * @param [in] ttl   - time to live in seconds, 0 for none.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+client::set(const char *key, int klen, const char *value, int vlen, uint32_t ttl)
+{
+	std::vector<std::vector<result>> results;
+
+	if ((key == nullptr) || (klen < 0) || (value == nullptr) || (vlen < 0))
+		return E_invalid_arg;
+
+	int retval = pipeline(
+		{ request::set(std::string(key, klen), std::string(value, vlen), ttl) },
+		results);
+	if (retval != E_ok)
+		return retval;
+
+	return results[0][0].status;
+}
+
+/**
+ * Removes the key.
+ *
+ * @param [in] key  - key.
+ * @param [in] klen - key length.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+client::remove(const char *key, int klen)
+{
+	std::vector<std::vector<result>> results;
+
+	if ((key == nullptr) || (klen < 0))
+		return E_invalid_arg;
+
+	int retval = pipeline({ request::remove(std::string(key, klen)) }, results);
+	if (retval != E_ok)
+		return retval;
+
+	return results[0][0].status;
+}
+
+/**
+ * Gets the values of the keys in one request.
+ *
+ * @param [in]  keys    - keys, at most MAX_MULTI_GET.
+ * @param [out] results - result of every key.
+ *
+ * @return E_ok on success, -ve error code on failure. The
+ * status of the individual keys is in the results.
+ */
+int
+client::multi_get(const std::vector<std::string> &keys, std::vector<result> &results)
+{
+	std::vector<std::vector<result>> rv;
+
+	int retval = pipeline({ request::multi_get(keys) }, rv);
+	if (retval != E_ok)
+		return retval;
+
+	results = std::move(rv[0]);
+	return E_ok;
+}
+
+} // namespace rdbd
+} // namespace snf
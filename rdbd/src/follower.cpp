@@ -0,0 +1,539 @@
+#include "follower.h"
+#include "proto.h"
+#include "error.h"
+#include "file.h"
+#include "filesystem.h"
+#include "logmgr.h"
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+namespace snf {
+namespace rdbd {
+
+/*
+ * The primary checkpoints the database before sending the
+ * snapshot; it may take a while for a large database.
+ */
+constexpr int SNAPSHOT_TIMEOUT = 300000;
+
+/*
+ * The primary sends a heartbeat every second; a primary that
+ * is silent for this long is given up on.
+ */
+constexpr int FOLLOW_TIMEOUT = 10000;
+
+/*
+ * The stop request is checked this often while waiting for
+ * the changes.
+ */
+constexpr int POLL_INTERVAL = 200;
+
+/*
+ * Interval between the attempts to connect to the primary.
+ */
+constexpr int RETRY_INTERVAL = 1000;
+
+/*
+ * Snapshot files are received in chunks of this size.
+ */
+constexpr int SNAPSHOT_CHUNK = 64 * 1024;
+
+/*
+ * The database files derived from the ones in the snapshot;
+ * stale copies are removed before the snapshot is installed.
+ * The warm-up manifest (.warm) holds key page offsets of the
+ * database it was written for.
+ */
+static const char *DERIVED_FILES[] = { ".oix", ".txn", ".hti", ".warm" };
+
+static inline int
+get_status(frame_reader &reader, int *status)
+{
+	uint16_t s;
+
+	if (!reader.get_u16(&s))
+		return E_mismatch;
+	*status = static_cast<int16_t>(s);
+	return E_ok;
+}
+
+/*
+ * Sends the request frame.
+ */
+static int
+send_request(snf::net::socket *sock, const std::string &out)
+{
+	int bwritten = 0;
+	int oserr = 0;
+
+	return sock->writen(out.data(), static_cast<int>(out.size()), &bwritten,
+			snf::net::POLL_WAIT_FOREVER, &oserr);
+}
+
+/*
+ * Receives a response frame to the request.
+ */
+static int
+receive_response(snf::net::socket *sock, uint32_t id, opcode op, header &hdr, std::vector<char> &payload)
+{
+	char    hbuf[HEADER_SIZE];
+	int     bread = 0;
+	int     oserr = 0;
+	int     retval;
+
+	retval = sock->readn(hbuf, HEADER_SIZE, &bread, snf::net::POLL_WAIT_FOREVER, &oserr);
+	if (retval != E_ok)
+		return retval;
+	if (bread != HEADER_SIZE)
+		return E_connection_reset;
+
+	if (!decode_header(hbuf, hdr) || (hdr.id != id) || (hdr.op != op))
+		return E_mismatch;
+
+	payload.resize(hdr.length);
+	if (hdr.length > 0) {
+		bread = 0;
+		retval = sock->readn(payload.data(), static_cast<int>(hdr.length), &bread,
+				snf::net::POLL_WAIT_FOREVER, &oserr);
+		if (retval != E_ok)
+			return retval;
+		if (bread != static_cast<int>(hdr.length))
+			return E_connection_reset;
+	}
+
+	return E_ok;
+}
+
+/*
+ * Receives a snapshot file into the given file.
+ */
+static int
+receive_file(snf::net::socket *sock, const std::string &fname, int64_t size)
+{
+	std::vector<char>       buf(SNAPSHOT_CHUNK);
+	snf::file               file(fname, 0022);
+	snf::file::open_flags   oflags;
+	int64_t                 offset = 0;
+	int                     bread;
+	int                     bwritten;
+	int                     oserr = 0;
+	int                     retval;
+
+	oflags.o_write = true;
+	oflags.o_create = true;
+	oflags.o_truncate = true;
+
+	retval = file.open(oflags, 0600, &oserr);
+	if (retval != E_ok) {
+		ERROR_STRM("follower", oserr)
+			<< "failed to open file " << fname
+			<< snf::log::record::endl;
+		return retval;
+	}
+
+	while (offset < size) {
+		int n = static_cast<int>(std::min(size - offset, static_cast<int64_t>(SNAPSHOT_CHUNK)));
+
+		bread = 0;
+		retval = sock->readn(buf.data(), n, &bread, snf::net::POLL_WAIT_FOREVER, &oserr);
+		if ((retval == E_ok) && (bread != n))
+			retval = E_connection_reset;
+		if (retval != E_ok) {
+			ERROR_STRM("follower", oserr)
+				<< "failed to receive file " << fname
+				<< snf::log::record::endl;
+			break;
+		}
+
+		bwritten = 0;
+		retval = file.write(offset, buf.data(), n, &bwritten, &oserr);
+		if ((retval == E_ok) && (bwritten != n))
+			retval = E_write_failed;
+		if (retval != E_ok) {
+			ERROR_STRM("follower", oserr)
+				<< "failed to write file " << fname
+				<< snf::log::record::endl;
+			break;
+		}
+
+		offset += n;
+	}
+
+	if (retval == E_ok) {
+		retval = file.sync(&oserr);
+		if (retval != E_ok) {
+			ERROR_STRM("follower", oserr)
+				<< "failed to sync file " << fname
+				<< snf::log::record::endl;
+		}
+	}
+
+	file.close();
+	return retval;
+}
+
+/*
+ * Connects to the primary.
+ */
+snf::net::socket *
+follower::connect(const std::string &host, in_port_t port)
+{
+	try {
+		std::unique_ptr<snf::net::socket> s(
+			DBG_NEW snf::net::socket(AF_INET, snf::net::socket_type::tcp));
+		s->tcpnodelay(true);
+		s->connect(AF_INET, host, port);
+		return s.release();
+	} catch (std::system_error &ex) {
+		ERROR_STRM("follower", ex.code().value())
+			<< ex.what()
+			<< snf::log::record::endl;
+		return nullptr;
+	}
+}
+
+/**
+ * Gets a snapshot of the primary database. The database files
+ * are received next to the existing ones, if any, and then
+ * replace them; the database must not be open.
+ *
+ * @param [in] host - primary host.
+ * @param [in] port - primary port.
+ * @param [in] path - database path; created if it does not
+ *                    exist.
+ * @param [in] name - database name; the same as that of the
+ *                    primary database.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+follower::snapshot(const std::string &host, in_port_t port, const std::string &path, const std::string &name)
+{
+	std::vector<std::pair<std::string, int64_t>>    files;
+	std::vector<char>                               payload;
+	header                                          hdr;
+	std::string                                     request;
+	std::string                                     prefix;
+	int                                             oserr = 0;
+	int                                             status = E_ok;
+	int                                             retval;
+
+	retval = snf::fs::mkdir(path.c_str(), 0700, &oserr);
+	if (retval != E_ok) {
+		ERROR_STRM("follower", oserr)
+			<< "failed to create directory " << path
+			<< snf::log::record::endl;
+		return retval;
+	}
+
+	prefix = path;
+	prefix.push_back(snf::pathsep());
+	prefix += name;
+
+	std::unique_ptr<snf::net::socket> sock(connect(host, port));
+	if (!sock)
+		return E_connect_failed;
+
+	sock->rcvtimeout(SNAPSHOT_TIMEOUT);
+
+	frame_writer writer(request, 1, opcode::snapshot, 0);
+	writer.finish();
+
+	retval = send_request(sock.get(), request);
+	if (retval == E_ok)
+		retval = receive_response(sock.get(), 1, opcode::snapshot, hdr, payload);
+	if (retval != E_ok) {
+		ERROR_STRM("follower")
+			<< "failed to get snapshot from " << host << ":" << port
+			<< " with status " << retval
+			<< snf::log::record::endl;
+		return retval;
+	}
+
+	frame_reader reader(payload.data(), static_cast<int>(hdr.length));
+	if (get_status(reader, &status) != E_ok)
+		return E_mismatch;
+
+	if (status != E_ok) {
+		ERROR_STRM("follower")
+			<< "primary " << host << ":" << port
+			<< " failed to take snapshot with status " << status
+			<< snf::log::record::endl;
+		return status;
+	}
+
+	for (uint16_t i = 0; i < hdr.count; ++i) {
+		const char  *suffix;
+		int         slen;
+		uint64_t    size;
+
+		if (!reader.get_bytes(&suffix, &slen) || !reader.get_u64(&size))
+			return E_mismatch;
+
+		std::string s(suffix, slen);
+		if (std::none_of(std::begin(SNAPSHOT_FILES), std::end(SNAPSHOT_FILES),
+				[&s](const char *f) { return s == f; }))
+			return E_mismatch;
+
+		files.emplace_back(prefix + s, static_cast<int64_t>(size));
+	}
+
+	if (!reader.at_end())
+		return E_mismatch;
+
+	for (auto &f : files) {
+		retval = receive_file(sock.get(), f.first + ".part", f.second);
+		if (retval != E_ok)
+			break;
+	}
+
+	sock->close();
+
+	if (retval == E_ok) {
+		for (const char *suffix : DERIVED_FILES)
+			snf::fs::remove_file((prefix + suffix).c_str());
+
+		for (auto &f : files) {
+			retval = snf::fs::rename(f.first.c_str(), (f.first + ".part").c_str(), &oserr);
+			if (retval != E_ok) {
+				ERROR_STRM("follower", oserr)
+					<< "failed to rename " << f.first << ".part"
+					<< snf::log::record::endl;
+				break;
+			}
+		}
+	}
+
+	for (auto &f : files)
+		snf::fs::remove_file((f.first + ".part").c_str());
+
+	INFO_STRM("follower")
+		<< "snapshot of " << name
+		<< " from " << host << ":" << port
+		<< " completed with status " << retval
+		<< snf::log::record::endl;
+
+	return retval;
+}
+
+/*
+ * Follows the changes on one connection to the primary.
+ *
+ * @return E_ok if stopped, the status from the primary or of
+ * applying the changes if following cannot go on, -ve error
+ * code on a transport failure.
+ */
+int
+follower::follow()
+{
+	std::vector<change_rec_t>   changes;
+	std::vector<char>           payload;
+	std::string                 request;
+	header                      hdr;
+	int                         oserr = 0;
+	int                         status;
+	int                         retval;
+	int                         waited;
+
+	std::unique_ptr<snf::net::socket> sock(connect(m_host, m_port));
+	if (!sock)
+		return E_connect_failed;
+
+	sock->rcvtimeout(FOLLOW_TIMEOUT);
+
+	uint64_t from = m_rdb->lastSequence() + 1;
+
+	frame_writer writer(request, 1, opcode::follow, 0);
+	writer.put_u64(from);
+	writer.finish();
+
+	retval = send_request(sock.get(), request);
+	if (retval != E_ok)
+		return retval;
+
+	INFO_STRM("follower")
+		<< "following " << m_host << ":" << m_port
+		<< " from " << from
+		<< snf::log::record::endl;
+
+	for (;;) {
+		for (waited = 0; waited < FOLLOW_TIMEOUT; waited += POLL_INTERVAL) {
+			{
+				std::lock_guard<std::mutex> guard(m_lock);
+				if (m_stop)
+					return E_ok;
+			}
+
+			oserr = 0;
+			if (sock->is_readable(POLL_INTERVAL, &oserr))
+				break;
+			if (oserr != 0)
+				return E_read_failed;
+		}
+
+		if (waited >= FOLLOW_TIMEOUT)
+			return E_timed_out;
+
+		retval = receive_response(sock.get(), 1, opcode::follow, hdr, payload);
+		if (retval != E_ok)
+			return retval;
+
+		frame_reader reader(payload.data(), static_cast<int>(hdr.length));
+		if (get_status(reader, &status) != E_ok)
+			return E_mismatch;
+
+		if (status != E_ok) {
+			std::lock_guard<std::mutex> guard(m_lock);
+			m_status = status;
+			return status;
+		}
+
+		changes.resize(hdr.count);
+		for (auto &cr : changes) {
+			if (!reader.get_change(&cr))
+				return E_mismatch;
+		}
+
+		if (!reader.at_end())
+			return E_mismatch;
+
+		if (!changes.empty()) {
+			retval = m_rdb->applyChanges(changes);
+			if (retval != E_ok) {
+				std::lock_guard<std::mutex> guard(m_lock);
+				m_status = retval;
+				return retval;
+			}
+		}
+
+		m_cond.notify_all();
+	}
+}
+
+/*
+ * Follows the primary, connecting again on a transport
+ * failure, until stopped or following cannot go on.
+ */
+void
+follower::run()
+{
+	for (;;) {
+		int retval = follow();
+
+		std::unique_lock<std::mutex> guard(m_lock);
+
+		if (m_status != E_ok) {
+			ERROR_STRM("follower")
+				<< "stopped following " << m_host << ":" << m_port
+				<< " at " << m_rdb->lastSequence()
+				<< " with status " << m_status
+				<< snf::log::record::endl;
+			m_cond.notify_all();
+			return;
+		}
+
+		if (m_stop)
+			return;
+
+		WARNING_STRM("follower")
+			<< "lost " << m_host << ":" << m_port
+			<< " with status " << retval
+			<< "; connecting again"
+			<< snf::log::record::endl;
+
+		m_cond.wait_for(guard, std::chrono::milliseconds(RETRY_INTERVAL),
+			[this] { return m_stop; });
+		if (m_stop)
+			return;
+	}
+}
+
+/**
+ * Starts following the primary.
+ *
+ * @param [in] rdb  - open database, set up from a snapshot of
+ *                    the primary database (see snapshot()).
+ * @param [in] host - primary host.
+ * @param [in] port - primary port.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+follower::start(Rdb *rdb, const std::string &host, in_port_t port)
+{
+	if (rdb == nullptr)
+		return E_invalid_arg;
+
+	if (m_thread.joinable())
+		return E_invalid_state;
+
+	m_rdb = rdb;
+	m_host = host;
+	m_port = port;
+	m_stop = false;
+	m_status = E_ok;
+
+	m_thread = std::thread(&follower::run, this);
+	return E_ok;
+}
+
+/**
+ * Stops following the primary.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+follower::stop()
+{
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_stop = true;
+	}
+
+	m_cond.notify_all();
+
+	if (m_thread.joinable())
+		m_thread.join();
+
+	return E_ok;
+}
+
+/**
+ * Gets the status of the follower: E_ok as long as it is
+ * following the primary, or trying to connect to it, the
+ * reason it stopped otherwise. E_not_found means the changes
+ * needed are no longer in the change feed of the primary.
+ */
+int
+follower::status()
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	return m_status;
+}
+
+/**
+ * Waits for the change with the given sequence to be applied.
+ *
+ * @param [in] seq - sequence to wait for.
+ * @param [in] to  - timeout in milliseconds.
+ *
+ * @return E_ok if the change is applied, E_timed_out if not
+ * yet, the status of the follower if it stopped.
+ */
+int
+follower::wait_for(uint64_t seq, int to)
+{
+	std::unique_lock<std::mutex> guard(m_lock);
+
+	bool done = m_cond.wait_for(guard, std::chrono::milliseconds(to),
+		[this, seq] { return (m_status != E_ok) || (m_rdb->lastSequence() >= seq); });
+
+	if (m_status != E_ok)
+		return m_status;
+
+	return done ? E_ok : E_timed_out;
+}
+
+} // namespace rdbd
+} // namespace snf
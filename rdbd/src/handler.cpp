@@ -0,0 +1,602 @@
+#include "handler.h"
+#include "server.h"
+#include "proto.h"
+#include "error.h"
+#include "file.h"
+#include "filesystem.h"
+#include "logmgr.h"
+#include <algorithm>
+#include <climits>
+#include <vector>
+
+namespace snf {
+namespace rdbd {
+
+/*
+ * A connection blocked in the middle of a frame for this long
+ * is closed.
+ */
+constexpr int RECV_TIMEOUT = 30000;
+
+/*
+ * The responses are flushed once they grow beyond this size.
+ */
+constexpr size_t MAX_BATCH = 64 * 1024;
+
+/*
+ * Requests executed per dispatch of a connection; a client
+ * that keeps the pipeline full does not hold on to a worker
+ * thread for ever.
+ */
+constexpr int MAX_REQUESTS = 256;
+
+/*
+ * A follower waiting for changes gets a heartbeat this often.
+ */
+constexpr int HEARTBEAT_INTERVAL = 1000;
+
+/*
+ * A follower that does not take the changes for this long is
+ * dropped.
+ */
+constexpr int SEND_TIMEOUT = 30000;
+
+/*
+ * Snapshot files are sent in chunks of this size.
+ */
+constexpr int SNAPSHOT_CHUNK = 64 * 1024;
+
+static inline bool
+valid_key(int klen)
+{
+	return (klen > 0) && (klen <= MAX_KEY_LENGTH);
+}
+
+static inline bool
+valid_value(int vlen)
+{
+	return (vlen > 0) && (vlen <= MAX_VALUE_LENGTH);
+}
+
+static inline void
+put_status(frame_writer &writer, int status)
+{
+	writer.put_u16(static_cast<uint16_t>(static_cast<int16_t>(status)));
+}
+
+/*
+ * Gets the key and appends the status, and the value if found,
+ * to the response.
+ */
+static void
+get_value(Rdb *rdb, const char *key, int klen, frame_writer &writer)
+{
+	char    value[MAX_VALUE_LENGTH];
+	int     vlen = MAX_VALUE_LENGTH;
+	int     status = E_invalid_arg;
+
+	if (valid_key(klen))
+		status = rdb->get(key, klen, value, &vlen);
+
+	put_status(writer, status);
+	if (status == E_ok)
+		writer.put_bytes(value, vlen);
+}
+
+/*
+ * Executes the request and appends the response to the output
+ * buffer. An invalid key or value is reported in the response
+ * status; a malformed request fails as there is no telling
+ * where the next request starts.
+ *
+ * A follower serves reads only; the updates fail with
+ * E_invalid_state.
+ *
+ * @return E_ok on success, E_invalid_arg if the request is
+ * malformed.
+ */
+static int
+execute(server *srvr, const header &hdr, const char *payload, std::string &out)
+{
+	Rdb             *rdb = srvr->db();
+	frame_reader    reader(payload, static_cast<int>(hdr.length));
+	const char      *key = nullptr;
+	const char      *value = nullptr;
+	int             klen = 0;
+	int             vlen = 0;
+	int             status;
+
+	switch (hdr.op) {
+		case opcode::get: {
+			if (!reader.get_bytes(&key, &klen) || !reader.at_end())
+				return E_invalid_arg;
+
+			frame_writer writer(out, hdr.id, hdr.op, 1);
+			get_value(rdb, key, klen, writer);
+			writer.finish();
+			break;
+		}
+
+		case opcode::set: {
+			uint32_t ttl = 0;
+			if (!reader.get_bytes(&key, &klen) ||
+				!reader.get_bytes(&value, &vlen) ||
+				!reader.get_u32(&ttl) ||
+				!reader.at_end())
+				return E_invalid_arg;
+
+			if (!valid_key(klen) || !valid_value(vlen) || (ttl > INT_MAX))
+				status = E_invalid_arg;
+			else if (srvr->read_only())
+				status = E_invalid_state;
+			else if (ttl > 0)
+				status = rdb->setWithTTL(key, klen, value, vlen, static_cast<int>(ttl));
+			else
+				status = rdb->set(key, klen, value, vlen);
+
+			frame_writer writer(out, hdr.id, hdr.op, 1);
+			put_status(writer, status);
+			writer.finish();
+			break;
+		}
+
+		case opcode::remove: {
+			if (!reader.get_bytes(&key, &klen) || !reader.at_end())
+				return E_invalid_arg;
+
+			if (!valid_key(klen))
+				status = E_invalid_arg;
+			else if (srvr->read_only())
+				status = E_invalid_state;
+			else
+				status = rdb->remove(key, klen);
+
+			frame_writer writer(out, hdr.id, hdr.op, 1);
+			put_status(writer, status);
+			writer.finish();
+			break;
+		}
+
+		case opcode::multi_get: {
+			if ((hdr.count == 0) || (hdr.count > MAX_MULTI_GET))
+				return E_invalid_arg;
+
+			std::vector<std::pair<const char *, int>> keys;
+			keys.reserve(hdr.count);
+			for (uint16_t i = 0; i < hdr.count; ++i) {
+				if (!reader.get_bytes(&key, &klen))
+					return E_invalid_arg;
+				keys.emplace_back(key, klen);
+			}
+
+			if (!reader.at_end())
+				return E_invalid_arg;
+
+			frame_writer writer(out, hdr.id, hdr.op, hdr.count);
+			for (auto &k : keys)
+				get_value(rdb, k.first, k.second, writer);
+			writer.finish();
+			break;
+		}
+
+		default:
+			return E_invalid_arg;
+	}
+
+	return E_ok;
+}
+
+/*
+ * Writes the batched responses.
+ */
+static int
+flush(snf::net::socket *sock, std::string &out)
+{
+	int bwritten = 0;
+	int oserr = 0;
+	int retval = E_ok;
+
+	if (!out.empty()) {
+		retval = sock->writen(out.data(), static_cast<int>(out.size()), &bwritten,
+				snf::net::POLL_WAIT_FOREVER, &oserr);
+		if (retval != E_ok) {
+			ERROR_STRM(nullptr, oserr)
+				<< "failed to write responses to socket "
+				<< *sock
+				<< snf::log::record::endl;
+		}
+		out.clear();
+	}
+
+	return retval;
+}
+
+/*
+ * Sends the file contents following the snapshot response.
+ */
+static int
+send_file(snf::net::socket *sock, const std::string &fname, int64_t size)
+{
+	std::vector<char>       buf(SNAPSHOT_CHUNK);
+	snf::file               file(fname, 0022);
+	snf::file::open_flags   oflags;
+	int64_t                 offset = 0;
+	int                     bread;
+	int                     bwritten;
+	int                     oserr = 0;
+	int                     retval;
+
+	oflags.o_read = true;
+
+	retval = file.open(oflags, 0600, &oserr);
+	if (retval != E_ok) {
+		ERROR_STRM(nullptr, oserr)
+			<< "failed to open file " << fname
+			<< snf::log::record::endl;
+		return retval;
+	}
+
+	while (offset < size) {
+		int n = static_cast<int>(std::min(size - offset, static_cast<int64_t>(SNAPSHOT_CHUNK)));
+
+		bread = 0;
+		retval = file.read(offset, buf.data(), n, &bread, &oserr);
+		if ((retval == E_ok) && (bread != n))
+			retval = E_read_failed;
+		if (retval != E_ok) {
+			ERROR_STRM(nullptr, oserr)
+				<< "failed to read file " << fname
+				<< snf::log::record::endl;
+			break;
+		}
+
+		bwritten = 0;
+		retval = sock->writen(buf.data(), n, &bwritten, snf::net::POLL_WAIT_FOREVER, &oserr);
+		if (retval != E_ok) {
+			ERROR_STRM(nullptr, oserr)
+				<< "failed to write file " << fname
+				<< " to socket " << *sock
+				<< snf::log::record::endl;
+			break;
+		}
+
+		offset += n;
+	}
+
+	file.close();
+	return retval;
+}
+
+/*
+ * Checkpoints the database into a scratch directory and sends
+ * the files, as described in proto.h. A failed checkpoint is
+ * reported in the response status.
+ *
+ * @return E_ok on success, -ve error code if the connection
+ * is no longer usable.
+ */
+static int
+send_snapshot(server *srvr, snf::net::socket *sock, const header &hdr)
+{
+	Rdb                                         *rdb = srvr->db();
+	std::vector<std::pair<std::string, int64_t>> files;
+	std::string                                 out;
+	std::string                                 dir;
+	std::string                                 prefix;
+	int                                         oserr = 0;
+	int                                         retval = E_ok;
+	int                                         status;
+
+	dir = rdb->getPath();
+	dir.push_back(snf::pathsep());
+	dir += rdb->getName();
+	dir += ".snapshot.";
+	dir += std::to_string(srvr->next_snapshot());
+
+	prefix = dir;
+	prefix.push_back(snf::pathsep());
+	prefix += rdb->getName();
+
+	status = rdb->checkpoint(dir);
+	if (status == E_ok) {
+		for (const char *suffix : SNAPSHOT_FILES) {
+			std::string fname = prefix + suffix;
+			int64_t size = snf::fs::size(fname.c_str(), &oserr);
+			if (size < 0) {
+				ERROR_STRM(nullptr, oserr)
+					<< "failed to get size of file " << fname
+					<< snf::log::record::endl;
+				status = static_cast<int>(size);
+				break;
+			}
+			files.emplace_back(fname, size);
+		}
+	}
+
+	if (status != E_ok)
+		files.clear();
+
+	frame_writer writer(out, hdr.id, hdr.op, static_cast<uint16_t>(files.size()));
+	put_status(writer, status);
+	for (size_t i = 0; i < files.size(); ++i) {
+		writer.put_bytes(SNAPSHOT_FILES[i]);
+		writer.put_u64(static_cast<uint64_t>(files[i].second));
+	}
+	writer.finish();
+
+	retval = flush(sock, out);
+	for (size_t i = 0; (retval == E_ok) && (i < files.size()); ++i)
+		retval = send_file(sock, files[i].first, files[i].second);
+
+	for (const char *suffix : SNAPSHOT_FILES)
+		snf::fs::remove_file((prefix + suffix).c_str());
+	snf::fs::remove_dir(dir.c_str());
+
+	INFO_STRM(nullptr)
+		<< "snapshot " << dir
+		<< " to socket " << *sock
+		<< " completed with status " << ((status == E_ok) ? retval : status)
+		<< snf::log::record::endl;
+
+	return retval;
+}
+
+/**
+ * Sends the changes to a follower, starting at the given
+ * sequence, until the follower goes away, it asks for changes
+ * no longer in the change feed, or the server is stopped. Runs
+ * in a thread of its own (see server::add_follower).
+ *
+ * @param [in] srvr - server.
+ * @param [in] s    - follower connection.
+ * @param [in] id   - ID of the follow request.
+ * @param [in] from - sequence of the first change to send.
+ */
+void
+ship_changes(server *srvr, snf::net::socket *s, uint32_t id, uint64_t from)
+{
+	std::unique_ptr<snf::net::socket> sock(s);
+	std::vector<change_rec_t>   changes;
+	std::string                 out;
+	int                         status;
+
+	INFO_STRM(nullptr)
+		<< "shipping changes from " << from
+		<< " to socket " << *sock
+		<< snf::log::record::endl;
+
+	while (!srvr->stopping()) {
+		status = srvr->db()->readChanges(from, MAX_CHANGES, changes);
+		if ((status == E_ok) && changes.empty()) {
+			status = srvr->db()->waitForChanges(from, HEARTBEAT_INTERVAL);
+			if (status == E_ok)
+				continue;
+			if (status == E_timed_out)
+				status = E_ok;
+		}
+
+		frame_writer writer(out, id, opcode::follow, static_cast<uint16_t>(changes.size()));
+		put_status(writer, status);
+		for (auto &cr : changes)
+			writer.put_change(cr);
+		writer.finish();
+
+		if ((flush(sock.get(), out) != E_ok) || (status != E_ok))
+			break;
+
+		if (!changes.empty())
+			from = changes.back().cr_seq + 1;
+	}
+
+	INFO_STRM(nullptr)
+		<< "stopped shipping changes at " << from
+		<< " to socket " << *sock
+		<< snf::log::record::endl;
+
+	sock->close();
+}
+
+/*
+ * Executes the requests received on the connection. Requests
+ * are read as long as they are available without waiting, so a
+ * pipelining client gets all the responses to its batch in one
+ * write. The connection is then registered with the reactor
+ * again, or closed on end of file or error.
+ */
+static void
+process_requests(server *srvr, snf::net::socket *s)
+{
+	std::unique_ptr<snf::net::socket> sock(s);
+	std::vector<char>   payload;
+	std::string         out;
+	char                hbuf[HEADER_SIZE];
+	header              hdr;
+	int                 bread;
+	int                 oserr = 0;
+	int                 retval;
+	int                 nrequests = 0;
+	bool                close_connection = false;
+
+	do {
+		bread = 0;
+		retval = sock->readn(hbuf, HEADER_SIZE, &bread, snf::net::POLL_WAIT_FOREVER, &oserr);
+		if ((retval != E_ok) || (bread != HEADER_SIZE)) {
+			if ((retval != E_ok) || (bread != 0)) {
+				ERROR_STRM(nullptr, oserr)
+					<< "failed to read request header from socket "
+					<< *sock
+					<< snf::log::record::endl;
+			}
+			close_connection = true;
+			break;
+		}
+
+		if (!decode_header(hbuf, hdr)) {
+			ERROR_STRM(nullptr)
+				<< "invalid request header from socket "
+				<< *sock
+				<< snf::log::record::endl;
+			close_connection = true;
+			break;
+		}
+
+		payload.resize(hdr.length);
+		if (hdr.length > 0) {
+			bread = 0;
+			retval = sock->readn(payload.data(), static_cast<int>(hdr.length), &bread,
+					snf::net::POLL_WAIT_FOREVER, &oserr);
+			if ((retval != E_ok) || (bread != static_cast<int>(hdr.length))) {
+				ERROR_STRM(nullptr, oserr)
+					<< "failed to read request payload from socket "
+					<< *sock
+					<< snf::log::record::endl;
+				close_connection = true;
+				break;
+			}
+		}
+
+		if ((hdr.op == opcode::snapshot) || (hdr.op == opcode::follow)) {
+			// Not pipelined; the responses so far go first
+			if (flush(sock.get(), out) != E_ok) {
+				close_connection = true;
+				break;
+			}
+
+			if (hdr.op == opcode::snapshot) {
+				if (!payload.empty() || (send_snapshot(srvr, sock.get(), hdr) != E_ok)) {
+					close_connection = true;
+					break;
+				}
+				continue;
+			}
+
+			frame_reader reader(payload.data(), static_cast<int>(hdr.length));
+			uint64_t from = 0;
+			if (!reader.get_u64(&from) || !reader.at_end()) {
+				close_connection = true;
+				break;
+			}
+
+			// The connection now belongs to the follower thread
+			sock->sndtimeout(SEND_TIMEOUT);
+			srvr->add_follower(sock.release(), hdr.id, from);
+			return;
+		}
+
+		if (execute(srvr, hdr, payload.data(), out) != E_ok) {
+			ERROR_STRM(nullptr)
+				<< "malformed request " << hdr.id
+				<< " from socket " << *sock
+				<< snf::log::record::endl;
+			close_connection = true;
+			break;
+		}
+
+		if (out.size() >= MAX_BATCH) {
+			if (flush(sock.get(), out) != E_ok) {
+				close_connection = true;
+				break;
+			}
+		}
+	} while ((++nrequests < MAX_REQUESTS) && sock->is_readable(snf::net::POLL_WAIT_NONE, &oserr));
+
+	// Responses to the requests preceding an error are still sent
+	if ((flush(sock.get(), out) != E_ok) || close_connection) {
+		DEBUG_STRM(nullptr)
+			<< "closing socket "
+			<< *sock
+			<< snf::log::record::endl;
+		sock->close();
+		return;
+	}
+
+	sock_t thesock = *sock;
+	srvr->reactor().add_handler(
+		thesock,
+		snf::net::event::read,
+		DBG_NEW read_handler(*srvr, sock.release()));
+}
+
+/*
+ * Registers the accepted connection with the reactor. This is
+ * done from the thread pool as the reactor calls the handlers
+ * with its lock held.
+ */
+static void
+register_connection(server *srvr, snf::net::socket *s)
+{
+	sock_t thesock = *s;
+	srvr->reactor().add_handler(
+		thesock,
+		snf::net::event::read,
+		DBG_NEW read_handler(*srvr, s));
+}
+
+bool
+accept_handler::operator()(sock_t s, snf::net::event e)
+{
+	if (*m_sock != s) {
+		ERROR_STRM("accept_handler")
+			<< "socket mismatch"
+			<< snf::log::record::endl;
+		return false;
+	}
+
+	if (e != snf::net::event::read) {
+		ERROR_STRM("accept_handler")
+			<< "unexpected event received "
+			<< snf::net::eventstr(e)
+			<< snf::log::record::endl;
+		return false;
+	}
+
+	try {
+		std::unique_ptr<snf::net::socket> nsock(
+			DBG_NEW snf::net::socket(std::move(m_sock->accept())));
+		nsock->blocking(true);
+		nsock->tcpnodelay(true);
+		nsock->rcvtimeout(RECV_TIMEOUT);
+
+		DEBUG_STRM("accept_handler")
+			<< "accepted socket "
+			<< *nsock
+			<< snf::log::record::endl;
+
+		m_server.thread_pool()->submit(register_connection, &m_server, nsock.release());
+	} catch (std::system_error &ex) {
+		// A failed accept (e.g. the peer is gone) does not stop the listener
+		ERROR_STRM("accept_handler", ex.code().value())
+			<< ex.what()
+			<< snf::log::record::endl;
+	}
+
+	return true;
+}
+
+bool
+read_handler::operator()(sock_t s, snf::net::event e)
+{
+	if (*m_sock != s) {
+		ERROR_STRM("read_handler")
+			<< "socket mismatch"
+			<< snf::log::record::endl;
+		return false;
+	}
+
+	if (e != snf::net::event::read) {
+		DEBUG_STRM("read_handler")
+			<< "closing socket " << *m_sock
+			<< " on event " << snf::net::eventstr(e)
+			<< snf::log::record::endl;
+		m_sock->close();
+		return false;
+	}
+
+	m_server.thread_pool()->submit(process_requests, &m_server, m_sock.release());
+
+	// Registered again once the requests are processed.
+	return false;
+}
+
+} // namespace rdbd
+} // namespace snf
@@ -0,0 +1,213 @@
+#include "proto.h"
+#include "net.h"
+
+namespace snf {
+namespace rdbd {
+
+/*
+ * Encodes the frame header.
+ *
+ * @param [out] buf - buffer of HEADER_SIZE bytes.
+ * @param [in]  hdr - frame header.
+ */
+void
+encode_header(char *buf, const header &hdr)
+{
+	uint32_t    u32;
+	uint16_t    u16;
+
+	u32 = snf::net::hton(hdr.length);
+	memcpy(buf, &u32, 4);
+	u32 = snf::net::hton(hdr.id);
+	memcpy(buf + 4, &u32, 4);
+	buf[8] = static_cast<char>(hdr.op);
+	buf[9] = static_cast<char>(hdr.flags);
+	u16 = snf::net::hton(hdr.count);
+	memcpy(buf + 10, &u16, 2);
+}
+
+/*
+ * Decodes the frame header.
+ *
+ * @param [in]  buf - buffer of HEADER_SIZE bytes.
+ * @param [out] hdr - frame header.
+ *
+ * @return true if the header is valid, false otherwise.
+ */
+bool
+decode_header(const char *buf, header &hdr)
+{
+	uint32_t    u32;
+	uint16_t    u16;
+
+	memcpy(&u32, buf, 4);
+	hdr.length = snf::net::ntoh(u32);
+	memcpy(&u32, buf + 4, 4);
+	hdr.id = snf::net::ntoh(u32);
+
+	uint8_t op = static_cast<uint8_t>(buf[8]);
+	if (!valid_opcode(op))
+		return false;
+
+	hdr.op = static_cast<opcode>(op);
+	hdr.flags = static_cast<uint8_t>(buf[9]);
+	memcpy(&u16, buf + 10, 2);
+	hdr.count = snf::net::ntoh(u16);
+
+	return (hdr.length <= static_cast<uint32_t>(MAX_PAYLOAD));
+}
+
+frame_writer::frame_writer(std::string &buf, uint32_t id, opcode op, uint16_t count)
+	: m_buf(buf)
+	, m_start(buf.size())
+{
+	header hdr;
+	hdr.id = id;
+	hdr.op = op;
+	hdr.count = count;
+
+	char hbuf[HEADER_SIZE];
+	encode_header(hbuf, hdr);
+	m_buf.append(hbuf, HEADER_SIZE);
+}
+
+void
+frame_writer::put_u16(uint16_t v)
+{
+	v = snf::net::hton(v);
+	m_buf.append(reinterpret_cast<const char *>(&v), 2);
+}
+
+void
+frame_writer::put_u32(uint32_t v)
+{
+	v = snf::net::hton(v);
+	m_buf.append(reinterpret_cast<const char *>(&v), 4);
+}
+
+void
+frame_writer::put_u64(uint64_t v)
+{
+	put_u32(static_cast<uint32_t>(v >> 32));
+	put_u32(static_cast<uint32_t>(v));
+}
+
+void
+frame_writer::put_bytes(const char *b, int len)
+{
+	put_u16(static_cast<uint16_t>(len));
+	if (len > 0)
+		m_buf.append(b, len);
+}
+
+void
+frame_writer::put_change(const change_rec_t &cr)
+{
+	put_u64(cr.cr_seq);
+	put_u16(static_cast<uint16_t>(cr.cr_op));
+	put_bytes(cr.cr_key, cr.cr_klen);
+	put_bytes(cr.cr_value, cr.cr_vlen);
+	put_u32(cr.cr_expiry);
+}
+
+/*
+ * Sets the payload length in the frame header.
+ */
+void
+frame_writer::finish()
+{
+	uint32_t len = static_cast<uint32_t>(m_buf.size() - m_start - HEADER_SIZE);
+	len = snf::net::hton(len);
+	memcpy(&m_buf[m_start], &len, 4);
+}
+
+bool
+frame_reader::get_u16(uint16_t *v)
+{
+	if ((m_end - m_cur) < 2)
+		return false;
+	memcpy(v, m_cur, 2);
+	*v = snf::net::ntoh(*v);
+	m_cur += 2;
+	return true;
+}
+
+bool
+frame_reader::get_u32(uint32_t *v)
+{
+	if ((m_end - m_cur) < 4)
+		return false;
+	memcpy(v, m_cur, 4);
+	*v = snf::net::ntoh(*v);
+	m_cur += 4;
+	return true;
+}
+
+bool
+frame_reader::get_u64(uint64_t *v)
+{
+	uint32_t hi, lo;
+
+	if (!get_u32(&hi) || !get_u32(&lo))
+		return false;
+	*v = (static_cast<uint64_t>(hi) << 32) | lo;
+	return true;
+}
+
+/*
+ * Gets the length prefixed bytes. The bytes are not copied;
+ * they point into the payload.
+ */
+bool
+frame_reader::get_bytes(const char **b, int *len)
+{
+	uint16_t n;
+
+	if (!get_u16(&n))
+		return false;
+	if ((m_end - m_cur) < n)
+		return false;
+
+	*b = m_cur;
+	*len = n;
+	m_cur += n;
+	return true;
+}
+
+/*
+ * Gets a change record. The key and the value are checked to
+ * fit in the record, not to be valid.
+ */
+bool
+frame_reader::get_change(change_rec_t *cr)
+{
+	uint64_t    seq;
+	uint16_t    op;
+	uint32_t    expiry;
+	const char  *key;
+	const char  *value;
+	int         klen;
+	int         vlen;
+
+	if (!get_u64(&seq) || !get_u16(&op) ||
+		!get_bytes(&key, &klen) || !get_bytes(&value, &vlen) ||
+		!get_u32(&expiry))
+		return false;
+
+	if ((klen > MAX_KEY_LENGTH) || (vlen > MAX_VALUE_LENGTH))
+		return false;
+
+	memset(cr, 0, sizeof(*cr));
+	cr->cr_seq = seq;
+	cr->cr_magic = CHANGE_MAGIC;
+	cr->cr_op = static_cast<short>(op);
+	cr->cr_klen = static_cast<short>(klen);
+	cr->cr_vlen = static_cast<short>(vlen);
+	cr->cr_expiry = expiry;
+	memcpy(cr->cr_key, key, klen);
+	memcpy(cr->cr_value, value, vlen);
+	return true;
+}
+
+} // namespace rdbd
+} // namespace snf
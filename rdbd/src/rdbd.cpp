@@ -0,0 +1,233 @@
+#include <chrono>
+#include <csignal>
+#include <thread>
+#include "net.h"
+#include "server.h"
+#include "follower.h"
+#include "filesystem.h"
+#include "logmgr.h"
+#include "logger.h"
+#include "flogger.h"
+
+static bool                         Verbosity;
+static volatile std::sig_atomic_t   Terminated;
+
+static void
+signalHandler(int)
+{
+	Terminated = 1;
+}
+
+static int
+usage(const char *prog)
+{
+	std::cerr
+		<< prog
+		<< " -path <db_path> -name <db_name> [-port <port>]" << std::endl
+		<< "        [-threads <worker_threads>] [-htsize <hash_table_size>]" << std::endl
+		<< "        [-pgsize <page_size>] [-memusage <%_of_memory>]" << std::endl
+		<< "        [-syncdf <0|1>] [-syncif <0|1>] [-feed | -follow <host>:<port>]" << std::endl
+		<< "        [-logpath <log_path>] [-v]" << std::endl;
+	return 1;
+}
+
+/*
+ * Gets the name of the file with the sequence of the last
+ * change applied to a follower database.
+ */
+static std::string
+sequenceFile(const Rdb &rdb)
+{
+	std::string fname(rdb.getPath());
+	fname.push_back(snf::pathsep());
+	fname += rdb.getName();
+	fname += ".seq";
+	return fname;
+}
+
+/*
+ * Serves the database until terminated. A follower serves
+ * reads only and applies the changes of the primary; it
+ * starts from a snapshot of the primary database if it has
+ * none.
+ *
+ * @return E_ok on success, E_not_found if the follower fell
+ * too far behind the primary and needs a new snapshot, -ve
+ * error code on failure.
+ */
+static int
+serve(Rdb &rdb, in_port_t port, int threads, const std::string &primary, in_port_t primaryPort)
+{
+	int retval;
+	bool following = !primary.empty();
+
+	if (following) {
+		if (!snf::fs::exists(sequenceFile(rdb).c_str())) {
+			retval = snf::rdbd::follower::snapshot(primary, primaryPort, rdb.getPath(), rdb.getName());
+			if (retval != E_ok) {
+				std::cerr << "failed to get snapshot with status " << retval << std::endl;
+				return retval;
+			}
+		}
+	}
+
+	retval = rdb.open();
+	if (retval != E_ok) {
+		std::cerr << "failed to open database with status " << retval << std::endl;
+		return retval;
+	}
+
+	{
+		snf::rdbd::server srvr;
+		snf::rdbd::follower fllwr;
+
+		srvr.read_only(following);
+
+		retval = srvr.start(&rdb, port, threads);
+		if (retval != E_ok) {
+			std::cerr << "failed to start server with status " << retval << std::endl;
+		} else if (following) {
+			retval = fllwr.start(&rdb, primary, primaryPort);
+			if (retval != E_ok)
+				std::cerr << "failed to start follower with status " << retval << std::endl;
+		}
+
+		while ((retval == E_ok) && !Terminated) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(200));
+			if (following)
+				retval = fllwr.status();
+		}
+
+		fllwr.stop();
+		srvr.stop();
+	}
+
+	rdb.close();
+
+	return retval;
+}
+
+int
+main(int argc, const char **argv)
+{
+	int retval = E_ok;
+	std::string path;
+	std::string name;
+	std::string logPath;
+	std::string primary;
+	in_port_t primaryPort = 0;
+	int port = 16790;
+	int threads = 4;
+	int htSize = -1;
+	int pgSize = -1;
+	RdbOptions dbOpt;
+	char prog[MAXPATHLEN + 1];
+
+	snf::basename(prog, MAXPATHLEN + 1, argv[0], true);
+
+	for (int i = 1; i < argc; ++i) {
+		const char *opt = argv[i];
+
+		if (strcmp("-v", opt) == 0) {
+			Verbosity = true;
+			continue;
+		}
+
+		if (strcmp("-feed", opt) == 0) {
+			dbOpt.changeFeed(true);
+			continue;
+		}
+
+		++i;
+		if (argv[i] == 0) {
+			std::cerr << "missing argument to " << opt << std::endl;
+			return usage(prog);
+		}
+
+		if (strcmp("-path", opt) == 0) {
+			path = argv[i];
+		} else if (strcmp("-name", opt) == 0) {
+			name = argv[i];
+		} else if (strcmp("-port", opt) == 0) {
+			port = atoi(argv[i]);
+		} else if (strcmp("-threads", opt) == 0) {
+			threads = atoi(argv[i]);
+		} else if (strcmp("-htsize", opt) == 0) {
+			htSize = atoi(argv[i]);
+		} else if (strcmp("-pgsize", opt) == 0) {
+			pgSize = atoi(argv[i]);
+		} else if (strcmp("-memusage", opt) == 0) {
+			if (dbOpt.setMemoryUsage(atoi(argv[i])) != E_ok) {
+				std::cerr << "invalid memory usage (" << argv[i] << ")" << std::endl;
+				return 1;
+			}
+		} else if (strcmp("-syncdf", opt) == 0) {
+			dbOpt.syncDataFile(atoi(argv[i]) != 0);
+		} else if (strcmp("-syncif", opt) == 0) {
+			dbOpt.syncIndexFile(atoi(argv[i]) != 0);
+		} else if (strcmp("-follow", opt) == 0) {
+			const char *colon = strrchr(argv[i], ':');
+			int pport = colon ? atoi(colon + 1) : 0;
+			if ((colon == 0) || (colon == argv[i]) || (pport <= 0) || (pport > 65535)) {
+				std::cerr << "invalid primary (" << argv[i] << ")" << std::endl;
+				return 1;
+			}
+			primary.assign(argv[i], colon - argv[i]);
+			primaryPort = static_cast<in_port_t>(pport);
+		} else if (strcmp("-logpath", opt) == 0) {
+			logPath = argv[i];
+		} else {
+			return usage(prog);
+		}
+	}
+
+	if (path.empty() || name.empty()) {
+		std::cerr << "database path and name must be specified" << std::endl;
+		return usage(prog);
+	}
+
+	if ((port < 0) || (port > 65535) || (threads <= 0)) {
+		std::cerr << "invalid port or number of threads" << std::endl;
+		return 1;
+	}
+
+	if (!primary.empty() && dbOpt.changeFeed()) {
+		std::cerr << "a follower cannot have a change feed" << std::endl;
+		return 1;
+	}
+
+	snf::log::severity sev = Verbosity ? snf::log::severity::trace : snf::log::severity::info;
+	if (!logPath.empty()) {
+		snf::log::file_logger *flog = DBG_NEW snf::log::file_logger { logPath, sev };
+		flog->make_path(true);
+		snf::log::manager::instance().add_logger(flog);
+	} else {
+		snf::log::manager::instance().add_logger(DBG_NEW snf::log::console_logger(sev));
+	}
+
+	std::signal(SIGINT, signalHandler);
+	std::signal(SIGTERM, signalHandler);
+
+	snf::net::initialize();
+
+	Rdb rdb(path, name, dbOpt);
+
+	if (pgSize != -1)
+		rdb.setKeyPageSize(pgSize);
+
+	if (htSize != -1)
+		rdb.setHashTableSize(htSize);
+
+	for (;;) {
+		retval = serve(rdb, static_cast<in_port_t>(port), threads, primary, primaryPort);
+		if ((retval != E_not_found) || Terminated)
+			break;
+
+		// Fell too far behind the primary; start over from a new snapshot
+		snf::fs::remove_file(sequenceFile(rdb).c_str());
+	}
+
+	snf::net::finalize();
+
+	return (retval == E_ok) ? 0 : 1;
+}
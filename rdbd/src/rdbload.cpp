@@ -0,0 +1,340 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+#include "net.h"
+#include "client.h"
+#include "rdb.h"
+#include "json.h"
+#include "logmgr.h"
+#include "logger.h"
+
+static bool   Verbosity;
+
+/*
+ * Load configuration.
+ */
+typedef struct load_config
+{
+	std::string host;       // server host
+	int         port;       // server port
+	int         conns;      // connections, one thread each
+	int         depth;      // requests per pipeline
+	int64_t     num;        // keys
+	int64_t     ops;        // operations, if no duration
+	int         duration;   // seconds
+	int         reads;      // % of reads
+	int         vsize;      // value size
+	bool        fill;       // set all the keys first
+	uint64_t    seed;       // random seed
+} load_config_t;
+
+/*
+ * Result of a connection.
+ */
+typedef struct load_result
+{
+	int64_t                 ops;        // operations done
+	int64_t                 found;      // keys found (reads)
+	int64_t                 errors;     // operations failed
+	std::vector<int64_t>    latencies;  // pipeline latencies in nanoseconds
+} load_result_t;
+
+static int64_t
+Elapsed(const std::chrono::steady_clock::time_point &start)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start).count();
+}
+
+static double
+Percentile(const std::vector<int64_t> &sorted, double pct)
+{
+	if (sorted.empty())
+		return 0;
+
+	size_t i = size_t(std::ceil(double(sorted.size()) * pct / 100.0));
+	if (i > 0)
+		i--;
+	if (i >= sorted.size())
+		i = sorted.size() - 1;
+
+	return double(sorted[i]) / 1000.0;
+}
+
+static std::string
+Key(int64_t index)
+{
+	char key[32];
+	snprintf(key, sizeof(key), "key%012" PRId64, index);
+	return key;
+}
+
+/*
+ * Runs the load on one connection: pipelines of depth requests
+ * until ops operations are done or the time is up.
+ */
+static void
+Run(const load_config_t &config, int conn, int64_t ops, bool fill,
+	const std::chrono::steady_clock::time_point &end, load_result_t &r)
+{
+	snf::rdbd::client                           clnt;
+	std::mt19937_64                             rng(config.seed + uint64_t(conn) + 1);
+	std::vector<snf::rdbd::request>             requests;
+	std::vector<std::vector<snf::rdbd::result>> results;
+	std::string                                 value(size_t(config.vsize), 'v');
+	int64_t                                     next = 0;
+
+	if (clnt.connect(config.host, static_cast<in_port_t>(config.port)) != E_ok) {
+		r.errors += std::max<int64_t>(ops, 1);
+		return;
+	}
+
+	// keys of the connection when filling
+	int64_t first = (config.num / config.conns) * conn +
+			std::min(int64_t(conn), config.num % config.conns);
+
+	while ((ops < 0) ? (std::chrono::steady_clock::now() < end) : (r.ops < ops)) {
+		int n = config.depth;
+		if ((ops >= 0) && (int64_t(n) > (ops - r.ops)))
+			n = int(ops - r.ops);
+
+		requests.clear();
+		for (int i = 0; i < n; ++i) {
+			if (fill) {
+				requests.push_back(snf::rdbd::request::set(Key(first + next++), value));
+			} else {
+				std::string key = Key(int64_t(rng() % uint64_t(config.num)));
+				if (int(rng() % 100) < config.reads)
+					requests.push_back(snf::rdbd::request::get(key));
+				else
+					requests.push_back(snf::rdbd::request::set(key, value));
+			}
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		int status = clnt.pipeline(requests, results);
+		r.latencies.push_back(Elapsed(start));
+
+		if (status != E_ok) {
+			r.errors += n;
+			r.ops += n;
+			if (clnt.connect(config.host, static_cast<in_port_t>(config.port)) != E_ok)
+				break;
+			continue;
+		}
+
+		for (int i = 0; i < n; ++i) {
+			int s = results[i][0].status;
+			if (requests[i].op == snf::rdbd::opcode::get) {
+				if (s == E_ok)
+					r.found++;
+				else if (s != E_not_found)
+					r.errors++;
+			} else if (s != E_ok) {
+				r.errors++;
+			}
+		}
+
+		r.ops += n;
+	}
+}
+
+static snf::json::value
+Load(const char *name, const load_config_t &config, bool fill)
+{
+	std::vector<load_result_t>  results(config.conns);
+	std::vector<std::thread>    workers;
+	int64_t                     ops = fill ? config.num : config.ops;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point end = start + std::chrono::seconds(config.duration);
+
+	for (int c = 0; c < config.conns; ++c) {
+		int64_t n = -1;
+		if (ops >= 0)
+			n = ops / config.conns + ((c < (ops % config.conns)) ? 1 : 0);
+		results[c] = load_result_t();
+		workers.push_back(std::thread([&, c, n] {
+			Run(config, c, n, fill, end, results[c]);
+		}));
+	}
+
+	for (std::thread &w : workers)
+		w.join();
+
+	int64_t elapsed = Elapsed(start);
+
+	load_result_t total = load_result_t();
+	for (load_result_t &r : results) {
+		total.ops += r.ops;
+		total.found += r.found;
+		total.errors += r.errors;
+		total.latencies.insert(total.latencies.end(), r.latencies.begin(), r.latencies.end());
+	}
+
+	std::sort(total.latencies.begin(), total.latencies.end());
+
+	double seconds = double(elapsed) / 1e9;
+
+	if (Verbosity) {
+		std::cerr
+			<< name << ": " << total.ops << " ops in "
+			<< seconds << " s" << std::endl;
+	}
+
+	return OBJECT {
+		KVPAIR("load", name),
+		KVPAIR("connections", config.conns),
+		KVPAIR("pipeline", config.depth),
+		KVPAIR("ops", total.ops),
+		KVPAIR("found", total.found),
+		KVPAIR("errors", total.errors),
+		KVPAIR("seconds", seconds),
+		KVPAIR("ops_per_sec", (seconds > 0) ? (double(total.ops) / seconds) : 0.0),
+		KVPAIR("pipeline_latency_us", OBJECT {
+			KVPAIR("p50", Percentile(total.latencies, 50)),
+			KVPAIR("p99", Percentile(total.latencies, 99)),
+			KVPAIR("p999", Percentile(total.latencies, 99.9)),
+			KVPAIR("max", Percentile(total.latencies, 100))
+		})
+	};
+}
+
+static int
+usage(const char *prog)
+{
+	std::cerr
+		<< prog
+		<< " [-host <host>] [-port <port>] [-conns <connections>]" << std::endl
+		<< "        [-pipeline <depth>] [-num <keys>] [-ops <ops> | -duration <seconds>]" << std::endl
+		<< "        [-reads <%_of_reads>] [-vsize <value_size>] [-fill] [-seed <n>]" << std::endl
+		<< "        [-pretty] [-v]" << std::endl;
+	return 1;
+}
+
+int
+main(int argc, const char **argv)
+{
+	bool pretty = false;
+	load_config_t config;
+	char prog[MAXPATHLEN + 1];
+
+	config.host = "localhost";
+	config.port = 16790;
+	config.conns = 4;
+	config.depth = 16;
+	config.num = 100000;
+	config.ops = -1;
+	config.duration = 10;
+	config.reads = 90;
+	config.vsize = 100;
+	config.fill = false;
+	config.seed = 301;
+
+	snf::basename(prog, MAXPATHLEN + 1, argv[0], true);
+
+	for (int i = 1; i < argc; ++i) {
+		const char *opt = argv[i];
+
+		if (strcmp("-pretty", opt) == 0) {
+			pretty = true;
+			continue;
+		} else if (strcmp("-fill", opt) == 0) {
+			config.fill = true;
+			continue;
+		} else if (strcmp("-v", opt) == 0) {
+			Verbosity = true;
+			continue;
+		}
+
+		++i;
+		if (argv[i] == 0) {
+			std::cerr << "missing argument to " << opt << std::endl;
+			return usage(prog);
+		}
+
+		if (strcmp("-host", opt) == 0) {
+			config.host = argv[i];
+		} else if (strcmp("-port", opt) == 0) {
+			config.port = atoi(argv[i]);
+		} else if (strcmp("-conns", opt) == 0) {
+			config.conns = atoi(argv[i]);
+		} else if (strcmp("-pipeline", opt) == 0) {
+			config.depth = atoi(argv[i]);
+		} else if (strcmp("-num", opt) == 0) {
+			config.num = atoll(argv[i]);
+		} else if (strcmp("-ops", opt) == 0) {
+			config.ops = atoll(argv[i]);
+		} else if (strcmp("-duration", opt) == 0) {
+			config.duration = atoi(argv[i]);
+		} else if (strcmp("-reads", opt) == 0) {
+			config.reads = atoi(argv[i]);
+		} else if (strcmp("-vsize", opt) == 0) {
+			config.vsize = atoi(argv[i]);
+		} else if (strcmp("-seed", opt) == 0) {
+			config.seed = strtoull(argv[i], 0, 10);
+		} else {
+			return usage(prog);
+		}
+	}
+
+	if ((config.port <= 0) || (config.port > 65535) ||
+		(config.conns <= 0) || (config.depth <= 0) || (config.num <= 0)) {
+		std::cerr << "invalid port, connections, pipeline depth or number of keys" << std::endl;
+		return 1;
+	}
+
+	if ((config.ops < 0) && (config.duration <= 0)) {
+		std::cerr << "invalid duration" << std::endl;
+		return 1;
+	}
+
+	if ((config.reads < 0) || (config.reads > 100)) {
+		std::cerr << "invalid read percentage (" << config.reads << ")" << std::endl;
+		return 1;
+	}
+
+	if ((config.vsize <= 0) || (config.vsize > MAX_VALUE_LENGTH)) {
+		std::cerr << "invalid value size (" << config.vsize << ")" << std::endl;
+		return 1;
+	}
+
+	// errors are in the report
+	snf::log::manager::instance().add_logger(
+		DBG_NEW snf::log::console_logger(snf::log::severity::warning));
+
+	snf::net::initialize();
+
+	snf::json::array results;
+
+	if (config.fill)
+		results.add(Load("fill", config, true));
+	results.add(Load((config.reads == 100) ? "read" : "mixed", config, false));
+
+	snf::net::finalize();
+
+	snf::json::value report = OBJECT {
+		KVPAIR("server", OBJECT {
+			KVPAIR("host", config.host),
+			KVPAIR("port", config.port)
+		}),
+		KVPAIR("config", OBJECT {
+			KVPAIR("num", config.num),
+			KVPAIR("ops", config.ops),
+			KVPAIR("duration", config.duration),
+			KVPAIR("reads", config.reads),
+			KVPAIR("vsize", config.vsize),
+			KVPAIR("seed", int64_t(config.seed))
+		}),
+		KVPAIR("results", results)
+	};
+
+	std::cout << report.str(pretty) << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,164 @@
+#include "server.h"
+#include "error.h"
+#include "handler.h"
+#include "logmgr.h"
+#include <thread>
+
+namespace snf {
+namespace rdbd {
+
+snf::net::socket *
+server::setup_socket(in_port_t port)
+{
+	try {
+		std::unique_ptr<snf::net::socket> s(
+			DBG_NEW snf::net::socket(AF_INET, snf::net::socket_type::tcp));
+		s->keepalive(true);
+		s->tcpnodelay(true);
+		s->reuseaddr(true);
+		s->blocking(false);
+		s->bind(AF_INET, port);
+		s->listen(128);
+
+		m_port = s->local_address().port();
+
+		DEBUG_STRM("server")
+			<< "socket " << *s
+			<< " bound to port "
+			<< m_port
+			<< snf::log::record::endl;
+
+		return s.release();
+	} catch (std::system_error &ex) {
+		ERROR_STRM("server", ex.code().value())
+			<< ex.what()
+			<< snf::log::record::endl;
+		return nullptr;
+	}
+}
+
+/**
+ * Starts the server.
+ *
+ * @param [in] rdb      - open database to serve.
+ * @param [in] port     - port to listen on, 0 for an
+ *                        ephemeral port (see port()).
+ * @param [in] nthreads - number of worker threads.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+server::start(Rdb *rdb, in_port_t port, int nthreads)
+{
+	if (m_started)
+		return E_ok;
+
+	if (m_stopped) {
+		ERROR_STRM("server")
+			<< "server cannot be restarted once it is stopped"
+			<< snf::log::record::endl;
+		return E_invalid_state;
+	}
+
+	if ((rdb == nullptr) || (nthreads <= 0)) {
+		ERROR_STRM("server")
+			<< "invalid database or thread count"
+			<< snf::log::record::endl;
+		return E_invalid_arg;
+	}
+
+	m_rdb = rdb;
+
+	std::unique_ptr<snf::net::socket> sock(setup_socket(port));
+	if (!sock) {
+		ERROR_STRM("server")
+			<< "failed to get socket bound to port "
+			<< port
+			<< snf::log::record::endl;
+		return E_bind_failed;
+	}
+
+	m_thrdpool.reset(DBG_NEW snf::thread_pool(nthreads));
+
+	INFO_STRM("server")
+		<< "listening on port "
+		<< m_port
+		<< " with "
+		<< nthreads
+		<< " worker threads"
+		<< snf::log::record::endl;
+
+	sock_t s = *sock;
+	m_reactor.add_handler(
+		s,
+		snf::net::event::read,
+		DBG_NEW accept_handler(*this, sock.release()));
+
+	m_started = true;
+
+	return E_ok;
+}
+
+/**
+ * Starts shipping the changes to a follower.
+ *
+ * @param [in] s    - follower connection; owned by the server
+ *                    from here on.
+ * @param [in] id   - ID of the follow request.
+ * @param [in] from - sequence of the first change to send.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+server::add_follower(snf::net::socket *s, uint32_t id, uint64_t from)
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+
+	if (m_stopping) {
+		s->close();
+		delete s;
+		return E_invalid_state;
+	}
+
+	m_shippers++;
+	std::thread([this, s, id, from] {
+		ship_changes(this, s, id, from);
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_shippers--;
+		m_cond.notify_all();
+	}).detach();
+
+	return E_ok;
+}
+
+/**
+ * Stops the server. The reactor is stopped first so that no
+ * more connections are handed over to the thread pool, which
+ * is stopped next. The followers are then disconnected, in at
+ * most a heartbeat interval. The database is not closed.
+ *
+ * @return E_ok on success, -ve error code on failure.
+ */
+int
+server::stop()
+{
+	if (m_stopped)
+		return E_ok;
+
+	m_stopping = true;
+	m_reactor.stop();
+	if (m_thrdpool)
+		m_thrdpool->stop();
+
+	{
+		std::unique_lock<std::mutex> guard(m_lock);
+		m_cond.wait(guard, [this] { return m_shippers == 0; });
+	}
+
+	m_started = false;
+	m_stopped = true;
+	return E_ok;
+}
+
+} // namespace rdbd
+} // namespace snf
@@ -0,0 +1,18 @@
+#include <atomic>
+#include <thread>
+#include "test.h"
+#include "testmain.h"
+#include "servertest.h"
+#include "repltest.h"
+
+namespace snf {
+namespace tf {
+
+test *test_list[] = {
+	DBG_NEW servertest(),
+	DBG_NEW repltest(),
+	0
+};
+
+} // namespace tf
+} // namespace snf
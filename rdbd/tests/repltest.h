@@ -0,0 +1,316 @@
+#include "net.h"
+#include "server.h"
+#include "client.h"
+#include "follower.h"
+#include "filesystem.h"
+#include "file.h"
+
+class repltest : public snf::tf::test
+{
+private:
+	static const int NKEYS = 50;
+	static const int SEGSIZE = 64;
+	static const int SEGMENTS = 2;
+	static const int SKEYS = 400;
+
+	static std::string make_key(int i)
+	{
+		char key[32];
+		snprintf(key, sizeof(key), "replkey%04d", i);
+		return key;
+	}
+
+	static std::string make_value(int i, int gen)
+	{
+		char value[32];
+		snprintf(value, sizeof(value), "replvalue%04d-%d", i, gen);
+		return value;
+	}
+
+	/*
+	 * Checks that the follower has the value, or does not have
+	 * the key.
+	 */
+	bool check(snf::rdbd::client &clnt, const std::string &key, const std::string &value)
+	{
+		char buf[MAX_VALUE_LENGTH];
+		int buflen = sizeof(buf);
+
+		int retval = clnt.get(key.data(), int(key.size()), buf, &buflen);
+		m_strm << "follower get: key = " << key;
+		if (value.empty()) {
+			ASSERT_EQ(int, retval, E_not_found, m_strm.str());
+		} else {
+			ASSERT_EQ(int, retval, E_ok, m_strm.str());
+			ASSERT_EQ(std::string, std::string(buf, buflen), value, m_strm.str());
+		}
+		m_strm.str("");
+		return true;
+	}
+
+public:
+	repltest() : snf::tf::test() {}
+	~repltest() {}
+
+	virtual const char *name() const
+	{
+		return "Replication Test";
+	}
+
+	virtual const char *description() const
+	{
+		return "Follows a primary rdbd server";
+	}
+
+	bool replicate(Rdb &primary, snf::rdbd::server &psrvr, const std::string &fpath)
+	{
+		TEST_LOG("snapshot/follow");
+
+		snf::rdbd::client pclnt;
+		int retval = pclnt.connect("127.0.0.1", psrvr.port(), 5000);
+		ASSERT_EQ(int, retval, E_ok, "primary connect");
+
+		std::string key;
+		std::string value;
+
+		for (int i = 0; i < NKEYS; ++i) {
+			key = make_key(i);
+			value = make_value(i, 1);
+			retval = pclnt.set(key.data(), int(key.size()), value.data(), int(value.size()));
+			ASSERT_EQ(int, retval, E_ok, "primary set");
+		}
+
+		retval = snf::rdbd::follower::snapshot("127.0.0.1", psrvr.port(), fpath, "repldb");
+		ASSERT_EQ(int, retval, E_ok, "snapshot");
+
+		// changes after the snapshot
+		for (int i = 0; i < NKEYS / 2; ++i) {
+			key = make_key(i);
+			value = make_value(i, 2);
+			retval = pclnt.set(key.data(), int(key.size()), value.data(), int(value.size()));
+			ASSERT_EQ(int, retval, E_ok, "primary update");
+		}
+
+		RdbOptions options;
+		options.syncDataFile(false);
+		Rdb replica(fpath, "repldb", 1024, 11, options);
+
+		retval = replica.open();
+		ASSERT_EQ(int, retval, E_ok, "follower database open");
+
+		bool ok = false;
+
+		{
+			snf::rdbd::server fsrvr;
+			snf::rdbd::follower fllwr;
+
+			fsrvr.read_only(true);
+			retval = fsrvr.start(&replica, 0, 2);
+			ASSERT_EQ(int, retval, E_ok, "follower server start");
+
+			retval = fllwr.start(&replica, "127.0.0.1", psrvr.port());
+			ASSERT_EQ(int, retval, E_ok, "follower start");
+
+			retval = fllwr.wait_for(primary.lastSequence(), 10000);
+			ASSERT_EQ(int, retval, E_ok, "follower caught up");
+
+			snf::rdbd::client fclnt;
+			retval = fclnt.connect("127.0.0.1", fsrvr.port(), 5000);
+			ASSERT_EQ(int, retval, E_ok, "follower connect");
+
+			for (int i = 0; i < NKEYS; ++i) {
+				if (!check(fclnt, make_key(i), make_value(i, (i < NKEYS / 2) ? 2 : 1)))
+					return false;
+			}
+
+			key = make_key(0);
+			value = make_value(0, 3);
+			retval = fclnt.set(key.data(), int(key.size()), value.data(), int(value.size()));
+			ASSERT_EQ(int, retval, E_invalid_state, "follower set");
+			retval = fclnt.remove(key.data(), int(key.size()));
+			ASSERT_EQ(int, retval, E_invalid_state, "follower remove");
+
+			// changes while following
+			for (int i = 0; i < NKEYS / 4; ++i) {
+				key = make_key(i);
+				retval = pclnt.remove(key.data(), int(key.size()));
+				ASSERT_EQ(int, retval, E_ok, "primary remove");
+			}
+
+			retval = fllwr.wait_for(primary.lastSequence(), 10000);
+			ASSERT_EQ(int, retval, E_ok, "follower caught up");
+
+			for (int i = 0; i < NKEYS / 4; ++i) {
+				if (!check(fclnt, make_key(i), std::string()))
+					return false;
+			}
+
+			// the changes missed while stopped are no longer
+			// in the change feed
+			fllwr.stop();
+
+			for (int i = 0; i < SEGSIZE * (SEGMENTS + 1); ++i) {
+				key = make_key(NKEYS - 1);
+				value = make_value(NKEYS - 1, i);
+				retval = pclnt.set(key.data(), int(key.size()), value.data(), int(value.size()));
+				ASSERT_EQ(int, retval, E_ok, "primary update");
+			}
+
+			retval = fllwr.start(&replica, "127.0.0.1", psrvr.port());
+			ASSERT_EQ(int, retval, E_ok, "follower start");
+
+			retval = fllwr.wait_for(primary.lastSequence(), 10000);
+			ASSERT_EQ(int, retval, E_not_found, "follower too far behind");
+			ASSERT_EQ(int, fllwr.status(), E_not_found, "follower status");
+
+			fclnt.close();
+			fllwr.stop();
+			fsrvr.stop();
+			ok = true;
+		}
+
+		pclnt.close();
+
+		retval = replica.close();
+		ASSERT_EQ(int, retval, E_ok, "follower database close");
+
+		return ok;
+	}
+
+	/*
+	 * Takes a snapshot into a directory with files left over from
+	 * an earlier database: the derived ones are to be removed.
+	 */
+	bool replicate_snapshot(const std::string &dbPath)
+	{
+		TEST_LOG("snapshot over an earlier database");
+
+		std::string ppath(dbPath);
+		ppath.push_back(snf::pathsep());
+		ppath.append("sprimary");
+
+		std::string fpath(dbPath);
+		fpath.push_back(snf::pathsep());
+		fpath.append("sfollower");
+
+		int retval = snf::fs::mkdir(ppath.c_str(), 0700);
+		ASSERT_EQ(int, retval, E_ok, "primary directory");
+
+		RdbOptions options;
+		options.syncDataFile(false);
+
+		Rdb primary(ppath, "snapdb", 1024, 31, options);
+
+		retval = primary.open();
+		ASSERT_EQ(int, retval, E_ok, "primary database open");
+
+		std::string key;
+		std::string value;
+
+		for (int i = 0; i < SKEYS; ++i) {
+			key = make_key(i);
+			value = make_value(i, 0);
+			retval = primary.set(key.data(), int(key.size()), value.data(), int(value.size()));
+			ASSERT_EQ(int, retval, E_ok, "primary set");
+		}
+
+		// left over from an earlier database
+		std::string warm = fpath + snf::pathsep() + "snapdb.warm";
+		retval = snf::fs::mkdir(fpath.c_str(), 0700);
+		ASSERT_EQ(int, retval, E_ok, "follower directory");
+		{
+			snf::file_ptr fp(warm, "w");
+			fputs("stale", fp);
+		}
+
+		{
+			snf::rdbd::server psrvr;
+			retval = psrvr.start(&primary, 0, 2);
+			ASSERT_EQ(int, retval, E_ok, "primary server start");
+
+			retval = snf::rdbd::follower::snapshot("127.0.0.1", psrvr.port(), fpath, "snapdb");
+			psrvr.stop();
+			ASSERT_EQ(int, retval, E_ok, "snapshot");
+		}
+
+		retval = primary.close();
+		ASSERT_EQ(int, retval, E_ok, "primary database close");
+
+		std::string scratch = ppath + snf::pathsep() + "snapdb.snapshot.1";
+		ASSERT_EQ(bool, snf::fs::exists(scratch.c_str()), false, "snapshot directory removed");
+		ASSERT_EQ(bool, snf::fs::exists(warm.c_str()), false, "stale warm-up manifest removed");
+
+		Rdb replica(fpath, "snapdb", 1024, 31, options);
+
+		retval = replica.open();
+		ASSERT_EQ(int, retval, E_ok, "follower database open");
+
+		for (int i = 0; i < SKEYS; ++i) {
+			char buf[MAX_VALUE_LENGTH];
+			int buflen = sizeof(buf);
+
+			key = make_key(i);
+			retval = replica.get(key.data(), int(key.size()), buf, &buflen);
+			m_strm << "follower get: key = " << key;
+			ASSERT_EQ(int, retval, E_ok, m_strm.str());
+			ASSERT_EQ(std::string, std::string(buf, buflen), make_value(i, 0), m_strm.str());
+			m_strm.str("");
+		}
+
+		retval = replica.close();
+		ASSERT_EQ(int, retval, E_ok, "follower database close");
+
+		return true;
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		ASSERT_NE(const snf::config *, conf, nullptr, "check config");
+		const char *dbPath = conf->get("DBPATH");
+		ASSERT_NE(const char *, dbPath, nullptr, "get DBPATH from config");
+
+		std::string ppath(dbPath);
+		ppath.push_back(snf::pathsep());
+		ppath.append("primary");
+
+		std::string fpath(dbPath);
+		fpath.push_back(snf::pathsep());
+		fpath.append("follower");
+
+		snf::net::initialize();
+
+		int retval = snf::fs::mkdir(ppath.c_str(), 0700);
+		ASSERT_EQ(int, retval, E_ok, "primary directory");
+
+		RdbOptions options;
+		options.syncDataFile(false);
+		options.changeFeed(true);
+		options.setFeedSegmentSize(SEGSIZE);
+		options.setFeedSegments(SEGMENTS);
+
+		Rdb primary(ppath, "repldb", 1024, 11, options);
+
+		retval = primary.open();
+		ASSERT_EQ(int, retval, E_ok, "primary database open");
+
+		bool ok = false;
+
+		{
+			snf::rdbd::server psrvr;
+			retval = psrvr.start(&primary, 0, 2);
+			ASSERT_EQ(int, retval, E_ok, "primary server start");
+
+			ok = replicate(primary, psrvr, fpath);
+
+			psrvr.stop();
+		}
+
+		retval = primary.close();
+		ASSERT_EQ(int, retval, E_ok, "primary database close");
+
+		if (ok)
+			ok = replicate_snapshot(dbPath);
+
+		return ok;
+	}
+};
@@ -0,0 +1,212 @@
+#include "net.h"
+#include "server.h"
+#include "client.h"
+
+class servertest : public snf::tf::test
+{
+private:
+	static const int NKEYS = 100;
+
+	static std::string make_key(int i)
+	{
+		char key[32];
+		snprintf(key, sizeof(key), "rdbdkey%04d", i);
+		return key;
+	}
+
+	static std::string make_value(int i)
+	{
+		char value[32];
+		snprintf(value, sizeof(value), "rdbdvalue%04d", i);
+		return value;
+	}
+
+public:
+	servertest() : snf::tf::test() {}
+	~servertest() {}
+
+	virtual const char *name() const
+	{
+		return "Server Test";
+	}
+
+	virtual const char *description() const
+	{
+		return "Serves a database over the rdbd protocol";
+	}
+
+	bool single(snf::rdbd::client &clnt)
+	{
+		TEST_LOG("get/set/remove");
+
+		std::string key = make_key(0);
+		std::string value = make_value(0);
+		char buf[MAX_VALUE_LENGTH];
+		int buflen = sizeof(buf);
+
+		int retval = clnt.set(key.data(), int(key.size()), value.data(), int(value.size()));
+		ASSERT_EQ(int, retval, E_ok, "set");
+
+		retval = clnt.get(key.data(), int(key.size()), buf, &buflen);
+		ASSERT_EQ(int, retval, E_ok, "get");
+		ASSERT_EQ(std::string, std::string(buf, buflen), value, "get: value");
+
+		buflen = 4;
+		retval = clnt.get(key.data(), int(key.size()), buf, &buflen);
+		ASSERT_EQ(int, retval, E_insufficient_buffer, "get: small buffer");
+
+		retval = clnt.remove(key.data(), int(key.size()));
+		ASSERT_EQ(int, retval, E_ok, "remove");
+
+		buflen = sizeof(buf);
+		retval = clnt.get(key.data(), int(key.size()), buf, &buflen);
+		ASSERT_EQ(int, retval, E_not_found, "get: removed key");
+
+		retval = clnt.remove(key.data(), int(key.size()));
+		ASSERT_EQ(int, retval, E_not_found, "remove: removed key");
+
+		retval = clnt.set(key.data(), int(key.size()), value.data(), int(value.size()), 3600);
+		ASSERT_EQ(int, retval, E_ok, "set with ttl");
+
+		buflen = sizeof(buf);
+		retval = clnt.get(key.data(), int(key.size()), buf, &buflen);
+		ASSERT_EQ(int, retval, E_ok, "get: key with ttl");
+
+		std::string longkey(MAX_KEY_LENGTH + 1, 'k');
+		retval = clnt.set(longkey.data(), int(longkey.size()), value.data(), int(value.size()));
+		ASSERT_EQ(int, retval, E_invalid_arg, "set: key too long");
+
+		std::string longvalue(MAX_VALUE_LENGTH + 1, 'v');
+		retval = clnt.set(key.data(), int(key.size()), longvalue.data(), int(longvalue.size()));
+		ASSERT_EQ(int, retval, E_invalid_arg, "set: value too long");
+
+		// the connection is still usable
+		ASSERT_EQ(bool, clnt.is_connected(), true, "connected after invalid requests");
+
+		return true;
+	}
+
+	bool pipelined(snf::rdbd::client &clnt)
+	{
+		TEST_LOG("pipeline/multi_get");
+
+		std::vector<snf::rdbd::request> requests;
+		std::vector<std::vector<snf::rdbd::result>> results;
+		std::vector<std::string> keys;
+
+		for (int i = 0; i < NKEYS; ++i) {
+			requests.push_back(snf::rdbd::request::set(make_key(i), make_value(i)));
+			requests.push_back(snf::rdbd::request::get(make_key(i)));
+			keys.push_back(make_key(i));
+		}
+		keys.push_back(make_key(NKEYS));
+		requests.push_back(snf::rdbd::request::multi_get(keys));
+
+		int retval = clnt.pipeline(requests, results);
+		ASSERT_EQ(int, retval, E_ok, "pipeline");
+		ASSERT_EQ(size_t, results.size(), requests.size(), "pipeline results");
+
+		for (int i = 0; i < NKEYS; ++i) {
+			m_strm << "pipelined set/get: key = " << make_key(i);
+			ASSERT_EQ(int, results[2 * i][0].status, E_ok, m_strm.str());
+			ASSERT_EQ(int, results[2 * i + 1][0].status, E_ok, m_strm.str());
+			ASSERT_EQ(std::string, results[2 * i + 1][0].value, make_value(i), m_strm.str());
+			m_strm.str("");
+		}
+
+		std::vector<snf::rdbd::result> &mget = results.back();
+		ASSERT_EQ(size_t, mget.size(), keys.size(), "multi_get results");
+		for (int i = 0; i < NKEYS; ++i) {
+			m_strm << "multi_get: key = " << make_key(i);
+			ASSERT_EQ(int, mget[i].status, E_ok, m_strm.str());
+			ASSERT_EQ(std::string, mget[i].value, make_value(i), m_strm.str());
+			m_strm.str("");
+		}
+		ASSERT_EQ(int, mget[NKEYS].status, E_not_found, "multi_get: missing key");
+
+		std::vector<snf::rdbd::result> mresults;
+		retval = clnt.multi_get({ make_key(1), std::string(MAX_KEY_LENGTH + 1, 'k') }, mresults);
+		ASSERT_EQ(int, retval, E_ok, "multi_get");
+		ASSERT_EQ(int, mresults[0].status, E_ok, "multi_get: key");
+		ASSERT_EQ(int, mresults[1].status, E_invalid_arg, "multi_get: key too long");
+
+		return true;
+	}
+
+	bool concurrent(in_port_t port)
+	{
+		TEST_LOG("concurrent clients");
+
+		const int nclients = 4;
+		std::atomic<int> failures(0);
+		std::vector<std::thread> threads;
+
+		for (int c = 0; c < nclients; ++c) {
+			threads.push_back(std::thread([&failures, port, c] {
+				snf::rdbd::client clnt;
+				if (clnt.connect("127.0.0.1", port) != E_ok) {
+					failures++;
+					return;
+				}
+
+				std::vector<snf::rdbd::request> requests;
+				std::vector<std::vector<snf::rdbd::result>> results;
+				for (int n = 0; n < 20; ++n) {
+					requests.clear();
+					for (int i = 0; i < NKEYS; ++i)
+						requests.push_back(snf::rdbd::request::get(make_key(i)));
+					if ((clnt.pipeline(requests, results) != E_ok) ||
+						(results[c][0].value != make_value(c)))
+						failures++;
+				}
+			}));
+		}
+
+		for (std::thread &t : threads)
+			t.join();
+
+		ASSERT_EQ(int, failures, 0, "concurrent pipelines");
+		return true;
+	}
+
+	virtual bool execute(const snf::config *conf)
+	{
+		ASSERT_NE(const snf::config *, conf, nullptr, "check config");
+		const char *dbPath = conf->get("DBPATH");
+		ASSERT_NE(const char *, dbPath, nullptr, "get DBPATH from config");
+		const char *dbName = conf->get("DBNAME");
+		ASSERT_NE(const char *, dbName, nullptr, "get DBNAME from config");
+
+		snf::net::initialize();
+
+		RdbOptions options;
+		options.syncDataFile(false);
+		Rdb rdb(dbPath, dbName, 1024, 11, options);
+
+		int retval = rdb.open();
+		ASSERT_EQ(int, retval, E_ok, "database open");
+
+		bool ok = false;
+
+		{
+			snf::rdbd::server srvr;
+			retval = srvr.start(&rdb, 0, 2);
+			ASSERT_EQ(int, retval, E_ok, "server start");
+			ASSERT_NE(in_port_t, srvr.port(), 0, "server port");
+
+			snf::rdbd::client clnt;
+			retval = clnt.connect("127.0.0.1", srvr.port(), 5000);
+			ASSERT_EQ(int, retval, E_ok, "client connect");
+
+			ok = single(clnt) && pipelined(clnt) && concurrent(srvr.port());
+
+			clnt.close();
+			srvr.stop();
+		}
+
+		retval = rdb.close();
+		ASSERT_EQ(int, retval, E_ok, "database close");
+
+		return ok;
+	}
+};